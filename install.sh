@@ -41,8 +41,12 @@ echo -n "Building data..."
 ./util/makedb.pl
 echo "done"
 
+echo -n "Compiling binary database..."
+./util/makebindb.pl share/agl/data/germline.db share/agl/data staticdata
+echo "done"
+
 echo -n "Copying files to ${dest}..."
-cp agl $dest
+cp agl aglbin2txt $dest
 cp -p share/agl/data/* $datadest
 cp -p staticdata/*     $datadest
 echo "done"
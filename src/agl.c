@@ -4,8 +4,8 @@
    Program:    agl (Assign Germ Line)
    \file       agl.c
    
-   \version    V1.8
-   \date       19.03.25
+   \version    V1.34
+   \date       17.10.26
    \brief      Assigns IMGT germline
    
    \copyright  (c) UCL / Prof. Andrew C. R. Martin 2020-25
@@ -57,72 +57,184 @@
                     alignment
    V1.7   22.04.23  Adds info on IGHG1*08 and IGHG1*15
    V1.8   19.03.25  Added hinges
+   V1.9   17.10.26  Germline databases are read once and kept in memory
+   V1.10  17.10.26  Ties are broken on gene names parsed when the
+                    database is loaded
+   V1.11  17.10.26  Species selection uses the partitioned database
+   V1.12  17.10.26  Each unique germline sequence is aligned only once
+                    per scan
+   V1.13  17.10.26  Added k-mer prefilter (-k and -x)
+   V1.14  18.10.26  Alignments use the in-tree SIMD kernels in align.c
+   V1.15  18.10.26  Candidate sequences are scored in blocks with one
+                    sequence per SIMD lane and only the best is aligned
+   V1.16  18.10.26  Added -j to process sequences in parallel threads
+   V1.17  18.10.26  The germline assignment code is moved to libagl.c.
+                    This file just handles the command line and prints
+                    the AGLRESULT for each sequence
+   V1.18  18.10.26  Added --serve and --client. Options are collected
+                    in an OPTIONS structure
+   V1.19  18.10.26  Added -c to assign each distinct sequence only once
+   V1.20  18.10.26  Added -C to keep results on disk between runs
+   V1.21  18.10.26  J, C and hinge regions are only searched for after
+                    the domains before them. Added -r and -R
+   V1.22  18.10.26  Added -t to run the scans for each sequence at the
+                    same time
+   V1.23  18.10.26  FASTA input is read with fastain.c so there is no
+                    limit on the length of a header or sequence
+   V1.24  18.10.26  Added --format airr for tab-separated output with
+                    one row per sequence
+   V1.25  18.10.26  Added --format binary
+   V1.26  18.10.26  Added --stats
+   V1.27  18.10.26  --stats also counts the entries, alignments and
+                    ties for each database type and times the input
+                    and output
+   V1.28  18.10.26  Added --trace and --trace-sample
+   V1.29  18.10.26  Errors about individual sequences are sent back to
+                    --client rather than printed by the server
+   V1.30  18.10.26  The --client request is allocated to fit rather than
+                    cutting a long species short
+   V1.31  18.10.26  The whole sequence is searched for every region
+                    unless -r is given
+   V1.32  18.10.26  Every germline sequence is aligned unless -k is
+                    given
+   V1.33  18.10.26  --client passes on -k, -x, -r and -R
+   V1.34  18.10.26  A data directory whose path is too long is reported
 
 *************************************************************************/
 /* Includes
 */
-#define USEPATH 1
-
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
+#include <pthread.h>
 #include "bioplib/seq.h"
 #include "bioplib/sequtil.h"
 #include "bioplib/general.h"
 #include "bioplib/macros.h"
-#include "findfields.h"
 #include "agl.h"
-#include "whereami/whereami.h"
+#include "libagl.h"
+#include "pipeline.h"
+#include "server.h"
+#include "fastain.h"
+#include "aglbin.h"
+#include "stats.h"
+#include "trace.h"
 
 /************************************************************************/
 /* Defines and macros
 */
-#define BLOCK_UNDEFINED 0
-#define BLOCK_X_V       1
-#define BLOCK_D         2
+#define REQUEST_TAG  "#agl"     /* Starts a request line            */
+#define FRAMED_TAG   "#agl-framed" /* Starts the request line sent by
+                                   --client, which wants the reply in
+                                   frames (see server.c)                */
+#define MAXREQARGS   16         /* Most words in a request line         */
+
+#define FORMAT_TEXT   0         /* Output formats for --format          */
+#define FORMAT_AIRR   1
+#define FORMAT_BINARY 2
+
+#define NAIRRREGIONS 7          /* Regions given columns by --format
+                                   airr                                 */
 
 #define CHAINTYPE(x) (                            \
    (x)==CHAINTYPE_LIGHT ? "Light" :               \
     ((x)==CHAINTYPE_HEAVY ? "Heavy" : "Unknown"))
 
+/************************************************************************/
+/* Type definitions
+*/
+typedef struct
+{
+   char infile[MAXBUFF+1],      /* Input and output files or blank      */
+        outfile[MAXBUFF+1],
+        species[MAXBUFF+1],     /* Species or blank                     */
+        dataDir[MAXBUFF+1],     /* Data directory or blank              */
+        serveSocket[MAXBUFF+1], /* Socket for --serve or blank          */
+        cacheDir[MAXBUFF+1],    /* Directory for -C or blank            */
+        clientSocket[MAXBUFF+1], /* Socket for --client or blank        */
+        traceFile[MAXBUFF+1];   /* Trace file for --trace or blank      */
+   BOOL verbose,
+        showAlignment,
+        doDSegment,
+        stats;                  /* Print statistics at the end          */
+   int  format,                 /* FORMAT_ value                        */
+        chainType,
+        shortList,              /* Sequences to align (0 for all)       */
+        slack,                  /* Residues searched outside where a
+                                   domain can be (-1 for everywhere)    */
+        nThreads,               /* 0 for one per CPU, -1 if not given   */
+        scanThreads;            /* Threads for the scans of a sequence
+                                   (0 for one per CPU)                  */
+   long cacheSize;              /* Results kept in memory (0 for none)  */
+   double tracePercent;         /* Percentage of sequences traced       */
+}  OPTIONS;
+
+typedef struct
+{
+   AGLCONTEXT *context;
+   FILE       *err;             /* Errors about a sequence              */
+   BOOL       showAlignment;
+   int        format;
+   AGLBINDICT *dict;            /* Germline numbers for --format binary */
+}  PROCESSDATA;
+
+typedef struct
+{
+   char   *data;
+   size_t size,                 /* Bytes allocated                      */
+          len;                  /* Bytes used                           */
+}  OUTBUF;
+
 /************************************************************************/
 /* Globals
 */
+/* Column prefixes for --format airr and the domain labels from
+   AssignGermlines() that go in them
+*/
+static char *sAIRRRegions[NAIRRREGIONS] =
+   {"v", "d", "j", "c", "hinge", "ch2", "ch3"};
+static char *sAIRRDomains[NAIRRREGIONS][2] =
+   {{"VH", "VL"}, {"DH", NULL}, {"JH", "JL"}, {"CH1", "CL"},
+    {"HINGE", NULL}, {"CH2", NULL}, {"CH3-CHS", NULL}};
+
+/* Each thread formats its output for --format airr or binary into its
+   own buffer
+*/
+static pthread_key_t  sOutBufKey;
+static pthread_once_t sOutBufOnce = PTHREAD_ONCE_INIT;
 
 /************************************************************************/
 /* Prototypes
 */
 int main(int argc, char **argv);
 void Usage(void);
-BOOL ParseCmdLine(int argc, char **argv, char *infile, char *outfile,
-                  BOOL *verbose, BOOL *showAlignment, int *chainType,
-                  char *species, char *dataDir, BOOL *doDSegment);
-void ProcessSeq(FILE *out, char *seq, BOOL verbose, BOOL showAlignment,
-                int chainType, char *species, char *dataDir,
-                BOOL doDSegment);
-REAL ScanAgainstDB(char *type, char *seq, BOOL verbose, char *species,
-                   char *match, char *bestAlign1, char *bestAlign2,
-                   char *dataDir);
-REAL CompareSeqs(char *theSeq, char *seq, int window,
-                 char *align1, char *align2, BOOL noScale);
-BOOL PreferHeader(char *newHeader, char *oldHeader);
-void GetDomainID(char *header, char *id, int maxbuff);
-void RemoveSequence(char *seq, char *align1, char *align2, BOOL verbose);
+BOOL ParseCmdLine(int argc, char **argv, OPTIONS *options);
+void ProcessRecord(FILE *out, char *header, char *seq, void *data);
+void ServeConnection(FILE *in, FILE *out, void *data);
+char *BuildRequest(OPTIONS *options);
+BOOL SendFrame(FILE *out, int channel, FILE **fp, char **text,
+               size_t *size);
+void PrintResults(FILE *out, AGLRESULT *result, BOOL showAlignment);
 void PrintResult(FILE *out, char *domain, REAL score, char *match);
-int CalculateDbLen(char *seq);
-int CalcShortSeqLen(char *align1, char *align2);
 void PrintAlignment(FILE *out, char *align1, char *align2);
-void DoDSegment(FILE *out, char *seq, char *species, char *dataDir,
-                char *hvBestAlign1, char *hvBestAlign2, 
-                char *hjBestAlign1, char *hjBestAlign2,
-                BOOL verbose, BOOL showAlignment);
-void CopyDSegment(char *DSeq, char *seq);
-BOOL PrintSpecialMatches(FILE *out, char *CH1, char *CH2, char *CH3);
-
-#ifdef USEPATH
-char *FindPath(void);
-BOOL DirectoryExists(char *dirName);
-#endif
+void GetMatchFields(char *match, char *id, char *frame, char *species);
+void PrintAIRRHeader(FILE *out, BOOL showAlignment);
+void PrintAIRRRow(FILE *out, char *header, char *seq, AGLRESULT *result,
+                  BOOL showAlignment);
+void AddAIRRDomain(OUTBUF *buf, AGLDOMAIN *domain, int seqLen,
+                   BOOL showAlignment);
+int TrimAlignment(char *align1, char *align2, char **start);
+void AddCIGAR(OUTBUF *buf, AGLDOMAIN *domain, int seqLen);
+int CountMismatches(AGLDOMAIN *domain);
+void PrintBinaryRecord(FILE *out, char *header, AGLRESULT *result,
+                       AGLBINDICT *dict);
+AGLBINDICT *MakeGermlineDict(AGLCONTEXT *context);
+void AddOutput(OUTBUF *buf, char *format, ...);
+void AddBytes(OUTBUF *buf, void *data, size_t size);
+OUTBUF *ThreadOutBuf(void);
+void MakeOutBufKey(void);
+void FreeOutBuf(void *buf);
 
 /************************************************************************/
 /*>int main(int argc, char **argv)
@@ -131,740 +243,539 @@ BOOL DirectoryExists(char *dirName);
    Main program
 
    - 31.03.20 Original   By: ACRM
+   - 17.10.26 Creates the germline database once for all sequences
+   - 17.10.26 Sets the shortlist size
+   - 18.10.26 Sequences are processed by RunPipeline() so that -j can
+              use several threads
+   - 18.10.26 Creates an AGLCONTEXT
+   - 18.10.26 Added server and client modes. Options are in an OPTIONS
+              structure
+   - 18.10.26 Sets up the result cache for -c and reports its use
+   - 18.10.26 Sets up the on-disk cache for -C
+   - 18.10.26 Sets the slack for -r and -R
+   - 18.10.26 Sets up the scan threads for -t
+   - 18.10.26 Prints the header for --format airr
+   - 18.10.26 Makes the germline dictionary for --format binary
+   - 18.10.26 Prints the statistics for --stats
+   - 18.10.26 Writes the trace file for --trace
+   - 18.10.26 The germline database can't be set up if the data
+              directory path is too long, so the error no longer says
+              there was no memory
 */
 int main(int argc, char **argv)
 {
-   char infile[MAXBUFF+1],
-        outfile[MAXBUFF+1],
-        species[MAXBUFF+1],
-        dataDir[MAXBUFF+1];
-   BOOL verbose       = FALSE,
-        showAlignment = FALSE,
-        doDSegment    = FALSE;
-   int  chainType     = CHAINTYPE_UNKNOWN;
+   OPTIONS    options;
+   FILE       *in  = stdin,
+              *out = stdout;
+   AGLCONTEXT *context;
 
+   if(!ParseCmdLine(argc, argv, &options))
+   {
+      Usage();
+      return(0);
+   }
 
-   if(ParseCmdLine(argc, argv, infile, outfile, &verbose, &showAlignment,
-                   &chainType, species, dataDir, &doDSegment))
+   /* The client just passes the request on to the server              */
+   if(options.clientSocket[0])
    {
-      FILE *in  = stdin,
-           *out = stdout;
+      char *request;
+      BOOL ok;
 
-      if(blOpenStdFiles(infile, outfile, &in, &out))
+      if(!blOpenStdFiles(options.infile, options.outfile, &in, &out))
       {
-         char header[MAXBUFF+1];
-         char *seq = NULL;
-         BOOL ok = FALSE;
-         static char fastaBuffer[MAXBUFF+1];
-
-         while((seq = blReadFASTAExtBuffer(in, header, MAXBUFF,
-                                           fastaBuffer, MAXBUFF))!=NULL)
-         {
-            ok = TRUE;
-            fprintf(out, "%s\n", header);
-
-            ProcessSeq(out, seq, verbose, showAlignment,
-                       chainType, species, dataDir, doDSegment);
-            free(seq);
-         }
-
-         if(!ok)
-         {
-            fprintf(stderr, "No sequence found for %s\n", header);
-         }
-         
-         if(in  != stdin)  fclose(in);
-         if(out != stdout) fclose(out);
+         fprintf(stderr,"Unable to open input or output file\n");
+         return(1);
       }
-      else
+
+      if((request = BuildRequest(&options))==NULL)
       {
-         fprintf(stderr,"Unable to open input or output file\n");
+         fprintf(stderr,"No memory for request\n");
          return(1);
       }
+      ok = RunClient(options.clientSocket, request, in, out, stderr);
+      free(request);
+
+      if(in  != stdin)  fclose(in);
+      if(out != stdout) fclose(out);
+      return(ok ? 0 : 1);
    }
-   else
+
+   if(options.stats)
+      EnableStats();
+   if(options.traceFile[0] &&
+      !OpenTrace(options.traceFile, options.tracePercent))
    {
-      Usage();
+      fprintf(stderr,"Unable to write trace file %s\n", options.traceFile);
+      return(1);
    }
-   
-   return(0);
-}
-
 
-/************************************************************************/
-/*>void ProcessSeq(FILE *out, char *seq, BOOL verbose, BOOL showAlignment,
-                   int chainType, char *species, char *dataDir,
-                   BOOL doDSegment)
-   ------------------------------------------------------------------
-*//**
-   \param[in]   out            Output file pointer
-   \param[in]   seq            Sequence to analyze
-   \param[in]   verbose        Verbose output
-   \param[in]   showAlignment  Show the alignment of each region
-   \param[in]   chainType      Type of chain (or unknown)
-   \param[in]   species        "Homo", "Mus" or blank
-   \param[in]   dataDir        Data directory
-   \param[in]   doDSegment     Handle D-segment for heavy chains
+   if((context = InitAGL(options.dataDir, options.species,
+                         options.chainType, options.doDSegment,
+                         options.shortList, options.verbose))==NULL)
+   {
+      fprintf(stderr,"Unable to set up germline database\n");
+      return(1);
+   }
+   SetAGLSlack(context, options.slack);
 
-   - 31.03.20 Original   By: ACRM
-   - 14.04.20 Added showAlignment
-   - 26.04.23 Added D-segment handling
-   - 19.03.25 Added hinge handling
-CHECKED - ERROR IS IN ScanAgainstDB
-*/
-void ProcessSeq(FILE *out, char *seq, BOOL verbose, BOOL showAlignment,
-                int chainType, char *species, char *dataDir,
-                BOOL doDSegment)
+   if(!SetAGLThreads(context, (options.scanThreads == 0) ?
+                     CountCPUs() : options.scanThreads))
+   {
+      fprintf(stderr,"Unable to start scan threads\n");
+      FreeAGL(context);
+      return(1);
+   }
 
-{
-   char        lvMatch[MAXBUFF+1],
-               hvMatch[MAXBUFF+1],
-               ljMatch[MAXBUFF+1],
-               hjMatch[MAXBUFF+1],
-               lcMatch[MAXBUFF+1],
-               CH1Match[MAXBUFF+1],
-               CH2Match[MAXBUFF+1],
-               hingeMatch[MAXBUFF+1],
-               CH3CHSMatch[MAXBUFF+1];
-   static char lvBestAlign1[HUGEBUFF+1],
-               lvBestAlign2[HUGEBUFF+1],
-               hvBestAlign1[HUGEBUFF+1],
-               hvBestAlign2[HUGEBUFF+1],
-               lcBestAlign1[HUGEBUFF+1],
-               lcBestAlign2[HUGEBUFF+1],
-               CH1BestAlign1[HUGEBUFF+1],
-               CH1BestAlign2[HUGEBUFF+1],
-               CH2BestAlign1[HUGEBUFF+1],
-               CH2BestAlign2[HUGEBUFF+1],
-               CH3BestAlign1[HUGEBUFF+1],
-               CH3BestAlign2[HUGEBUFF+1],
-               hingeBestAlign1[HUGEBUFF+1],
-               hingeBestAlign2[HUGEBUFF+1],
-               bestAlign1[HUGEBUFF+1],
-               bestAlign2[HUGEBUFF+1];
-   REAL        lvScore     = -1.0,
-               hvScore     = -1.0,
-               ljScore     = -1.0,
-               hjScore     = -1.0,
-               lcScore     = -1.0,
-               CH1Score    = -1.0,
-               CH2Score    = -1.0,
-               hingeScore  = -1.0,
-               CH3CHSScore = -1.0;
-
-   /* Find out what the chain type is if it isn't specified             */
-   if(chainType == CHAINTYPE_UNKNOWN)
+   if(!SetAGLCache(context, options.cacheSize))
    {
-      lvScore = ScanAgainstDB("light_v", seq, verbose, species,
-                              lvMatch,  lvBestAlign1, lvBestAlign2,
-                              dataDir);
-      hvScore = ScanAgainstDB("heavy_v", seq, verbose, species,
-                              hvMatch,  hvBestAlign1, hvBestAlign2,
-                              dataDir);
-      if((lvScore > hvScore) && (lvScore > THRESHOLD_LV))
-      {
-         chainType = CHAINTYPE_LIGHT;
-      }
-      else if((hvScore > lvScore) && (hvScore > THRESHOLD_HV))
-      {
-         chainType = CHAINTYPE_HEAVY;
-      }
-      
-      if(chainType == CHAINTYPE_UNKNOWN)
-      {
-         lcScore  = ScanAgainstDB("light_c", seq, verbose, species,
-                                  lcMatch,  lcBestAlign1,  lcBestAlign2,
-                                  dataDir);
-         CH1Score = ScanAgainstDB("CH1",     seq, verbose, species,
-                                  CH1Match, CH1BestAlign1, CH1BestAlign2,
-                                  dataDir);
-      }
+      fprintf(stderr,"No memory for result cache\n");
+      FreeAGL(context);
+      return(1);
+   }
+   if(options.cacheDir[0] && !SetAGLCacheDir(context, options.cacheDir))
+   {
+      fprintf(stderr,"Unable to use cache directory %s\n",
+              options.cacheDir);
+      FreeAGL(context);
+      return(1);
+   }
 
-      if((lcScore > CH1Score) && (lcScore > THRESHOLD_LC))
-      {
-         chainType = CHAINTYPE_LIGHT;
-      }
-      else if((CH1Score > lcScore) && (CH1Score > THRESHOLD_HC))
-      {
-         chainType = CHAINTYPE_HEAVY;
-      }
-      fprintf(out, "# Chain type: %s\n", CHAINTYPE(chainType));
+   /* -j 0 means use all the CPUs. A server uses them all by default.
+      Verbose output goes straight to stderr so would be jumbled by
+      threads
+   */
+   if((options.nThreads == 0) ||
+      ((options.nThreads < 0) && options.serveSocket[0]))
+      options.nThreads = CountCPUs();
+   if((options.nThreads < 0) || options.verbose)
+      options.nThreads = 1;
+
+   if(options.serveSocket[0])
+   {
+      PROCESSDATA processData;
+
+      processData.context       = context;
+      processData.err           = stderr;
+      processData.showAlignment = options.showAlignment;
+      processData.format        = options.format;
+
+      /* Only returns if the server couldn't be started                */
+      LoadAGL(context);
+      processData.dict = MakeGermlineDict(context);
+      RunServer(options.serveSocket, options.nThreads, ServeConnection,
+                &processData);
+      FreeAGL(context);
+      return(1);
    }
 
-   switch(chainType)
+   if(blOpenStdFiles(options.infile, options.outfile, &in, &out))
    {
-   case CHAINTYPE_LIGHT:
-      if(lvScore < 0.0)
-         lvScore = ScanAgainstDB("light_v", seq, verbose, species,
-                                 lvMatch, lvBestAlign1, lvBestAlign2,
-                                 dataDir);
-      if(lvScore > THRESHOLD_LV)
-      {
-         PrintResult(out, "VL", lvScore, lvMatch);
-         if(showAlignment)
-            PrintAlignment(out, lvBestAlign1, lvBestAlign2);
-
-         ljScore = ScanAgainstDB("light_j", seq, verbose, species,
-                                 ljMatch, bestAlign1, bestAlign2,
-                                 dataDir);
-         if(ljScore > THRESHOLD_LJ)
-         {
-#ifdef REMOVESEQS
-            RemoveSequence(seq, lvBestAlign1, lvBestAlign2, verbose);
-            RemoveSequence(seq, bestAlign1, bestAlign2, verbose);
-#endif
-            PrintResult(out, "JL", ljScore, ljMatch);
-            if(showAlignment)
-               PrintAlignment(out, bestAlign1, bestAlign2);
-         }
-      }
+      PROCESSDATA processData;
 
-      if(lcScore < 0.0)
-         lcScore = ScanAgainstDB("light_c", seq, verbose, species,
-                                 lcMatch, lcBestAlign1, lcBestAlign2,
-                                 dataDir);
-      if(lcScore > THRESHOLD_LC)
-      {
-#ifdef REMOVESEQS
-         RemoveSequence(seq, lcBestAlign1, lcBestAlign2, verbose);
-#endif
-         PrintResult(out, "CL", lcScore, lcMatch);
-         if(showAlignment)
-            PrintAlignment(out, lcBestAlign1, lcBestAlign2);
-      }
-      
-      break;
-
-   case CHAINTYPE_HEAVY:
-      if(CH3CHSScore < 0.0)
-         CH3CHSScore = ScanAgainstDB("CH3-CHS", seq, verbose, species,
-                                     CH3CHSMatch,
-                                     CH3BestAlign1, CH3BestAlign2,
-                                     dataDir);
-#ifdef REMOVESEQS
-      if(CH3CHSScore > THRESHOLD_HC)
-         RemoveSequence(seq, CH3BestAlign1, CH3BestAlign2, verbose);
-#endif      
-      if(CH2Score < 0.0)
-         CH2Score = ScanAgainstDB("CH2", seq, verbose, species,
-                                  CH2Match, CH2BestAlign1, CH2BestAlign2,
-                                  dataDir);
-#ifdef REMOVESEQS
-      if(CH2Score > THRESHOLD_HC)
-         RemoveSequence(seq, CH2BestAlign1, CH2BestAlign2, verbose);
-#endif
-      if(CH1Score < 0.0)
-         CH1Score = ScanAgainstDB("CH1", seq, verbose, species,
-                                  CH1Match, CH1BestAlign1, CH1BestAlign2,
-                                  dataDir);
-#ifdef REMOVESEQS
-      if(CH1Score > THRESHOLD_HC)
-         RemoveSequence(seq, CH1BestAlign1, CH1BestAlign2, verbose);
-#endif      
-      if(hvScore < 0.0)
-         hvScore  = ScanAgainstDB("heavy_v", seq, verbose, species,
-                                  hvMatch, hvBestAlign1, hvBestAlign2,
-                                  dataDir);
-
-      if(CH1Match[0] && CH2Match[0])
-      {
-         hingeScore  = ScanAgainstDB("hinges", seq, verbose, species,
-                                     hingeMatch, hingeBestAlign1,
-                                     hingeBestAlign2, dataDir);
-      }
-      
-      if(hvScore > THRESHOLD_HV)
-      {
-#ifdef REMOVESEQS
-         RemoveSequence(seq, hvBestAlign1, hvBestAlign2, verbose);
-#endif
-         PrintResult(out, "VH", hvScore, hvMatch);
-         if(showAlignment)
-            PrintAlignment(out, hvBestAlign1, hvBestAlign2);
-         
-         hjScore = ScanAgainstDB("heavy_j", seq, verbose, species,
-                                 hjMatch, bestAlign1, bestAlign2,
-                                 dataDir);
-         if(hjScore > THRESHOLD_HJ)
-         {
-#ifdef REMOVESEQS
-            RemoveSequence(seq, bestAlign1, bestAlign2, verbose);
-#endif
-            PrintResult(out, "JH", hjScore, hjMatch);
-            if(showAlignment)
-               PrintAlignment(out, bestAlign1, bestAlign2);
-
-            /* If we have found both V and J, then we can try to find
-               the D segment (if required)
-            */
-            if(doDSegment)
-            {
-               DoDSegment(out, seq, species, dataDir,
-                          hvBestAlign1, hvBestAlign2,  /* V             */
-                          bestAlign1,   bestAlign2,    /* J             */
-                          verbose, showAlignment);
-            }
-         }
-      }
+      processData.context       = context;
+      processData.err           = stderr;
+      processData.showAlignment = options.showAlignment;
+      processData.format        = options.format;
+      processData.dict          = NULL;
 
-      if(CH1Score > THRESHOLD_HC)
+      if(options.format == FORMAT_AIRR)
+         PrintAIRRHeader(out, options.showAlignment);
+      if(options.format == FORMAT_BINARY)
       {
-         PrintResult(out, "CH1", CH1Score, CH1Match);
-         if(showAlignment)
-            PrintAlignment(out, CH1BestAlign1, CH1BestAlign2);
+         processData.dict = MakeGermlineDict(context);
+         WriteAGLBinHeader(out, processData.dict);
       }
-      
-      if(hingeScore > THRESHOLD_HINGE)
-      {
-         PrintResult(out, "HINGE", hingeScore, hingeMatch);
-         if(showAlignment)
-            PrintAlignment(out, hingeBestAlign1, hingeBestAlign2);
-      }
-      
-      if(CH2Score > THRESHOLD_HC)
+
+      if(RunPipeline(in, out, options.nThreads, ProcessRecord,
+                     &processData) == 0)
       {
-         PrintResult(out, "CH2", CH2Score, CH2Match);
-         if(showAlignment)
-            PrintAlignment(out, CH2BestAlign1, CH2BestAlign2);
+         fprintf(stderr, "No sequence found for %s\n",
+                 (options.infile[0] ? options.infile : "stdin"));
       }
-      
-      if(CH3CHSScore > THRESHOLD_HC)
+      else if(options.cacheSize || options.cacheDir[0])
       {
-         PrintResult(out, "CH3-CHS", CH3CHSScore, CH3CHSMatch);
-         if(showAlignment)
-            PrintAlignment(out, CH3BestAlign1, CH3BestAlign2);
+         long nSeqs, nHits, nDiskHits;
+         GetAGLCacheStats(context, &nSeqs, &nHits, &nDiskHits);
+         if(options.cacheSize)
+            fprintf(stderr, "Result cache: %ld of %ld sequences were \
+duplicates\n", nHits, nSeqs);
+         if(options.cacheDir[0])
+            fprintf(stderr, "Result cache: %ld of %ld sequences were \
+found in %s\n", nDiskHits, nSeqs, options.cacheDir);
       }
 
-      
-      /* 22.02.24 Added to print info on special cases where mixed allelic
-         variants actually indicate a higher numbered allele
-      */
-      PrintSpecialMatches(out, CH1Match, CH2Match, CH3CHSMatch);
+      if(options.stats)
+         PrintStats(stderr);
 
-      break;
-
-   default:
-      fprintf(stderr, "Error: Can't identify chain type!\n");
+      if(in  != stdin)  fclose(in);
+      if(out != stdout) fclose(out);
+      FreeAGLBinDict(processData.dict);
+      FreeAGL(context);
+      FreeStats();
+      CloseTrace();
+   }
+   else
+   {
+      fprintf(stderr,"Unable to open input or output file\n");
+      FreeAGL(context);
+      return(1);
    }
+
+   return(0);
 }
 
 
 /************************************************************************/
-/*>REAL ScanAgainstDB(char *type, char *theSeq, BOOL verbose, 
-                      char *species, char *match, char *bestAlign1, 
-                      char *bestAlign2, char *dataDir)
-   -----------------------------------------------------------------------
+/*>void ProcessRecord(FILE *out, char *header, char *seq, void *data)
+   ------------------------------------------------------------------
 *//**
-   \param[in]  type       The database type against which we scan
-   \param[in]  theSeq     The sequences to test
-   \param[in]  verbose    Verbose output
-   \param[in]  species    "Homo", "Mus" or blank
-   \param[out] match      The best matching entry
-   \param[out] bestAlign1 The alignment of our sequence
-   \param[out] bestAlign2 The alignment of the database sequence
-   \param[in]  dataDir    Data directory
-   \return                The score for the match
-
-   Scans a sequence against the specified database.
-
-   - 31.03.20 Original   By: ACRM
-   - 11.06.21 Added USEPATH code
-   - 13.06.22 Added window size of 2 for C regions and 10 for others
-   - 19.03.25 Initialize match
+   \param[in]   out      Output file pointer
+   \param[in]   header   FASTA header
+   \param[in]   seq      Sequence to analyze
+   \param[in]   data     The PROCESSDATA options
+
+   Prints the header and the results for one FASTA record. Called by
+   RunPipeline(), possibly from several threads at once.
+
+   - 18.10.26 Original (from main())   By: ACRM
+   - 18.10.26 Uses AssignGermlines() and PrintResults()
+   - 18.10.26 Frees the result
+   - 18.10.26 Prints a row for --format airr
+   - 18.10.26 Prints a record for --format binary
+   - 18.10.26 Printing the result is timed for --stats
+   - 18.10.26 The sequence and printing are traced for --trace
+   - 18.10.26 Reports an unknown chain type to processData->err rather
+              than each format doing so to stderr
 */
-REAL ScanAgainstDB(char *type, char *theSeq, BOOL verbose, char *species,
-                   char *match, char *bestAlign1, char *bestAlign2,
-                   char *dataDir)
+void ProcessRecord(FILE *out, char *header, char *seq, void *data)
 {
-   char        filename[MAXBUFF+1],
-               bestMatch[MAXBUFF+1];
-   BOOL        noEnv;
-   FILE        *dbFp = NULL;
-   REAL        maxScore = 0.0;
-   int         maxDbLen = 0;
-   static char align1[HUGEBUFF+1],
-               align2[HUGEBUFF+1];
-
-   match[0] = '\0';
-   
-   if(dataDir[0] != '\0')
+   PROCESSDATA *processData = (PROCESSDATA *)data;
+   AGLRESULT   result;
+   STATSTIMER  timer;
+   TRACESPAN   seqSpan,
+               span;
+
+   if(StartTraceSeq() >= 0)
+      StartTraceSpan(&seqSpan);
+   else
+      seqSpan.seqNum = -1;
+
+   if(processData->format == FORMAT_TEXT)
+      fprintf(out, "%s\n", header);
+   if(!AssignGermlines(processData->context, seq, &result))
    {
-      sprintf(filename, "%s/%s.dat", dataDir, type);
+      fprintf(stderr, "\nError (agl): No memory for sequence\n");
+      exit(1);
    }
+
+   StartStatsTimer(&timer);
+   StartTraceSpan(&span);
+   if(processData->format == FORMAT_AIRR)
+      PrintAIRRRow(out, header, seq, &result, processData->showAlignment);
+   else if(processData->format == FORMAT_BINARY)
+      PrintBinaryRecord(out, header, &result, processData->dict);
    else
+      PrintResults(out, &result, processData->showAlignment);
+   if(result.chainType == CHAINTYPE_UNKNOWN)
+      fprintf(processData->err, "Error: Can't identify chain type!\n");
+   StopStatsStage(&timer, STATS_OUTPUT);
+   EndTraceSpan(&span, "output", "stage", NULL);
+
+   if(seqSpan.seqNum >= 0)
    {
-#ifdef USEPATH
-      char *path;
-      /* Get path to executable                                         */
-      if((path = FindPath())!=NULL)
-      {
-         /* Append the location below the binary directory and see if it
-            exists. If it does then set the filename to include this
-            path. If not, then just save the filename itself
-         */
-         sprintf(filename, "%s/share/agl/data", path);
-         if(DirectoryExists(filename))
-         {
-            sprintf(filename, "%s/share/agl/data/%s.dat", path, type);
-         }
-         else
-         {
-            sprintf(filename, "%s.dat", type);
-         }
-         
-         free(path);
-      }
-      else
-      {
-         sprintf(filename, "%s.dat", type);
-      }
-#else
-      sprintf(filename, "%s.dat", type);
-#endif
+      char escHeader[MAXBUFF+1];
+
+      EscapeTraceString(escHeader, header, MAXBUFF+1);
+      EndTraceSpan(&seqSpan, "sequence", "sequence",
+                   "\"header\":\"%s\",\"length\":%d", escHeader,
+                   (int)strlen(seq));
+      SetTraceSeq(-1);
    }
 
-   
-   if(verbose)
-      fprintf(stderr,"\n\nChecking %s\n", type);
+   FreeAGLResult(&result);
+}
+
 
-   if((dbFp = blOpenFile(filename, AGLDATADIR, "r", &noEnv))!=NULL)
+/************************************************************************/
+/*>void ServeConnection(FILE *in, FILE *out, void *data)
+   -----------------------------------------------------
+*//**
+   \param[in]   in       Request from the client
+   \param[in]   out      Reply to the client
+   \param[in]   data     The server's PROCESSDATA
+
+   Handles one request to the server. The request may start with a
+   line made by BuildRequest() giving the options for this request,
+   followed by any number of FASTA records. The reply is exactly what
+   agl would print with those options. Options that only affect the
+   server (-d, -j, -t, -c, -C, -v) are ignored.
+
+   If the request line starts with FRAMED_TAG, the output for each
+   record and any errors about it are sent as separate frames (see
+   WriteServerFrame()) so that the client can print the errors on its
+   own standard error. Otherwise errors are printed by the server.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Reads the request with fastain.c
+   - 18.10.26 Handles --format
+   - 18.10.26 Sends the reply in frames if asked
+   - 18.10.26 Applies -k, -x, -r and -R
+*/
+void ServeConnection(FILE *in, FILE *out, void *data)
+{
+   PROCESSDATA *serverData = (PROCESSDATA *)data,
+               processData;
+   AGLCONTEXT  context;
+   FASTAIN     *fastaIn;
+   FASTAREC    record;
+   FILE        *recOut  = out,
+               *recErr  = NULL;
+   char        *line,
+               *outText = NULL,
+               *errText = NULL;
+   size_t      outSize  = 0,
+               errSize  = 0;
+   BOOL        framed   = FALSE,
+               ok       = TRUE;
+
+   /* Start from the server's settings                                  */
+   context                   = *(serverData->context);
+   processData.context       = &context;
+   processData.err           = serverData->err;
+   processData.showAlignment = serverData->showAlignment;
+   processData.format        = serverData->format;
+   processData.dict          = serverData->dict;
+
+   if((fastaIn = OpenFASTAIn(in))==NULL)
    {
-      char header[MAXBUFF+1];
-      char *seq = NULL;
-      static char fastaBuffer[MAXBUFF+1];
+      fprintf(out, "Error (agl): No memory for request\n");
+      return;
+   }
 
-      while((seq = blReadFASTAExtBuffer(dbFp, header, MAXBUFF,
-                                        fastaBuffer, MAXBUFF))!=NULL)
+   if(((line = ReadFASTAPreamble(fastaIn))!=NULL) &&
+      (line[0] == REQUEST_TAG[0]))
+   {
+      char    *args[MAXREQARGS],
+              *word,
+              *savePtr;
+      OPTIONS options;
+      int     nArgs = 0;
+
+      for(word=strtok_r(line, " \t\r\n", &savePtr);
+          (word != NULL) && (nArgs < MAXREQARGS);
+          word=strtok_r(NULL, " \t\r\n", &savePtr))
+         args[nArgs++] = word;
+
+      framed = ((nArgs > 0) && !strcmp(args[0], FRAMED_TAG));
+      if((nArgs == 0) ||
+         (strcmp(args[0], REQUEST_TAG) && !framed) ||
+         !ParseCmdLine(nArgs, args, &options))
       {
-         if((species[0] == '\0') ||
-            (strstr(header, species) != NULL))
-         {
-            REAL score;
-            int  dbLen;
-            int  window = 10;
-            BOOL noScale = FALSE;
+         char *message = "Error (agl): Bad request\n";
 
-            if(header[1] == 'C')
-            {
-               /* Use a window of 10 by default, or a window of 2 for 
-                  constant regions
-               */
-               window = 2;
-            }
-            else if(header[1] == 'D')
-            {
-               /* Don't scale the score if it's a D-segment             */
-               noScale = TRUE;
-            }
-            
-            score = CompareSeqs(theSeq, seq, window, align1, align2,
-                                noScale);
-            dbLen = CalculateDbLen(align2);
-
-#ifdef DEBUG
-            if(verbose)
-               fprintf(stderr, "Comparing with %s {%f, %f} {%d, %d}\n",
-                       header, score, maxScore, dbLen, maxDbLen);
-#endif 
-            if(/* Length has increased and score not decreased much     */
-               ((dbLen > maxDbLen) &&
-                (score > (maxScore-THRESHOLD_LEN_SCORE)))   ||
-               /* Score has increased and length not shorter            */
-               ((score > maxScore) && (dbLen >= maxDbLen))  ||
-               /* Score has increased significantly while length is 
-                  shorter 
-               */
-               ((score >  (maxScore + THRESHOLD_SCORE_INC)) &&
-                (dbLen >= (maxDbLen-THRESHOLD_SCORE_LEN))))
-            {
-               if(verbose)
-                  fprintf(stderr, "Comparing with %s *** %.4f\n",
-                          header, score);
-            
-               maxScore = score;
-               maxDbLen = dbLen;
-               strncpy(bestMatch,  header, MAXBUFF);
-               strncpy(bestAlign1, align1, HUGEBUFF);
-               strncpy(bestAlign2, align2, HUGEBUFF);
-            }
-            else if(score == maxScore)
-            {
-               /* If the scores are the same, choose the one with the 
-                  better gene name
-               */
-               if(PreferHeader(header, bestMatch))
-               {
-                  if(verbose)
-                     fprintf(stderr, "Comparing with %s *** %.4f \
-(Chosen on name)\n", header, score);
-            
-                  maxScore = score;
-                  strncpy(bestMatch,  header, MAXBUFF);
-                  strncpy(bestAlign1, align1, HUGEBUFF);
-                  strncpy(bestAlign2, align2, HUGEBUFF);
-               }
-               else if(verbose)
-               {
-                  fprintf(stderr, "Comparing with %s (rejected %.4f)\n",
-                          header, score);
-               }
-            }
-            else if(verbose)
-            {
-               fprintf(stderr, "Comparing with %s (%.4f)\n",
-                       header, score);
-            }
-         }
-         
-         free(seq);
-         seq=NULL;
+         if(framed)
+            WriteServerFrame(out, SERVER_ERROR, message, strlen(message));
+         else
+            fprintf(out, "%s", message);
+         CloseFASTAIn(fastaIn);
+         return;
       }
-      FCLOSE(dbFp);
+
+      strncpy(context.species, options.species, MAXBUFF);
+      context.chainType         = options.chainType;
+      context.doDSegment        = options.doDSegment;
+      context.shortList         = options.shortList;
+      SetAGLSlack(&context, options.slack);
+      processData.showAlignment = options.showAlignment;
+      processData.format        = options.format;
    }
-   else
+
+   /* Each record's output and errors are collected in memory and sent
+      as frames once it is done
+   */
+   if(framed)
    {
-      fprintf(stderr, "\nError (agl): Unable to open data file (%s)\n",
-              filename);
-      if(noEnv)
-      {
-         fprintf(stderr, "   Set the environment variable '%s' to the \
-location of the processed sequence files.\n",
-                 AGLDATADIR);
-      }
-      fprintf(stderr, "\n");
-      
-      exit(1);
+      recOut = NULL;
+      if(!SendFrame(out, SERVER_OUTPUT, &recOut, &outText, &outSize) ||
+         !SendFrame(out, SERVER_ERROR,  &recErr, &errText, &errSize))
+         ok = FALSE;
+      processData.err = recErr;
    }
 
-   strncpy(match, bestMatch, MAXBUFF);
-   return(maxScore);
-
-}
+   if(ok)
+   {
+      if(processData.format == FORMAT_AIRR)
+         PrintAIRRHeader(recOut, processData.showAlignment);
+      else if(processData.format == FORMAT_BINARY)
+         WriteAGLBinHeader(recOut, processData.dict);
+   }
 
+   while(ok && ReadFASTARecord(fastaIn, &record))
+   {
+      ProcessRecord(recOut, record.header, record.seq, &processData);
+      ReleaseFASTARecord(fastaIn, &record);
 
-/************************************************************************/
-int CalculateDbLen(char *seq)
-{
-   int i,
-       len=0;
+      if(framed)
+      {
+         ok = SendFrame(out, SERVER_ERROR,  &recErr, &errText, &errSize) &&
+              SendFrame(out, SERVER_OUTPUT, &recOut, &outText, &outSize);
+         processData.err = recErr;
+      }
+      fflush(out);
+   }
+   CloseFASTAIn(fastaIn);
 
-   for(i=0; i<strlen(seq); i++)
+   if(framed)
    {
-      if(seq[i] != '-')
-         len++;
+      /* Anything left (e.g. the AIRR header with no records)          */
+      if(ok)
+         SendFrame(out, SERVER_OUTPUT, &recOut, &outText, &outSize);
+      if(recOut != NULL)
+         fclose(recOut);
+      if(recErr != NULL)
+         fclose(recErr);
+      free(outText);
+      free(errText);
    }
-   return(len);
 }
 
+
 /************************************************************************/
-/*>BOOL PreferHeader(char *newHeader, char *oldHeader)
-   ---------------------------------------------------
+/*>BOOL SendFrame(FILE *out, int channel, FILE **fp, char **text,
+                  size_t *size)
+   ---------------------------------------------------------------
 *//**
-   \param[in]  newHeader  The FAA header for the new entry
-   \param[in]  oldHeader  The FAA header for the current best entry
-   \return                Should be use the new entry?
-
-   Used when two hits score the same. Tests the names of the hits and
-   sees if the new one has a preferred name
-
-   - 31.03.20 Original   By: ACRM
-CHECKED
+   \param[in]     out       The connection to the client
+   \param[in]     channel   SERVER_OUTPUT or SERVER_ERROR
+   \param[in,out] fp        Memory stream (NULL to just open one)
+   \param[in,out] text      Its buffer
+   \param[in,out] size      Its size
+   \return                  Success
+
+   Sends what has been written to a memory stream from
+   open_memstream() as a frame, if anything has, and opens a new empty
+   stream in its place.
+
+   - 18.10.26 Original   By: ACRM
 */
-BOOL PreferHeader(char *newHeader, char *oldHeader)
+BOOL SendFrame(FILE *out, int channel, FILE **fp, char **text,
+               size_t *size)
 {
-   char newID[SMALLBUFF+1],
-        oldID[SMALLBUFF+1],
-        newClass[SMALLBUFF],
-        newDistal[SMALLBUFF],
-        newFamily[SMALLBUFF],
-        newSubclass[SMALLBUFF],
-        oldClass[SMALLBUFF],
-        oldDistal[SMALLBUFF],
-        oldFamily[SMALLBUFF],
-        oldSubclass[SMALLBUFF];
-   int  newAllele,
-        oldAllele,
-        oldNum, newNum;
-
-   GetDomainID(newHeader, newID, SMALLBUFF);
-   GetDomainID(oldHeader, oldID, SMALLBUFF);
-
-   FindFields(newID, newClass, newSubclass, newFamily, &newAllele,
-              newDistal);
-   FindFields(oldID, oldClass, oldSubclass, oldFamily, &oldAllele,
-              oldDistal);
-
-   /* If it's non-distal and the current best is distal, 
-      keep the new one 
-   */
-   if((newDistal[0] == '\0') && (oldDistal[0] != '\0'))
-      return(TRUE);
-   
-   /* If the sub-class is numeric and the old one isn't, 
-      keep the new one 
-   */
-   oldNum = atoi(oldSubclass);
-   newNum = atoi(newSubclass);
-   if((newNum > 0) && (oldNum == 0))
-      return(TRUE);
+   BOOL ok = TRUE;
 
-   /* If both are numeric and the new one is lower, 
-      keep the new one  
-   */
-   if((newNum && oldNum) && (newNum < oldNum))
-      return(TRUE);
-   if(newNum > oldNum)
-      return(FALSE);
-
-   /* If the family is numeric and the old one isn't,
-      keep the new one 
-   */
-   oldNum = atoi(oldFamily);
-   newNum = atoi(newFamily);
-   if((newNum > 0) && (oldNum == 0))
-      return(TRUE);
+   if(*fp != NULL)
+   {
+      fclose(*fp);
+      if(*size)
+         ok = WriteServerFrame(out, channel, *text, *size);
+      free(*text);
+   }
 
-   /* If both are numeric and the new one is lower,
-      keep the new one   
-   */
-   if((newNum && oldNum) && (newNum < oldNum))
-      return(TRUE);
-   if(newNum > oldNum)
+   *text = NULL;
+   *size = 0;
+   if((*fp = open_memstream(text, size))==NULL)
       return(FALSE);
-
-   /* Keep the lowest allele                                            
-   */
-   if(newAllele < oldAllele)
-      return(TRUE);
-
-   return(FALSE);
+   return(ok);
 }
 
 
 /************************************************************************/
-/*>void GetDomainID(char *header, char *id, int maxbuff)
-   -----------------------------------------------------
+/*>char *BuildRequest(OPTIONS *options)
+   ------------------------------------
 *//**
-   \param[in]  header   The Fasta header
-   \param[out] id       The ID extracted from the header
-   \param[out] maxbuff  Maximum buffer size for the ID
-
-   Extracts the IMGT domain identifier from the FASTA header
-
-   - 31.03.20 Original   By: ACRM
+   \param[in]   options   Options from the command line
+   \return               Allocated request line for the server (or NULL
+                         if no memory)
+
+   Makes the line sent by --client to give the server the options
+   that change the output. It asks for the reply in frames so that
+   errors can be printed on our standard error.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Passes on --format airr
+   - 18.10.26 Passes on --format binary
+   - 18.10.26 Asks for a framed reply
+   - 18.10.26 The request is allocated to fit so a long species isn't
+              cut short
+   - 18.10.26 Passes on -k, -x, -r and -R. They are always sent so the
+              server's own settings don't apply
 */
-void GetDomainID(char *header, char *id, int maxbuff)
+char *BuildRequest(OPTIONS *options)
 {
-   int start, i,
-       headerLen;
+   char   *request;
+   size_t size;
+   FILE   *fp;
+
+   if((fp = open_memstream(&request, &size))==NULL)
+      return(NULL);
+
+   fprintf(fp, "%s%s%s%s%s%s%s",
+            FRAMED_TAG,
+            ((options->chainType == CHAINTYPE_LIGHT) ? " -L" :
+             ((options->chainType == CHAINTYPE_HEAVY) ? " -H" : "")),
+            (options->doDSegment    ? " -D" : ""),
+            (options->showAlignment ? " -a" : ""),
+            ((options->format == FORMAT_AIRR) ? " --format airr" :
+             ((options->format == FORMAT_BINARY) ? " --format binary" : "")),
+            (options->species[0]    ? " -s " : ""),
+            options->species);
+
+   if(options->shortList > 0)
+      fprintf(fp, " -k %d", options->shortList);
+   else
+      fprintf(fp, " -x");
 
-   headerLen = strlen(header);
-   
-   for(start=0; start<headerLen; start++)
-   {
-      if(header[start] == '_')
-      {
-         start++;
-         break;
-      }
-   }
-   
-   for(i=0; i<headerLen-start && i<maxbuff; i++)
+   if(options->slack >= 0)
+      fprintf(fp, " -r %d\n", options->slack);
+   else
+      fprintf(fp, " -R\n");
+
+   if(fclose(fp))
    {
-      id[i] = header[start+i];
-      if(id[i] == '_')
-      {
-         break;
-      }
+      free(request);
+      return(NULL);
    }
-   
-   id[i] = '\0';
+   return(request);
 }
 
 
 /************************************************************************/
-/*>REAL CompareSeqs(char *theSeq, char *seq, int window, 
-                    char *align1, char *align2, BOOL noScale)
-   ---------------------------------------------------------------------
+/*>void PrintResults(FILE *out, AGLRESULT *result, BOOL showAlignment)
+   -------------------------------------------------------------------
 *//**
-   \param[in]   theSeq   the sequence of interest
-   \param[in]   seq      the database sequence
-   \param[in]   window   Window size
-   \param[out]  align1   Alignment of our sequence
-   \param[out]  align2   Alignment of database sequence
-   \param[in]   noScale  Don't scale score by length (for D-segment)
-   \return               Score for alignment
+   \param[in]   out            Output file pointer
+   \param[in]   result         Result from AssignGermlines()
+   \param[in]   showAlignment  Show the alignment of each region
 
-   - 31.03.20 Original   By: ACRM
-   - 13.06.22 Changed to use a window in the alignment to speed it up
-              Added window size as a parameter
-   - 26.04.23 Added noScale
-   - 27.04.23 Changed extension penalty from 5 to 1
+   Prints the results for a sequence in the original agl format.
+   Nothing is printed for an unknown chain type; ProcessRecord()
+   reports it.
+
+   - 18.10.26 Original (printing code from ProcessSeq())   By: ACRM
+   - 18.10.26 The error for an unknown chain type moved to
+              ProcessRecord()
 */
-REAL CompareSeqs(char *theSeq, char *seq, int window,
-                 char *align1, char *align2, BOOL noScale)
+void PrintResults(FILE *out, AGLRESULT *result, BOOL showAlignment)
 {
-   int  score;
-   int  alignLen;
-   int  shortSeqLen = MIN(strlen(theSeq), strlen(seq));
-   
-   score = blAffinealignWindow(theSeq, strlen(theSeq),
-                               seq, strlen(seq),
-                               FALSE,  /* verbose            */
-                               TRUE,   /* identity           */
-                               5,      /* opening penalty    */
-                               1,      /* extension penalty  */
-                               window, /* window             */
-                               align1,
-                               align2,
-                               &alignLen);
-   align1[alignLen] = align2[alignLen] = '\0';
-
-   shortSeqLen = CalcShortSeqLen(align1, align2);
-
-#ifdef DEBUG   
-   fprintf(stderr, "\n>>>%s\n", align1);
-   fprintf(stderr, ">>>%s %d\n", align2, shortSeqLen);
-#endif
-
-   if(noScale)
-      return((REAL)score);
-   
-   return((REAL)score / (REAL)shortSeqLen);
-}
+   int i;
 
+   if(result->chainTypeFound)
+      fprintf(out, "# Chain type: %s\n", CHAINTYPE(result->chainType));
 
-/************************************************************************/
-int CalcShortSeqLen(char *align1, char *align2)
-{
-   int start, stop, i, len1=0, len2=0,
-      alnLen = strlen(align1);
-   
+   if(result->chainType == CHAINTYPE_UNKNOWN)
+      return;
 
-   /* Find where the alignment starts                                   */
-   for(start=0; start<alnLen; start++)
-   {
-      if((align1[start] != '-') && (align2[start] != '-'))
-         break;
-   }
-   /* Find where the alignment stops                                    */
-   for(stop=alnLen-1; stop>start; stop--)
-   {
-      if((align1[stop] != '-') && (align2[stop] != '-'))
-         break;
-   }
-   /* Step between start and stop and calculate the number of residues 
-      in each sequence
-   */
-   for(i=start; i<=stop; i++)
+   for(i=0; i<result->nDomains; i++)
    {
-      if(align1[i] != '-')
-         len1++;
-      if(align2[i] != '-')
-         len2++;
+      AGLDOMAIN *domain = &(result->domains[i]);
+
+      PrintResult(out, domain->domain, domain->score, domain->match);
+      if(showAlignment)
+         PrintAlignment(out, domain->align1, domain->align2);
    }
 
-   return(MIN(len1, len2));
+   if(result->special[0])
+      fprintf(out, "%s\n", result->special);
 }
 
 
@@ -882,20 +793,95 @@ int CalcShortSeqLen(char *align1, char *align2)
 -  26.04.23 V1.6
 -  22.02.24 V1.7
 -  19.03.25 V1.8
+-  18.10.26 V1.16 Added -j
+-  18.10.26 V1.17
+-  18.10.26 V1.18 Added --serve and --client
+-  18.10.26 V1.19 Added -c
+-  18.10.26 V1.20 Added -C
+-  18.10.26 V1.21 Added -r and -R
+-  18.10.26 V1.22 Added -t
+-  18.10.26 V1.24 Added --format
+-  18.10.26 V1.25 Added --format binary
+-  18.10.26 V1.31 -R is the default
+-  18.10.26 V1.32 -x is the default
+-  18.10.26 V1.33
+-  18.10.26 V1.34
 */
 void Usage(void)
 {
-   printf("\nagl V1.8 (c) 2020-25 UCL, Prof. Andrew C.R. Martin\n\n");
-
-   printf("Usage: agl [-H|-L] [-D] [-s species] [-d datadir] [-v] [-a] \
-[file.faa [out.txt]]\n");
+   printf("\nagl V1.34 (c) 2020-26 UCL, Prof. Andrew C.R. Martin\n\n");
+
+   printf("Usage: agl [-H|-L] [-D] [-s species] [-d datadir] [-k n|-x] \
+[-r n|-R] [-v]\n");
+   printf("           [-a] [--format f] [-j n] [-t n] [-c n] [-C dir] \
+[--stats]\n");
+   printf("           [--trace out.json [--trace-sample pc]]\n");
+   printf("           [file.faa [out.txt]]\n");
+   printf("       agl [-H|-L] [-D] [-s species] [-d datadir] [-k n|-x] \
+[-r n|-R] [-a]\n");
+   printf("           [--format f] [-j n] [-t n] [-c n] [-C dir] \
+--serve socket\n");
+   printf("       agl [-H|-L] [-D] [-s species] [-a] [--format f] \
+--client socket\n");
+   printf("           [file.faa [out.txt]]\n");
    printf("           -H Heavy chain\n");
    printf("           -L Light chain\n");
    printf("           -D Do the D-segment with heavy chains\n");
    printf("           -s Specify a species (Homo or Mus)\n");
    printf("           -d Specify data directory\n");
+   printf("           -k Align only the n germline sequences sharing \
+most %d-mers\n", KMERLEN);
+   printf("              with the query. This is faster but can miss \
+the best match\n");
+   printf("           -x Exhaustive - align against every germline \
+sequence (the\n");
+   printf("              default)\n");
+   printf("           -r Search only n residues either side of where \
+each J, C or\n");
+   printf("              hinge region can be. This is faster but can \
+change the scores\n");
+   printf("           -R Search the whole sequence for every region \
+(the default)\n");
    printf("           -v Verbose\n");
    printf("           -a Show alignments and number of mismatches\n");
+   printf("           --format Output format: text (the default), \
+airr or binary\n");
+   printf("              airr writes a tab-separated row for each \
+sequence. With -a,\n");
+   printf("              the alignments are given as CIGAR strings\n");
+   printf("              binary writes records for aglbin2txt or \
+other programs (see\n");
+   printf("              aglbin.h). -a is ignored\n");
+   printf("           -j Process n sequences at a time in parallel \
+threads (0 to use\n");
+   printf("              all the CPUs). Ignored with -v\n");
+   printf("           -t Use n threads to run the searches for each \
+sequence at the\n");
+   printf("              same time (0 to use all the CPUs). Ignored \
+with -v\n");
+   printf("           -c Assign each distinct sequence only once, \
+keeping up to n\n");
+   printf("              results in memory\n");
+   printf("           -C Keep results in the named directory for \
+later runs\n");
+   printf("           --stats Print the work and time spent scanning \
+each germline\n");
+   printf("              database, the time spent reading and printing \
+sequences and\n");
+   printf("              the peak memory used to standard error at \
+the end\n");
+   printf("           --trace Write a timeline of the work on each \
+sequence to the\n");
+   printf("              named file as Chrome trace events\n");
+   printf("           --trace-sample Trace only pc percent of the \
+sequences (default\n");
+   printf("              100)\n");
+   printf("           --serve Run as a server listening on the named \
+Unix socket.\n");
+   printf("              Only the user running the server may \
+connect\n");
+   printf("           --client Send the sequences to a server on the \
+named socket\n");
 
    printf("\nagl (Assign Germ Line) is a program for assigning IMGT \
 germlines to\n");
@@ -911,7 +897,92 @@ the basis\n");
 
    printf("\nAs of V1.5, the FASTA file may contain multiple \
 sequences.\n");
+
+   printf("\nAs of V1.13, -k n aligns only the n germline sequences \
+sharing most\n");
+   printf("%d-mers with the query. The best match isn't always among \
+them, so by\n", KMERLEN);
+   printf("default every sequence is aligned.\n");
+
+   printf("\nAs of V1.16, -j may be used to process several sequences \
+at once. The\n");
+   printf("results are still written in the order of the input.\n");
+
+   printf("\nAs of V1.18, --serve keeps the germline databases in \
+memory and\n");
+   printf("answers requests on a Unix socket using a pool of threads \
+(-j, default\n");
+   printf("one per CPU). --client sends the sequences to the server \
+and prints the\n");
+   printf("results exactly as agl would. -H, -L, -D, -s, -a, \
+--format, -k, -x, -r\n");
+   printf("and -R are passed on with each request.\n");
+
+   printf("\nAs of V1.19, -c stores the results of up to n distinct \
+sequences so that\n");
+   printf("repeated sequences are not aligned again.\n");
+   printf("The number of duplicates is reported on standard error.\n");
+
+   printf("\nAs of V1.20, -C keeps results on disk so that sequences \
+seen in earlier\n");
+   printf("runs are not aligned again. Results are ignored if the \
+germline data\n");
+   printf("files change.\n");
+
+   printf("\nAs of V1.21, -r n searches for J only after the end of V, \
+the constant\n");
+   printf("domains after J and the hinge between CH1 and CH2, with n \
+residues to\n");
+   printf("spare. A region cut short like this can give a different \
+score, so by\n");
+   printf("default the whole sequence is searched.\n");
+
+   printf("\nAs of V1.22, -t runs the searches for the different \
+regions of a\n");
+   printf("sequence at the same time. This is quicker for a few \
+sequences; for\n");
+   printf("many, -j makes better use of the CPUs.\n");
    
+   printf("\nAs of V1.24, --format airr writes a header line and then \
+one tab-separated\n");
+   printf("row for each sequence giving the call, %% identity, \
+mismatches and the\n");
+   printf("aligned residues of the query and germline for each \
+region.\n");
+
+   printf("\nAs of V1.25, --format binary writes the same information \
+as fixed-size\n");
+   printf("records that can be read without parsing. aglbin2txt \
+converts them back\n");
+   printf("to text.\n");
+
+   printf("\nAs of V1.26, --stats reports the number of scans of each \
+germline database\n");
+   printf("and the wall clock and CPU time they took. 'make bench' in \
+the src\n");
+   printf("directory uses this to time agl on a set of standard \
+workloads.\n");
+
+   printf("\nAs of V1.27, --stats also gives the entries visited, \
+those skipped as they\n");
+   printf("weren't of the species (-s), weren't on the k-mer \
+shortlist (-k) or\n");
+   printf("couldn't score well enough, ties broken on the gene name, \
+alignments and\n");
+   printf("matrix cells for each database, and the time spent \
+reading the input and\n");
+   printf("formatting the output.\n");
+
+   printf("\nAs of V1.28, --trace writes the time spent on the chain \
+typing, each\n");
+   printf("database scan, the D segment and the output for each \
+sequence. Load the\n");
+   printf("file into chrome://tracing or https://ui.perfetto.dev to \
+see it. Each\n");
+   printf("thread has its own track. --trace-sample 1 traces only \
+one sequence in a\n");
+   printf("hundred, so it can be left on for large runs.\n");
+
    printf("\nIf a data directory is not specified using -d, it will \
 first look in the\n");
    printf("share/agl/data directory below the location of the \
@@ -923,39 +994,47 @@ specified using the\n");
 
 
 /************************************************************************/
-/*>BOOL ParseCmdLine(int argc, char **argv, char *infile, char *outfile,
-                     BOOL *verbose, BOOL *showAlignment, 
-                     int *chainType, char *species, char *dataDir,
-                     BOOL *doDSegment)
-   ---------------------------------------------------------------------
+/*>BOOL ParseCmdLine(int argc, char **argv, OPTIONS *options)
+   ----------------------------------------------------------
 *//**
    \param[in]   argc           Argument count
    \param[in]   **argv         Argument array
-   \param[out]  *infile        Input filename (or blank string)
-   \param[out]  *outfile       Output filename (or blank string)
-   \param[out]  *verbose       Verbose
-   \param[out]  *showAlignment Show the alignments
-   \param[out]  *chainType     Chain type
-   \param[out]  *species       Species or blank string
-   \param[out]  *dataDir       Data directory or blank string
-   \param[out]  *doDSegment    Handle the D segment for heavy chains
+   \param[out]  *options       Options from the command line
    \return                     Success
 
    Parse the command line
 
 -  31.03.20 Original    By: ACRM
 -  26.04.23 Added -D/doDSegment
+-  17.10.26 Added -k and -x
+-  18.10.26 Added -j
+-  18.10.26 Fills in an OPTIONS structure including the defaults.
+            Added --serve and --client
+-  18.10.26 Added -c
+-  18.10.26 Added -C
+-  18.10.26 Added -r and -R
+-  18.10.26 Added -t
+-  18.10.26 Added --format
+-  18.10.26 Added --stats
+-  18.10.26 Added --trace and --trace-sample
 */
-BOOL ParseCmdLine(int argc, char **argv, char *infile, char *outfile,
-                  BOOL *verbose, BOOL *showAlignment, int *chainType,
-                  char *species, char *dataDir,
-                  BOOL *doDSegment)
+BOOL ParseCmdLine(int argc, char **argv, OPTIONS *options)
 {
    argc--;
    argv++;
-   
-   infile[0]  = outfile[0] = '\0';
-   species[0] = dataDir[0] = '\0';
+
+   memset(options, 0, sizeof(OPTIONS));
+   options->verbose       = FALSE;
+   options->showAlignment = FALSE;
+   options->doDSegment    = FALSE;
+   options->stats         = FALSE;
+   options->chainType     = CHAINTYPE_UNKNOWN;
+   options->shortList     = DEF_SHORTLIST;
+   options->slack         = DEF_SLACK;
+   options->nThreads      = -1;
+   options->scanThreads   = 1;
+   options->format        = FORMAT_TEXT;
+   options->tracePercent  = 100.0;
    
    while(argc)
    {
@@ -963,25 +1042,79 @@ BOOL ParseCmdLine(int argc, char **argv, char *infile, char *outfile,
       {
          switch(argv[0][1])
          {
+         case '-':
+            if(!strcmp(argv[0], "--serve"))
+            {
+               argc--; argv++;
+               if(!argc)
+                  return(FALSE);
+               strncpy(options->serveSocket, argv[0], MAXBUFF);
+            }
+            else if(!strcmp(argv[0], "--client"))
+            {
+               argc--; argv++;
+               if(!argc)
+                  return(FALSE);
+               strncpy(options->clientSocket, argv[0], MAXBUFF);
+            }
+            else if(!strcmp(argv[0], "--trace"))
+            {
+               argc--; argv++;
+               if(!argc)
+                  return(FALSE);
+               strncpy(options->traceFile, argv[0], MAXBUFF);
+            }
+            else if(!strcmp(argv[0], "--trace-sample"))
+            {
+               argc--; argv++;
+               if(!argc ||
+                  !sscanf(argv[0], "%lf", &(options->tracePercent)) ||
+                  (options->tracePercent <= 0.0) ||
+                  (options->tracePercent > 100.0))
+                  return(FALSE);
+            }
+            else if(!strcmp(argv[0], "--stats"))
+            {
+               options->stats = TRUE;
+            }
+            else if(!strcmp(argv[0], "--format"))
+            {
+               argc--; argv++;
+               if(!argc)
+                  return(FALSE);
+               if(!strcmp(argv[0], "airr"))
+                  options->format = FORMAT_AIRR;
+               else if(!strcmp(argv[0], "binary"))
+                  options->format = FORMAT_BINARY;
+               else if(!strcmp(argv[0], "text"))
+                  options->format = FORMAT_TEXT;
+               else
+                  return(FALSE);
+            }
+            else
+            {
+               return(FALSE);
+            }
+            break;
          case 'v':
-            *verbose = TRUE;
+            options->verbose = TRUE;
             break;
          case 'a':
-            *showAlignment = TRUE;
+            options->showAlignment = TRUE;
             break;
          case 'D':
-            *doDSegment = TRUE;
+            options->doDSegment = TRUE;
             break;
          case 'L':
          case 'l':
-            if(*chainType != CHAINTYPE_UNKNOWN)
+            if(options->chainType != CHAINTYPE_UNKNOWN)
                return(FALSE);
-            *chainType = CHAINTYPE_LIGHT;
+            options->chainType = CHAINTYPE_LIGHT;
             break;
          case 'H':
-            if(*chainType != CHAINTYPE_UNKNOWN)
+            if(options->chainType != CHAINTYPE_UNKNOWN)
                return(FALSE);
-            *chainType = CHAINTYPE_HEAVY;
+            options->chainType = CHAINTYPE_HEAVY;
             break;
          case 'h':
             return(FALSE);
@@ -989,13 +1122,57 @@ BOOL ParseCmdLine(int argc, char **argv, char *infile, char *outfile,
             argc--; argv++;
             if(!argc)
                return(FALSE);
-            strncpy(species, argv[0], MAXBUFF);
+            strncpy(options->species, argv[0], MAXBUFF);
             break;
          case 'd':
             argc--; argv++;
             if(!argc)
                return(FALSE);
-            strncpy(dataDir, argv[0], MAXBUFF);
+            strncpy(options->dataDir, argv[0], MAXBUFF);
+            break;
+         case 'k':
+            argc--; argv++;
+            if(!argc || !sscanf(argv[0], "%d", &(options->shortList)) ||
+               (options->shortList < 1))
+               return(FALSE);
+            break;
+         case 'x':
+            options->shortList = 0;
+            break;
+         case 'r':
+            argc--; argv++;
+            if(!argc || !sscanf(argv[0], "%d", &(options->slack)) ||
+               (options->slack < 0))
+               return(FALSE);
+            break;
+         case 'R':
+            options->slack = -1;
+            break;
+         case 't':
+            argc--; argv++;
+            if(!argc || !sscanf(argv[0], "%d", &(options->scanThreads)) ||
+               (options->scanThreads < 0) ||
+               (options->scanThreads > MAXPOOLTHREADS))
+               return(FALSE);
+            break;
+         case 'c':
+            argc--; argv++;
+            if(!argc || !sscanf(argv[0], "%ld", &(options->cacheSize)) ||
+               (options->cacheSize < 1))
+               return(FALSE);
+            break;
+         case 'C':
+            argc--; argv++;
+            if(!argc)
+               return(FALSE);
+            strncpy(options->cacheDir, argv[0], MAXBUFF);
+            break;
+         case 'j':
+            argc--; argv++;
+            if(!argc || !sscanf(argv[0], "%d", &(options->nThreads)) ||
+               (options->nThreads < 0) ||
+               (options->nThreads > MAXTHREADS))
+               return(FALSE);
             break;
          default:
             return(FALSE);
@@ -1011,114 +1188,27 @@ BOOL ParseCmdLine(int argc, char **argv, char *infile, char *outfile,
 
          if(argc)
          {
-            strncpy(infile, argv[0], MAXBUFF);
+            strncpy(options->infile, argv[0], MAXBUFF);
             argc--; argv++;
             if(argc)
             {
-               strncpy(outfile, argv[0], MAXBUFF);
+               strncpy(options->outfile, argv[0], MAXBUFF);
                argc--; argv++;
             }
          }
       }
    }
-   
-   return(TRUE);
-}
-
-
-/************************************************************************/
-/*>void RemoveSequence(char *seq, char *align1, char *align2, 
-                       BOOL verbose)
-   -----------------------------------------------------------
-*//**
-   \param[in,out]   seq        The sequence
-   \param[in]       align1     Our sequence aligned
-   \param[in]       align2     Database sequence aligned
-   \param[in]       verbose    Verbose output
 
-   Finds the region of the sequence that has been aligned with a 
-   database sequence and removes it.
-
-   - 31.03.20 Original   By: ACRM
-*/
-void RemoveSequence(char *seq, char *align1, char *align2, BOOL verbose)
-{
-   int         i, j,
-               start, stop,
-               alnLen = MAX(strlen(align1), strlen(align2));
-   static char buffer[HUGEBUFF+1];
-
-   if(verbose)
-   {
-      fprintf(stderr, "Input seq:        %s\n", seq);
-      fprintf(stderr, "Alignment:        %s\n", align1);
-      fprintf(stderr, "                  %s\n", align2);
-      fprintf(stderr, "Alignment length: %d\n", alnLen);
-   }
-   
-   /* Find the start of the aligned region                              */
-   for(i=0; i<alnLen; i++)
-   {
-      if((align1[i] != '-') &&
-         (align2[i] != '-'))
-      {
-         start = i;
-         break;
-      }
-   }
-   
-   /* Find the end of the aligned region                                */
-   for(i=alnLen-1; i>start; i--)
-   {
-      if((align1[i] != '-') &&
-         (align2[i] != '-'))
-      {
-         stop = i;
-         break;
-      }
-   }
-
-   if(verbose)
-      fprintf(stderr, "Start: %d Stop: %d\n", start, stop);
-
-#ifdef OLD
-   /* Copy up to the start                                              */
-   j=0;
-   for(i=0; i<start; i++)
-   {
-      if(align1[i] != '-')
-      {
-         buffer[j++] = align1[i];
-      }
+   /* Can't be both server and client                                   */
+   if(options->serveSocket[0] && options->clientSocket[0])
+      return(FALSE);
 
-   }
-   
-   /* Copy after the end                                                */
-   for(i=stop+1; i<alnLen; i++)
-   {
-      if(align1[i] != '-')
-      {
-         buffer[j++] = align1[i];
-      }
-   }
-   buffer[j] = '\0';
-   
-   /* Copy this back into seq                                           */
-   i = strlen(seq);
-   strncpy(seq, buffer, i);
-   seq[i] = '\0';
-#else
-   for(i=0; i<strlen(seq); i++)
-   {
-      if((i>=start) && (i<=stop))
-      {
-         seq[i] = 'X';
-      }
-   }
-#endif
+   /* A trace is only written when processing a file                    */
+   if(options->traceFile[0] &&
+      (options->serveSocket[0] || options->clientSocket[0]))
+      return(FALSE);
    
-   if(verbose)
-      fprintf(stderr, "Output seq:       %s\n", seq);
+   return(TRUE);
 }
 
 
@@ -1134,27 +1224,15 @@ void RemoveSequence(char *seq, char *align1, char *align2, BOOL verbose)
    Prints the match information
 
    - 31.03.20 Original   By: ACRM
+   - 18.10.26 The match is split up by GetMatchFields()
 */
 void PrintResult(FILE *out, char *domain, REAL score, char *match)
 {
    char id[LABELBUFF],
         frame[LABELBUFF],
         species[LABELBUFF];
-   
-   match = strchr(match, '_');
-   match++;
-   strncpy(id, match, LABELBUFF-1);
-   TERMAT(id, '_');
 
-   match = strchr(match, '_');
-   match++;
-   strncpy(frame, match, LABELBUFF-1);
-   TERMAT(frame, '_');
-   
-   match = strchr(match, '_');
-   match++;
-   strncpy(species, match, LABELBUFF-1);
-   
+   GetMatchFields(match, id, frame, species);
    fprintf(out, "%-7s : %6.2f%% : %-12s : %s : %s\n",
            domain, 100.0*score, id, frame, species);
 }
@@ -1172,40 +1250,25 @@ void PrintResult(FILE *out, char *domain, REAL score, char *match)
 
 -  14.04.20 Original   By: ACRM
 -  14.06.21 Added printing of number of mismatches
+-  18.10.26 Prints the aligned region in place rather than from a copy
+            limited to HUGEBUFF
+-  18.10.26 The ends are trimmed by TrimAlignment()
 */
 void PrintAlignment(FILE *out, char *inAlign1, char *inAlign2)
 {
-   char align1[HUGEBUFF+1],
-        align2[HUGEBUFF+1],
-        *aln1,
+   char *aln1,
         *aln2;
    int  i,
+        len,
         nMismatches = 0;
-   
-   strncpy(align1, inAlign1, HUGEBUFF);
-   strncpy(align2, inAlign2, HUGEBUFF);
-   aln1=align1+strlen(align1)-1;
-   aln2=align2+strlen(align2)-1;
-   while((*aln1 == '-')  || (*aln2 == '-'))
-   {
-      aln1--;
-      aln2--;
-   }
-   *(aln1+1)='\0';
-   *(aln2+1)='\0';
 
-   aln1=align1;
-   aln2=align2;
-   while((*aln1 == '-')||(*aln2 == '-'))
-   {
-      aln1++;
-      aln2++;
-   }
+   len  = TrimAlignment(inAlign1, inAlign2, &aln1);
+   aln2 = inAlign2 + (aln1 - inAlign1);
 
-   fprintf(out, "    %s\n", aln1);
+   fprintf(out, "    %.*s\n", len, aln1);
 
    fprintf(out, "    ");
-   for(i=0; i<strlen(aln1); i++)
+   for(i=0; i<len; i++)
    {
       if(aln1[i] == aln2[i])
       {
@@ -1219,215 +1282,517 @@ void PrintAlignment(FILE *out, char *inAlign1, char *inAlign2)
    }
    fprintf(out,"\n");
    
-   fprintf(out, "    %s\n", aln2);
+   fprintf(out, "    %.*s\n", len, aln2);
    fprintf(out, "    Mismatches: %d\n\n", nMismatches);
 }
 
 
 /************************************************************************/
-/*>void DoDSegment(FILE *out, char *seq, char *species, char *dataDir,
-                   char *hvBestAlign1, char *hvBestAlign2, 
-                   char *hjBestAlign1, char *hjBestAlign2,
-                   BOOL verbose, BOOL showAlignment)
+/*>void GetMatchFields(char *match, char *id, char *frame, char *species)
+   ----------------------------------------------------------------------
 *//**
-   \param[in]     *out           Output file pointer
-   \param[in,out] *seq           Sequence to analyze
-   \param[in]     *species       "Homo", "Mus" or blank
-   \param[in]     *dataDir       Data directory
-   \param[in]     *hvBestAlign1  Best VH alignment (in seq)
-   \param[in]     *hvBestAlign2  Best VH alignment (in database)
-   \param[in]     *hjBestAlign1  Best JH alignment (in seq)
-   \param[in]     *hjBestAlign2  Best JH alignment (in database)
-   \param[in]     verbose        Verbose output
-   \param[in]     showAlignment  Show the alignment of the region
-
-   Handle the identification of a D-segment. If we are not deleting
-   regions, then this does so and extracts just the region between
-   V and J since this is so short.
-
--  26.04.23 Original   By: ACRM   
+   \param[in]   match     Match FASTA header (region_id_frame_species)
+   \param[out]  id        Germline name
+   \param[out]  frame     Reading frame
+   \param[out]  species   Species
+
+   Splits up the header of a germline sequence. Each output must have
+   space for LABELBUFF characters.
+
+   - 18.10.26 Original (from PrintResult())   By: ACRM
 */
-void DoDSegment(FILE *out, char *seq, char *species, char *dataDir,
-                char *hvBestAlign1, char *hvBestAlign2, 
-                char *hjBestAlign1, char *hjBestAlign2,
-                BOOL verbose, BOOL showAlignment)
+void GetMatchFields(char *match, char *id, char *frame, char *species)
 {
-   char        hdMatch[MAXBUFF+1],
-               DSeq[MAXBUFF+1];
-   static char bestAlign1[HUGEBUFF+1],
-               bestAlign2[HUGEBUFF+1];
-   REAL        hdScore     = -1.0;
-   
-#ifndef REMOVESEQS
-   RemoveSequence(seq, hvBestAlign1, hvBestAlign2, verbose);
-   RemoveSequence(seq, hjBestAlign1, hjBestAlign2, verbose);
-#endif
+   id[0] = frame[0] = species[0] = '\0';
+   id[LABELBUFF-1] = frame[LABELBUFF-1] = species[LABELBUFF-1] = '\0';
 
-   CopyDSegment(DSeq, seq);
-   
-   hdScore = ScanAgainstDB("heavy_d", DSeq, verbose, species,
-                           hdMatch, bestAlign1, bestAlign2,
-                           dataDir);
+   if((match = strchr(match, '_'))==NULL)
+      return;
+   match++;
+   strncpy(id, match, LABELBUFF-1);
+   TERMAT(id, '_');
+
+   if((match = strchr(match, '_'))==NULL)
+      return;
+   match++;
+   strncpy(frame, match, LABELBUFF-1);
+   TERMAT(frame, '_');
 
-   if(hdScore > THRESHOLD_HD)
+   if((match = strchr(match, '_'))==NULL)
+      return;
+   match++;
+   strncpy(species, match, LABELBUFF-1);
+}
+
+
+/************************************************************************/
+/*>void PrintAIRRHeader(FILE *out, BOOL showAlignment)
+   ---------------------------------------------------
+*//**
+   \param[in]   out            Output file pointer
+   \param[in]   showAlignment  Include the CIGAR columns
+
+   Prints the column names for --format airr. The names follow the
+   AIRR Community rearrangement schema where there is one.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void PrintAIRRHeader(FILE *out, BOOL showAlignment)
+{
+   int i;
+
+   fprintf(out, "sequence_id\tlocus\tspecies");
+   for(i=0; i<NAIRRREGIONS; i++)
    {
-      int alnLength = CalcShortSeqLen(bestAlign1, bestAlign2);
-      
-      PrintResult(out, "DH", hdScore/(REAL)alnLength, hdMatch);
+      char *region = sAIRRRegions[i];
+
+      fprintf(out, "\t%s_call\t%s_identity\t%s_mismatches\
+\t%s_sequence_start\t%s_sequence_end\
+\t%s_germline_start\t%s_germline_end",
+              region, region, region, region, region, region, region);
       if(showAlignment)
-         PrintAlignment(out, bestAlign1, bestAlign2);
+         fprintf(out, "\t%s_cigar", region);
    }
+   fprintf(out, "\tnote\n");
 }
 
+
 /************************************************************************/
-/*>void CopyDSegment(char *DSeq, char *seq)
-   ----------------------------------------
+/*>void PrintAIRRRow(FILE *out, char *header, char *seq,
+                     AGLRESULT *result, BOOL showAlignment)
+   ------------------------------------------------------
 *//**
-   \param[out]   *DSeq    The region between the V and J segments
-   \param[in]    *seq     Sequence to analyze
-
-   Takes the sequence (seq) which has the V and J regions masked out
-   with X characters and then extracts the region between them and
-   copies it into DSeq.
-
--  26.04.23 Original   By: ACRM   
+   \param[in]   out            Output file pointer
+   \param[in]   header         FASTA header
+   \param[in]   seq            The sequence
+   \param[in]   result         Result from AssignGermlines()
+   \param[in]   showAlignment  Include the CIGAR columns
+
+   Prints the row for a sequence in --format airr. The row is built in
+   the thread's buffer and written with a single call. Regions that
+   weren't found have empty columns. Tabs in the header are changed to
+   spaces.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 The error for an unknown chain type moved to
+              ProcessRecord()
 */
-void CopyDSegment(char *DSeq, char *seq)
+void PrintAIRRRow(FILE *out, char *header, char *seq, AGLRESULT *result,
+                  BOOL showAlignment)
 {
-   int inPos  = 0,
-       outPos = 0,
-       block  = BLOCK_UNDEFINED;
-   
-   for(inPos=0, outPos=0;  inPos<strlen(seq);  inPos++)
+   OUTBUF *buf   = ThreadOutBuf();
+   int    seqLen = strlen(seq),
+          i, j;
+   char   *chp,
+          id[LABELBUFF],
+          frame[LABELBUFF],
+          species[LABELBUFF];
+
+   buf->len = 0;
+   AddOutput(buf, "%s", (header[0] == '>') ? header+1 : header);
+   for(chp=buf->data; *chp; chp++)
+   {
+      if(*chp == '\t')
+         *chp = ' ';
+   }
+
+   /* The locus is the start of the first germline name (IGH, IGK or
+      IGL)
+   */
+   id[0] = species[0] = '\0';
+   if(result->nDomains)
+      GetMatchFields(result->domains[0].match, id, frame, species);
+   AddOutput(buf, "\t%.3s\t%s", (strncmp(id, "IG", 2) ? "" : id),
+             species);
+
+   for(i=0; i<NAIRRREGIONS; i++)
    {
-      switch(block)
+      AGLDOMAIN *domain = NULL;
+
+      for(j=0; (j<result->nDomains) && (domain == NULL); j++)
       {
-      case BLOCK_UNDEFINED:
-         if(seq[inPos] == 'X') block = BLOCK_X_V;
-         break;
-      case BLOCK_X_V:
-         if(seq[inPos] != 'X')
-         {
-            block = BLOCK_D;
-            DSeq[outPos++] = seq[inPos];
-         }
-         break;
-      case BLOCK_D:
-         if(seq[inPos] == 'X')
-         {
-            inPos = strlen(seq+1);
-            break;
-         }
-         DSeq[outPos++] = seq[inPos];
+         if(!strcmp(result->domains[j].domain, sAIRRDomains[i][0]) ||
+            ((sAIRRDomains[i][1] != NULL) &&
+             !strcmp(result->domains[j].domain, sAIRRDomains[i][1])))
+            domain = &(result->domains[j]);
       }
+
+      if(domain != NULL)
+         AddAIRRDomain(buf, domain, seqLen, showAlignment);
+      else
+         AddOutput(buf, (showAlignment ? "\t\t\t\t\t\t\t\t" :
+                                         "\t\t\t\t\t\t\t"));
    }
-   DSeq[outPos] = '\0';
+   AddOutput(buf, "\t%s\n", result->special);
+
+   fwrite(buf->data, 1, buf->len, out);
 }
 
 
 /************************************************************************/
-/*>BOOL PrintSpecialMatches(FILE *out, char *CH1, char *CH2, char *CH3)
-   --------------------------------------------------------------------
+/*>void AddAIRRDomain(OUTBUF *buf, AGLDOMAIN *domain, int seqLen,
+                      BOOL showAlignment)
+   --------------------------------------------------------------
 *//**
-     \param[in]   out    Output file pointer
-     \param[in]   CH1    CH1 label
-     \param[in]   CH2    CH2 label
-     \param[in]   CH3    CH3-CHS label
-     \return             True if this was a special case; false otherwise
+   \param[in,out] buf            Row being built
+   \param[in]     domain         The domain
+   \param[in]     seqLen         Length of the query
+   \param[in]     showAlignment  Include the CIGAR
 
-     Looks for cases where apparent mixed allelic variants actually match
-     a different allelic variant indentifier.
+   Adds the columns for one region.
 
-     - 22.02.24 Original   By: ACRM
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Uses CountMismatches()
 */
-BOOL PrintSpecialMatches(FILE *out, char *CH1, char *CH2, char *CH3)
+void AddAIRRDomain(OUTBUF *buf, AGLDOMAIN *domain, int seqLen,
+                   BOOL showAlignment)
 {
-   CH1 = strchr(CH1, '_');
-   CH1++;
-   TERMAT(CH1, '_');
-   
-   CH2 = strchr(CH2, '_');
-   CH2++;
-   TERMAT(CH2, '_');
-   
-   CH3 = strchr(CH3, '_');
-   CH3++;
-   TERMAT(CH3, '_');
-   
-   if(!strncmp(CH1, "IGHG1*03", 8) &&
-      !strncmp(CH2, "IGHG1*01", 8) &&
-      !strncmp(CH3, "IGHG1*01", 8))
+   char id[LABELBUFF],
+        frame[LABELBUFF],
+        species[LABELBUFF];
+
+   GetMatchFields(domain->match, id, frame, species);
+   AddOutput(buf, "\t%s\t%.2f\t%d\t%d\t%d\t%d\t%d",
+             id, 100.0*domain->score, CountMismatches(domain),
+             domain->seqStart, domain->seqEnd,
+             domain->germStart, domain->germEnd);
+   if(showAlignment)
    {
-      fprintf(out, "*CH1/2/3 matches IGHG1*08\n");
-      return(TRUE);
+      AddOutput(buf, "\t");
+      AddCIGAR(buf, domain, seqLen);
    }
-   else if (!strncmp(CH1, "IGHG1*01", 8) &&
-            !strncmp(CH2, "IGHG1*01", 8) &&
-            !strncmp(CH3, "IGHG1*03", 8))
+}
+
+
+/************************************************************************/
+/*>int TrimAlignment(char *align1, char *align2, char **start)
+   -----------------------------------------------------------
+*//**
+   \param[in]   align1   Aligned sequence 1
+   \param[in]   align2   Aligned sequence 2
+   \param[out]  start    First column of align1 with residues in both
+   \return               Number of columns from there to the last with
+                         residues in both (0 if there are none)
+
+   - 18.10.26 Original (from PrintAlignment())   By: ACRM
+*/
+int TrimAlignment(char *align1, char *align2, char **start)
+{
+   int first = 0,
+       last  = strlen(align1) - 1;
+
+   while((last >= 0) && ((align1[last] == '-') || (align2[last] == '-')))
+      last--;
+   while((first <= last) &&
+         ((align1[first] == '-') || (align2[first] == '-')))
+      first++;
+
+   *start = align1 + first;
+   return(last - first + 1);
+}
+
+
+/************************************************************************/
+/*>void AddCIGAR(OUTBUF *buf, AGLDOMAIN *domain, int seqLen)
+   ---------------------------------------------------------
+*//**
+   \param[in,out] buf      Row being built
+   \param[in]     domain   The domain
+   \param[in]     seqLen   Length of the query
+
+   Adds the alignment as a CIGAR string in the AIRR style: the query
+   residues before and after the aligned region are soft clipped (S)
+   and the germline residues before it are skipped (N). Within it, M
+   is an aligned pair, I a residue only in the query and D one only
+   in the germline.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void AddCIGAR(OUTBUF *buf, AGLDOMAIN *domain, int seqLen)
+{
+   char *aln1,
+        *aln2,
+        op     = '\0';
+   int  len,
+        i,
+        nOp    = 0;
+
+   len  = TrimAlignment(domain->align1, domain->align2, &aln1);
+   aln2 = domain->align2 + (aln1 - domain->align1);
+
+   if(domain->seqStart > 1)
+      AddOutput(buf, "%dS", domain->seqStart - 1);
+   if(domain->germStart > 1)
+      AddOutput(buf, "%dN", domain->germStart - 1);
+
+   for(i=0; i<=len; i++)
    {
-      fprintf(out, "*** CH1/2/3 matches IGHG1*15\n");
-      return(TRUE);
+      char thisOp = '\0';
+
+      if(i < len)
+         thisOp = (aln1[i] == '-') ? 'D' : ((aln2[i] == '-') ? 'I' : 'M');
+      if(thisOp != op)
+      {
+         if(nOp)
+            AddOutput(buf, "%d%c", nOp, op);
+         op  = thisOp;
+         nOp = 0;
+      }
+      nOp++;
    }
-   else if (!strncmp(CH1, "IGHG1*03", 8) &&
-            !strncmp(CH2, "IGHG1*01", 8) &&
-            !strncmp(CH3, "IGHG1*03", 8))
+
+   if(seqLen > domain->seqEnd)
+      AddOutput(buf, "%dS", seqLen - domain->seqEnd);
+}
+
+
+/************************************************************************/
+/*>int CountMismatches(AGLDOMAIN *domain)
+   --------------------------------------
+*//**
+   \param[in]  domain   The domain
+   \return              Mismatches in its alignment
+
+   Mismatches are counted over the aligned region as shown by -a, so
+   include gaps.
+
+   - 18.10.26 Original (from AddAIRRDomain())   By: ACRM
+*/
+int CountMismatches(AGLDOMAIN *domain)
+{
+   char *aln1,
+        *aln2;
+   int  len,
+        i,
+        nMismatches = 0;
+
+   len  = TrimAlignment(domain->align1, domain->align2, &aln1);
+   aln2 = domain->align2 + (aln1 - domain->align1);
+   for(i=0; i<len; i++)
    {
-      fprintf(out, "*** CH1/2/3 matches IGHG1*03\n");
-      return(TRUE);
+      if(aln1[i] != aln2[i])
+         nMismatches++;
    }
-   else if (!strncmp(CH1, "IGHG1*01", 8) &&
-            !strncmp(CH3, "IGHG1*04", 8))
+   return(nMismatches);
+}
+
+
+/************************************************************************/
+/*>void PrintBinaryRecord(FILE *out, char *header, AGLRESULT *result,
+                          AGLBINDICT *dict)
+   ------------------------------------------------------------------
+*//**
+   \param[in]   out      Output file pointer
+   \param[in]   header   FASTA header
+   \param[in]   result   Result from AssignGermlines()
+   \param[in]   dict     Dictionary from MakeGermlineDict()
+
+   Prints the record for a sequence in --format binary (see aglbin.h).
+   Like PrintAIRRRow(), the record is built in the thread's buffer and
+   written with a single call.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 The error for an unknown chain type moved to
+              ProcessRecord()
+*/
+void PrintBinaryRecord(FILE *out, char *header, AGLRESULT *result,
+                       AGLBINDICT *dict)
+{
+   OUTBUF       *buf = ThreadOutBuf();
+   AGLBINRECORD record;
+   int          i;
+   static char  pad[AGLBINALIGN];
+
+   memset(&record, 0, sizeof(AGLBINRECORD));
+   record.headerLen      = strlen(header);
+   record.specialLen     = strlen(result->special);
+   record.nDomains       = result->nDomains;
+   record.chainType      = result->chainType;
+   record.chainTypeFound = result->chainTypeFound;
+   record.size           = AGLBINPAD(sizeof(AGLBINRECORD) +
+                                     record.nDomains *
+                                     sizeof(AGLBINDOMAIN) +
+                                     record.headerLen +
+                                     record.specialLen + 2);
+
+   buf->len = 0;
+   AddBytes(buf, &record, sizeof(AGLBINRECORD));
+   for(i=0; i<result->nDomains; i++)
    {
-      fprintf(out, "*** CH1/2/3 matches IGHG1*04\n");
-      return(TRUE);
+      AGLDOMAIN    *domain = &(result->domains[i]);
+      AGLBINDOMAIN binDomain;
+
+      memset(&binDomain, 0, sizeof(AGLBINDOMAIN));
+      binDomain.score      = domain->score;
+      binDomain.germline   = FindAGLBinGermline(dict, domain->match);
+      binDomain.mismatches = CountMismatches(domain);
+      binDomain.seqStart   = domain->seqStart;
+      binDomain.seqEnd     = domain->seqEnd;
+      binDomain.germStart  = domain->germStart;
+      binDomain.germEnd    = domain->germEnd;
+      binDomain.domain     = AGLBinDomainCode(domain->domain);
+      AddBytes(buf, &binDomain, sizeof(AGLBINDOMAIN));
    }
-   else if (!strncmp(CH1, "IGHG1*01", 8) &&
-            !strncmp(CH3, "IGHG1*07", 8))
+   AddBytes(buf, header, record.headerLen + 1);
+   AddBytes(buf, result->special, record.specialLen + 1);
+   AddBytes(buf, pad, record.size - buf->len);
+
+   fwrite(buf->data, 1, buf->len, out);
+}
+
+
+/************************************************************************/
+/*>AGLBINDICT *MakeGermlineDict(AGLCONTEXT *context)
+   -------------------------------------------------
+*//**
+   \param[in]  context   Context from InitAGL()
+   \return               Dictionary of all the germline sequences
+
+   - 18.10.26 Original   By: ACRM
+*/
+AGLBINDICT *MakeGermlineDict(AGLCONTEXT *context)
+{
+   AGLBINDICT *dict;
+   char       **names;
+   int        nNames;
+
+   if(((names = GetAGLGermlines(context, &nNames))==NULL) ||
+      ((dict  = MakeAGLBinDict(names, nNames))==NULL))
    {
-      fprintf(out, "*** CH1/2/3 matches IGHG1*07\n");
-      return(TRUE);
+      fprintf(stderr, "\nError (agl): No memory for germline \
+dictionary\n");
+      exit(1);
    }
-   
-   return(FALSE);
+   free(names);
+   return(dict);
 }
 
 
+/************************************************************************/
+/*>void AddOutput(OUTBUF *buf, char *format, ...)
+   ----------------------------------------------
+*//**
+   \param[in,out] buf      Buffer to add to
+   \param[in]     format   printf() format
+   \param[in]     ...      Values to print
+
+   Adds text to the end of a buffer, making it bigger if needed. The
+   text is always terminated.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void AddOutput(OUTBUF *buf, char *format, ...)
+{
+   va_list ap;
+   int     len;
+
+   for(;;)
+   {
+      va_start(ap, format);
+      len = vsnprintf(buf->data + buf->len, buf->size - buf->len,
+                      format, ap);
+      va_end(ap);
+
+      if(len < 0)
+         return;
+      if(buf->len + (size_t)len < buf->size)
+         break;
+
+      buf->size = MAX(2 * buf->size, buf->len + len + 1);
+      if((buf->data = (char *)realloc(buf->data, buf->size))==NULL)
+      {
+         fprintf(stderr, "\nError (agl): No memory for output\n");
+         exit(1);
+      }
+   }
+   buf->len += len;
+}
+
 
-#ifdef USEPATH
 /************************************************************************/
-char *FindPath(void)
+/*>void AddBytes(OUTBUF *buf, void *data, size_t size)
+   ---------------------------------------------------
+*//**
+   \param[in,out] buf    Buffer to add to
+   \param[in]     data   Bytes to add
+   \param[in]     size   Number of them
+
+   Adds binary data to the end of a buffer, making it bigger if needed.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void AddBytes(OUTBUF *buf, void *data, size_t size)
 {
-  char *path = NULL;
-  int  length, dirnameLength;
-
-  if((length = wai_getExecutablePath(NULL, 0, &dirnameLength)) > 0)
-  {
-     if((path = (char*)malloc(length + 1))==NULL)
-        return(NULL);
-     
-    wai_getExecutablePath(path, length, &dirnameLength);
-    path[dirnameLength] = '\0';
-    return(path);
-  }
-
-  return(NULL);
+   if(buf->len + size > buf->size)
+   {
+      buf->size = MAX(2 * buf->size, buf->len + size);
+      if((buf->data = (char *)realloc(buf->data, buf->size))==NULL)
+      {
+         fprintf(stderr, "\nError (agl): No memory for output\n");
+         exit(1);
+      }
+   }
+   memcpy(buf->data + buf->len, data, size);
+   buf->len += size;
 }
 
+
 /************************************************************************/
-#include <dirent.h>
-#include <errno.h>
-BOOL DirectoryExists(char *dirName)
+/*>OUTBUF *ThreadOutBuf(void)
+   --------------------------
+*//**
+   \return   This thread's output buffer
+
+   The buffer is kept for the life of the thread and grows to fit the
+   longest row or record.
+
+   - 18.10.26 Original   By: ACRM
+*/
+OUTBUF *ThreadOutBuf(void)
 {
+   OUTBUF *buf;
 
-   DIR* dir = opendir(dirName);
-   if (dir)
+   pthread_once(&sOutBufOnce, MakeOutBufKey);
+   if((buf = (OUTBUF *)pthread_getspecific(sOutBufKey))==NULL)
    {
-      /* Directory exists. */
-      closedir(dir);
-      return(TRUE);
+      if(((buf = (OUTBUF *)calloc(1, sizeof(OUTBUF)))==NULL) ||
+         ((buf->data = (char *)malloc(HUGEBUFF))==NULL))
+      {
+         fprintf(stderr, "\nError (agl): No memory for output\n");
+         exit(1);
+      }
+      buf->size = HUGEBUFF;
+      pthread_setspecific(sOutBufKey, buf);
    }
+   return(buf);
+}
+
 
-   return(FALSE);
+/************************************************************************/
+/*>void MakeOutBufKey(void)
+   ------------------------
+*//**
+   Creates the key for the threads' output buffers, which are freed
+   as each thread exits.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void MakeOutBufKey(void)
+{
+   pthread_key_create(&sOutBufKey, FreeOutBuf);
 }
-#endif
 
+
+/************************************************************************/
+/*>void FreeOutBuf(void *buf)
+   --------------------------
+*//**
+   \param[in]  buf   An OUTBUF
+
+   - 18.10.26 Original   By: ACRM
+*/
+void FreeOutBuf(void *buf)
+{
+   free(((OUTBUF *)buf)->data);
+   free(buf);
+}
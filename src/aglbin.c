@@ -0,0 +1,489 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       aglbin.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Binary result files
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+   Writes the header of a binary result file and reads the files back.
+   A dictionary of germline names is written once at the start, so each
+   domain in a record refers to its germline by number and each record
+   is a fixed size apart from the FASTA header and note. See aglbin.h
+   for the layout.
+
+**************************************************************************
+
+   Usage:
+   ======
+   See aglbin.h
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "bioplib/macros.h"
+#include "rescache.h"
+#include "aglbin.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+
+/************************************************************************/
+/* Globals
+*/
+/* Domain labels from AssignGermlines(), numbered in the records        */
+static char *sDomains[] =
+{
+   "VL", "JL", "CL",
+   "VH", "DH", "JH", "CH1", "HINGE", "CH2", "CH3-CHS"
+};
+
+/************************************************************************/
+/* Prototypes
+*/
+static BOOL ReadAll(FILE *fp, AGLBINFILE *binFile);
+static void CorruptAGLBin(void);
+
+
+/************************************************************************/
+/*>AGLBINDICT *MakeAGLBinDict(char **names, int nNames)
+   ----------------------------------------------------
+*//**
+   \param[in]  names    Germline names (FASTA headers - a leading > is
+                        ignored)
+   \param[in]  nNames   Number of names
+   \return              The dictionary (or NULL if no memory)
+
+   Numbers the names, dropping any repeats, and makes the file header
+   holding them. The names are not copied and must be kept.
+
+   - 18.10.26 Original   By: ACRM
+*/
+AGLBINDICT *MakeAGLBinDict(char **names, int nNames)
+{
+   AGLBINDICT   *dict;
+   AGLBINHEADER *header;
+   size_t       namesSize = 0;
+   uint32_t     *offsets;
+   char         *name;
+   int          i;
+
+   if((dict = (AGLBINDICT *)calloc(1, sizeof(AGLBINDICT)))==NULL)
+      return(NULL);
+
+   for(dict->tableSize=1;
+       dict->tableSize < 2 * (uint32_t)nNames;
+       dict->tableSize *= 2)
+      continue;
+   if(((dict->table = (uint32_t *)calloc(dict->tableSize,
+                                         sizeof(uint32_t)))==NULL) ||
+      ((dict->names = (char **)malloc(MAX(nNames, 1) *
+                                      sizeof(char *)))==NULL))
+   {
+      FreeAGLBinDict(dict);
+      return(NULL);
+   }
+
+   for(i=0; i<nNames; i++)
+   {
+      name = names[i] + (names[i][0] == '>');
+      if(FindAGLBinGermline(dict, name) == AGLBINNOGERM)
+      {
+         uint32_t slot = (uint32_t)HashString(name) & (dict->tableSize-1);
+
+         while(dict->table[slot])
+            slot = (slot + 1) & (dict->tableSize-1);
+         dict->names[dict->nNames++] = name;
+         dict->table[slot]           = dict->nNames;
+         namesSize += strlen(name) + 1;
+      }
+   }
+
+   /* The header, the offsets and the names, padded                     */
+   dict->size = sizeof(AGLBINHEADER) +
+      AGLBINPAD(dict->nNames * sizeof(uint32_t) + namesSize);
+   if((dict->data = (char *)calloc(1, dict->size))==NULL)
+   {
+      FreeAGLBinDict(dict);
+      return(NULL);
+   }
+
+   header = (AGLBINHEADER *)dict->data;
+   memcpy(header->magic, AGLBINMAGIC, sizeof(header->magic));
+   header->version    = AGLBINVERSION;
+   header->byteOrder  = AGLBINORDER;
+   header->nGermlines = dict->nNames;
+   header->dictSize   = (uint32_t)(dict->size - sizeof(AGLBINHEADER));
+
+   offsets   = (uint32_t *)(header + 1);
+   name      = (char *)(offsets + dict->nNames);
+   namesSize = 0;
+   for(i=0; i<(int)dict->nNames; i++)
+   {
+      offsets[i] = (uint32_t)namesSize;
+      strcpy(name + namesSize, dict->names[i]);
+      namesSize += strlen(dict->names[i]) + 1;
+   }
+
+   return(dict);
+}
+
+
+/************************************************************************/
+/*>void WriteAGLBinHeader(FILE *out, AGLBINDICT *dict)
+   ---------------------------------------------------
+*//**
+   \param[in]  out    Output file
+   \param[in]  dict   Dictionary from MakeAGLBinDict()
+
+   - 18.10.26 Original   By: ACRM
+*/
+void WriteAGLBinHeader(FILE *out, AGLBINDICT *dict)
+{
+   fwrite(dict->data, 1, dict->size, out);
+}
+
+
+/************************************************************************/
+/*>uint32_t FindAGLBinGermline(AGLBINDICT *dict, char *name)
+   ---------------------------------------------------------
+*//**
+   \param[in]  dict   Dictionary from MakeAGLBinDict()
+   \param[in]  name   Germline name (a leading > is ignored)
+   \return            Its number (AGLBINNOGERM if it isn't there)
+
+   May be called from several threads at once.
+
+   - 18.10.26 Original   By: ACRM
+*/
+uint32_t FindAGLBinGermline(AGLBINDICT *dict, char *name)
+{
+   uint32_t slot;
+
+   name += (name[0] == '>');
+   for(slot = (uint32_t)HashString(name) & (dict->tableSize-1);
+       dict->table[slot];
+       slot = (slot + 1) & (dict->tableSize-1))
+   {
+      if(!strcmp(dict->names[dict->table[slot]-1], name))
+         return(dict->table[slot]-1);
+   }
+   return(AGLBINNOGERM);
+}
+
+
+/************************************************************************/
+/*>void FreeAGLBinDict(AGLBINDICT *dict)
+   -------------------------------------
+*//**
+   \param[in]  dict   Dictionary from MakeAGLBinDict() (or NULL)
+
+   - 18.10.26 Original   By: ACRM
+*/
+void FreeAGLBinDict(AGLBINDICT *dict)
+{
+   if(dict == NULL)
+      return;
+
+   free(dict->data);
+   free(dict->names);
+   free(dict->table);
+   free(dict);
+}
+
+
+/************************************************************************/
+/*>int AGLBinDomainCode(char *label)
+   ---------------------------------
+*//**
+   \param[in]  label   Domain label from an AGLDOMAIN
+   \return             Its number in a record (AGLBINNODOMAIN if not
+                       known)
+
+   - 18.10.26 Original   By: ACRM
+*/
+int AGLBinDomainCode(char *label)
+{
+   int i;
+
+   for(i=0; i<(int)(sizeof(sDomains)/sizeof(sDomains[0])); i++)
+   {
+      if(!strcmp(sDomains[i], label))
+         return(i);
+   }
+   return(AGLBINNODOMAIN);
+}
+
+
+/************************************************************************/
+/*>char *AGLBinDomain(int code)
+   ----------------------------
+*//**
+   \param[in]  code   Domain number from a record
+   \return            The domain label ("?" if not known)
+
+   - 18.10.26 Original   By: ACRM
+*/
+char *AGLBinDomain(int code)
+{
+   if((code < 0) || (code >= (int)(sizeof(sDomains)/sizeof(sDomains[0]))))
+      return("?");
+   return(sDomains[code]);
+}
+
+
+/************************************************************************/
+/*>AGLBINFILE *OpenAGLBin(FILE *fp)
+   --------------------------------
+*//**
+   \param[in]  fp   Binary result file, at its start
+   \return          The file ready to read records (or NULL if no
+                    memory)
+
+   A regular file is mapped; anything else is read into memory. Exits
+   if the file isn't a binary result file written on a machine with
+   the same byte order.
+
+   - 18.10.26 Original   By: ACRM
+*/
+AGLBINFILE *OpenAGLBin(FILE *fp)
+{
+   AGLBINFILE   *binFile;
+   AGLBINHEADER *header;
+   struct stat  statBuf;
+   uint32_t     i;
+
+   if((binFile = (AGLBINFILE *)calloc(1, sizeof(AGLBINFILE)))==NULL)
+      return(NULL);
+
+   if((fstat(fileno(fp), &statBuf) == 0) && S_ISREG(statBuf.st_mode) &&
+      (statBuf.st_size > 0) &&
+      ((binFile->data = mmap(NULL, (size_t)statBuf.st_size, PROT_READ,
+                             MAP_PRIVATE, fileno(fp), 0)) != MAP_FAILED))
+   {
+      binFile->size   = (size_t)statBuf.st_size;
+      binFile->mapped = TRUE;
+      madvise(binFile->data, binFile->size, MADV_SEQUENTIAL);
+   }
+   else if(!ReadAll(fp, binFile))
+   {
+      free(binFile);
+      return(NULL);
+   }
+
+   header = (AGLBINHEADER *)binFile->data;
+   if((binFile->size < sizeof(AGLBINHEADER)) ||
+      memcmp(header->magic, AGLBINMAGIC, sizeof(header->magic)) ||
+      (header->version != AGLBINVERSION))
+   {
+      fprintf(stderr, "\nError (agl): Not an agl binary result file\n");
+      exit(1);
+   }
+   if(header->byteOrder != AGLBINORDER)
+   {
+      fprintf(stderr, "\nError (agl): The binary result file was \
+written on a machine with a\n             different byte order\n");
+      exit(1);
+   }
+   if((header->dictSize > binFile->size - sizeof(AGLBINHEADER)) ||
+      (header->dictSize % AGLBINALIGN) ||
+      (header->nGermlines > header->dictSize / sizeof(uint32_t)))
+      CorruptAGLBin();
+
+   binFile->nGermlines = header->nGermlines;
+   binFile->offsets    = (uint32_t *)(header + 1);
+   binFile->names      = (char *)(binFile->offsets + header->nGermlines);
+   binFile->pos        = sizeof(AGLBINHEADER) + header->dictSize;
+
+   /* Each name must be terminated within the dictionary                */
+   for(i=0; i<binFile->nGermlines; i++)
+   {
+      char *end = binFile->data + binFile->pos;
+
+      if((binFile->offsets[i] >= end - binFile->names) ||
+         (memchr(binFile->names + binFile->offsets[i], '\0',
+                 end - (binFile->names + binFile->offsets[i]))==NULL))
+         CorruptAGLBin();
+   }
+
+   return(binFile);
+}
+
+
+/************************************************************************/
+/*>AGLBINRECORD *NextAGLBinRecord(AGLBINFILE *binFile)
+   ---------------------------------------------------
+*//**
+   \param[in,out] binFile   File from OpenAGLBin()
+   \return                  The next record (or NULL at the end)
+
+   The record is checked to lie within the file, with its text
+   terminated. It stays valid until the file is closed.
+
+   - 18.10.26 Original   By: ACRM
+*/
+AGLBINRECORD *NextAGLBinRecord(AGLBINFILE *binFile)
+{
+   AGLBINRECORD *record;
+   size_t       left = binFile->size - binFile->pos,
+                need;
+
+   if(left == 0)
+      return(NULL);
+
+   record = (AGLBINRECORD *)(binFile->data + binFile->pos);
+   if((left < sizeof(AGLBINRECORD)) || (record->size > left) ||
+      (record->size % AGLBINALIGN))
+      CorruptAGLBin();
+
+   need = sizeof(AGLBINRECORD) + record->nDomains * sizeof(AGLBINDOMAIN)
+      + (size_t)record->headerLen + record->specialLen + 2;
+   if((need > record->size) ||
+      (AGLBINHEADERTEXT(record)[record->headerLen] != '\0') ||
+      (AGLBINSPECIAL(record)[record->specialLen] != '\0'))
+      CorruptAGLBin();
+
+   binFile->pos += record->size;
+   return(record);
+}
+
+
+/************************************************************************/
+/*>char *AGLBinGermline(AGLBINFILE *binFile, uint32_t germline)
+   ------------------------------------------------------------
+*//**
+   \param[in]  binFile    File from OpenAGLBin()
+   \param[in]  germline   Germline number from an AGLBINDOMAIN
+   \return                Its name (NULL if it isn't in the dictionary)
+
+   - 18.10.26 Original   By: ACRM
+*/
+char *AGLBinGermline(AGLBINFILE *binFile, uint32_t germline)
+{
+   if(germline >= binFile->nGermlines)
+      return(NULL);
+   return(binFile->names + binFile->offsets[germline]);
+}
+
+
+/************************************************************************/
+/*>void CloseAGLBin(AGLBINFILE *binFile)
+   -------------------------------------
+*//**
+   \param[in]  binFile   File from OpenAGLBin() (or NULL)
+
+   - 18.10.26 Original   By: ACRM
+*/
+void CloseAGLBin(AGLBINFILE *binFile)
+{
+   if(binFile == NULL)
+      return;
+
+   if(binFile->mapped)
+      munmap(binFile->data, binFile->size);
+   else
+      free(binFile->data);
+   free(binFile);
+}
+
+
+/************************************************************************/
+/*>static BOOL ReadAll(FILE *fp, AGLBINFILE *binFile)
+   --------------------------------------------------
+*//**
+   \param[in]     fp        File to read
+   \param[in,out] binFile   Its data and size are filled in
+   \return                  Success (FALSE if no memory)
+
+   Reads a file that can't be mapped, such as a pipe, into memory.
+   The buffer is allocated with malloc() so it is suitably aligned.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static BOOL ReadAll(FILE *fp, AGLBINFILE *binFile)
+{
+   size_t allocated = 0,
+          nRead;
+
+   do
+   {
+      if(binFile->size == allocated)
+      {
+         char *data;
+
+         allocated = MAX(2 * allocated, 1024 * 1024);
+         if((data = (char *)realloc(binFile->data, allocated))==NULL)
+         {
+            free(binFile->data);
+            return(FALSE);
+         }
+         binFile->data = data;
+      }
+      nRead = fread(binFile->data + binFile->size, 1,
+                    allocated - binFile->size, fp);
+      binFile->size += nRead;
+   }  while(nRead > 0);
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static void CorruptAGLBin(void)
+   -------------------------------
+*//**
+   Reports a damaged or truncated binary result file and exits.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void CorruptAGLBin(void)
+{
+   fprintf(stderr, "\nError (agl): The binary result file is damaged or \
+incomplete\n");
+   exit(1);
+}
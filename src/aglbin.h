@@ -0,0 +1,186 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       aglbin.h
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Binary result files
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+   A binary result file (--format binary) is laid out as follows, in
+   the byte order of the machine that wrote it:
+
+      AGLBINHEADER
+      Dictionary of germline names: dictSize bytes holding an offset
+         (uint32_t) for each name from the start of the names, then
+         the names, each terminated with a NUL
+      One record per sequence:
+         AGLBINRECORD
+         nDomains AGLBINDOMAINs
+         The FASTA header (headerLen bytes and a NUL)
+         The note on mixed alleles (specialLen bytes and a NUL)
+
+   The dictionary and every record are padded to a multiple of
+   AGLBINALIGN bytes so that a mapped file can be read in place.
+
+**************************************************************************
+
+   Usage:
+   ======
+   Writing:
+   dict = MakeAGLBinDict(names, nNames);
+   WriteAGLBinHeader(out, dict);
+   germline = FindAGLBinGermline(dict, match);
+   ...
+
+   Reading:
+   AGLBINFILE   *binFile;
+   AGLBINRECORD *record;
+
+   binFile = OpenAGLBin(fp);
+   while((record = NextAGLBinRecord(binFile)) != NULL)
+   {
+      domains = AGLBINDOMAINS(record);
+      header  = AGLBINHEADERTEXT(record);
+      name    = AGLBinGermline(binFile, domains[0].germline);
+      ...
+   }
+   CloseAGLBin(binFile);
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+
+*************************************************************************/
+#ifndef _AGLBIN_H
+#define _AGLBIN_H
+
+/************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "bioplib/SysDefs.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define AGLBINMAGIC    "AGLBIN\r\n" /* Start of the file                 */
+#define AGLBINVERSION  1
+#define AGLBINORDER    0x01020304U /* Checks the byte order             */
+#define AGLBINALIGN    8           /* Records start on multiples of this */
+#define AGLBINNOGERM   0xFFFFFFFFU /* Germline not in the dictionary    */
+#define AGLBINNODOMAIN 0xFF        /* Domain label not known            */
+
+#define AGLBINPAD(x)   (((x) + AGLBINALIGN - 1) & ~(size_t)(AGLBINALIGN - 1))
+
+/* Parts of a record                                                    */
+#define AGLBINDOMAINS(r)    ((AGLBINDOMAIN *)((char *)(r) +             \
+                                              sizeof(AGLBINRECORD)))
+#define AGLBINHEADERTEXT(r) ((char *)(AGLBINDOMAINS(r) + (r)->nDomains))
+#define AGLBINSPECIAL(r)    (AGLBINHEADERTEXT(r) + (r)->headerLen + 1)
+
+/************************************************************************/
+/* Type definitions
+*/
+typedef struct
+{
+   char     magic[8];           /* AGLBINMAGIC                          */
+   uint32_t version,            /* AGLBINVERSION                        */
+            byteOrder,          /* AGLBINORDER                          */
+            nGermlines,         /* Names in the dictionary              */
+            dictSize;           /* Bytes in the dictionary              */
+}  AGLBINHEADER;
+
+typedef struct
+{
+   uint32_t size,               /* Bytes in the record including this   */
+            headerLen;          /* Bytes in the FASTA header            */
+   uint16_t specialLen;         /* Bytes in the note                    */
+   uint8_t  nDomains,
+            chainType,          /* CHAINTYPE_ value                     */
+            chainTypeFound,     /* The chain type was worked out        */
+            pad[3];
+}  AGLBINRECORD;
+
+typedef struct
+{
+   double   score;              /* Fractional sequence identity         */
+   uint32_t germline,           /* Index into the dictionary            */
+            mismatches;         /* Mismatches in the aligned region     */
+   int32_t  seqStart,           /* First and last aligned residues of   */
+            seqEnd,             /* the query, numbered from 1           */
+            germStart,          /* First and last aligned residues of   */
+            germEnd;            /* the germline, numbered from 1        */
+   uint8_t  domain,             /* Index of the label (AGLBinDomain())  */
+            pad[7];
+}  AGLBINDOMAIN;
+
+typedef struct
+{
+   char     *data;              /* Header and dictionary as written     */
+   size_t   size;
+   char     **names;            /* Names in the dictionary              */
+   uint32_t *table,             /* Hash table of name index + 1         */
+            tableSize,
+            nNames;
+}  AGLBINDICT;
+
+typedef struct
+{
+   char     *data,              /* The whole file                       */
+            *names;             /* Start of the names in the dictionary */
+   uint32_t *offsets;           /* Offset of each name                  */
+   size_t   size,
+            pos;                /* Next record                          */
+   uint32_t nGermlines;
+   BOOL     mapped;
+}  AGLBINFILE;
+
+/************************************************************************/
+/* Prototypes
+*/
+AGLBINDICT *MakeAGLBinDict(char **names, int nNames);
+void WriteAGLBinHeader(FILE *out, AGLBINDICT *dict);
+uint32_t FindAGLBinGermline(AGLBINDICT *dict, char *name);
+void FreeAGLBinDict(AGLBINDICT *dict);
+int AGLBinDomainCode(char *label);
+char *AGLBinDomain(int code);
+AGLBINFILE *OpenAGLBin(FILE *fp);
+AGLBINRECORD *NextAGLBinRecord(AGLBINFILE *binFile);
+char *AGLBinGermline(AGLBINFILE *binFile, uint32_t germline);
+void CloseAGLBin(AGLBINFILE *binFile);
+
+#endif
@@ -0,0 +1,228 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       aglbin2txt.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Converts a binary result file to text
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+   Reads the output of agl --format binary and prints it as agl would
+   have printed it without --format (and without -a, as the binary
+   file holds no alignments). Used to check the binary output and as
+   an example of reading it.
+
+**************************************************************************
+
+   Usage:
+   ======
+   aglbin2txt [in.bin [out.txt]]
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bioplib/general.h"
+#include "bioplib/macros.h"
+#include "agl.h"
+#include "aglbin.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define CHAINTYPE(x) (                            \
+   (x)==CHAINTYPE_LIGHT ? "Light" :               \
+    ((x)==CHAINTYPE_HEAVY ? "Heavy" : "Unknown"))
+
+/************************************************************************/
+/* Globals
+*/
+
+/************************************************************************/
+/* Prototypes
+*/
+int main(int argc, char **argv);
+void Usage(void);
+void PrintRecord(FILE *out, AGLBINFILE *binFile, AGLBINRECORD *record);
+void PrintDomain(FILE *out, char *domain, REAL score, char *match);
+
+
+/************************************************************************/
+/*>int main(int argc, char **argv)
+   -------------------------------
+*//**
+   Main program
+
+   - 18.10.26 Original   By: ACRM
+*/
+int main(int argc, char **argv)
+{
+   FILE         *in  = stdin,
+                *out = stdout;
+   AGLBINFILE   *binFile;
+   AGLBINRECORD *record;
+
+   if((argc > 3) || ((argc > 1) && (argv[1][0] == '-')))
+   {
+      Usage();
+      return(0);
+   }
+
+   if(!blOpenStdFiles((argc > 1) ? argv[1] : "",
+                      (argc > 2) ? argv[2] : "", &in, &out))
+   {
+      fprintf(stderr,"Unable to open input or output file\n");
+      return(1);
+   }
+
+   if((binFile = OpenAGLBin(in))==NULL)
+   {
+      fprintf(stderr,"No memory for input\n");
+      return(1);
+   }
+
+   while((record = NextAGLBinRecord(binFile))!=NULL)
+      PrintRecord(out, binFile, record);
+
+   CloseAGLBin(binFile);
+   if(in  != stdin)  fclose(in);
+   if(out != stdout) fclose(out);
+   return(0);
+}
+
+
+/************************************************************************/
+/*>void PrintRecord(FILE *out, AGLBINFILE *binFile, AGLBINRECORD *record)
+   ----------------------------------------------------------------------
+*//**
+   \param[in]   out       Output file pointer
+   \param[in]   binFile   The binary result file
+   \param[in]   record    Record from it
+
+   Prints the results for a sequence as PrintResults() in agl.c does.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void PrintRecord(FILE *out, AGLBINFILE *binFile, AGLBINRECORD *record)
+{
+   AGLBINDOMAIN *domains = AGLBINDOMAINS(record);
+   char         *special = AGLBINSPECIAL(record);
+   int          i;
+
+   fprintf(out, "%s\n", AGLBINHEADERTEXT(record));
+
+   if(record->chainTypeFound)
+      fprintf(out, "# Chain type: %s\n", CHAINTYPE(record->chainType));
+
+   if(record->chainType == CHAINTYPE_UNKNOWN)
+   {
+      fprintf(stderr, "Error: Can't identify chain type!\n");
+      return;
+   }
+
+   for(i=0; i<record->nDomains; i++)
+   {
+      char *match = AGLBinGermline(binFile, domains[i].germline);
+
+      PrintDomain(out, AGLBinDomain(domains[i].domain),
+                  (REAL)domains[i].score, (match == NULL) ? "?" : match);
+   }
+
+   if(special[0])
+      fprintf(out, "%s\n", special);
+}
+
+
+/************************************************************************/
+/*>void PrintDomain(FILE *out, char *domain, REAL score, char *match)
+   ------------------------------------------------------------------
+*//**
+   \param[in]   out        Output file pointer
+   \param[in]   domain     Domain label
+   \param[in]   score      Score for match
+   \param[in]   match      Germline name from the dictionary
+
+   Prints the match information as PrintResult() in agl.c does.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void PrintDomain(FILE *out, char *domain, REAL score, char *match)
+{
+   char id[LABELBUFF],
+        frame[LABELBUFF],
+        species[LABELBUFF],
+        *field;
+   int  i;
+
+   /* The name is region_id_frame_species                              */
+   id[0] = frame[0] = species[0] = '\0';
+   field = strchr(match, '_');
+   for(i=0; (i<3) && (field != NULL); i++)
+   {
+      char *part = (i==0) ? id : ((i==1) ? frame : species);
+
+      strncpy(part, field+1, LABELBUFF-1);
+      part[LABELBUFF-1] = '\0';
+      if(i < 2)
+         TERMAT(part, '_');
+      field = strchr(field+1, '_');
+   }
+
+   fprintf(out, "%-7s : %6.2f%% : %-12s : %s : %s\n",
+           domain, 100.0*score, id, frame, species);
+}
+
+
+/************************************************************************/
+/*>void Usage(void)
+   ----------------
+*//**
+   Print usage message.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void Usage(void)
+{
+   printf("\naglbin2txt V1.0 (c) 2026 UCL, Prof. Andrew C.R. Martin\n\n");
+   printf("Usage: aglbin2txt [in.bin [out.txt]]\n");
+   printf("\nConverts the output of agl --format binary to the text \
+that agl prints\n");
+   printf("without --format or -a.\n\n");
+}
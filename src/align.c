@@ -0,0 +1,1592 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       align.c
+
+   \version    V1.6
+   \date       18.10.26
+   \brief      Affine gap alignment kernels
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+   An in-tree replacement for BiopLib's blAffinealignWindow() with
+   identity scoring. It gives the same scores and alignments but fills
+   the score matrix with SSE4.1 or AVX2 instructions where the CPU
+   supports them.
+
+   As in BiopLib, the matrix is filled backwards from the C-terminus.
+   Each cell is the identity score (1 or 0) plus the best of the
+   diagonal cell and the cells reached by a gap of up to 'window'
+   residues in either sequence, each gap costing the opening penalty
+   plus the extension penalty for each residue after the first. The
+   best cell in the first row or column gives the score and the
+   alignment is traced back from there.
+
+   Since a cell depends only on cells in later columns, a column can
+   be computed with each SIMD lane holding a different query residue.
+   The matrix is tried in 8-bit lanes first and, if any score
+   saturates, redone in 16-bit lanes. Very long sequences or long
+   gap windows use the scalar code. Only the matrix is stored; the
+   traceback recomputes the choice made at each cell on its path.
+
+   The kernel is chosen at run time from the CPU features, but may be
+   forced with SetAlignKernel() or the AGLKERNEL environment variable
+   (scalar, sse4.1 or avx2) for testing. Compiling with -DCHECK_ALIGN
+   makes CompareSeqs() in agl.c check every result against BiopLib.
+
+   AffineScore() gives the same score without the alignment, so a
+   scan can find the best hit without building alignment strings that
+   will be thrown away. It doesn't keep the matrix: a column only reads
+   the next window+1 columns, so just those are kept. With each cell
+   goes the end of the path that the traceback would follow from it,
+   so the aligned region is known as soon as the start of the path is.
+   The SIMD version of this uses 16-bit lanes to hold the ends.
+
+   AffineScoreLanes() goes the other way round, scoring one query
+   against a block of ALIGNLANES database sequences at once with each
+   lane holding a different sequence. It gives the score and the
+   length used to scale it, but not the alignment.
+
+   The work space is kept per-thread so the aligners may be called
+   from several threads at once. A thread should call FreeAlignWork()
+   before it exits. SetAlignKernel() should only be used before any
+   threads are started.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+   V1.1   18.10.26  Added AffineScoreLanes()
+   V1.2   18.10.26  Work space is per-thread. Added FreeAlignWork()
+   V1.3   18.10.26  The kernel is chosen with pthread_once()
+   V1.4   18.10.26  Added AffineScore() which gives the score without
+                    building the alignment
+   V1.5   18.10.26  Counts the alignments and matrix cells for --stats
+   V1.6   18.10.26  AffineScore() keeps only the columns of the matrix
+                    that are still needed. Added alignscore.h
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "bioplib/macros.h"
+#include "align.h"
+#include "stats.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define MAXSIMDWINDOW 32        /* Longest gap window done with SIMD    */
+#define MAXLANES      32        /* Most elements in a vector            */
+#define MATRIXALIGN   64        /* Byte alignment of the matrix         */
+#define MAXSCORE16    65535     /* Scores must fit in 16-bit lanes      */
+
+/* Code for the last aligned pair of a path, which is in the last row
+   or the last column
+*/
+#define PATHEND(i, j, length1, length2) \
+   (((i) == (length1)-1) ? (j) : ((length2) + (i)))
+
+/************************************************************************/
+/* Type definitions
+*/
+typedef struct
+{
+   void    *matrix;             /* Score matrix stored by column        */
+   uint8_t *query8;             /* Query padded with zeros              */
+   uint16_t *query16;           /* Query as 16-bit values               */
+   size_t  matrixSize,          /* Allocated sizes in bytes             */
+           querySize;
+   int     colLen,              /* Elements in each matrix column       */
+           elemSize;            /* Bytes per matrix element             */
+}  ALIGNWORK;
+
+typedef struct
+{
+   void    *matrix;             /* Score matrices stored by row with
+                                   ALIGNLANES bytes for each cell       */
+   size_t  matrixSize;          /* Allocated size in bytes              */
+   int     rowLen,              /* Cells in each row                    */
+           pad;                 /* Cells before the first column        */
+}  LANEWORK;
+
+typedef struct
+{
+   void     *scores,            /* Ring of columns of the score matrix  */
+            *ends;              /* PATHEND() of the path from each cell */
+   uint16_t *query16,           /* Query padded with zeros              */
+            *zero16;            /* A column of zeros                    */
+   int      *rowScores,         /* First row of the matrix              */
+            *rowEnds;
+   size_t   *next,              /* Offset of each column a gap may reach*/
+            ringSize,           /* Allocated sizes in bytes             */
+            colSize,
+            rowSize,
+            nextSize;
+   int      colLen,             /* Elements in each column              */
+            nCols,              /* Columns in the ring                  */
+            elemSize;           /* Bytes per element                    */
+}  SCOREWORK;
+
+typedef struct
+{
+   void      *matrix;           /* A filled score matrix                */
+   ptrdiff_t base,              /* Element offset of cell (0,0)         */
+             iStride,           /* Element offset between rows          */
+             jStride;           /* Element offset between columns       */
+   int       elemSize;          /* Bytes per element                    */
+}  MATRIXVIEW;
+
+/************************************************************************/
+/* Globals
+*/
+static __thread ALIGNWORK sWork;
+static __thread LANEWORK  sLaneWork;
+static __thread SCOREWORK sScoreWork;
+static int                sKernel = ALIGN_KERNEL_AUTO;
+static pthread_once_t     sKernelOnce = PTHREAD_ONCE_INIT;
+
+/************************************************************************/
+/* Prototypes
+*/
+static BOOL SetupWork(ALIGNWORK *work, char *seq1, int length1,
+                      int length2, int window, int elemSize);
+static void FillScalar(ALIGNWORK *work, char *seq1, int length1,
+                       char *seq2, int length2, int penalty, int penext,
+                       int window);
+static BOOL FillMatrix(ALIGNWORK *work, char *seq1, int length1,
+                       char *seq2, int length2, int penalty, int penext,
+                       int window, MATRIXVIEW *view);
+static int Cell(MATRIXVIEW *view, int i, int j);
+static int TraceBack(MATRIXVIEW *view, char *seq1, int length1,
+                     char *seq2, int length2, int penalty, int penext,
+                     int window, char *align1, char *align2,
+                     int *alignLen, int *shortLen);
+static int ChooseKernel(void);
+static void InitKernel(void);
+static BOOL SetupLaneWork(LANEWORK *work, int length1, int maxLen,
+                          int window);
+static BOOL FillScores(SCOREWORK *work, char *seq1, int length1,
+                       char *seq2, int length2, int penalty, int penext,
+                       int window);
+static BOOL SetupScoreWork(SCOREWORK *work, char *seq1, int length1,
+                           int length2, int window, int elemSize);
+static void ScoreScalar(SCOREWORK *work, char *seq1, int length1,
+                        char *seq2, int length2, int penalty, int penext,
+                        int window);
+static int BestPath(SCOREWORK *work, int length1, int length2,
+                    int *shortLen);
+
+/************************************************************************/
+/* SIMD versions of the matrix fill, generated from alignsimd.h
+*/
+#ifdef SIMD_X86
+#define FILLNAME  FillSSE8
+#define TARGET    "sse4.1"
+#define ELEM      uint8_t
+#define ELEMMAX   255
+#define QUERY     query8
+#define NLANES    16
+#define VTYPE     __m128i
+#define VLOAD(p)  _mm_loadu_si128((const __m128i *)(p))
+#define VSTORE(p, v)  _mm_store_si128((__m128i *)(p), (v))
+#define VSTOREU(p, v) _mm_storeu_si128((__m128i *)(p), (v))
+#define VSET1(x)  _mm_set1_epi8((char)(x))
+#define VZERO     _mm_setzero_si128()
+#define VSUBS     _mm_subs_epu8
+#define VADDS     _mm_adds_epu8
+#define VMAX      _mm_max_epu8
+#define VCMPEQ    _mm_cmpeq_epi8
+#define VAND      _mm_and_si128
+#include "alignsimd.h"
+
+#define FILLNAME  FillSSE16
+#define TARGET    "sse4.1"
+#define ELEM      uint16_t
+#define ELEMMAX   MAXSCORE16
+#define QUERY     query16
+#define NLANES    8
+#define VTYPE     __m128i
+#define VLOAD(p)  _mm_loadu_si128((const __m128i *)(p))
+#define VSTORE(p, v)  _mm_store_si128((__m128i *)(p), (v))
+#define VSTOREU(p, v) _mm_storeu_si128((__m128i *)(p), (v))
+#define VSET1(x)  _mm_set1_epi16((short)(x))
+#define VZERO     _mm_setzero_si128()
+#define VSUBS     _mm_subs_epu16
+#define VADDS     _mm_adds_epu16
+#define VMAX      _mm_max_epu16
+#define VCMPEQ    _mm_cmpeq_epi16
+#define VAND      _mm_and_si128
+#include "alignsimd.h"
+
+#define FILLNAME  FillAVX8
+#define TARGET    "avx2"
+#define ELEM      uint8_t
+#define ELEMMAX   255
+#define QUERY     query8
+#define NLANES    32
+#define VTYPE     __m256i
+#define VLOAD(p)  _mm256_loadu_si256((const __m256i *)(p))
+#define VSTORE(p, v)  _mm256_store_si256((__m256i *)(p), (v))
+#define VSTOREU(p, v) _mm256_storeu_si256((__m256i *)(p), (v))
+#define VSET1(x)  _mm256_set1_epi8((char)(x))
+#define VZERO     _mm256_setzero_si256()
+#define VSUBS     _mm256_subs_epu8
+#define VADDS     _mm256_adds_epu8
+#define VMAX      _mm256_max_epu8
+#define VCMPEQ    _mm256_cmpeq_epi8
+#define VAND      _mm256_and_si256
+#include "alignsimd.h"
+
+#define FILLNAME  FillAVX16
+#define TARGET    "avx2"
+#define ELEM      uint16_t
+#define ELEMMAX   MAXSCORE16
+#define QUERY     query16
+#define NLANES    16
+#define VTYPE     __m256i
+#define VLOAD(p)  _mm256_loadu_si256((const __m256i *)(p))
+#define VSTORE(p, v)  _mm256_store_si256((__m256i *)(p), (v))
+#define VSTOREU(p, v) _mm256_storeu_si256((__m256i *)(p), (v))
+#define VSET1(x)  _mm256_set1_epi16((short)(x))
+#define VZERO     _mm256_setzero_si256()
+#define VSUBS     _mm256_subs_epu16
+#define VADDS     _mm256_adds_epu16
+#define VMAX      _mm256_max_epu16
+#define VCMPEQ    _mm256_cmpeq_epi16
+#define VAND      _mm256_and_si256
+#include "alignsimd.h"
+
+/************************************************************************/
+/* SIMD versions of the lane matrix fill, generated from alignlanes.h
+*/
+#define LANENAME  FillLanesSSE
+#define TARGET    "sse4.1"
+#define NVEC      2
+#define VTYPE     __m128i
+#define VLOAD(p)  _mm_loadu_si128((const __m128i *)(p))
+#define VSET1(x)  _mm_set1_epi8((char)(x))
+#define VSUBS     _mm_subs_epu8
+#define VADDS     _mm_adds_epu8
+#define VMAX      _mm_max_epu8
+#define VCMPEQ    _mm_cmpeq_epi8
+#define VAND      _mm_and_si128
+#include "alignlanes.h"
+
+#define LANENAME  FillLanesAVX
+#define TARGET    "avx2"
+#define NVEC      1
+#define VTYPE     __m256i
+#define VLOAD(p)  _mm256_loadu_si256((const __m256i *)(p))
+#define VSET1(x)  _mm256_set1_epi8((char)(x))
+#define VSUBS     _mm256_subs_epu8
+#define VADDS     _mm256_adds_epu8
+#define VMAX      _mm256_max_epu8
+#define VCMPEQ    _mm256_cmpeq_epi8
+#define VAND      _mm256_and_si256
+#include "alignlanes.h"
+
+/************************************************************************/
+/* SIMD versions of the score-only fill, generated from alignscore.h
+*/
+#define SCORENAME ScoreSSE
+#define TARGET    "sse4.1"
+#define NLANES    8
+#define VTYPE     __m128i
+#define VLOAD(p)  _mm_loadu_si128((const __m128i *)(p))
+#define VSTORE(p, v)  _mm_store_si128((__m128i *)(p), (v))
+#define VSET1(x)  _mm_set1_epi16((short)(x))
+#define VZERO     _mm_setzero_si128()
+#define VSUBS     _mm_subs_epu16
+#define VADDS     _mm_adds_epu16
+#define VMAX      _mm_max_epu16
+#define VCMPEQ    _mm_cmpeq_epi16
+#define VAND      _mm_and_si128
+#define VBLEND    _mm_blendv_epi8
+#include "alignscore.h"
+
+#define SCORENAME ScoreAVX
+#define TARGET    "avx2"
+#define NLANES    16
+#define VTYPE     __m256i
+#define VLOAD(p)  _mm256_loadu_si256((const __m256i *)(p))
+#define VSTORE(p, v)  _mm256_store_si256((__m256i *)(p), (v))
+#define VSET1(x)  _mm256_set1_epi16((short)(x))
+#define VZERO     _mm256_setzero_si256()
+#define VSUBS     _mm256_subs_epu16
+#define VADDS     _mm256_adds_epu16
+#define VMAX      _mm256_max_epu16
+#define VCMPEQ    _mm256_cmpeq_epi16
+#define VAND      _mm256_and_si256
+#define VBLEND    _mm256_blendv_epi8
+#include "alignscore.h"
+#endif
+
+
+/************************************************************************/
+/*>int AffineAlign(char *seq1, int length1, char *seq2, int length2,
+                   int penalty, int penext, int window,
+                   char *align1, char *align2, int *alignLen)
+   -------------------------------------------------------------------
+*//**
+   \param[in]  seq1      First sequence (the query)
+   \param[in]  length1   Length of first sequence
+   \param[in]  seq2      Second sequence (the database entry)
+   \param[in]  length2   Length of second sequence
+   \param[in]  penalty   Gap opening penalty
+   \param[in]  penext    Gap extension penalty
+   \param[in]  window    Maximum gap length (<1 for no limit)
+   \param[out] align1    Sequence 1 aligned
+   \param[out] align2    Sequence 2 aligned
+   \param[out] alignLen  Alignment length
+   \return               Alignment score
+
+   Performs an affine gap penalty alignment with identity scoring,
+   giving the same result as
+
+      blAffinealignWindow(seq1, length1, seq2, length2, FALSE, TRUE,
+                          penalty, penext, window, align1, align2,
+                          alignLen);
+
+   The alignment strings are not terminated.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Counted for --stats
+*/
+int AffineAlign(char *seq1, int length1, char *seq2, int length2,
+                int penalty, int penext, int window,
+                char *align1, char *align2, int *alignLen)
+{
+   MATRIXVIEW view;
+
+   *alignLen = 0;
+   if((length1 < 1) || (length2 < 1))
+      return(0);
+
+   if(window < 1)
+      window = MAX(length1, length2);
+
+   if(!FillMatrix(&sWork, seq1, length1, seq2, length2, penalty, penext,
+                  window, &view))
+      return(0);
+   CountStatsAlignments(1, (long)length1 * length2);
+
+   return(TraceBack(&view, seq1, length1, seq2, length2, penalty, penext,
+                    window, align1, align2, alignLen, NULL));
+}
+
+
+/************************************************************************/
+/*>int AffineScore(char *seq1, int length1, char *seq2, int length2,
+                   int penalty, int penext, int window, int *shortLen)
+   -------------------------------------------------------------------
+*//**
+   \param[in]  seq1      First sequence (the query)
+   \param[in]  length1   Length of first sequence
+   \param[in]  seq2      Second sequence (the database entry)
+   \param[in]  length2   Length of second sequence
+   \param[in]  penalty   Gap opening penalty
+   \param[in]  penext    Gap extension penalty
+   \param[in]  window    Maximum gap length (<1 for no limit)
+   \param[out] shortLen  Length of the shorter sequence between the
+                         first and last aligned pairs - i.e. what
+                         CalcShortSeqLen() in libagl.c would give for
+                         the alignment
+   \return               Alignment score
+
+   Gives the score AffineAlign() would, without building the
+   alignment. As for AffineScoreLanes(), neither sequence may contain
+   '-'.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Counted for --stats
+   - 18.10.26 Keeps only the columns still needed rather than the
+              whole matrix
+*/
+int AffineScore(char *seq1, int length1, char *seq2, int length2,
+                int penalty, int penext, int window, int *shortLen)
+{
+   *shortLen = 0;
+   if((length1 < 1) || (length2 < 1))
+      return(0);
+
+   if(window < 1)
+      window = MAX(length1, length2);
+
+   if(!FillScores(&sScoreWork, seq1, length1, seq2, length2, penalty,
+                  penext, window))
+      return(0);
+   CountStatsAlignments(1, (long)length1 * length2);
+
+   return(BestPath(&sScoreWork, length1, length2, shortLen));
+}
+
+
+/************************************************************************/
+/*>BOOL AffineScoreLanes(char *seq1, int length1,
+                         unsigned char *residues, int *lengths,
+                         int maxLen, int penalty, int penext,
+                         int window, int *scores, int *shortLens)
+   ------------------------------------------------------------------
+*//**
+   \param[in]  seq1      First sequence (the query)
+   \param[in]  length1   Length of first sequence
+   \param[in]  residues  ALIGNLANES database sequences interleaved
+   \param[in]  lengths   Length of each database sequence (0 if the
+                         lane is unused)
+   \param[in]  maxLen    Longest database sequence
+   \param[in]  penalty   Gap opening penalty
+   \param[in]  penext    Gap extension penalty
+   \param[in]  window    Maximum gap length
+   \param[out] scores    Alignment score for each lane
+   \param[out] shortLens For each lane, the length of the shorter
+                         sequence between the first and last aligned
+                         pairs - i.e. what CalcShortSeqLen() in agl.c
+                         would give for the alignment
+   \return               FALSE if the lanes can't be used (no SIMD,
+                         database sequences too long or too big a
+                         window)
+
+   Scores a query against a block of database sequences, giving the
+   same scores as AffineAlign() would for each. The block holds
+   residue p (counting from the C-terminus, so the last residue is
+   p=0) of the sequence in lane l at residues[p*ALIGNLANES + l], with
+   zeros after the end of each sequence.
+
+   The matrices are filled together in 8-bit lanes, which can't
+   overflow since a score can't be more than the length of the shorter
+   sequence. The path through each is then followed to find where the
+   aligned region ends, without building the alignment.
+
+   Neither sequence may contain '-' since CalcShortSeqLen() would
+   confuse those with gaps.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Counted for --stats
+*/
+BOOL AffineScoreLanes(char *seq1, int length1, unsigned char *residues,
+                      int *lengths, int maxLen, int penalty, int penext,
+                      int window, int *scores, int *shortLens)
+{
+#ifdef SIMD_X86
+   LANEWORK   *work = &sLaneWork;
+   MATRIXVIEW view;
+   long       nCells = 0;
+   int        kernel,
+              nLanes = 0,
+              lane;
+
+   if((kernel = GetAlignKernel()) == ALIGN_KERNEL_SCALAR)
+      return(FALSE);
+   if((window < 1) || (window > MAXSIMDWINDOW) ||
+      (length1 < 1) || (maxLen < 1) || (maxLen > MAXLANELEN))
+      return(FALSE);
+   if(!SetupLaneWork(work, length1, maxLen, window))
+      return(FALSE);
+
+   if(kernel == ALIGN_KERNEL_AVX2)
+      FillLanesAVX(work, seq1, length1, residues, maxLen, penalty,
+                   penext, window);
+   else
+      FillLanesSSE(work, seq1, length1, residues, maxLen, penalty,
+                   penext, window);
+
+   /* Column j of a sequence is column length-1-j of the stored matrix */
+   view.matrix   = work->matrix;
+   view.iStride  = (ptrdiff_t)work->rowLen * ALIGNLANES;
+   view.jStride  = -ALIGNLANES;
+   view.elemSize = 1;
+   for(lane=0; lane<ALIGNLANES; lane++)
+   {
+      char seq2[MAXLANELEN];
+      int  p;
+
+      if(lengths[lane] < 1)
+         continue;
+      for(p=0; p<lengths[lane]; p++)
+         seq2[lengths[lane]-1-p] = (char)residues[(size_t)p*ALIGNLANES + lane];
+
+      view.base    = (ptrdiff_t)(work->pad + lengths[lane] - 1) *
+                     ALIGNLANES + lane;
+      scores[lane] = TraceBack(&view, seq1, length1, seq2, lengths[lane],
+                               penalty, penext, window, NULL, NULL, NULL,
+                               &(shortLens[lane]));
+      nLanes++;
+      nCells += (long)length1 * lengths[lane];
+   }
+   CountStatsAlignments(nLanes, nCells);
+   return(TRUE);
+#else
+   return(FALSE);
+#endif
+}
+
+
+/************************************************************************/
+/*>static BOOL FillMatrix(ALIGNWORK *work, char *seq1, int length1,
+                          char *seq2, int length2, int penalty,
+                          int penext, int window, MATRIXVIEW *view)
+   -----------------------------------------------------------------
+*//**
+   \param[in,out] work      Work space
+   \param[in]     seq1      First sequence
+   \param[in]     length1   Length of first sequence
+   \param[in]     seq2      Second sequence
+   \param[in]     length2   Length of second sequence
+   \param[in]     penalty   Gap opening penalty
+   \param[in]     penext    Gap extension penalty
+   \param[in]     window    Maximum gap length
+   \param[out]    view      How to read the filled matrix
+   \return                  Success (FALSE if no memory)
+
+   Fills the score matrix with the fastest kernel that can hold the
+   scores.
+
+   - 18.10.26 Original (code from AffineAlign())   By: ACRM
+*/
+static BOOL FillMatrix(ALIGNWORK *work, char *seq1, int length1,
+                       char *seq2, int length2, int penalty, int penext,
+                       int window, MATRIXVIEW *view)
+{
+   int  kernel;
+   BOOL done = FALSE;
+
+   if((kernel = GetAlignKernel()) != ALIGN_KERNEL_SCALAR)
+   {
+      if((window <= MAXSIMDWINDOW) &&
+         (MIN(length1, length2) < MAXSCORE16))
+      {
+#ifdef SIMD_X86
+         /* Try 8-bit lanes and, if that overflows, 16-bit lanes        */
+         if(SetupWork(work, seq1, length1, length2, window, 1))
+         {
+            done = (kernel == ALIGN_KERNEL_AVX2) ?
+               FillAVX8(work, length1, seq2, length2, penalty, penext,
+                        window) :
+               FillSSE8(work, length1, seq2, length2, penalty, penext,
+                        window);
+         }
+         if(!done && SetupWork(work, seq1, length1, length2, window, 2))
+         {
+            done = (kernel == ALIGN_KERNEL_AVX2) ?
+               FillAVX16(work, length1, seq2, length2, penalty, penext,
+                         window) :
+               FillSSE16(work, length1, seq2, length2, penalty, penext,
+                         window);
+         }
+#endif
+      }
+   }
+
+   if(!done)
+   {
+      if(!SetupWork(work, seq1, length1, length2, window, sizeof(int)))
+         return(FALSE);
+      FillScalar(work, seq1, length1, seq2, length2, penalty, penext,
+                 window);
+   }
+
+   view->matrix   = work->matrix;
+   view->base     = 0;
+   view->iStride  = 1;
+   view->jStride  = work->colLen;
+   view->elemSize = work->elemSize;
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL SetupLaneWork(LANEWORK *work, int length1, int maxLen,
+                             int window)
+   -----------------------------------------------------------------
+*//**
+   \param[in,out] work      Work space
+   \param[in]     length1   Length of the query
+   \param[in]     maxLen    Longest database sequence
+   \param[in]     window    Maximum gap length
+   \return                  Success
+
+   Makes sure the lane work space is big enough and clears the cells
+   that are read but not written by the fill: the columns before the
+   start of each row and the rows after the end of the query.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static BOOL SetupLaneWork(LANEWORK *work, int length1, int maxLen,
+                          int window)
+{
+   int    pad    = window + 1,
+          rowLen = maxLen + pad,
+          nRows  = length1 + window + 1,
+          i;
+   size_t cellSize = ALIGNLANES,
+          size     = (size_t)nRows * rowLen * cellSize;
+
+   if(size > work->matrixSize)
+   {
+      free(work->matrix);
+      work->matrixSize = 0;
+      if(posix_memalign(&(work->matrix), MATRIXALIGN, size))
+      {
+         work->matrix = NULL;
+         return(FALSE);
+      }
+      work->matrixSize = size;
+   }
+
+   work->rowLen = rowLen;
+   work->pad    = pad;
+
+   for(i=0; i<length1; i++)
+   {
+      memset((char *)work->matrix + (size_t)i * rowLen * cellSize, 0,
+             pad * cellSize);
+   }
+   memset((char *)work->matrix + (size_t)length1 * rowLen * cellSize, 0,
+          (size_t)(nRows - length1) * rowLen * cellSize);
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL SetupWork(ALIGNWORK *work, char *seq1, int length1,
+                         int length2, int window, int elemSize)
+   ----------------------------------------------------------------
+*//**
+   \param[in,out] work      Work space
+   \param[in]     seq1      The query sequence
+   \param[in]     length1   Length of the query
+   \param[in]     length2   Length of the database sequence
+   \param[in]     window    Maximum gap length
+   \param[in]     elemSize  Bytes per matrix element (1, 2 or 4)
+   \return                  Success
+
+   Makes sure the work space is big enough, copies the query in and
+   clears the parts of the matrix that are read but not written by the
+   fill: the rows beyond the query and the columns beyond the database
+   sequence. Each column has room for the query rounded up to a whole
+   number of vectors plus the rows read by gaps.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static BOOL SetupWork(ALIGNWORK *work, char *seq1, int length1,
+                      int length2, int window, int elemSize)
+{
+   int    colLen,
+          nCols,
+          rowEnd,
+          pad,
+          i, j;
+   size_t size;
+
+   /* The SIMD fills read up to 'window' rows and columns beyond the
+      end of the sequences. The scalar fill doesn't, and its window
+      may be the whole sequence.
+   */
+   pad    = (elemSize == sizeof(int)) ? 0 : window;
+
+   /* Rows: query rounded up, then the rows read by gaps and an extra
+      vector so that unaligned loads stay in the column
+   */
+   rowEnd = ((length1 + MAXLANES - 1) / MAXLANES) * MAXLANES;
+   colLen = rowEnd + ((pad + 2 + MAXLANES - 1) / MAXLANES) * MAXLANES +
+            MAXLANES;
+   nCols  = length2 + pad + 2;
+   size   = (size_t)colLen * nCols * elemSize;
+
+   if(size > work->matrixSize)
+   {
+      free(work->matrix);
+      work->matrixSize = 0;
+      if(posix_memalign(&(work->matrix), MATRIXALIGN, size))
+      {
+         work->matrix = NULL;
+         return(FALSE);
+      }
+      work->matrixSize = size;
+   }
+
+   if((size_t)colLen > work->querySize)
+   {
+      free(work->query8);
+      free(work->query16);
+      work->query8  = (uint8_t *)malloc(colLen * sizeof(uint8_t));
+      work->query16 = (uint16_t *)malloc(colLen * sizeof(uint16_t));
+      if((work->query8 == NULL) || (work->query16 == NULL))
+      {
+         free(work->query8);
+         free(work->query16);
+         work->query8    = NULL;
+         work->query16   = NULL;
+         work->querySize = 0;
+         return(FALSE);
+      }
+      work->querySize = colLen;
+   }
+
+   for(i=0; i<colLen; i++)
+   {
+      work->query8[i]  = (i<length1) ? (uint8_t)seq1[i] : 0;
+      work->query16[i] = work->query8[i];
+   }
+
+   work->colLen   = colLen;
+   work->elemSize = elemSize;
+
+   /* Clear the rows below the query in each column, then the extra
+      columns
+   */
+   for(j=0; j<length2; j++)
+   {
+      memset((char *)work->matrix +
+             ((size_t)j * colLen + length1) * elemSize,
+             0, (size_t)(colLen - length1) * elemSize);
+   }
+   memset((char *)work->matrix + (size_t)length2 * colLen * elemSize,
+          0, (size_t)(nCols - length2) * colLen * elemSize);
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static void FillScalar(ALIGNWORK *work, char *seq1, int length1,
+                          char *seq2, int length2, int penalty,
+                          int penext, int window)
+   ----------------------------------------------------------------
+*//**
+   \param[in,out] work      Work space set up for int elements
+   \param[in]     seq1      The query sequence
+   \param[in]     length1   Length of the query
+   \param[in]     seq2      The database sequence
+   \param[in]     length2   Length of the database sequence
+   \param[in]     penalty   Gap opening penalty
+   \param[in]     penext    Gap extension penalty
+   \param[in]     window    Maximum gap length
+
+   Fills the score matrix in the same way as blAffinealignWindow().
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void FillScalar(ALIGNWORK *work, char *seq1, int length1,
+                       char *seq2, int length2, int penalty, int penext,
+                       int window)
+{
+   int *matrix = (int *)work->matrix,
+       colLen  = work->colLen,
+       i, j, k, l, g;
+
+#define M(a, b) matrix[(size_t)(b) * colLen + (a)]
+   for(j=length2-1; j>=0; j--)
+   {
+      for(i=length1-1; i>=0; i--)
+      {
+         int best = 0;
+
+         if((i < length1-1) && (j < length2-1))
+         {
+            int right = 0,
+                down  = 0;
+
+            best = M(i+1, j+1);
+
+            if(i+2 < length1)
+               right = M(i+2, j+1) - penalty;
+            for(k=i+3, g=1; (k<length1) && (k<=i+1+window); k++, g++)
+               right = MAX(right, M(k, j+1) - (penalty + g*penext));
+
+            if(j+2 < length2)
+               down = M(i+1, j+2) - penalty;
+            for(l=j+3, g=1; (l<length2) && (l<=j+1+window); l++, g++)
+               down = MAX(down, M(i+1, l) - (penalty + g*penext));
+
+            best = MAX(best, MAX(right, down));
+         }
+
+         M(i, j) = best + ((seq1[i] == seq2[j]) ? 1 : 0);
+      }
+   }
+#undef M
+}
+
+
+/************************************************************************/
+/*>static BOOL FillScores(SCOREWORK *work, char *seq1, int length1,
+                          char *seq2, int length2, int penalty,
+                          int penext, int window)
+   ----------------------------------------------------------------
+*//**
+   \param[in,out] work      Work space
+   \param[in]     seq1      First sequence
+   \param[in]     length1   Length of first sequence
+   \param[in]     seq2      Second sequence
+   \param[in]     length2   Length of second sequence
+   \param[in]     penalty   Gap opening penalty
+   \param[in]     penext    Gap extension penalty
+   \param[in]     window    Maximum gap length
+   \return                  Success (FALSE if no memory)
+
+   Fills the columns kept for AffineScore() with the fastest kernel
+   that can hold the scores and path ends.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static BOOL FillScores(SCOREWORK *work, char *seq1, int length1,
+                       char *seq2, int length2, int penalty, int penext,
+                       int window)
+{
+#ifdef SIMD_X86
+   int kernel = GetAlignKernel();
+
+   if((kernel != ALIGN_KERNEL_SCALAR) && (window <= MAXSIMDWINDOW) &&
+      (length1 + length2 < MAXSCORE16) &&
+      SetupScoreWork(work, seq1, length1, length2, window, 2))
+   {
+      if(kernel == ALIGN_KERNEL_AVX2)
+         ScoreAVX(work, length1, seq2, length2, penalty, penext, window);
+      else
+         ScoreSSE(work, length1, seq2, length2, penalty, penext, window);
+      return(TRUE);
+   }
+#endif
+
+   if(!SetupScoreWork(work, seq1, length1, length2, window, sizeof(int)))
+      return(FALSE);
+   ScoreScalar(work, seq1, length1, seq2, length2, penalty, penext,
+               window);
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL SetupScoreWork(SCOREWORK *work, char *seq1, int length1,
+                              int length2, int window, int elemSize)
+   ---------------------------------------------------------------------
+*//**
+   \param[in,out] work      Work space
+   \param[in]     seq1      The query sequence
+   \param[in]     length1   Length of the query
+   \param[in]     length2   Length of the database sequence
+   \param[in]     window    Maximum gap length
+   \param[in]     elemSize  Bytes per element (2 or sizeof(int))
+   \return                  Success
+
+   Makes sure the work space for the score-only fill is big enough,
+   copies the query in and clears the rows beyond the query in each
+   column kept. The columns are laid out as for SetupWork(), but there
+   are only enough of them for a column and the window+1 after it.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static BOOL SetupScoreWork(SCOREWORK *work, char *seq1, int length1,
+                           int length2, int window, int elemSize)
+{
+   int    colLen,
+          nCols,
+          rowEnd,
+          pad,
+          i, j;
+   size_t size;
+
+   pad    = (elemSize == sizeof(int)) ? 0 : window;
+   rowEnd = ((length1 + MAXLANES - 1) / MAXLANES) * MAXLANES;
+   colLen = rowEnd + ((pad + 2 + MAXLANES - 1) / MAXLANES) * MAXLANES +
+            MAXLANES;
+   nCols  = MIN(window + 2, length2);
+   size   = (size_t)colLen * nCols * elemSize;
+
+   if(size > work->ringSize)
+   {
+      free(work->scores);
+      free(work->ends);
+      work->ringSize = 0;
+      work->ends     = NULL;
+      if(posix_memalign(&(work->scores), MATRIXALIGN, size))
+      {
+         work->scores = NULL;
+         return(FALSE);
+      }
+      if(posix_memalign(&(work->ends), MATRIXALIGN, size))
+      {
+         free(work->scores);
+         work->scores = work->ends = NULL;
+         return(FALSE);
+      }
+      work->ringSize = size;
+   }
+
+   if((size_t)colLen > work->colSize)
+   {
+      free(work->query16);
+      free(work->zero16);
+      work->query16 = (uint16_t *)malloc(colLen * sizeof(uint16_t));
+      work->zero16  = (uint16_t *)calloc(colLen, sizeof(uint16_t));
+      if((work->query16 == NULL) || (work->zero16 == NULL))
+      {
+         free(work->query16);
+         free(work->zero16);
+         work->query16 = work->zero16 = NULL;
+         work->colSize = 0;
+         return(FALSE);
+      }
+      work->colSize = colLen;
+   }
+
+   if((size_t)length2 > work->rowSize)
+   {
+      free(work->rowScores);
+      free(work->rowEnds);
+      work->rowScores = (int *)malloc(length2 * sizeof(int));
+      work->rowEnds   = (int *)malloc(length2 * sizeof(int));
+      if((work->rowScores == NULL) || (work->rowEnds == NULL))
+      {
+         free(work->rowScores);
+         free(work->rowEnds);
+         work->rowScores = work->rowEnds = NULL;
+         work->rowSize   = 0;
+         return(FALSE);
+      }
+      work->rowSize = length2;
+   }
+
+   if((size_t)nCols > work->nextSize)
+   {
+      free(work->next);
+      if((work->next = (size_t *)malloc(nCols * sizeof(size_t)))==NULL)
+      {
+         work->nextSize = 0;
+         return(FALSE);
+      }
+      work->nextSize = nCols;
+   }
+
+   for(i=0; i<colLen; i++)
+      work->query16[i] = (i<length1) ? (unsigned char)seq1[i] : 0;
+
+   work->colLen   = colLen;
+   work->nCols    = nCols;
+   work->elemSize = elemSize;
+
+   for(j=0; j<nCols; j++)
+   {
+      size_t offset = ((size_t)j * colLen + length1) * elemSize,
+             count  = (size_t)(colLen - length1) * elemSize;
+
+      memset((char *)work->scores + offset, 0, count);
+      memset((char *)work->ends   + offset, 0, count);
+   }
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static void ScoreScalar(SCOREWORK *work, char *seq1, int length1,
+                           char *seq2, int length2, int penalty,
+                           int penext, int window)
+   ----------------------------------------------------------------
+*//**
+   \param[in,out] work      Work space set up for int elements
+   \param[in]     seq1      The query sequence
+   \param[in]     length1   Length of the query
+   \param[in]     seq2      The database sequence
+   \param[in]     length2   Length of the database sequence
+   \param[in]     penalty   Gap opening penalty
+   \param[in]     penext    Gap extension penalty
+   \param[in]     window    Maximum gap length (at least 1)
+
+   Fills the matrix as FillScalar() does, but keeps only the columns
+   that are still to be read. Each cell also gets the PATHEND() of the
+   path TraceBack() would follow from it: the move is chosen as it is
+   there and the end is copied from the cell it leads to. The first
+   row is kept for BestPath().
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void ScoreScalar(SCOREWORK *work, char *seq1, int length1,
+                        char *seq2, int length2, int penalty, int penext,
+                        int window)
+{
+   int    *scores = (int *)work->scores,
+          *ends   = (int *)work->ends,
+          colLen  = work->colLen,
+          nCols   = work->nCols,
+          i, j, k, l, g, nNext;
+   size_t *next   = work->next;
+
+   for(j=length2-1; j>=0; j--)
+   {
+      size_t colStart = (size_t)(j % nCols) * colLen;
+
+      /* The columns after this one that a gap in seq1 may reach       */
+      for(l=j+1, nNext=0; (l<length2) && (l<=j+1+window); l++)
+         next[nNext++] = (size_t)(l % nCols) * colLen;
+
+      for(i=length1-1; i>=0; i--)
+      {
+         int best = 0,
+             end  = PATHEND(i, j, length1, length2);
+
+         if((i < length1-1) && (j < length2-1))
+         {
+            int *nextCol = scores + next[0],
+                dia      = nextCol[i+1],
+                rCell    = i+2,
+                dCell    = 1,
+                right,
+                down;
+
+            right = (rCell < length1) ? nextCol[rCell] - penalty : 0;
+            for(k=i+3, g=1; (k<length1) && (k<=i+1+window); k++, g++)
+            {
+               int thisScore = nextCol[k] - (penalty + g*penext);
+               if(thisScore > right)
+               {
+                  right = thisScore;
+                  rCell = k;
+               }
+            }
+
+            down = (nNext > 1) ? scores[next[1] + i+1] - penalty : 0;
+            for(l=2, g=1; l<nNext; l++, g++)
+            {
+               int thisScore = scores[next[l] + i+1] -
+                               (penalty + g*penext);
+               if(thisScore > down)
+               {
+                  down  = thisScore;
+                  dCell = l;
+               }
+            }
+
+            /* Make the same move as TraceBack()                        */
+            if((dia >= right) && (dia >= down))
+            {
+               best = dia;
+               end  = ends[next[0] + i+1];
+            }
+            else if(right >= down)
+            {
+               best = right;
+               end  = ends[next[0] + rCell];
+            }
+            else
+            {
+               best = down;
+               end  = ends[next[dCell] + i+1];
+            }
+         }
+
+         scores[colStart + i] = best + ((seq1[i] == seq2[j]) ? 1 : 0);
+         ends[colStart + i]   = end;
+      }
+
+      work->rowScores[j] = scores[colStart];
+      work->rowEnds[j]   = ends[colStart];
+   }
+}
+
+
+/************************************************************************/
+/*>static int BestPath(SCOREWORK *work, int length1, int length2,
+                       int *shortLen)
+   --------------------------------------------------------------
+*//**
+   \param[in]  work      Work space filled by FillScores()
+   \param[in]  length1   Length of the query
+   \param[in]  length2   Length of the database sequence
+   \param[out] shortLen  Length of the shorter sequence between the
+                         first and last aligned pairs
+   \return               Alignment score
+
+   Finds the start of the path as TraceBack() does, from the first
+   row and then the first column (which is the first column kept),
+   and works out shortLen from the end of the path.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static int BestPath(SCOREWORK *work, int length1, int length2,
+                    int *shortLen)
+{
+   int score = work->rowScores[0],
+       end   = work->rowEnds[0],
+       bestI = 0,
+       bestJ = 0,
+       endI,
+       endJ,
+       i, j;
+
+   for(j=0; j<length2; j++)
+   {
+      if(work->rowScores[j] > score)
+      {
+         score = work->rowScores[j];
+         end   = work->rowEnds[j];
+         bestJ = j;
+      }
+   }
+   for(i=0; i<length1; i++)
+   {
+      int cell, cellEnd;
+
+      if(work->elemSize == 2)
+      {
+         cell    = ((uint16_t *)work->scores)[i];
+         cellEnd = ((uint16_t *)work->ends)[i];
+      }
+      else
+      {
+         cell    = ((int *)work->scores)[i];
+         cellEnd = ((int *)work->ends)[i];
+      }
+
+      if(cell > score)
+      {
+         score = cell;
+         end   = cellEnd;
+         bestI = i;
+         bestJ = 0;
+      }
+   }
+
+   if(end < length2)
+   {
+      endI = length1-1;
+      endJ = end;
+   }
+   else
+   {
+      endI = end - length2;
+      endJ = length2-1;
+   }
+
+   *shortLen = MIN(endI - bestI + 1, endJ - bestJ + 1);
+   return(score);
+}
+
+
+/************************************************************************/
+/*>static int Cell(MATRIXVIEW *view, int i, int j)
+   -----------------------------------------------
+*//**
+   \param[in]  view   A filled matrix
+   \param[in]  i      Position in the query
+   \param[in]  j      Position in the database sequence
+   \return            Matrix value
+
+   Reads a matrix cell whatever the layout and element size
+
+   - 18.10.26 Original   By: ACRM
+*/
+static int Cell(MATRIXVIEW *view, int i, int j)
+{
+   ptrdiff_t offset = view->base + i * view->iStride + j * view->jStride;
+
+   switch(view->elemSize)
+   {
+   case 1:
+      return(((uint8_t *)view->matrix)[offset]);
+   case 2:
+      return(((uint16_t *)view->matrix)[offset]);
+   default:
+      break;
+   }
+   return(((int *)view->matrix)[offset]);
+}
+
+
+/************************************************************************/
+/*>static int TraceBack(MATRIXVIEW *view, char *seq1, int length1,
+                        char *seq2, int length2, int penalty,
+                        int penext, int window, char *align1,
+                        char *align2, int *alignLen, int *shortLen)
+   ----------------------------------------------------------------
+*//**
+   \param[in]  view      A filled matrix
+   \param[in]  seq1      The query sequence
+   \param[in]  length1   Length of the query
+   \param[in]  seq2      The database sequence
+   \param[in]  length2   Length of the database sequence
+   \param[in]  penalty   Gap opening penalty
+   \param[in]  penext    Gap extension penalty
+   \param[in]  window    Maximum gap length
+   \param[out] align1    Sequence 1 aligned (NULL if not needed)
+   \param[out] align2    Sequence 2 aligned
+   \param[out] alignLen  Alignment length
+   \param[out] shortLen  Length of the shorter sequence between the
+                         first and last aligned pairs (may be NULL)
+   \return               Alignment score
+
+   Finds the best score in the first row or column and follows the
+   path from there. At each cell the move is worked out again exactly
+   as blAffinealignWindow() chose it: the diagonal wins ties, then a
+   gap in seq2, then a gap in seq1, and the shortest gap wins among
+   equal scoring gaps.
+
+   If align1 is NULL, the path is followed just to find where it ends
+   and align2 and alignLen aren't used.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static int TraceBack(MATRIXVIEW *view, char *seq1, int length1,
+                     char *seq2, int length2, int penalty, int penext,
+                     int window, char *align1, char *align2,
+                     int *alignLen, int *shortLen)
+{
+   int i, j, k, l, g,
+       bestI = 0,
+       bestJ = 0,
+       score,
+       pos   = 0;
+
+   score = Cell(view, 0, 0);
+   for(j=0; j<length2; j++)
+   {
+      if(Cell(view, 0, j) > score)
+      {
+         score = Cell(view, 0, j);
+         bestI = 0;
+         bestJ = j;
+      }
+   }
+   for(i=0; i<length1; i++)
+   {
+      if(Cell(view, i, 0) > score)
+      {
+         score = Cell(view, i, 0);
+         bestI = i;
+         bestJ = 0;
+      }
+   }
+
+   /* Leading residues                                                  */
+   if(align1 != NULL)
+   {
+      for(i=0; i<bestI; i++)
+      {
+         align1[pos] = seq1[i];
+         align2[pos] = '-';
+         pos++;
+      }
+      for(j=0; j<bestJ; j++)
+      {
+         align1[pos] = '-';
+         align2[pos] = seq2[j];
+         pos++;
+      }
+   }
+
+   i = bestI;
+   j = bestJ;
+   while((i < length1-1) && (j < length2-1))
+   {
+      int dia, right, down,
+          rCell, dCell,
+          nextI, nextJ;
+
+      dia   = Cell(view, i+1, j+1);
+
+      /* If the diagonal gives this cell's score, it wins any tie with
+         the gaps so they needn't be checked
+      */
+      if(Cell(view, i, j) - ((seq1[i] == seq2[j]) ? 1 : 0) == dia)
+      {
+         if(align1 != NULL)
+         {
+            align1[pos] = seq1[i];
+            align2[pos] = seq2[j];
+            pos++;
+         }
+         i++;
+         j++;
+         continue;
+      }
+
+      rCell = i+2;
+      right = (rCell < length1) ? Cell(view, rCell, j+1) - penalty : 0;
+      for(k=i+3, g=1; (k<length1) && (k<=i+1+window); k++, g++)
+      {
+         int thisScore = Cell(view, k, j+1) - (penalty + g*penext);
+         if(thisScore > right)
+         {
+            right = thisScore;
+            rCell = k;
+         }
+      }
+
+      dCell = j+2;
+      down  = (dCell < length2) ? Cell(view, i+1, dCell) - penalty : 0;
+      for(l=j+3, g=1; (l<length2) && (l<=j+1+window); l++, g++)
+      {
+         int thisScore = Cell(view, i+1, l) - (penalty + g*penext);
+         if(thisScore > down)
+         {
+            down  = thisScore;
+            dCell = l;
+         }
+      }
+
+      if((dia >= right) && (dia >= down))
+      {
+         nextI = i+1;
+         nextJ = j+1;
+      }
+      else if(right >= down)
+      {
+         nextI = rCell;
+         nextJ = j+1;
+      }
+      else
+      {
+         nextI = i+1;
+         nextJ = dCell;
+      }
+
+      if(align1 != NULL)
+      {
+         align1[pos] = seq1[i];
+         align2[pos] = seq2[j];
+         pos++;
+         for(k=i+1; k<nextI; k++)
+         {
+            align1[pos] = seq1[k];
+            align2[pos] = '-';
+            pos++;
+         }
+         for(l=j+1; l<nextJ; l++)
+         {
+            align1[pos] = '-';
+            align2[pos] = seq2[l];
+            pos++;
+         }
+      }
+      i = nextI;
+      j = nextJ;
+   }
+
+   /* (i,j) is now the last aligned pair                                */
+   if(shortLen != NULL)
+      *shortLen = MIN(i - bestI + 1, j - bestJ + 1);
+
+   /* Last aligned pair and trailing residues                           */
+   if(align1 != NULL)
+   {
+      align1[pos] = seq1[i];
+      align2[pos] = seq2[j];
+      pos++;
+      for(k=i+1; k<length1; k++)
+      {
+         align1[pos] = seq1[k];
+         align2[pos] = '-';
+         pos++;
+      }
+      for(l=j+1; l<length2; l++)
+      {
+         align1[pos] = '-';
+         align2[pos] = seq2[l];
+         pos++;
+      }
+      *alignLen = pos;
+   }
+
+   return(score);
+}
+
+
+/************************************************************************/
+/*>static int ChooseKernel(void)
+   -----------------------------
+*//**
+   \return   The best kernel for this CPU
+
+   Uses the AGLKERNEL environment variable if it is set, otherwise
+   checks the CPU features.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static int ChooseKernel(void)
+{
+   char *env;
+
+   if((env = getenv(AGLKERNEL))!=NULL)
+   {
+      if(!strcmp(env, "scalar"))
+         return(ALIGN_KERNEL_SCALAR);
+#ifdef SIMD_X86
+      if(!strcmp(env, "sse4.1") && __builtin_cpu_supports("sse4.1"))
+         return(ALIGN_KERNEL_SSE41);
+      if(!strcmp(env, "avx2") && __builtin_cpu_supports("avx2"))
+         return(ALIGN_KERNEL_AVX2);
+#endif
+   }
+
+#ifdef SIMD_X86
+   __builtin_cpu_init();
+   if(__builtin_cpu_supports("avx2"))
+      return(ALIGN_KERNEL_AVX2);
+   if(__builtin_cpu_supports("sse4.1"))
+      return(ALIGN_KERNEL_SSE41);
+#endif
+   return(ALIGN_KERNEL_SCALAR);
+}
+
+
+/************************************************************************/
+/*>void SetAlignKernel(int kernel)
+   -------------------------------
+*//**
+   \param[in]  kernel   ALIGN_KERNEL_AUTO, _SCALAR, _SSE41 or _AVX2
+
+   Forces the alignment kernel. ALIGN_KERNEL_AUTO chooses again from
+   the CPU features. A kernel the CPU can't run is ignored.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Stops a later GetAlignKernel() choosing again
+*/
+void SetAlignKernel(int kernel)
+{
+   pthread_once(&sKernelOnce, InitKernel);
+   sKernel = ChooseKernel();
+
+#ifdef SIMD_X86
+   if((kernel == ALIGN_KERNEL_SCALAR) ||
+      ((kernel == ALIGN_KERNEL_SSE41) &&
+       __builtin_cpu_supports("sse4.1"))  ||
+      ((kernel == ALIGN_KERNEL_AVX2) &&
+       __builtin_cpu_supports("avx2")))
+      sKernel = kernel;
+#else
+   if(kernel == ALIGN_KERNEL_SCALAR)
+      sKernel = kernel;
+#endif
+}
+
+
+/************************************************************************/
+/*>int GetAlignKernel(void)
+   ------------------------
+*//**
+   \return   The kernel in use
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Kernel is chosen by InitKernel() through pthread_once()
+*/
+int GetAlignKernel(void)
+{
+   pthread_once(&sKernelOnce, InitKernel);
+   return(sKernel);
+}
+
+
+/************************************************************************/
+/*>static void InitKernel(void)
+   ----------------------------
+*//**
+   Chooses the kernel unless it has already been set.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void InitKernel(void)
+{
+   if(sKernel == ALIGN_KERNEL_AUTO)
+      sKernel = ChooseKernel();
+}
+
+
+/************************************************************************/
+/*>char *AlignKernelName(int kernel)
+   ---------------------------------
+*//**
+   \param[in]  kernel   Kernel number
+   \return              Name of the kernel
+
+   - 18.10.26 Original   By: ACRM
+*/
+char *AlignKernelName(int kernel)
+{
+   switch(kernel)
+   {
+   case ALIGN_KERNEL_SCALAR:
+      return("scalar");
+   case ALIGN_KERNEL_SSE41:
+      return("sse4.1");
+   case ALIGN_KERNEL_AVX2:
+      return("avx2");
+   default:
+      break;
+   }
+   return("auto");
+}
+
+
+/************************************************************************/
+/*>void FreeAlignWork(void)
+   ------------------------
+*//**
+   Frees the calling thread's alignment work space. It is allocated
+   again if the thread aligns anything else.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Also frees the work space for AffineScore()
+*/
+void FreeAlignWork(void)
+{
+   free(sWork.matrix);
+   free(sWork.query8);
+   free(sWork.query16);
+   free(sLaneWork.matrix);
+   free(sScoreWork.scores);
+   free(sScoreWork.ends);
+   free(sScoreWork.query16);
+   free(sScoreWork.zero16);
+   free(sScoreWork.rowScores);
+   free(sScoreWork.rowEnds);
+   free(sScoreWork.next);
+   memset(&sWork,      0, sizeof(ALIGNWORK));
+   memset(&sLaneWork,  0, sizeof(LANEWORK));
+   memset(&sScoreWork, 0, sizeof(SCOREWORK));
+}
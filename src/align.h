@@ -0,0 +1,91 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       align.h
+
+   \version    V1.3
+   \date       18.10.26
+   \brief      Affine gap alignment kernels
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+   V1.1   18.10.26  Added AffineScoreLanes()
+   V1.2   18.10.26  Added FreeAlignWork() and MAXLANELEN
+   V1.3   18.10.26  Added AffineScore()
+
+*************************************************************************/
+#ifndef _ALIGN_H
+#define _ALIGN_H
+
+/************************************************************************/
+/* Includes
+*/
+#include "bioplib/SysDefs.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define ALIGN_KERNEL_AUTO   0   /* Alignment kernels                    */
+#define ALIGN_KERNEL_SCALAR 1
+#define ALIGN_KERNEL_SSE41  2
+#define ALIGN_KERNEL_AVX2   3
+#define AGLKERNEL           "AGLKERNEL" /* Environment variable to force
+                                           a kernel                     */
+#define ALIGNLANES          32  /* Sequences in a block scored together */
+#define MAXLANELEN          254 /* Longest sequence scored in a lane    */
+
+/************************************************************************/
+/* Prototypes
+*/
+int AffineAlign(char *seq1, int length1, char *seq2, int length2,
+                int penalty, int penext, int window,
+                char *align1, char *align2, int *alignLen);
+int AffineScore(char *seq1, int length1, char *seq2, int length2,
+                int penalty, int penext, int window, int *shortLen);
+BOOL AffineScoreLanes(char *seq1, int length1, unsigned char *residues,
+                      int *lengths, int maxLen, int penalty, int penext,
+                      int window, int *scores, int *shortLens);
+void SetAlignKernel(int kernel);
+int GetAlignKernel(void);
+char *AlignKernelName(int kernel);
+void FreeAlignWork(void);
+
+#endif
@@ -0,0 +1,156 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       alignlanes.h
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Template for filling score matrices for a block of
+               sequences in SIMD lanes
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+   This file is included by align.c once for each instruction set.
+   Before including it, define:
+
+   LANENAME   Name of the function to generate
+   TARGET     GCC target attribute string (e.g. "avx2")
+   NVEC       Number of vectors holding the ALIGNLANES bytes of a cell
+   VTYPE      Vector type
+   VLOAD      Unaligned load
+   VSET1      Broadcast a byte
+   VSUBS      Unsigned saturating subtract
+   VADDS      Unsigned saturating add
+   VMAX       Unsigned maximum
+   VCMPEQ     Compare for equality
+   VAND       Bitwise and
+
+   The macros are undefined again at the end of the file.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+
+*************************************************************************/
+
+/************************************************************************/
+/*>static void LANENAME(LANEWORK *work, char *seq1, int length1,
+                        unsigned char *residues, int maxLen, int penalty,
+                        int penext, int window)
+   -------------------------------------------------------------------
+*//**
+   \param[in,out] work      Work space set up by SetupLaneWork()
+   \param[in]     seq1      The query sequence
+   \param[in]     length1   Length of the query
+   \param[in]     residues  ALIGNLANES sequences interleaved, last
+                            residue first (see AffineScoreLanes())
+   \param[in]     maxLen    Longest sequence
+   \param[in]     penalty   Gap opening penalty
+   \param[in]     penext    Gap extension penalty
+   \param[in]     window    Maximum gap length (1..MAXSIMDWINDOW)
+
+   Fills the score matrices for all the lanes together, one query
+   residue (row) at a time working back from the end. The sequences
+   are stored from their C-terminal ends so every lane reaches its last
+   column together: column j here is column (length-1-j) of the normal
+   matrix. Each cell holds one byte for each lane. Cells past the end
+   of a shorter sequence are filled but never read.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void __attribute__((target(TARGET)))
+LANENAME(LANEWORK *work, char *seq1, int length1,
+         unsigned char *residues, int maxLen, int penalty, int penext,
+         int window)
+{
+   VTYPE *matrix  = (VTYPE *)work->matrix,
+         gapPen[MAXSIMDWINDOW],
+         one      = VSET1(1);
+   int   rowLen   = work->rowLen * NVEC,
+         pad      = work->pad * NVEC,
+         i, j, d, v;
+
+   for(d=0; d<window; d++)
+      gapPen[d] = VSET1(MIN(penalty + d*penext, 255));
+
+   for(i=length1-1; i>=0; i--)
+   {
+      VTYPE *row   = matrix + (size_t)i * rowLen + pad,
+            *next  = row + rowLen,
+            query  = VSET1((unsigned char)seq1[i]);
+
+      for(j=0; j<maxLen; j++)
+      {
+         for(v=0; v<NVEC; v++)
+         {
+            VTYPE best,
+                  id  = VAND(VCMPEQ(VLOAD(residues +
+                                          ((size_t)j*NVEC + v) *
+                                          sizeof(VTYPE)),
+                                    query), one);
+            int   col = (j-1)*NVEC + v;
+
+            /* Diagonal                                                 */
+            best = next[col];
+
+            for(d=0; d<window; d++)
+            {
+               /* Gap in seq2 (skip query residues)                     */
+               best = VMAX(best, VSUBS(next[(size_t)(d+1)*rowLen + col],
+                                       gapPen[d]));
+               /* Gap in seq1 (skip database residues)                  */
+               best = VMAX(best, VSUBS(next[col - (d+1)*NVEC],
+                                       gapPen[d]));
+            }
+
+            row[j*NVEC + v] = VADDS(best, id);
+         }
+      }
+   }
+}
+
+#undef LANENAME
+#undef TARGET
+#undef NVEC
+#undef VTYPE
+#undef VLOAD
+#undef VSET1
+#undef VSUBS
+#undef VADDS
+#undef VMAX
+#undef VCMPEQ
+#undef VAND
@@ -0,0 +1,214 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       alignscore.h
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Template for the SIMD score-only fill
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+   This file is included by align.c once for each instruction set.
+   Before including it, define:
+
+   SCORENAME  Name of the function to generate
+   TARGET     GCC target attribute string (e.g. "avx2")
+   NLANES     Number of 16-bit elements in a vector
+   VTYPE      Vector type
+   VLOAD      Unaligned load
+   VSTORE     Aligned store
+   VSET1      Broadcast a 16-bit value
+   VZERO      Zero vector
+   VSUBS      Unsigned saturating 16-bit subtract
+   VADDS      Unsigned saturating 16-bit add
+   VMAX       Unsigned 16-bit maximum
+   VCMPEQ     16-bit compare for equality
+   VAND       Bitwise and
+   VBLEND     Take bytes from the second vector where the mask is set
+
+   The macros are undefined again at the end of the file.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+
+*************************************************************************/
+
+/************************************************************************/
+/*>static void SCORENAME(SCOREWORK *work, int length1, char *seq2,
+                         int length2, int penalty, int penext,
+                         int window)
+   ---------------------------------------------------------------
+*//**
+   \param[in,out] work      Work space from SetupScoreWork() for 16-bit
+                            elements
+   \param[in]     length1   Length of the query
+   \param[in]     seq2      Database sequence
+   \param[in]     length2   Length of the database sequence
+   \param[in]     penalty   Gap opening penalty
+   \param[in]     penext    Gap extension penalty
+   \param[in]     window    Maximum gap length (1..MAXSIMDWINDOW)
+
+   Does what ScoreScalar() does a vector of query residues at a time,
+   as the FILLNAME() kernels in alignsimd.h do. Alongside each score
+   goes the end of the path from the cell, taken from the diagonal,
+   the best gap in seq2 or the best gap in seq1 in that order of
+   preference. Only a strictly better gap replaces a shorter one.
+   Scores below zero are saturated, but a gap that doesn't score above
+   zero can't beat the diagonal so the choice is the same.
+
+   Scores and ends both fit in 16 bits since SetupScoreWork() is only
+   asked for 16-bit elements when length1+length2 < MAXSCORE16.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void __attribute__((target(TARGET)))
+SCORENAME(SCOREWORK *work, int length1, char *seq2, int length2,
+          int penalty, int penext, int window)
+{
+   uint16_t *scores = (uint16_t *)work->scores,
+            *ends   = (uint16_t *)work->ends,
+            *query  = work->query16,
+            *zero   = work->zero16,
+            *next[MAXSIMDWINDOW+1],
+            *nextEnds[MAXSIMDWINDOW+1];
+   int      colLen  = work->colLen,
+            nCols   = work->nCols,
+            rowEnd  = ((length1 + NLANES - 1) / NLANES) * NLANES,
+            i, j, d;
+   VTYPE    gapPen[MAXSIMDWINDOW],
+            one     = VSET1(1);
+
+   for(d=0; d<window; d++)
+      gapPen[d] = VSET1(MIN(penalty + d*penext, MAXSCORE16));
+
+   for(j=length2-1; j>=0; j--)
+   {
+      size_t   colStart = (size_t)(j % nCols) * colLen;
+      uint16_t *col     = scores + colStart,
+               *colEnds = ends   + colStart;
+      VTYPE    residue  = VSET1((unsigned char)seq2[j]);
+
+      /* The columns after this one that a gap in seq1 may reach, with
+         zeros beyond the end of the database sequence
+      */
+      for(d=0; d<=window; d++)
+      {
+         int l = j+1+d;
+
+         if(l < length2)
+         {
+            next[d]     = scores + (size_t)(l % nCols) * colLen;
+            nextEnds[d] = ends   + (size_t)(l % nCols) * colLen;
+         }
+         else
+         {
+            next[d] = nextEnds[d] = zero;
+         }
+      }
+
+      for(i=0; i<rowEnd; i+=NLANES)
+      {
+         VTYPE dia      = VLOAD(next[0] + i + 1),
+               diaEnd   = VLOAD(nextEnds[0] + i + 1),
+               right    = VZERO,
+               rightEnd = VZERO,
+               down     = VZERO,
+               downEnd  = VZERO,
+               gap, notBetter, best, end;
+
+         for(d=0; d<window; d++)
+         {
+            /* Gap in seq2 (skip query residues)                        */
+            gap       = VSUBS(VLOAD(next[0] + i + 2 + d), gapPen[d]);
+            notBetter = VCMPEQ(VMAX(gap, right), right);
+            right     = VMAX(right, gap);
+            rightEnd  = VBLEND(VLOAD(nextEnds[0] + i + 2 + d), rightEnd,
+                               notBetter);
+
+            /* Gap in seq1 (skip database residues)                     */
+            gap       = VSUBS(VLOAD(next[d+1] + i + 1), gapPen[d]);
+            notBetter = VCMPEQ(VMAX(gap, down), down);
+            down      = VMAX(down, gap);
+            downEnd   = VBLEND(VLOAD(nextEnds[d+1] + i + 1), downEnd,
+                               notBetter);
+         }
+
+         /* The diagonal wins ties, then the gap in seq2                */
+         best = VMAX(right, down);
+         end  = VBLEND(downEnd, rightEnd, VCMPEQ(best, right));
+         end  = VBLEND(end, diaEnd, VCMPEQ(VMAX(dia, best), dia));
+         best = VMAX(dia, best);
+
+         /* Add 1 for an identical residue                              */
+         best = VADDS(best, VAND(VCMPEQ(VLOAD(query + i), residue), one));
+         VSTORE(col + i, best);
+         VSTORE(colEnds + i, end);
+      }
+
+      /* The path stops at the last row or column                       */
+      if(j == length2-1)
+      {
+         for(i=0; i<length1; i++)
+            colEnds[i] = (uint16_t)PATHEND(i, j, length1, length2);
+      }
+      else
+      {
+         colEnds[length1-1] = (uint16_t)PATHEND(length1-1, j, length1,
+                                                length2);
+      }
+
+      work->rowScores[j] = col[0];
+      work->rowEnds[j]   = colEnds[0];
+   }
+}
+
+#undef SCORENAME
+#undef TARGET
+#undef NLANES
+#undef VTYPE
+#undef VLOAD
+#undef VSTORE
+#undef VSET1
+#undef VZERO
+#undef VSUBS
+#undef VADDS
+#undef VMAX
+#undef VCMPEQ
+#undef VAND
+#undef VBLEND
@@ -0,0 +1,171 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       alignsimd.h
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Template for the SIMD score matrix fill
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+   This file is included by align.c once for each combination of
+   instruction set and lane width. Before including it, define:
+
+   FILLNAME   Name of the function to generate
+   TARGET     GCC target attribute string (e.g. "avx2")
+   ELEM       Matrix element type (uint8_t or uint16_t)
+   ELEMMAX    Largest value of ELEM
+   QUERY      Member of ALIGNWORK holding the query as ELEMs
+   NLANES     Number of ELEMs in a vector
+   VTYPE      Vector type
+   VLOAD      Unaligned load
+   VSTORE     Aligned store
+   VSTOREU    Unaligned store
+   VSET1      Broadcast a value
+   VZERO      Zero vector
+   VSUBS      Unsigned saturating subtract
+   VADDS      Unsigned saturating add
+   VMAX       Unsigned maximum
+   VCMPEQ     Compare for equality
+   VAND       Bitwise and
+
+   The macros are undefined again at the end of the file.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+
+*************************************************************************/
+
+/************************************************************************/
+/*>static BOOL FILLNAME(ALIGNWORK *work, int length1, char *seq2,
+                        int length2, int penalty, int penext,
+                        int window)
+   ---------------------------------------------------------------
+*//**
+   \param[in,out] work      Work space with the query set up and the
+                            matrix padding cleared
+   \param[in]     length1   Length of the query
+   \param[in]     seq2      Database sequence
+   \param[in]     length2   Length of the database sequence
+   \param[in]     penalty   Gap opening penalty
+   \param[in]     penext    Gap extension penalty
+   \param[in]     window    Maximum gap length (1..MAXSIMDWINDOW)
+   \return                  FALSE if the scores overflowed the lanes
+
+   Fills the score matrix one column (residue of seq2) at a time
+   working back from the end, with each vector holding consecutive
+   residues of the query. A cell depends only on later columns, so
+   there is no dependency between the lanes. Gap scores below zero
+   can't beat the diagonal (which is never negative) so unsigned
+   saturating arithmetic gives exactly the same matrix as the scalar
+   code as long as nothing reaches ELEMMAX.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static BOOL __attribute__((target(TARGET)))
+FILLNAME(ALIGNWORK *work, int length1, char *seq2, int length2,
+         int penalty, int penext, int window)
+{
+   ELEM  *matrix = (ELEM *)work->matrix,
+         *query  = (ELEM *)work->QUERY;
+   int   colLen  = work->colLen,
+         rowEnd  = ((length1 + NLANES - 1) / NLANES) * NLANES,
+         i, j, d;
+   VTYPE gapPen[MAXSIMDWINDOW],
+         one     = VSET1(1),
+         maxSeen = VZERO;
+   ELEM  check[NLANES];
+
+   for(d=0; d<window; d++)
+      gapPen[d] = VSET1(MIN(penalty + d*penext, ELEMMAX));
+
+   for(j=length2-1; j>=0; j--)
+   {
+      ELEM  *col  = matrix + (size_t)j * colLen,
+            *next = col + colLen;
+      VTYPE residue = VSET1((unsigned char)seq2[j]);
+
+      for(i=0; i<rowEnd; i+=NLANES)
+      {
+         /* Diagonal                                                    */
+         VTYPE best = VLOAD(next + i + 1);
+
+         for(d=0; d<window; d++)
+         {
+            /* Gap in seq2 (skip query residues)                        */
+            best = VMAX(best, VSUBS(VLOAD(next + i + 2 + d), gapPen[d]));
+            /* Gap in seq1 (skip database residues)                     */
+            best = VMAX(best,
+                        VSUBS(VLOAD(next + (size_t)(d+1)*colLen + i + 1),
+                              gapPen[d]));
+         }
+
+         /* Add 1 for an identical residue                              */
+         best = VADDS(best, VAND(VCMPEQ(VLOAD(query + i), residue), one));
+         maxSeen = VMAX(maxSeen, best);
+         VSTORE(col + i, best);
+      }
+   }
+
+   VSTOREU(check, maxSeen);
+   for(i=0; i<NLANES; i++)
+   {
+      if(check[i] == ELEMMAX)
+         return(FALSE);
+   }
+   return(TRUE);
+}
+
+#undef FILLNAME
+#undef TARGET
+#undef ELEM
+#undef ELEMMAX
+#undef QUERY
+#undef NLANES
+#undef VTYPE
+#undef VLOAD
+#undef VSTORE
+#undef VSTOREU
+#undef VSET1
+#undef VZERO
+#undef VSUBS
+#undef VADDS
+#undef VMAX
+#undef VCMPEQ
+#undef VAND
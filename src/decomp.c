@@ -0,0 +1,500 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       decomp.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Decompression of gzip and zstd input on its own thread
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+   Compressed input is recognised by its first bytes and decompressed
+   by a thread of its own, so decompression overlaps with the
+   alignments rather than being run as a separate process (zcat) with
+   the data copied through a pipe. The thread fills a ring buffer from
+   which the FASTA reader takes the decompressed text as though it
+   were reading a file. gzip is read with zlib (including files made
+   of several gzip members, as written by bgzip or by concatenating
+   files); zstd needs agl to be built with HAVE_ZSTD defined.
+
+**************************************************************************
+
+   Usage:
+   ======
+   See decomp.h
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "bioplib/macros.h"
+#include "decomp.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+
+/************************************************************************/
+/* Globals
+*/
+
+/************************************************************************/
+/* Prototypes
+*/
+static void *DecompThread(void *arg);
+static void InflateGzip(DECOMP *decomp);
+#ifdef HAVE_ZSTD
+static void InflateZstd(DECOMP *decomp);
+#endif
+static size_t ReadInput(DECOMP *decomp);
+static char *RingSpace(DECOMP *decomp, size_t *space);
+static void RingAdd(DECOMP *decomp, size_t nBytes);
+
+
+/************************************************************************/
+/*>int CompressionFormat(char *data, size_t len)
+   ---------------------------------------------
+*//**
+   \param[in]  data   The start of the input
+   \param[in]  len    Bytes of it available
+   \return            COMPRESS_NONE, COMPRESS_GZIP, COMPRESS_ZSTD or
+                      COMPRESS_UNKNOWN if more bytes are needed to tell
+
+   - 18.10.26 Original   By: ACRM
+*/
+int CompressionFormat(char *data, size_t len)
+{
+   static unsigned char gzipMagic[] = {0x1f, 0x8b},
+                        zstdMagic[] = {0x28, 0xb5, 0x2f, 0xfd};
+
+   if(!memcmp(data, gzipMagic, MIN(len, sizeof(gzipMagic))))
+      return((len < sizeof(gzipMagic)) ? COMPRESS_UNKNOWN : COMPRESS_GZIP);
+   if(!memcmp(data, zstdMagic, MIN(len, sizeof(zstdMagic))))
+      return((len < sizeof(zstdMagic)) ? COMPRESS_UNKNOWN : COMPRESS_ZSTD);
+   return(COMPRESS_NONE);
+}
+
+
+/************************************************************************/
+/*>DECOMP *StartDecomp(int fd, int format, char *data, size_t len)
+   ---------------------------------------------------------------
+*//**
+   \param[in]  fd       Compressed input
+   \param[in]  format   COMPRESS_GZIP or COMPRESS_ZSTD
+   \param[in]  data     Compressed bytes already read from fd
+   \param[in]  len      Number of them
+   \return              The decompressor (or NULL if it couldn't be
+                        started)
+
+   Starts the thread decompressing data and then the rest of fd.
+
+   - 18.10.26 Original   By: ACRM
+*/
+DECOMP *StartDecomp(int fd, int format, char *data, size_t len)
+{
+   DECOMP *decomp;
+
+#ifndef HAVE_ZSTD
+   if(format == COMPRESS_ZSTD)
+   {
+      fprintf(stderr, "\nError (agl): This version of agl cannot read \
+zstd input. Rebuild it\n             with HAVE_ZSTD defined or use \
+zstdcat.\n");
+      exit(1);
+   }
+#endif
+
+   if((decomp = (DECOMP *)calloc(1, sizeof(DECOMP)))==NULL)
+      return(NULL);
+   decomp->ring  = (char *)malloc(DECOMPRINGSIZE);
+   decomp->input = (char *)malloc(MAX(len, DECOMPINSIZE));
+   if((decomp->ring == NULL) || (decomp->input == NULL))
+   {
+      free(decomp->ring);
+      free(decomp->input);
+      free(decomp);
+      return(NULL);
+   }
+   memcpy(decomp->input, data, len);
+   decomp->inputLen = len;
+   decomp->fd       = fd;
+   decomp->format   = format;
+   pthread_mutex_init(&(decomp->lock), NULL);
+   pthread_cond_init(&(decomp->changed), NULL);
+
+   if(pthread_create(&(decomp->thread), NULL, DecompThread, decomp))
+   {
+      free(decomp->ring);
+      free(decomp->input);
+      free(decomp);
+      return(NULL);
+   }
+   return(decomp);
+}
+
+
+/************************************************************************/
+/*>ssize_t ReadDecomp(DECOMP *decomp, char *buffer, size_t size)
+   -------------------------------------------------------------
+*//**
+   \param[in,out] decomp   The decompressor
+   \param[out]    buffer   Decompressed data
+   \param[in]     size     Space in buffer
+   \return                 Bytes placed in buffer (0 at the end of the
+                           input)
+
+   Used like read(). Waits until some data have been decompressed.
+
+   - 18.10.26 Original   By: ACRM
+*/
+ssize_t ReadDecomp(DECOMP *decomp, char *buffer, size_t size)
+{
+   size_t nBytes,
+          tail;
+
+   pthread_mutex_lock(&(decomp->lock));
+   while((decomp->head == decomp->tail) && !decomp->done)
+      pthread_cond_wait(&(decomp->changed), &(decomp->lock));
+   tail   = decomp->tail % DECOMPRINGSIZE;
+   nBytes = MIN(size, decomp->head - decomp->tail);
+   nBytes = MIN(nBytes, DECOMPRINGSIZE - tail);
+   pthread_mutex_unlock(&(decomp->lock));
+
+   /* The thread doesn't write to this part of the ring until the tail
+      is moved past it
+   */
+   memcpy(buffer, decomp->ring + tail, nBytes);
+
+   pthread_mutex_lock(&(decomp->lock));
+   decomp->tail += nBytes;
+   pthread_cond_signal(&(decomp->changed));
+   pthread_mutex_unlock(&(decomp->lock));
+
+   return((ssize_t)nBytes);
+}
+
+
+/************************************************************************/
+/*>void StopDecomp(DECOMP *decomp)
+   -------------------------------
+*//**
+   \param[in]  decomp   Decompressor from StartDecomp() (or NULL)
+
+   Stops the thread, if it hasn't finished, and frees the decompressor.
+   fd is not closed.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void StopDecomp(DECOMP *decomp)
+{
+   if(decomp == NULL)
+      return;
+
+   pthread_mutex_lock(&(decomp->lock));
+   decomp->stopping = TRUE;
+   pthread_cond_signal(&(decomp->changed));
+   pthread_mutex_unlock(&(decomp->lock));
+   pthread_join(decomp->thread, NULL);
+
+   pthread_mutex_destroy(&(decomp->lock));
+   pthread_cond_destroy(&(decomp->changed));
+   free(decomp->ring);
+   free(decomp->input);
+   free(decomp);
+}
+
+
+/************************************************************************/
+/*>static void *DecompThread(void *arg)
+   ------------------------------------
+*//**
+   \param[in]  arg   The decompressor
+   \return           NULL
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void *DecompThread(void *arg)
+{
+   DECOMP *decomp = (DECOMP *)arg;
+
+#ifdef HAVE_ZSTD
+   if(decomp->format == COMPRESS_ZSTD)
+      InflateZstd(decomp);
+   else
+#endif
+      InflateGzip(decomp);
+
+   pthread_mutex_lock(&(decomp->lock));
+   decomp->done = TRUE;
+   pthread_cond_signal(&(decomp->changed));
+   pthread_mutex_unlock(&(decomp->lock));
+   return(NULL);
+}
+
+
+/************************************************************************/
+/*>static void InflateGzip(DECOMP *decomp)
+   ---------------------------------------
+*//**
+   \param[in,out] decomp   The decompressor
+
+   Decompresses gzip input into the ring until the input ends or the
+   reader stops. Each member of a multi-member file is decompressed in
+   turn. Exits if the input is corrupt or cut short.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void InflateGzip(DECOMP *decomp)
+{
+   z_stream zStream;
+   BOOL     eof   = FALSE,
+            ended = FALSE;
+   char     *out;
+   size_t   space,
+            nOut;
+   int      status;
+
+   memset(&zStream, 0, sizeof(z_stream));
+   if(inflateInit2(&zStream, 15+16) != Z_OK)
+   {
+      fprintf(stderr, "\nError (agl): Unable to start gzip \
+decompression\n");
+      exit(1);
+   }
+   zStream.next_in  = (Bytef *)decomp->input;
+   zStream.avail_in = (uInt)decomp->inputLen;
+
+   for(;;)
+   {
+      if((zStream.avail_in == 0) && !eof)
+      {
+         if((zStream.avail_in = (uInt)ReadInput(decomp)) == 0)
+            eof = TRUE;
+         zStream.next_in = (Bytef *)decomp->input;
+      }
+      if((out = RingSpace(decomp, &space))==NULL)
+         break;
+
+      zStream.next_out  = (Bytef *)out;
+      zStream.avail_out = (uInt)space;
+      status = inflate(&zStream, Z_NO_FLUSH);
+      nOut   = space - zStream.avail_out;
+      RingAdd(decomp, nOut);
+
+      if(status == Z_STREAM_END)
+      {
+         /* Another member may follow                                  */
+         inflateReset(&zStream);
+         ended = TRUE;
+      }
+      else if((status == Z_OK) || (status == Z_BUF_ERROR))
+      {
+         if(zStream.total_in)
+            ended = FALSE;
+         if(eof && !nOut && !zStream.avail_in)
+            break;
+      }
+      else
+      {
+         fprintf(stderr, "\nError (agl): Corrupt gzip input\n");
+         exit(1);
+      }
+   }
+
+   if(eof && !ended)
+   {
+      fprintf(stderr, "\nError (agl): gzip input ends part way \
+through\n");
+      exit(1);
+   }
+   inflateEnd(&zStream);
+}
+
+
+#ifdef HAVE_ZSTD
+/************************************************************************/
+/*>static void InflateZstd(DECOMP *decomp)
+   ---------------------------------------
+*//**
+   \param[in,out] decomp   The decompressor
+
+   Decompresses zstd input into the ring until the input ends or the
+   reader stops. Exits if the input is corrupt or cut short.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void InflateZstd(DECOMP *decomp)
+{
+   ZSTD_DStream   *zStream;
+   ZSTD_inBuffer  zIn;
+   ZSTD_outBuffer zOut;
+   BOOL           eof    = FALSE;
+   size_t         status = 0,
+                  space;
+
+   if((zStream = ZSTD_createDStream())==NULL)
+   {
+      fprintf(stderr, "\nError (agl): Unable to start zstd \
+decompression\n");
+      exit(1);
+   }
+   ZSTD_initDStream(zStream);
+   zIn.src  = decomp->input;
+   zIn.size = decomp->inputLen;
+   zIn.pos  = 0;
+
+   for(;;)
+   {
+      if((zIn.pos == zIn.size) && !eof)
+      {
+         if((zIn.size = ReadInput(decomp)) == 0)
+            eof = TRUE;
+         zIn.pos = 0;
+      }
+      if((zOut.dst = RingSpace(decomp, &space))==NULL)
+         break;
+
+      zOut.size = space;
+      zOut.pos  = 0;
+      status    = ZSTD_decompressStream(zStream, &zOut, &zIn);
+      if(ZSTD_isError(status))
+      {
+         fprintf(stderr, "\nError (agl): Corrupt zstd input (%s)\n",
+                 ZSTD_getErrorName(status));
+         exit(1);
+      }
+      RingAdd(decomp, zOut.pos);
+
+      /* Output may still be held back when the input has all been used */
+      if(eof && (zOut.pos == 0))
+         break;
+   }
+
+   if(eof && (status != 0))
+   {
+      fprintf(stderr, "\nError (agl): zstd input ends part way \
+through\n");
+      exit(1);
+   }
+   ZSTD_freeDStream(zStream);
+}
+#endif
+
+
+/************************************************************************/
+/*>static size_t ReadInput(DECOMP *decomp)
+   ---------------------------------------
+*//**
+   \param[in,out] decomp   The decompressor
+   \return                 Compressed bytes read (0 at the end)
+
+   - 18.10.26 Original   By: ACRM
+*/
+static size_t ReadInput(DECOMP *decomp)
+{
+   ssize_t nRead;
+
+   do
+   {
+      nRead = read(decomp->fd, decomp->input, DECOMPINSIZE);
+   }  while((nRead < 0) && (errno == EINTR));
+
+   return((nRead > 0) ? (size_t)nRead : 0);
+}
+
+
+/************************************************************************/
+/*>static char *RingSpace(DECOMP *decomp, size_t *space)
+   -----------------------------------------------------
+*//**
+   \param[in,out] decomp   The decompressor
+   \param[out]    space    Bytes that may be written
+   \return                 Where to write them (NULL if the reader has
+                           stopped)
+
+   Waits until part of the ring is free and gives the free space up to
+   the end of the ring.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static char *RingSpace(DECOMP *decomp, size_t *space)
+{
+   size_t head;
+   BOOL   stopping;
+
+   pthread_mutex_lock(&(decomp->lock));
+   while((decomp->head - decomp->tail == DECOMPRINGSIZE) &&
+         !decomp->stopping)
+      pthread_cond_wait(&(decomp->changed), &(decomp->lock));
+   head     = decomp->head % DECOMPRINGSIZE;
+   *space   = MIN(DECOMPRINGSIZE - (decomp->head - decomp->tail),
+                  DECOMPRINGSIZE - head);
+   stopping = decomp->stopping;
+   pthread_mutex_unlock(&(decomp->lock));
+
+   return(stopping ? NULL : decomp->ring + head);
+}
+
+
+/************************************************************************/
+/*>static void RingAdd(DECOMP *decomp, size_t nBytes)
+   --------------------------------------------------
+*//**
+   \param[in,out] decomp   The decompressor
+   \param[in]     nBytes   Bytes written at the space from RingSpace()
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void RingAdd(DECOMP *decomp, size_t nBytes)
+{
+   if(nBytes == 0)
+      return;
+
+   pthread_mutex_lock(&(decomp->lock));
+   decomp->head += nBytes;
+   pthread_cond_signal(&(decomp->changed));
+   pthread_mutex_unlock(&(decomp->lock));
+}
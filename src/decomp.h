@@ -0,0 +1,110 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       decomp.h
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Decompression of gzip and zstd input on its own thread
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+
+**************************************************************************
+
+   Usage:
+   ======
+   DECOMP *decomp;
+
+   if((format = CompressionFormat(data, len)) == COMPRESS_NONE)
+      ... read the input as it is ...
+   decomp = StartDecomp(fd, format, data, len);
+   while((nRead = ReadDecomp(decomp, buffer, size)) > 0)
+      ...
+   StopDecomp(decomp);
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+
+*************************************************************************/
+#ifndef _DECOMP_H
+#define _DECOMP_H
+
+/************************************************************************/
+/* Includes
+*/
+#include <stddef.h>
+#include <sys/types.h>
+#include <pthread.h>
+#include "bioplib/SysDefs.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define COMPRESS_NONE    0
+#define COMPRESS_GZIP    1
+#define COMPRESS_ZSTD    2
+#define COMPRESS_UNKNOWN 3      /* Could be compressed - need more bytes */
+
+#define MAXMAGIC         4      /* Bytes needed to identify a format    */
+#define DECOMPRINGSIZE   (4*1024*1024) /* Decompressed bytes held ready  */
+#define DECOMPINSIZE     (256*1024)    /* Compressed bytes read at a time */
+
+/************************************************************************/
+/* Type definitions
+*/
+typedef struct
+{
+   pthread_t       thread;
+   pthread_mutex_t lock;        /* Protects the counts and flags        */
+   pthread_cond_t  changed;     /* Bytes added to or taken from ring    */
+   char            *ring,       /* Decompressed data                    */
+                   *input;      /* Compressed data                      */
+   size_t          head,        /* Bytes ever added to the ring         */
+                   tail,        /* Bytes ever taken from the ring       */
+                   inputLen;    /* Compressed bytes waiting in input    */
+   int             fd,
+                   format;
+   BOOL            done,        /* All the input has been decompressed  */
+                   stopping;    /* The reader has finished              */
+}  DECOMP;
+
+/************************************************************************/
+/* Prototypes
+*/
+int CompressionFormat(char *data, size_t len);
+DECOMP *StartDecomp(int fd, int format, char *data, size_t len);
+ssize_t ReadDecomp(DECOMP *decomp, char *buffer, size_t size);
+void StopDecomp(DECOMP *decomp);
+
+#endif
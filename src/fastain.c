@@ -0,0 +1,641 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       fastain.c
+
+   \version    V1.1
+   \date       18.10.26
+   \brief      FASTA input without copying or fixed-size buffers
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+   Reads FASTA records without copying them. A regular file is mapped
+   into memory and each record is handed out where it lies: the header
+   line and the sequence are terminated in place and the white space
+   is squeezed out of the sequence. The mapping is private so the file
+   itself is not changed. Other input (pipes, sockets) is read in large
+   blocks and the records are handed out from those in the same way.
+   There is no limit on the length of a header or a sequence.
+
+   A record stays valid until it is released. Records must be released
+   in the order they were read, by one thread at a time, though not
+   necessarily the thread reading them. Once released, the pages of a
+   mapped file are given back to the system so reading a large file
+   doesn't fill memory with modified copies of its pages; a block is
+   freed once all the records in it are released.
+
+   Input compressed with gzip or zstd is recognised from its first
+   bytes and decompressed on a separate thread (see decomp.c); the
+   records are then read from blocks as for a pipe.
+
+**************************************************************************
+
+   Usage:
+   ======
+   See fastain.h
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+   V1.1   18.10.26  Reads gzip and zstd input
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "bioplib/macros.h"
+#include "fastain.h"
+
+#if defined(__SSE2__)
+#define SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+/************************************************************************/
+/* Defines and macros
+*/
+
+/************************************************************************/
+/* Globals
+*/
+
+/************************************************************************/
+/* Prototypes
+*/
+static BOOL MapFile(FASTAIN *in, size_t fileSize, off_t offset);
+static FASTABLOCK *NewBlock(size_t size);
+static void DropBlock(FASTABLOCK *block);
+static BOOL ReadMore(FASTAIN *in);
+static void CheckCompressed(FASTAIN *in, size_t skip);
+static BOOL FindRecord(FASTAIN *in, size_t *searched, size_t *end);
+static size_t StripWhiteSpace(char *buffer, size_t len);
+
+
+/************************************************************************/
+/*>FASTAIN *OpenFASTAIn(FILE *fp)
+   ------------------------------
+*//**
+   \param[in]  fp   File to read
+   \return          The reader (or NULL if no memory)
+
+   A regular file is mapped from the current position of fp. Anything
+   else, or a compressed file, is read from its file descriptor, so
+   nothing must have been read from it through fp. fp is not closed by
+   CloseFASTAIn().
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Compressed files are not mapped. Checks for compressed
+              input
+*/
+FASTAIN *OpenFASTAIn(FILE *fp)
+{
+   FASTAIN     *in;
+   struct stat statBuf;
+   off_t       offset;
+   char        magic[MAXMAGIC];
+   ssize_t     nMagic;
+
+   if((in = (FASTAIN *)calloc(1, sizeof(FASTAIN)))==NULL)
+      return(NULL);
+   in->fd = fileno(fp);
+
+   if((fstat(in->fd, &statBuf) == 0) && S_ISREG(statBuf.st_mode) &&
+      ((offset = ftello(fp)) >= 0) && (statBuf.st_size > offset) &&
+      ((nMagic = pread(in->fd, magic, MAXMAGIC, offset)) > 0) &&
+      (CompressionFormat(magic, (size_t)nMagic) == COMPRESS_NONE) &&
+      MapFile(in, (size_t)statBuf.st_size, offset))
+      return(in);
+
+   if((in->block = NewBlock(FASTABLOCKSIZE))==NULL)
+   {
+      free(in);
+      return(NULL);
+   }
+   in->data = in->block->data;
+   CheckCompressed(in, 0);
+   return(in);
+}
+
+
+/************************************************************************/
+/*>BOOL ReadFASTARecord(FASTAIN *in, FASTAREC *record)
+   ---------------------------------------------------
+*//**
+   \param[in,out] in       The reader
+   \param[out]    record   The next record
+   \return                 Was a record read? (FALSE at the end of the
+                           input)
+
+   Lines before the first header are skipped. The header is the whole
+   line, including the > but not the line ending. The sequence is the
+   lines up to the next header with all white space (and any other
+   control characters) removed.
+
+   - 18.10.26 Original   By: ACRM
+*/
+BOOL ReadFASTARecord(FASTAIN *in, FASTAREC *record)
+{
+   size_t searched = 0,
+          end,
+          seqStart;
+   char   *header,
+          *newLine;
+
+   /* Once the end of the input has been reached, whatever is left is
+      the last record
+   */
+   while(!FindRecord(in, &searched, &end))
+   {
+      if(in->eof)
+         return(FALSE);
+      ReadMore(in);
+   }
+
+   header = in->data + in->pos;
+   if((newLine = memchr(header, '\n', end - in->pos))!=NULL)
+   {
+      seqStart          = (newLine - in->data) + 1;
+      record->headerLen = newLine - header;
+   }
+   else
+   {
+      seqStart          = end;
+      record->headerLen = end - in->pos;
+   }
+   if(record->headerLen && (header[record->headerLen-1] == '\r'))
+      record->headerLen--;
+
+   /* The sequence is always followed by at least one byte of white
+      space unless it ends the input, where there is a spare byte
+   */
+   record->header = header;
+   record->seq    = in->data + seqStart;
+   record->seqLen = StripWhiteSpace(record->seq, end - seqStart);
+   record->header[record->headerLen] = '\0';
+   record->seq[record->seqLen]       = '\0';
+
+   record->end   = end;
+   record->block = in->block;
+   if(in->block != NULL)
+      __sync_add_and_fetch(&(in->block->nRefs), 1);
+
+   in->pos = end;
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>char *ReadFASTAPreamble(FASTAIN *in)
+   ------------------------------------
+*//**
+   \param[in,out] in   The reader (before any records are read)
+   \return             The first line if it comes before the first
+                       record (or NULL)
+
+   Gives a line of text, such as a request to the server, sent before
+   the FASTA records. The line is terminated in place and stays valid
+   until the first record is read. The records after it may be
+   compressed.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Checks for compressed input after the line
+*/
+char *ReadFASTAPreamble(FASTAIN *in)
+{
+   char   *line,
+          *newLine;
+   size_t len,
+          skip;
+
+   while(!in->eof &&
+         ((in->pos == in->len) ||
+          (memchr(in->data + in->pos, '\n', in->len - in->pos)==NULL)))
+      ReadMore(in);
+
+   if((in->pos == in->len) || (in->data[in->pos] == '>'))
+      return(NULL);
+
+   line    = in->data + in->pos;
+   newLine = memchr(line, '\n', in->len - in->pos);
+   len     = (newLine != NULL) ? (size_t)(newLine - line) :
+                                 (in->len - in->pos);
+   skip    = (newLine != NULL) ? len + 1 : len;
+
+   /* Checking the records for compression may move the line          */
+   if((in->block != NULL) && (in->decomp == NULL))
+      CheckCompressed(in, skip);
+   line     = in->data + in->pos;
+   in->pos += skip;
+
+   if(len && (line[len-1] == '\r'))
+      len--;
+   line[len] = '\0';
+   return(line);
+}
+
+
+/************************************************************************/
+/*>void ReleaseFASTARecord(FASTAIN *in, FASTAREC *record)
+   ------------------------------------------------------
+*//**
+   \param[in,out] in       The reader
+   \param[in,out] record   Record from ReadFASTARecord()
+
+   Says that the record is no longer needed.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void ReleaseFASTARecord(FASTAIN *in, FASTAREC *record)
+{
+   if(record->block != NULL)
+   {
+      DropBlock(record->block);
+      record->block = NULL;
+   }
+   else if(in->mapAddr != NULL)
+   {
+      size_t pageSize = (size_t)sysconf(_SC_PAGESIZE),
+             upTo     = record->end - (record->end % pageSize);
+
+      /* The page holding the end may hold the next record too         */
+      if(upTo >= in->dropped + FASTABLOCKSIZE)
+      {
+         madvise(in->mapAddr + in->dropped, upTo - in->dropped,
+                 MADV_DONTNEED);
+         in->dropped = upTo;
+      }
+   }
+}
+
+
+/************************************************************************/
+/*>void CloseFASTAIn(FASTAIN *in)
+   ------------------------------
+*//**
+   \param[in]  in   Reader from OpenFASTAIn() (or NULL)
+
+   Frees the reader. Records from a mapped file must all have been
+   released.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Stops any decompression
+*/
+void CloseFASTAIn(FASTAIN *in)
+{
+   if(in == NULL)
+      return;
+
+   if(in->mapAddr != NULL)
+      munmap(in->mapAddr, in->mapSize);
+   StopDecomp(in->decomp);
+   if(in->block != NULL)
+      DropBlock(in->block);
+   free(in);
+}
+
+
+/************************************************************************/
+/*>static BOOL MapFile(FASTAIN *in, size_t fileSize, off_t offset)
+   ---------------------------------------------------------------
+*//**
+   \param[in,out] in         The reader
+   \param[in]     fileSize   Size of the file
+   \param[in]     offset     Where to start reading
+   \return                   Success
+
+   Maps the file privately so that records can be terminated in place.
+   A page of zeros after the end leaves room to terminate the last
+   record.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static BOOL MapFile(FASTAIN *in, size_t fileSize, off_t offset)
+{
+   size_t pageSize = (size_t)sysconf(_SC_PAGESIZE),
+          start    = (size_t)offset - ((size_t)offset % pageSize),
+          size     = fileSize - start;
+   char   *addr;
+
+   if((addr = mmap(NULL, size + pageSize, PROT_READ|PROT_WRITE,
+                   MAP_PRIVATE|MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+      return(FALSE);
+   if(mmap(addr, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_FIXED,
+           in->fd, (off_t)start) == MAP_FAILED)
+   {
+      munmap(addr, size + pageSize);
+      return(FALSE);
+   }
+   madvise(addr, size, MADV_SEQUENTIAL);
+
+   in->mapAddr = in->data = addr;
+   in->mapSize = size + pageSize;
+   in->len     = size;
+   in->pos     = (size_t)offset - start;
+   in->eof     = TRUE;
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static FASTABLOCK *NewBlock(size_t size)
+   ----------------------------------------
+*//**
+   \param[in]  size   Bytes to allocate
+   \return            Empty block held by the reader (or NULL if no
+                      memory)
+
+   - 18.10.26 Original   By: ACRM
+*/
+static FASTABLOCK *NewBlock(size_t size)
+{
+   FASTABLOCK *block;
+
+   if((block = (FASTABLOCK *)malloc(sizeof(FASTABLOCK)))==NULL)
+      return(NULL);
+   if((block->data = (char *)malloc(size))==NULL)
+   {
+      free(block);
+      return(NULL);
+   }
+   block->size  = size;
+   block->len   = 0;
+   block->nRefs = 1;
+   return(block);
+}
+
+
+/************************************************************************/
+/*>static void DropBlock(FASTABLOCK *block)
+   ----------------------------------------
+*//**
+   \param[in,out] block   Block no longer needed by a record or the
+                          reader
+
+   Frees the block when nothing is using it.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void DropBlock(FASTABLOCK *block)
+{
+   if(__sync_sub_and_fetch(&(block->nRefs), 1) == 0)
+   {
+      free(block->data);
+      free(block);
+   }
+}
+
+
+/************************************************************************/
+/*>static BOOL ReadMore(FASTAIN *in)
+   ---------------------------------
+*//**
+   \param[in,out] in   The reader (not mapped)
+   \return             Was anything read?
+
+   Reads whatever is available, up to the space left in the block.
+   When the block is full, the part not yet handed out is moved to a
+   new block, twice the size if a single record filled the old one.
+   Records in the old block are not affected. One byte is always kept
+   spare to terminate the last record.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Reads from the decompressor if there is one
+*/
+static BOOL ReadMore(FASTAIN *in)
+{
+   FASTABLOCK *block = in->block;
+   ssize_t    nRead;
+
+   if(block->len + 1 >= block->size)
+   {
+      FASTABLOCK *newBlock;
+      size_t     keep = block->len - in->pos;
+
+      if((newBlock = NewBlock(MAX(FASTABLOCKSIZE, 2 * (keep + 1))))==NULL)
+      {
+         fprintf(stderr, "\nError (agl): No memory for sequence\n");
+         exit(1);
+      }
+      memcpy(newBlock->data, block->data + in->pos, keep);
+      newBlock->len = keep;
+      DropBlock(block);
+
+      in->block = block = newBlock;
+      in->data  = block->data;
+      in->len   = keep;
+      in->pos   = 0;
+   }
+
+   if(in->decomp != NULL)
+   {
+      nRead = ReadDecomp(in->decomp, block->data + block->len,
+                         block->size - block->len - 1);
+   }
+   else
+   {
+      do
+      {
+         nRead = read(in->fd, block->data + block->len,
+                      block->size - block->len - 1);
+      }  while((nRead < 0) && (errno == EINTR));
+   }
+
+   if(nRead <= 0)
+   {
+      in->eof = TRUE;
+      return(FALSE);
+   }
+
+   block->len += nRead;
+   in->len     = block->len;
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static void CheckCompressed(FASTAIN *in, size_t skip)
+   -----------------------------------------------------
+*//**
+   \param[in,out] in     The reader (not mapped)
+   \param[in]     skip   Bytes after in->pos that aren't compressed
+
+   Reads the start of the input after the bytes skipped. If it is
+   compressed, what has been read is handed to a decompressor, which
+   the block is then filled from. Reading stops as soon as the input
+   can't be compressed, so this doesn't wait for more than the first
+   few bytes from a pipe or socket.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void CheckCompressed(FASTAIN *in, size_t skip)
+{
+   int format;
+
+   while(((format = CompressionFormat(in->data + in->pos + skip,
+                                      in->len - in->pos - skip))
+          == COMPRESS_UNKNOWN) && ReadMore(in))
+      continue;
+
+   if((format == COMPRESS_GZIP) || (format == COMPRESS_ZSTD))
+   {
+      if((in->decomp = StartDecomp(in->fd, format,
+                                   in->data + in->pos + skip,
+                                   in->len - in->pos - skip))==NULL)
+      {
+         fprintf(stderr, "\nError (agl): No memory for decompression\n");
+         exit(1);
+      }
+      in->block->len = in->len = in->pos + skip;
+   }
+}
+
+
+/************************************************************************/
+/*>static BOOL FindRecord(FASTAIN *in, size_t *searched, size_t *end)
+   ------------------------------------------------------------------
+*//**
+   \param[in,out] in         The reader
+   \param[in,out] searched   Bytes after the start of the record already
+                             searched for the next header
+   \return                   Is a whole record available?
+   \param[out]    end        Offset of the end of the record
+
+   Skips any complete lines before the next header, which is left at
+   in->pos. The record ends at the next line starting with a > or at
+   the end of the input.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static BOOL FindRecord(FASTAIN *in, size_t *searched, size_t *end)
+{
+   char *data = in->data,
+        *p;
+
+   while((in->pos < in->len) && (data[in->pos] != '>'))
+   {
+      if((p = memchr(data + in->pos, '\n', in->len - in->pos))==NULL)
+      {
+         if(in->eof)
+            in->pos = in->len;
+         return(FALSE);
+      }
+      in->pos = (p - data) + 1;
+   }
+   if(in->pos == in->len)
+      return(FALSE);
+
+   /* Look for a > at the start of a line                              */
+   for(p = data + in->pos + MAX(*searched, 1);
+       (p = memchr(p, '>', in->len - (p - data)))!=NULL;
+       p++)
+   {
+      if(*(p-1) == '\n')
+      {
+         *end = p - data;
+         return(TRUE);
+      }
+   }
+   *searched = in->len - in->pos;
+
+   if(in->eof)
+   {
+      *end = in->len;
+      return(TRUE);
+   }
+   return(FALSE);
+}
+
+
+/************************************************************************/
+/*>static size_t StripWhiteSpace(char *buffer, size_t len)
+   -------------------------------------------------------
+*//**
+   \param[in,out] buffer   Text to squeeze
+   \param[in]     len      Its length
+   \return                 The new length
+
+   Moves the characters other than white space and control characters
+   (anything up to a space) down over them. With SSE2, 16 characters
+   are tested at a time and runs without white space are moved as a
+   whole, so a sequence on one line isn't moved at all.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static size_t StripWhiteSpace(char *buffer, size_t len)
+{
+   size_t in  = 0,
+          out = 0;
+
+#ifdef SIMD_SSE2
+   const __m128i space = _mm_set1_epi8(' ');
+
+   for(; in + 16 <= len; in += 16)
+   {
+      __m128i chars = _mm_loadu_si128((__m128i *)(buffer + in));
+      int     white;
+
+      /* Characters up to a space are unchanged by taking the minimum  */
+      white = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(chars, space),
+                                               chars));
+      if(white == 0)
+      {
+         if(out != in)
+            _mm_storeu_si128((__m128i *)(buffer + out), chars);
+         out += 16;
+      }
+      else if(white != 0xFFFF)
+      {
+         int i;
+
+         for(i=0; i<16; i++)
+         {
+            if(!(white & (1 << i)))
+               buffer[out++] = buffer[in+i];
+         }
+      }
+   }
+#endif
+
+   for(; in<len; in++)
+   {
+      if((unsigned char)buffer[in] > ' ')
+         buffer[out++] = buffer[in];
+   }
+   return(out);
+}
@@ -0,0 +1,125 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       fastain.h
+
+   \version    V1.1
+   \date       18.10.26
+   \brief      FASTA input without copying or fixed-size buffers
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+
+**************************************************************************
+
+   Usage:
+   ======
+   FASTAIN  *in;
+   FASTAREC record;
+
+   in = OpenFASTAIn(fp);
+   while(ReadFASTARecord(in, &record))
+   {
+      ... use record.header and record.seq ...
+      ReleaseFASTARecord(in, &record);
+   }
+   CloseFASTAIn(in);
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+   V1.1   18.10.26  Reads gzip and zstd input
+
+*************************************************************************/
+#ifndef _FASTAIN_H
+#define _FASTAIN_H
+
+/************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stddef.h>
+#include "bioplib/SysDefs.h"
+#include "decomp.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define FASTABLOCKSIZE (1024*1024) /* Bytes read at a time from a stream */
+
+/************************************************************************/
+/* Type definitions
+*/
+typedef struct _fastablock
+{
+   char   *data;
+   size_t size,                 /* Bytes allocated                      */
+          len;                  /* Bytes read into it                   */
+   int    nRefs;                /* Records using it, plus one while it
+                                   is being read into                   */
+}  FASTABLOCK;
+
+typedef struct
+{
+   char       *header,          /* Header line (including the >)        */
+              *seq;             /* Sequence with white space removed    */
+   size_t     headerLen,
+              seqLen;
+   FASTABLOCK *block;           /* Block holding it (NULL if mapped)    */
+   size_t     end;              /* Offset after it in the mapped file   */
+}  FASTAREC;
+
+typedef struct
+{
+   int        fd;
+   FASTABLOCK *block;           /* Block being read (NULL if mapped)    */
+   char       *data,            /* Mapped file or the block's data      */
+              *mapAddr;
+   size_t     mapSize,
+              len,              /* Bytes of data                        */
+              pos,              /* Next byte to parse                   */
+              dropped;          /* Mapped pages before this are
+                                   discarded                            */
+   DECOMP     *decomp;          /* Decompressor (or NULL)               */
+   BOOL       eof;
+}  FASTAIN;
+
+/************************************************************************/
+/* Prototypes
+*/
+FASTAIN *OpenFASTAIn(FILE *fp);
+BOOL ReadFASTARecord(FASTAIN *in, FASTAREC *record);
+char *ReadFASTAPreamble(FASTAIN *in);
+void ReleaseFASTARecord(FASTAIN *in, FASTAREC *record);
+void CloseFASTAIn(FASTAIN *in);
+
+#endif
@@ -4,8 +4,8 @@
    Program:    agl (Assign Germ Line)
    \file       findfields.c
    
-   \version    V1.5
-   \date       14.11.22
+   \version    V1.7
+   \date       17.10.26
    \brief      Parse IMGT identifier into fields
    
    \copyright  (c) UCL / Prof. Andrew C. R. Martin 2022
@@ -48,6 +48,9 @@
    =================
    V1.0   31.03.20  Original
    V1.5   14.11.22  Frees regex buffer if there were no matches
+   V1.6   17.10.26  Patterns are held in a table and compiled only once
+   V1.7   18.10.26  Patterns are compiled with pthread_once() so
+                    FindFields() may be called from several threads
 
 *************************************************************************/
 /* Includes
@@ -57,6 +60,8 @@
 #include <string.h>
 #include <regex.h>
 #include <assert.h>
+#include <pthread.h>
+#include "bioplib/SysDefs.h"
 #include "bioplib/macros.h"
 #include "findfields.h"
 #include "agl.h"
@@ -64,10 +69,69 @@
 /************************************************************************/
 /* Defines and macros
 */
+#define NPATTERNS (sizeof(sPatterns)/sizeof(sPatterns[0]))
+#define DISTAL_D  (-1)          /* Distal flag is always 'D'            */
+
+/************************************************************************/
+/* Type definitions
+*/
+typedef struct
+{
+   char *regex;                 /* The regular expression               */
+   int  class,                  /* Match number for each field, 0 if    */
+        subclass,               /* the field is not present             */
+        family,
+        distal,
+        allele;
+}  PATTERN;
 
 /************************************************************************/
 /* Globals
 */
+/* Patterns are tried in this order and the first match is used         */
+static PATTERN sPatterns[] =
+{
+   /* CCCCSSDD-FF*AA (e.g. IGKV1D-16*01)                                */
+   {"^([A-Z]+)([0-9]+)([A-Z0-9]+)-([0-9]+)\\*([0-9]+)",        1,2,4,3,5},
+   /* CCCCSS-FFDD*AA (e.g. IGKV1-16D*01)                                */
+   {"^([A-Z]+)([0-9]+)-([0-9]+)([A-Z]+)\\*([0-9]+)",           1,2,3,4,5},
+   /* CCCCSS-FF*AA (e.g. IGHV1-NL1*01)                                  */
+   {"^([A-Z]+)([0-9]+)-([A-Z0-9]+)\\*([0-9]+)",                1,2,3,0,4},
+   /* CCCCSS-FF-FF*AA (e.g. IGHV1-38-4*01)                              */
+   {"^([A-Z]+)([0-9]+)-([0-9]+-[0-9]+)\\*([0-9]+)",            1,2,3,0,4},
+   /* CCCCSSDD*AA (e.g. TRDV1S1*01)                                     */
+   {"^([A-Z]+)([0-9]+)([A-Z0-9]+)\\*([0-9]+)",                 1,2,3,0,4},
+   /* CCCCSS-FF*AA (e.g. IGHV3-48*02)                                   */
+   {"^([A-Z]+)([0-9]+)-([0-9]+)\\*([0-9]+)",                   1,2,3,0,4},
+   /* CCCCSS-FF*AA (e.g. IGKV12-e*01)                                   */
+   {"^([A-Z]+)([0-9]+)-([a-zA-Z]+)\\*([0-9]+)",                1,2,3,0,4},
+   /* CCCCSS*AA (e.g. IGHG2*01)                                         */
+   {"^([A-Z]+)([0-9]+)\\*([0-9]+)",                            1,2,0,0,3},
+   /* CCCC*AA (e.g. IGHA*01)                                            */
+   {"^([A-Z]+)\\*([0-9]+)",                                    1,0,0,0,2},
+   /* CCCCSS/DD-FF*AA (e.g. IGHD1/OR15-1a*01)                           */
+   {"^([A-Z]+)([0-9]*)/([A-Z0-9]+)-([a-zA-Z0-9]+)\\*([0-9]+)", 1,2,4,3,5},
+   /* CCCC-SS/FFFF*AA (e.g. IGLJ-C/OR18*01)                             */
+   {"^([A-Z]+)-([A-Z]+)/([A-Z0-9]+)\\*([0-9]+)",               1,2,3,0,4},
+   /* CCCCSS/FFF*AA (e.g. TRAV14/DV4*01)                                */
+   {"^([A-Z]+)([0-9]+)/([A-Z0-9]+)\\*([0-9]+)",                1,2,3,0,4},
+   /* CCCCSS-SS/FFF*AA (e.g. TRAV38-2/DV8*01)                           */
+   {"^([A-Z]+)([0-9]+-[0-9]+)/([A-Z0-9]+)\\*([0-9]+)",         1,2,3,0,4},
+   /* CCCCSS-SS/FFF-F*AA (e.g. TRAV15-1/DV6-1*01)                       */
+   {"^([A-Z]+)([0-9]+-[0-9]+)/([A-Z0-9]+-[0-9]+)\\*([0-9]+)",  1,2,3,0,4},
+   /* CCCCSSD-SS/FFF-F*AA (e.g. TRAV15D-1/DV6D-1*01)                    */
+   {"^([A-Z]+)([0-9]+D-[0-9]+)/([A-Z0-9]+-[0-9]+)\\*([0-9]+)",
+                                                      1,2,3,DISTAL_D,4},
+   /* CCCCSSD-SS/FFF*AA (e.g. TRAV14D-3/DV8*01)                         */
+   {"^([A-Z]+)([0-9]+D-[0-9]+)/([A-Z0-9]+)\\*([0-9]+)",
+                                                      1,2,3,DISTAL_D,4},
+   /* CCCCSSD/FFF*AA (e.g. TRAV16D/DV11*01)                             */
+   {"^([A-Z]+)([0-9]+)D/([A-Z0-9]+)\\*([0-9]+)",
+                                                      1,2,3,DISTAL_D,4}
+};
+
+static regex_t        sCompiled[sizeof(sPatterns)/sizeof(sPatterns[0])];
+static pthread_once_t sCompileOnce = PTHREAD_ONCE_INIT;
 
 /************************************************************************/
 /* Prototypes
@@ -75,6 +139,7 @@
 static void CopyMatch(char *out, int maxbuff, char *in,
                       regmatch_t *pMatches, int matchNum);
 static int IntMatch(char *in, regmatch_t *pMatches, int matchNum);
+static void CompilePatterns(void);
 
 /************************************************************************/
 #ifdef TEST
@@ -246,11 +311,13 @@ int test_findfields(void)
    \param[in]   maxbuff    Max size of output
    \param[in]   in         Input string
    \param[in]   pMatches   POSIX regex structure pointer
-   \param[in]   matchNum   Match number we wish to extract
+   \param[in]   matchNum   Match number we wish to extract (0 if the
+                           field is not present in this pattern)
 
    Extracts the specified match from the input string
 
    - 31.03.20 Original   By: ACRM
+   - 17.10.26 Match number 0 gives a blank string
 */
 static void CopyMatch(char *out, int maxbuff, char *in,
                       regmatch_t *pMatches, int matchNum)
@@ -260,7 +327,7 @@ static void CopyMatch(char *out, int maxbuff, char *in,
               nCopy;
 
    out[0] = '\0';
-   if(match->rm_so == (-1))
+   if((matchNum == 0) || (match->rm_so == (-1)))
       return;
 
    matchLen = match->rm_eo - match->rm_so;
@@ -276,12 +343,14 @@ static void CopyMatch(char *out, int maxbuff, char *in,
 *//**
    \param[in]   in         Input string
    \param[in]   pMatches   POSIX regex structure pointer
-   \param[in]   matchNum   Match number we wish to extract
+   \param[in]   matchNum   Match number we wish to extract (0 if the
+                           field is not present in this pattern)
    \return                 Integer extracted from string
 
    Extracts the specified integer match from the input string
 
    - 31.03.20 Original   By: ACRM
+   - 17.10.26 Match number 0 gives 0
 */
 static int IntMatch(char *in, regmatch_t *pMatches, int matchNum)
 {
@@ -291,7 +360,7 @@ static int IntMatch(char *in, regmatch_t *pMatches, int matchNum)
    char        buffer[SMALLBUFF];
 
    buffer[0] = '\0';
-   if(match->rm_so == (-1))
+   if((matchNum == 0) || (match->rm_so == (-1)))
       return(0);
 
    matchLen = match->rm_eo - match->rm_so;
@@ -303,6 +372,30 @@ static int IntMatch(char *in, regmatch_t *pMatches, int matchNum)
 }
 
 
+/************************************************************************/
+/*>static void CompilePatterns(void)
+   ---------------------------------
+*//**
+   Compiles the regular expressions in the patterns table. This is done
+   once, the first time FindFields() is called, rather than for every
+   identifier
+
+   - 17.10.26 Original   By: ACRM
+   - 18.10.26 Called through pthread_once()
+*/
+static void CompilePatterns(void)
+{
+   int i,
+       err;
+
+   for(i=0; i<NPATTERNS; i++)
+   {
+      err = regcomp(&(sCompiled[i]), sPatterns[i].regex, REG_EXTENDED);
+      assert(err == 0);
+   }
+}
+
+
 /************************************************************************/
 /*>void FindFields(char *id, char *class, char *subclass, char *family,
                    int *pAllele, char *distal)
@@ -318,309 +411,40 @@ static int IntMatch(char *in, regmatch_t *pMatches, int matchNum)
    Parses an IMGT gene ID to extract class, etc.
 
    - 31.03.20 Original   By: ACRM
+   - 17.10.26 The patterns are now held in a table and only compiled
+              once
+   - 18.10.26 Thread-safe compilation of the patterns
 */
 void FindFields(char *id, char *class, char *subclass, char *family,
                 int *pAllele, char *distal)
 {
-   regex_t    re;
    regmatch_t matches[LABELBUFF];
-   int        err;
+   int        i;
 
    class[0]    = '\0';
    subclass[0] = '\0';
    distal[0]   = '\0';
    family[0]   = '\0';
    *pAllele    = 0;
-   
-   /* CCCCSSDD-FF*AA (e.g. IGKV1D-16*01)                                */
-   err = regcomp(&re, "^([A-Z]+)([0-9]+)([A-Z0-9]+)-([0-9]+)\\*([0-9]+)",
-                 REG_EXTENDED);
-   assert(err == 0);
-   if(regexec(&re, id, sizeof(matches)/sizeof(matches[0]),
-              (regmatch_t *)&matches, 0) == 0)
-   {
-      CopyMatch(class,    SMALLBUFF, id, matches, 1);
-      CopyMatch(subclass, SMALLBUFF, id, matches, 2);
-      CopyMatch(distal,   SMALLBUFF, id, matches, 3);
-      CopyMatch(family,   SMALLBUFF, id, matches, 4);
-      *pAllele = IntMatch(id, matches, 5);
-      regfree(&re);
-      return;
-   }
-
-   /* CCCCSS-FFDD*AA (e.g. IGKV1-16D*01)                                */
-   regfree(&re);
-   err = regcomp(&re, "^([A-Z]+)([0-9]+)-([0-9]+)([A-Z]+)\\*([0-9]+)",
-                 REG_EXTENDED);
-   assert(err == 0);
-   if(regexec(&re, id, sizeof(matches)/sizeof(matches[0]),
-              (regmatch_t *)&matches, 0) == 0)
-   {
-      CopyMatch(class,    SMALLBUFF, id, matches, 1);
-      CopyMatch(subclass, SMALLBUFF, id, matches, 2);
-      CopyMatch(distal,   SMALLBUFF, id, matches, 4);
-      CopyMatch(family,   SMALLBUFF, id, matches, 3);
-      *pAllele = IntMatch(id, matches, 5);
-      regfree(&re);
-      return;
-   }
-
-   /* CCCCSS-FF*AA (e.g. IGHV1-NL1*01)                                  */
-   regfree(&re);
-   err = regcomp(&re, "^([A-Z]+)([0-9]+)-([A-Z0-9]+)\\*([0-9]+)",
-                 REG_EXTENDED);
-   assert(err == 0);
-   if(regexec(&re, id, sizeof(matches)/sizeof(matches[0]),
-              (regmatch_t *)&matches, 0) == 0)
-   {
-      CopyMatch(class,    SMALLBUFF, id, matches, 1);
-      CopyMatch(subclass, SMALLBUFF, id, matches, 2);
-      distal[0] = '\0';
-      CopyMatch(family,   SMALLBUFF, id, matches, 3);
-      *pAllele  = IntMatch(id, matches, 4);
-      regfree(&re);
-      return;
-   }
-
-   /* CCCCSS-FF-FF*AA (e.g. IGHV1-38-4*01)                              */
-   regfree(&re);
-   err = regcomp(&re, "^([A-Z]+)([0-9]+)-([0-9]+-[0-9]+)\\*([0-9]+)",
-                 REG_EXTENDED);
-   assert(err == 0);
-   if(regexec(&re, id, sizeof(matches)/sizeof(matches[0]),
-              (regmatch_t *)&matches, 0) == 0)
-   {
-      CopyMatch(class,    SMALLBUFF, id, matches, 1);
-      CopyMatch(subclass, SMALLBUFF, id, matches, 2);
-      distal[0] = '\0';
-      CopyMatch(family,   SMALLBUFF, id, matches, 3);
-      *pAllele  = IntMatch(id, matches, 4);
-      regfree(&re);
-      return;
-   }
-
-   /* CCCCSSDD*AA (e.g. TRDV1S1*01)                                     */
-   regfree(&re);
-   err = regcomp(&re, "^([A-Z]+)([0-9]+)([A-Z0-9]+)\\*([0-9]+)",
-                 REG_EXTENDED);
-   assert(err == 0);
-   if(regexec(&re, id, sizeof(matches)/sizeof(matches[0]),
-              (regmatch_t *)&matches, 0) == 0)
-   {
-      CopyMatch(class,    SMALLBUFF, id, matches, 1);
-      CopyMatch(subclass, SMALLBUFF, id, matches, 2);
-      distal[0] = '\0';
-      CopyMatch(family,   SMALLBUFF, id, matches, 3);
-      *pAllele  = IntMatch(id, matches, 4);
-      regfree(&re);
-      return;
-   }
 
-   /*  CCCCSS-FF*AA (e.g. IGHV3-48*02)                                  */
-   regfree(&re);
-   err = regcomp(&re, "^([A-Z]+)([0-9]+)-([0-9]+)\\*([0-9]+)",
-                 REG_EXTENDED);
-   assert(err == 0);
-   if(regexec(&re, id, sizeof(matches)/sizeof(matches[0]),
-              (regmatch_t *)&matches, 0) == 0)
-   {
-      CopyMatch(class,    SMALLBUFF, id, matches, 1);
-      CopyMatch(subclass, SMALLBUFF, id, matches, 2);
-      distal[0] = '\0';
-      CopyMatch(family,   SMALLBUFF, id, matches, 3);
-      *pAllele  = IntMatch(id, matches, 4);
-      regfree(&re);
-      return;
-   }
-
-   /*  CCCCSS-FF*AA (e.g. IGKV12-e*01)                                  */
-   regfree(&re);
-   err = regcomp(&re, "^([A-Z]+)([0-9]+)-([a-zA-Z]+)\\*([0-9]+)",
-                 REG_EXTENDED);
-   assert(err == 0);
-   if(regexec(&re, id, sizeof(matches)/sizeof(matches[0]),
-              (regmatch_t *)&matches, 0) == 0)
-   {
-      CopyMatch(class,    SMALLBUFF, id, matches, 1);
-      CopyMatch(subclass, SMALLBUFF, id, matches, 2);
-      distal[0] = '\0';
-      CopyMatch(family,   SMALLBUFF, id, matches, 3);
-      *pAllele  = IntMatch(id, matches, 4);
-      regfree(&re);
-      return;
-   }
-
-   /*  CCCCSS*AA (e.g. IGHG2*01)                                        */
-   regfree(&re);
-   err = regcomp(&re, "^([A-Z]+)([0-9]+)\\*([0-9]+)",
-                 REG_EXTENDED);
-   assert(err == 0);
-   if(regexec(&re, id, sizeof(matches)/sizeof(matches[0]),
-              (regmatch_t *)&matches, 0) == 0)
-   {
-      CopyMatch(class,    SMALLBUFF, id, matches, 1);
-      CopyMatch(subclass, SMALLBUFF, id, matches, 2);
-      distal[0] = '\0';
-      family[0] = '\0';
-      *pAllele  = IntMatch(id, matches, 3);
-      regfree(&re);
-      return;
-   }
-
-   /*  CCCC*AA (e.g. IGHA*01)                                           */
-   regfree(&re);
-   err = regcomp(&re, "^([A-Z]+)\\*([0-9]+)",
-                 REG_EXTENDED);
-   assert(err == 0);
-   if(regexec(&re, id, sizeof(matches)/sizeof(matches[0]),
-              (regmatch_t *)&matches, 0) == 0)
-   {
-      CopyMatch(class, SMALLBUFF, id, matches, 1);
-      subclass[0] = '\0';
-      distal[0]   = '\0';
-      family[0]   = '\0';
-      *pAllele    = IntMatch(id, matches, 2);
-      regfree(&re);
-      return;
-   }
-
-   /* CCCCSS/DD-FF*AA (e.g. IGHD1/OR15-1a*01)                           */
-   regfree(&re);
-   err = regcomp(&re,
-                 "^([A-Z]+)([0-9]*)/([A-Z0-9]+)-([a-zA-Z0-9]+)\\*([0-9]+)",
-                 REG_EXTENDED);
-   assert(err == 0);
-   if(regexec(&re, id, sizeof(matches)/sizeof(matches[0]),
-              (regmatch_t *)&matches, 0) == 0)
-   {
-      CopyMatch(class,    SMALLBUFF, id, matches, 1);
-      CopyMatch(subclass, SMALLBUFF, id, matches, 2);
-      CopyMatch(distal,   SMALLBUFF, id, matches, 3);
-      CopyMatch(family,   SMALLBUFF, id, matches, 4);
-      *pAllele = IntMatch(id, matches, 5);
-      regfree(&re);
-      return;
-   }
-
-   /*  CCCC-SS/FFFF*AA (e.g. IGLJ-C/OR18*01)                            */
-   regfree(&re);
-   err = regcomp(&re, "^([A-Z]+)-([A-Z]+)/([A-Z0-9]+)\\*([0-9]+)",
-                 REG_EXTENDED);
-   assert(err == 0);
-   if(regexec(&re, id, sizeof(matches)/sizeof(matches[0]),
-              (regmatch_t *)&matches, 0) == 0)
-   {
-      CopyMatch(class,    SMALLBUFF, id, matches, 1);
-      CopyMatch(subclass, SMALLBUFF, id, matches, 2);
-      distal[0] = '\0';
-      CopyMatch(family,   SMALLBUFF, id, matches, 3);
-      *pAllele  = IntMatch(id, matches, 4);
-      regfree(&re);
-      return;
-   }
-
-   /*  CCCCSS/FFF*AA (e.g. TRAV14/DV4*01)                               */
-   regfree(&re);
-   err = regcomp(&re, "^([A-Z]+)([0-9]+)/([A-Z0-9]+)\\*([0-9]+)",
-                 REG_EXTENDED);
-   assert(err == 0);
-   if(regexec(&re, id, sizeof(matches)/sizeof(matches[0]),
-              (regmatch_t *)&matches, 0) == 0)
-   {
-      CopyMatch(class,    SMALLBUFF, id, matches, 1);
-      CopyMatch(subclass, SMALLBUFF, id, matches, 2);
-      distal[0] = '\0';
-      CopyMatch(family,   SMALLBUFF, id, matches, 3);
-      *pAllele  = IntMatch(id, matches, 4);
-      regfree(&re);
-      return;
-   }
-
-   /*  CCCCSS-SS/FFF*AA (e.g. TRAV38-2/DV8*01)                          */
-   regfree(&re);
-   err = regcomp(&re, "^([A-Z]+)([0-9]+-[0-9]+)/([A-Z0-9]+)\\*([0-9]+)",
-                 REG_EXTENDED);
-   assert(err == 0);
-   if(regexec(&re, id, sizeof(matches)/sizeof(matches[0]),
-              (regmatch_t *)&matches, 0) == 0)
-   {
-      CopyMatch(class,    SMALLBUFF, id, matches, 1);
-      CopyMatch(subclass, SMALLBUFF, id, matches, 2);
-      distal[0] = '\0';
-      CopyMatch(family,   SMALLBUFF, id, matches, 3);
-      *pAllele  = IntMatch(id, matches, 4);
-      regfree(&re);
-      return;
-   }
-
-   /* CCCCSS-SS/FFF-F*AA (e.g. TRAV15-1/DV6-1*01)                       */
-   regfree(&re);
-   err = regcomp(&re,
-                 "^([A-Z]+)([0-9]+-[0-9]+)/([A-Z0-9]+-[0-9]+)\\*([0-9]+)",
-                 REG_EXTENDED);
-   assert(err == 0);
-   if(regexec(&re, id, sizeof(matches)/sizeof(matches[0]),
-              (regmatch_t *)&matches, 0) == 0)
-   {
-      CopyMatch(class,    SMALLBUFF, id, matches, 1);
-      CopyMatch(subclass, SMALLBUFF, id, matches, 2);
-      distal[0] = '\0';
-      CopyMatch(family,   SMALLBUFF, id, matches, 3);
-      *pAllele  = IntMatch(id, matches, 4);
-      regfree(&re);
-      return;
-   }
-
-   /* CCCCSSD-SS/FFF-F*AA (e.g. TRAV15D-1/DV6D-1*01)                    */
-   regfree(&re);
-   err = regcomp(&re,
-                 "^([A-Z]+)([0-9]+D-[0-9]+)/([A-Z0-9]+-[0-9]+)\\*([0-9]+)",
-                 REG_EXTENDED);
-   assert(err == 0);
-   if(regexec(&re, id, sizeof(matches)/sizeof(matches[0]),
-              (regmatch_t *)&matches, 0) == 0)
-   {
-      CopyMatch(class,    SMALLBUFF, id, matches, 1);
-      CopyMatch(subclass, SMALLBUFF, id, matches, 2);
-      strcpy(distal, "D");
-      CopyMatch(family,   SMALLBUFF, id, matches, 3);
-      *pAllele = IntMatch(id, matches, 4);
-      regfree(&re);
-      return;
-   }
-
-   /* CCCCSSD-SS/FFF*AA (e.g. TRAV14D-3/DV8*01)                         */
-   regfree(&re);
-   err = regcomp(&re, "^([A-Z]+)([0-9]+D-[0-9]+)/([A-Z0-9]+)\\*([0-9]+)",
-                 REG_EXTENDED);
-   assert(err == 0);
-   if(regexec(&re, id, sizeof(matches)/sizeof(matches[0]),
-              (regmatch_t *)&matches, 0) == 0)
-   {
-      CopyMatch(class,    SMALLBUFF, id, matches, 1);
-      CopyMatch(subclass, SMALLBUFF, id, matches, 2);
-      strcpy(distal, "D");
-      CopyMatch(family,   SMALLBUFF, id, matches, 3);
-      *pAllele = IntMatch(id, matches, 4);
-      regfree(&re);
-      return;
-   }
-
-   /* CCCCSSD/FFF*AA (e.g. TRAV16D/DV11*01)                             */
-   regfree(&re);
-   err = regcomp(&re, "^([A-Z]+)([0-9]+)D/([A-Z0-9]+)\\*([0-9]+)",
-                 REG_EXTENDED);
-   assert(err == 0);
-   if(regexec(&re, id, sizeof(matches)/sizeof(matches[0]),
-              (regmatch_t *)&matches, 0) == 0)
+   pthread_once(&sCompileOnce, CompilePatterns);
+   
+   for(i=0; i<NPATTERNS; i++)
    {
-      CopyMatch(class,    SMALLBUFF, id, matches, 1);
-      CopyMatch(subclass, SMALLBUFF, id, matches, 2);
-      strcpy(distal, "D");
-      CopyMatch(family,   SMALLBUFF, id, matches, 3);
-      *pAllele = IntMatch(id, matches, 4);
-      regfree(&re);
-      return;
+      if(regexec(&(sCompiled[i]), id, sizeof(matches)/sizeof(matches[0]),
+                 (regmatch_t *)&matches, 0) == 0)
+      {
+         PATTERN *p = &(sPatterns[i]);
+         
+         CopyMatch(class,    SMALLBUFF, id, matches, p->class);
+         CopyMatch(subclass, SMALLBUFF, id, matches, p->subclass);
+         CopyMatch(family,   SMALLBUFF, id, matches, p->family);
+         if(p->distal < 0)
+            strcpy(distal, "D");
+         else
+            CopyMatch(distal, SMALLBUFF, id, matches, p->distal);
+         *pAllele = IntMatch(id, matches, p->allele);
+         return;
+      }
    }
-   regfree(&re);
 }
@@ -0,0 +1,1616 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       germdb.c
+
+   \version    V1.14
+   \date       17.10.26
+   \brief      In-memory germline database
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+   Each germline database type (heavy_v, CH1, hinges, etc.) is read
+   from its .dat file the first time it is needed and then kept in
+   memory for the rest of the run. The data directory is resolved
+   once when the database is initialized.
+
+   If the compiled binary database (germline.db, written by
+   util/makebindb.pl) is present, it is mapped into memory read-only
+   and the entries point directly into the mapping, so no parsing is
+   needed and concurrent agl processes share the pages. Any database
+   type not found in the binary file is read from its .dat file.
+
+   Once loaded, the entries for a type are grouped into contiguous
+   partitions by species and locus (IGK, IGL, etc.), keeping the file
+   order within each partition. A request for a species (and
+   optionally a locus) is resolved against the partitions once, giving
+   a view that lists just the matching entries in their original file
+   order, so scans only touch the entries they need and results do not
+   depend on the partitioning.
+
+   Many alleles (and frames) translate to the same amino acid sequence,
+   so each type also has a list of unique sequences (GERMSEQs) and each
+   entry records which one it uses. A scan only needs to align each
+   unique sequence once.
+
+   An inverted index from each k-mer (KMERLEN residues) to the unique
+   sequences containing it is also built. ShortlistSeqs() uses this to
+   count the k-mers each sequence shares with the query so that only
+   the best few need to be aligned.
+
+   Regions and views are still loaded the first time they are asked
+   for, under a lock so that several threads can share the database.
+   Once loaded they are never changed, and a region is only marked as
+   loaded, and a view only linked into its region, once it is complete.
+   Later requests therefore find them without taking the lock.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   17.10.26  Original - code for locating the data directory
+                    moved from agl.c
+   V1.1   17.10.26  Added the memory-mapped binary database
+   V1.2   17.10.26  Gene names are parsed into a GENERANK as each entry
+                    is loaded
+   V1.3   17.10.26  Entries are grouped into species/locus partitions
+                    and species selections are made once per run
+   V1.4   17.10.26  Entries with identical sequences share a GERMSEQ
+   V1.5   17.10.26  Added the k-mer index used to shortlist sequences
+   V1.6   18.10.26  Unique sequences are also stored in blocks for
+                    lane-parallel scoring
+   V1.7   18.10.26  Regions and views are loaded under a lock so the
+                    database can be shared between threads
+   V1.8   18.10.26  Added HashGermDB() so results stored on disk can
+                    be tied to the data they came from
+   V1.9   18.10.26  Added MostSharedKmers() to help guess the chain type
+   V1.10  18.10.26  Regions and views that are already loaded are found
+                    without taking the lock
+   V1.11  18.10.26  The unique sequences are no longer stored in blocks
+   V1.12  18.10.26  The shortlist size is passed to ShortlistSeqs()
+   V1.13  18.10.26  Views count the entries left out for the species and
+                    for the locus
+   V1.14  18.10.26  Paths to the data that are too long are reported
+                    rather than cut short
+
+*************************************************************************/
+/* Includes
+*/
+#define USEPATH 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bioplib/seq.h"
+#include "bioplib/general.h"
+#include "bioplib/macros.h"
+#include "agl.h"
+#include "germdb.h"
+#include "findfields.h"
+#include "rescache.h"
+#include "whereami/whereami.h"
+
+#ifdef USEPATH
+#include <dirent.h>
+#include <errno.h>
+#endif
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define ENTRYBLOCK 64           /* Entries allocated at a time          */
+#define HASHMULT   16777619U    /* FNV-1a hash constants                */
+#define HASHSTART  2166136261U
+
+/* Binary database format - must match util/makebindb.pl               */
+#define GERMDB_MAGIC     "AGLGDB\0\0"
+#define GERMDB_BYTEORDER 0x01020304
+#define GERMDB_VERSION   1
+#define GERMDB_TYPELEN   32
+
+/************************************************************************/
+/* Type definitions
+*/
+typedef struct
+{
+   char     magic[8];
+   uint32_t byteOrder,
+            version,
+            nTypes,
+            nEntries,
+            typesOffset,
+            entriesOffset,
+            stringsOffset,
+            residuesOffset,
+            stringsSize,
+            residuesSize,
+            fileSize,
+            reserved;
+}  BINDBHEADER;
+
+typedef struct
+{
+   char     name[GERMDB_TYPELEN];
+   uint32_t firstEntry,
+            nEntries;
+}  BINDBTYPE;
+
+typedef struct
+{
+   uint32_t header,             /* Offsets into the string arena        */
+            region,
+            gene,
+            frame,
+            species,
+            seqOffset,          /* Offset into the residue arena        */
+            seqLen;
+}  BINDBENTRY;
+
+/************************************************************************/
+/* Globals
+*/
+
+/************************************************************************/
+/* Prototypes
+*/
+static GERMREGION *FindGermRegion(GERMDB *germDB, char *type);
+static GERMREGION *LookupGermRegion(GERMDB *germDB, char *type);
+static GERMVIEW *LookupGermView(GERMREGION *region, char *species,
+                                char *locus);
+static BOOL LoadGermRegion(GERMDB *germDB, GERMREGION *region);
+static BOOL MapBinaryDB(GERMDB *germDB);
+static BOOL CheckBinaryDB(char *addr, size_t size);
+static BOOL LoadMappedRegion(GERMDB *germDB, GERMREGION *region);
+static void SplitHeader(GERMENTRY *entry);
+static void RankGene(char *gene, GENERANK *rank);
+static BOOL PartitionRegion(GERMREGION *region);
+static BOOL ClassifySeqs(GERMREGION *region);
+static BOOL IndexKmers(GERMREGION *region);
+static int KmerCodes(char *seq, int *codes);
+static BOOL CountSharedKmers(GERMREGION *region, char *seq, int *counts);
+static int CompareInts(const void *a, const void *b);
+static GERMVIEW *MakeGermView(GERMREGION *region, char *species,
+                              char *locus);
+static BOOL DataFilename(GERMDB *germDB, char *name, char *ext,
+                         char *filename);
+
+#ifdef USEPATH
+static char *FindPath(void);
+static BOOL DirectoryExists(char *dirName);
+#endif
+
+
+/************************************************************************/
+/*>GERMDB *InitGermDB(char *dataDir)
+   ---------------------------------
+*//**
+   \param[in]  dataDir   Data directory from the command line (or blank)
+   \return               Allocated germline database (or NULL)
+
+   Creates an empty germline database and works out where the data
+   files are to be found. No data are read until a database type is
+   requested with GetGermRegion().
+
+   If dataDir is not specified, we look in the share/agl/data directory
+   below the location of the executable and, failing that, leave the
+   prefix blank so that blOpenFile() looks in the current directory
+   and then in the directory specified by the environment variable.
+   The binary database is looked for in the same way.
+
+   Returns NULL if the data directory is too long to be used. If the
+   path to the executable is too long, a warning is given and the
+   prefix is left blank.
+
+   - 17.10.26 Original (directory handling from ScanAgainstDB())
+              By: ACRM
+   - 17.10.26 Maps the binary database if there is one
+   - 18.10.26 Initializes the lock
+   - 18.10.26 Reports a path that is too long rather than cutting it
+              short
+*/
+GERMDB *InitGermDB(char *dataDir)
+{
+   GERMDB *germDB;
+
+   if((germDB = (GERMDB *)calloc(1, sizeof(GERMDB)))==NULL)
+      return(NULL);
+   pthread_mutex_init(&(germDB->lock), NULL);
+
+   if(dataDir[0] != '\0')
+   {
+      if(snprintf(germDB->dataPrefix, MAXBUFF, "%s/", dataDir) >=
+         MAXBUFF)
+      {
+         fprintf(stderr, "\nError (agl): Data directory path is too \
+long (%s)\n", dataDir);
+         pthread_mutex_destroy(&(germDB->lock));
+         free(germDB);
+         return(NULL);
+      }
+   }
+   else
+   {
+#ifdef USEPATH
+      char *path;
+      /* Get path to executable                                         */
+      if((path = FindPath())!=NULL)
+      {
+         char dirName[MAXBUFF+1];
+
+         /* Append the location below the binary directory and see if it
+            exists. If it does then use this as the prefix. If not, then
+            just leave the prefix blank
+         */
+         if((snprintf(dirName, MAXBUFF, "%s/share/agl/data",
+                      path) >= MAXBUFF) ||
+            (snprintf(germDB->dataPrefix, MAXBUFF, "%s/",
+                      dirName) >= MAXBUFF))
+         {
+            fprintf(stderr, "\nWarning (agl): Path to the executable is \
+too long to look for its data\n   directory (%s)\n", path);
+            germDB->dataPrefix[0] = '\0';
+         }
+         else if(!DirectoryExists(dirName))
+         {
+            germDB->dataPrefix[0] = '\0';
+         }
+
+         free(path);
+      }
+#endif
+   }
+
+   MapBinaryDB(germDB);
+
+   return(germDB);
+}
+
+
+/************************************************************************/
+/*>static BOOL MapBinaryDB(GERMDB *germDB)
+   ---------------------------------------
+*//**
+   \param[in,out] germDB   The germline database
+   \return                 Was a binary database mapped?
+
+   Looks for the compiled binary database and, if there is a valid one,
+   maps it into memory read-only.
+
+   - 17.10.26 Original   By: ACRM
+   - 18.10.26 The filename is made by DataFilename()
+*/
+static BOOL MapBinaryDB(GERMDB *germDB)
+{
+   char        filename[MAXBUFF+1];
+   BOOL        noEnv;
+   FILE        *fp;
+   struct stat statBuf;
+   char        *addr;
+
+   if(!DataFilename(germDB, GERMDB_FILE, "", filename) ||
+      ((fp = blOpenFile(filename, AGLDATADIR, "r", &noEnv))==NULL))
+      return(FALSE);
+
+   if((fstat(fileno(fp), &statBuf) != 0) ||
+      (statBuf.st_size < (off_t)sizeof(BINDBHEADER)))
+   {
+      FCLOSE(fp);
+      return(FALSE);
+   }
+
+   addr = (char *)mmap(NULL, (size_t)statBuf.st_size, PROT_READ,
+                       MAP_SHARED, fileno(fp), 0);
+   FCLOSE(fp);
+   if(addr == MAP_FAILED)
+      return(FALSE);
+
+   if(!CheckBinaryDB(addr, (size_t)statBuf.st_size))
+   {
+      fprintf(stderr, "Warning (agl): Ignoring invalid binary database \
+(%s)\n", filename);
+      munmap(addr, (size_t)statBuf.st_size);
+      return(FALSE);
+   }
+
+   germDB->mapAddr = addr;
+   germDB->mapSize = (size_t)statBuf.st_size;
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL CheckBinaryDB(char *addr, size_t size)
+   --------------------------------------------------
+*//**
+   \param[in]  addr   Start of the mapped file
+   \param[in]  size   Size of the mapped file
+   \return            Is the file valid?
+
+   Checks that the binary database has the right magic number, byte
+   order and version and that all the offsets stay within the file so
+   that we can safely point into it.
+
+   - 17.10.26 Original   By: ACRM
+*/
+static BOOL CheckBinaryDB(char *addr, size_t size)
+{
+   BINDBHEADER *header = (BINDBHEADER *)addr;
+   BINDBTYPE   *types;
+   BINDBENTRY  *entries;
+   char        *strings,
+               *residues;
+   uint32_t    i;
+
+   if(memcmp(header->magic, GERMDB_MAGIC, sizeof(header->magic)) ||
+      (header->byteOrder != GERMDB_BYTEORDER)                    ||
+      (header->version   != GERMDB_VERSION)                      ||
+      (header->fileSize  != size))
+      return(FALSE);
+
+   if(((uint64_t)header->typesOffset +
+       (uint64_t)header->nTypes * sizeof(BINDBTYPE)     > size) ||
+      ((uint64_t)header->entriesOffset +
+       (uint64_t)header->nEntries * sizeof(BINDBENTRY)  > size) ||
+      ((uint64_t)header->stringsOffset +
+       (uint64_t)header->stringsSize                    > size) ||
+      ((uint64_t)header->residuesOffset +
+       (uint64_t)header->residuesSize                   > size) ||
+      (header->stringsSize  == 0)                                 ||
+      (header->residuesSize == 0))
+      return(FALSE);
+
+   types    = (BINDBTYPE  *)(addr + header->typesOffset);
+   entries  = (BINDBENTRY *)(addr + header->entriesOffset);
+   strings  = addr + header->stringsOffset;
+   residues = addr + header->residuesOffset;
+
+   /* Every string must be terminated within its arena                  */
+   if((strings[header->stringsSize-1]   != '\0') ||
+      (residues[header->residuesSize-1] != '\0'))
+      return(FALSE);
+
+   for(i=0; i<header->nTypes; i++)
+   {
+      if((types[i].name[GERMDB_TYPELEN-1] != '\0') ||
+         ((uint64_t)types[i].firstEntry + types[i].nEntries >
+          header->nEntries))
+         return(FALSE);
+   }
+
+   for(i=0; i<header->nEntries; i++)
+   {
+      if((entries[i].header  >= header->stringsSize) ||
+         (entries[i].region  >= header->stringsSize) ||
+         (entries[i].gene    >= header->stringsSize) ||
+         (entries[i].frame   >= header->stringsSize) ||
+         (entries[i].species >= header->stringsSize) ||
+         ((uint64_t)entries[i].seqOffset + entries[i].seqLen >=
+          header->residuesSize)                      ||
+         (residues[entries[i].seqOffset + entries[i].seqLen] != '\0'))
+         return(FALSE);
+   }
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL LoadMappedRegion(GERMDB *germDB, GERMREGION *region)
+   ----------------------------------------------------------------
+*//**
+   \param[in]     germDB   The germline database
+   \param[in,out] region   The database type to be set up
+   \return                 Was the type found in the binary database?
+
+   Sets up the entries for a database type to point into the mapped
+   binary database. No strings are copied.
+
+   - 17.10.26 Original   By: ACRM
+*/
+static BOOL LoadMappedRegion(GERMDB *germDB, GERMREGION *region)
+{
+   BINDBHEADER *header;
+   BINDBTYPE   *types;
+   BINDBENTRY  *entries;
+   char        *strings,
+               *residues;
+   uint32_t    i, j;
+
+   if(germDB->mapAddr == NULL)
+      return(FALSE);
+
+   header   = (BINDBHEADER *)germDB->mapAddr;
+   types    = (BINDBTYPE  *)(germDB->mapAddr + header->typesOffset);
+   entries  = (BINDBENTRY *)(germDB->mapAddr + header->entriesOffset);
+   strings  = germDB->mapAddr + header->stringsOffset;
+   residues = germDB->mapAddr + header->residuesOffset;
+
+   for(i=0; i<header->nTypes; i++)
+   {
+      if(!strcmp(types[i].name, region->type))
+      {
+         if(types[i].nEntries &&
+            (region->entries =
+             (GERMENTRY *)malloc(types[i].nEntries * sizeof(GERMENTRY)))
+            == NULL)
+         {
+            return(FALSE);
+         }
+
+         for(j=0; j<types[i].nEntries; j++)
+         {
+            BINDBENTRY *binEntry = &(entries[types[i].firstEntry + j]);
+            GERMENTRY  *entry    = &(region->entries[j]);
+
+            entry->header  = strings + binEntry->header;
+            entry->region  = strings + binEntry->region;
+            entry->gene    = strings + binEntry->gene;
+            entry->frame   = strings + binEntry->frame;
+            entry->species = strings + binEntry->species;
+            entry->seq     = residues + binEntry->seqOffset;
+            entry->seqLen  = (int)binEntry->seqLen;
+            entry->order   = (int)j;
+            RankGene(entry->gene, &(entry->rank));
+         }
+
+         region->nEntries = (int)types[i].nEntries;
+         region->mapped   = TRUE;
+         return(TRUE);
+      }
+   }
+
+   return(FALSE);
+}
+
+
+/************************************************************************/
+/*>GERMREGION *GetGermRegion(GERMDB *germDB, char *type)
+   -----------------------------------------------------
+*//**
+   \param[in]  germDB   The germline database
+   \param[in]  type     The database type (e.g. heavy_v)
+   \return              The entries for that database type
+
+   Returns the set of entries for a database type, reading them from
+   the data file the first time they are requested. If the data file
+   can't be read, this is fatal. The lock is only taken if the type
+   hasn't already been loaded.
+
+   - 17.10.26 Original   By: ACRM
+   - 17.10.26 Uses the binary database if the type is there
+   - 18.10.26 Builds the blocks for lane-parallel scoring
+   - 18.10.26 Holds the lock - work moved to FindGermRegion()
+   - 18.10.26 Only takes the lock if the type isn't loaded
+   - 18.10.26 No longer builds blocks - ScanAgainstDB() packs the
+              sequences it needs
+*/
+GERMREGION *GetGermRegion(GERMDB *germDB, char *type)
+{
+   GERMREGION *region;
+
+   if((region = LookupGermRegion(germDB, type))==NULL)
+   {
+      pthread_mutex_lock(&(germDB->lock));
+      region = FindGermRegion(germDB, type);
+      pthread_mutex_unlock(&(germDB->lock));
+   }
+
+   return(region);
+}
+
+
+/************************************************************************/
+/*>static GERMREGION *LookupGermRegion(GERMDB *germDB, char *type)
+   ---------------------------------------------------------------
+*//**
+   \param[in]  germDB   The germline database
+   \param[in]  type     The database type (e.g. heavy_v)
+   \return              The entries for that database type (or NULL if
+                        it isn't loaded yet)
+
+   Finds a database type that has been loaded without taking the lock.
+   FindGermRegion() only counts a region once its type is set, and
+   only marks it as loaded once it is complete, so anything seen here
+   is never changed again.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static GERMREGION *LookupGermRegion(GERMDB *germDB, char *type)
+{
+   int nRegions = __atomic_load_n(&(germDB->nRegions), __ATOMIC_ACQUIRE),
+       i;
+
+   for(i=0; i<nRegions; i++)
+   {
+      GERMREGION *region = &(germDB->regions[i]);
+
+      if(!strcmp(region->type, type))
+         return(__atomic_load_n(&(region->loaded), __ATOMIC_ACQUIRE) ?
+                region : NULL);
+   }
+   return(NULL);
+}
+
+
+/************************************************************************/
+/*>static GERMREGION *FindGermRegion(GERMDB *germDB, char *type)
+   -------------------------------------------------------------
+*//**
+   \param[in]  germDB   The germline database
+   \param[in]  type     The database type (e.g. heavy_v)
+   \return              The entries for that database type
+
+   Does the work of GetGermRegion(). The lock must be held.
+
+   - 18.10.26 Original (from GetGermRegion())   By: ACRM
+   - 18.10.26 The region is counted once its type is set and marked
+              as loaded once it is complete, for LookupGermRegion()
+*/
+static GERMREGION *FindGermRegion(GERMDB *germDB, char *type)
+{
+   GERMREGION *region = NULL;
+   int        i;
+
+   for(i=0; i<germDB->nRegions; i++)
+   {
+      if(!strcmp(germDB->regions[i].type, type))
+      {
+         region = &(germDB->regions[i]);
+         break;
+      }
+   }
+
+   if(region == NULL)
+   {
+      if(germDB->nRegions >= MAXREGIONS)
+      {
+         fprintf(stderr, "\nError (agl): Too many database types\n");
+         exit(1);
+      }
+      region = &(germDB->regions[germDB->nRegions]);
+      strncpy(region->type, type, SMALLBUFF);
+      __atomic_store_n(&(germDB->nRegions), germDB->nRegions + 1,
+                       __ATOMIC_RELEASE);
+   }
+
+   if(!region->loaded)
+   {
+      if(!LoadMappedRegion(germDB, region) &&
+         !LoadGermRegion(germDB, region))
+         exit(1);
+      if(!PartitionRegion(region) || !ClassifySeqs(region) ||
+         !IndexKmers(region))
+      {
+         fprintf(stderr, "\nError (agl): No memory for %s database\n",
+                 region->type);
+         exit(1);
+      }
+      __atomic_store_n(&(region->loaded), TRUE, __ATOMIC_RELEASE);
+   }
+
+   return(region);
+}
+
+
+/************************************************************************/
+/*>GERMVIEW *GetGermView(GERMDB *germDB, char *type, char *species,
+                         char *locus)
+   ----------------------------------------------------------------
+*//**
+   \param[in]  germDB   The germline database
+   \param[in]  type     The database type (e.g. heavy_v)
+   \param[in]  species  Species (e.g. Homo) or blank for all species
+   \param[in]  locus    Locus (e.g. IGK) or blank for all loci
+   \return              The matching entries
+
+   Returns the entries of a database type that match a species and
+   locus, in the order they appear in the data file. The species
+   matches any partition whose species contains the string (so Mus
+   matches all the mouse species). The selection is made the first
+   time it is requested and kept for the rest of the run. The lock is
+   only taken to make it.
+
+   - 17.10.26 Original (species test from ScanAgainstDB())  By: ACRM
+   - 18.10.26 Holds the lock
+   - 18.10.26 Only takes the lock if the view hasn't been made
+*/
+GERMVIEW *GetGermView(GERMDB *germDB, char *type, char *species,
+                      char *locus)
+{
+   GERMREGION *region = GetGermRegion(germDB, type);
+   GERMVIEW   *view;
+
+   if((view = LookupGermView(region, species, locus))!=NULL)
+      return(view);
+
+   /* Another thread may have made it while we waited for the lock     */
+   pthread_mutex_lock(&(germDB->lock));
+   if(((view = LookupGermView(region, species, locus))==NULL) &&
+      ((view = MakeGermView(region, species, locus))==NULL))
+   {
+      fprintf(stderr, "\nError (agl): No memory for %s database\n",
+              region->type);
+      exit(1);
+   }
+   pthread_mutex_unlock(&(germDB->lock));
+
+   return(view);
+}
+
+
+/************************************************************************/
+/*>static GERMVIEW *LookupGermView(GERMREGION *region, char *species,
+                                   char *locus)
+   ------------------------------------------------------------------
+*//**
+   \param[in]  region   A loaded database type
+   \param[in]  species  Species or blank for all species
+   \param[in]  locus    Locus or blank for all loci
+   \return              The view already made (or NULL)
+
+   Finds a view without taking the lock. MakeGermView() only links a
+   view into the list once it is complete and views are never removed
+   while the database is in use.
+
+   - 18.10.26 Original (from GetGermView())   By: ACRM
+*/
+static GERMVIEW *LookupGermView(GERMREGION *region, char *species,
+                                char *locus)
+{
+   GERMVIEW *view;
+
+   for(view=__atomic_load_n(&(region->views), __ATOMIC_ACQUIRE);
+       view!=NULL;
+       view=view->next)
+   {
+      if(!strcmp(view->species, species) && !strcmp(view->locus, locus))
+         return(view);
+   }
+   return(NULL);
+}
+
+
+/************************************************************************/
+/*>static BOOL PartitionRegion(GERMREGION *region)
+   -----------------------------------------------
+*//**
+   \param[in,out] region   A loaded database type
+   \return                 Success
+
+   Groups the entries into contiguous partitions of the same species
+   and locus. Partitions are in order of first appearance and entries
+   keep their file order within a partition.
+
+   - 17.10.26 Original   By: ACRM
+*/
+static BOOL PartitionRegion(GERMREGION *region)
+{
+   GERMENTRY *sorted = NULL;
+   int       *partNum = NULL,
+             *next    = NULL,
+             maxParts = 0,
+             i, j;
+
+   region->nParts = 0;
+   if(region->nEntries == 0)
+      return(TRUE);
+
+   if((partNum = (int *)malloc(region->nEntries * sizeof(int)))==NULL)
+      return(FALSE);
+
+   for(i=0; i<region->nEntries; i++)
+   {
+      GERMENTRY *entry = &(region->entries[i]);
+      char      locus[LOCUSLEN+1];
+
+      strncpy(locus, entry->gene, LOCUSLEN);
+      locus[LOCUSLEN] = '\0';
+
+      for(j=0; j<region->nParts; j++)
+      {
+         if(!strcmp(region->parts[j].species, entry->species) &&
+            !strcmp(region->parts[j].locus, locus))
+            break;
+      }
+
+      if(j == region->nParts)
+      {
+         if(region->nParts >= maxParts)
+         {
+            maxParts += ENTRYBLOCK;
+            if((region->parts =
+                (GERMPART *)realloc(region->parts,
+                                    maxParts * sizeof(GERMPART)))==NULL)
+            {
+               free(partNum);
+               return(FALSE);
+            }
+         }
+         region->parts[j].species  = entry->species;
+         strcpy(region->parts[j].locus, locus);
+         region->parts[j].nEntries = 0;
+         region->nParts++;
+      }
+
+      partNum[i] = j;
+      region->parts[j].nEntries++;
+   }
+
+   /* Work out where each partition starts and copy the entries there   */
+   if(((sorted = (GERMENTRY *)malloc(region->nEntries *
+                                     sizeof(GERMENTRY)))==NULL) ||
+      ((next   = (int *)malloc(region->nParts * sizeof(int)))==NULL))
+   {
+      free(sorted);
+      free(partNum);
+      return(FALSE);
+   }
+
+   for(j=0; j<region->nParts; j++)
+   {
+      region->parts[j].first = (j==0) ? 0 :
+         region->parts[j-1].first + region->parts[j-1].nEntries;
+      next[j] = region->parts[j].first;
+   }
+
+   for(i=0; i<region->nEntries; i++)
+      sorted[next[partNum[i]]++] = region->entries[i];
+
+   /* The species strings belong to the entries so point them at the
+      moved copies
+   */
+   for(j=0; j<region->nParts; j++)
+      region->parts[j].species = sorted[region->parts[j].first].species;
+
+   free(region->entries);
+   region->entries = sorted;
+   free(next);
+   free(partNum);
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL ClassifySeqs(GERMREGION *region)
+   --------------------------------------------
+*//**
+   \param[in,out] region   A loaded database type
+   \return                 Success
+
+   Collects entries with identical sequences into classes. Entries are
+   only put in the same class if they would also be aligned in the
+   same way (i.e. the region code, header[1], is the same). The unique
+   sequences are found with a hash table.
+
+   - 17.10.26 Original   By: ACRM
+*/
+static BOOL ClassifySeqs(GERMREGION *region)
+{
+   int *table,
+       tableSize = 1,
+       i;
+
+   region->nSeqs = 0;
+   if(region->nEntries == 0)
+      return(TRUE);
+
+   while(tableSize < 2 * region->nEntries)
+      tableSize *= 2;
+
+   if((table = (int *)malloc(tableSize * sizeof(int)))==NULL)
+      return(FALSE);
+   if((region->seqs = (GERMSEQ *)malloc(region->nEntries *
+                                        sizeof(GERMSEQ)))==NULL)
+   {
+      free(table);
+      return(FALSE);
+   }
+   for(i=0; i<tableSize; i++)
+      table[i] = (-1);
+
+   for(i=0; i<region->nEntries; i++)
+   {
+      GERMENTRY    *entry = &(region->entries[i]);
+      char         code   = entry->header[1];
+      unsigned int hash   = HASHSTART;
+      char         *chp;
+      int          slot;
+
+      for(chp=entry->seq; *chp; chp++)
+         hash = (hash ^ (unsigned char)*chp) * HASHMULT;
+      hash = (hash ^ (unsigned char)code) * HASHMULT;
+
+      /* Linear probing until we find the sequence or an empty slot     */
+      for(slot = hash & (tableSize-1);
+          table[slot] >= 0;
+          slot = (slot+1) & (tableSize-1))
+      {
+         GERMSEQ *seqClass = &(region->seqs[table[slot]]);
+         if((seqClass->regionCode == code)            &&
+            (seqClass->seqLen     == entry->seqLen)   &&
+            !strcmp(seqClass->seq, entry->seq))
+            break;
+      }
+
+      if(table[slot] < 0)
+      {
+         GERMSEQ *seqClass = &(region->seqs[region->nSeqs]);
+         seqClass->seq        = entry->seq;
+         seqClass->seqLen     = entry->seqLen;
+         seqClass->regionCode = code;
+         seqClass->nMembers   = 0;
+         table[slot]          = region->nSeqs++;
+      }
+
+      entry->seqClass = table[slot];
+      region->seqs[table[slot]].nMembers++;
+   }
+
+   free(table);
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static int KmerCodes(char *seq, int *codes)
+   -------------------------------------------
+*//**
+   \param[in]  seq     Amino acid sequence
+   \param[out] codes   Sorted list of the distinct k-mers in the
+                       sequence (must have space for strlen(seq))
+   \return             Number of distinct k-mers
+
+   Encodes each k-mer of upper case letters as a number between 0 and
+   NKMERS-1. K-mers containing anything else are skipped.
+
+   - 17.10.26 Original   By: ACRM
+*/
+static int KmerCodes(char *seq, int *codes)
+{
+   int nCodes = 0,
+       code   = 0,
+       run    = 0,
+       i, j;
+
+   for(i=0; seq[i]; i++)
+   {
+      if((seq[i] >= 'A') && (seq[i] <= 'Z'))
+      {
+         code = ((code * 26) + (seq[i] - 'A')) % NKMERS;
+         if(++run >= KMERLEN)
+            codes[nCodes++] = code;
+      }
+      else
+      {
+         code = run = 0;
+      }
+   }
+
+   /* Sort and remove duplicates                                        */
+   if(nCodes > 1)
+   {
+      qsort(codes, nCodes, sizeof(int), CompareInts);
+      for(i=1, j=0; i<nCodes; i++)
+      {
+         if(codes[i] != codes[j])
+            codes[++j] = codes[i];
+      }
+      nCodes = j+1;
+   }
+   return(nCodes);
+}
+
+
+/************************************************************************/
+/*>static int CompareInts(const void *a, const void *b)
+   ----------------------------------------------------
+*//**
+   qsort() comparison function for integers
+
+   - 17.10.26 Original   By: ACRM
+*/
+static int CompareInts(const void *a, const void *b)
+{
+   int ia = *(const int *)a,
+       ib = *(const int *)b;
+   return((ia > ib) - (ia < ib));
+}
+
+
+/************************************************************************/
+/*>static BOOL IndexKmers(GERMREGION *region)
+   ------------------------------------------
+*//**
+   \param[in,out] region   A loaded database type with its sequence
+                           classes
+   \return                 Success
+
+   Builds the inverted index from k-mers to the unique sequences that
+   contain them. The index is built in two passes: the first counts
+   the sequences for each k-mer and the second fills them in.
+
+   - 17.10.26 Original   By: ACRM
+*/
+static BOOL IndexKmers(GERMREGION *region)
+{
+   int *codes = NULL,
+       *next  = NULL,
+       maxLen = 0,
+       pass, i, j;
+
+   for(i=0; i<region->nSeqs; i++)
+      maxLen = MAX(maxLen, region->seqs[i].seqLen);
+
+   if(((codes = (int *)malloc((maxLen+1) * sizeof(int)))==NULL) ||
+      ((region->kmerStart = (int *)calloc(NKMERS+1, sizeof(int)))==NULL))
+   {
+      free(codes);
+      return(FALSE);
+   }
+
+   for(pass=0; pass<2; pass++)
+   {
+      if(pass == 1)
+      {
+         /* Turn the counts into start positions                        */
+         for(i=0; i<NKMERS; i++)
+            region->kmerStart[i+1] += region->kmerStart[i];
+         if(((region->kmerSeqs =
+              (int *)malloc(MAX(region->kmerStart[NKMERS], 1) *
+                            sizeof(int)))==NULL) ||
+            ((next = (int *)malloc(NKMERS * sizeof(int)))==NULL))
+         {
+            free(codes);
+            return(FALSE);
+         }
+         memcpy(next, region->kmerStart, NKMERS * sizeof(int));
+      }
+
+      for(i=0; i<region->nSeqs; i++)
+      {
+         int nCodes = KmerCodes(region->seqs[i].seq, codes);
+
+         for(j=0; j<nCodes; j++)
+         {
+            if(pass == 0)
+               region->kmerStart[codes[j]+1]++;
+            else
+               region->kmerSeqs[next[codes[j]]++] = i;
+         }
+      }
+   }
+
+   free(next);
+   free(codes);
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>int ShortlistSeqs(GERMREGION *region, GERMVIEW *view, char *seq,
+                     int shortList, BOOL *candidate)
+   ---------------------------------------------------------------
+*//**
+   \param[in]  region     A database type from GetGermRegion()
+   \param[in]  view       The entries of that type being searched
+   \param[in]  seq        The query sequence
+   \param[in]  shortList  Number of sequences to select (0 for all)
+   \param[out] candidate  One flag per unique sequence in the region,
+                          set if it should be aligned
+   \return                Number of sequences to be aligned
+
+   Counts the k-mers that each unique sequence used by the view shares
+   with the query and selects those with the highest counts. All
+   sequences with the same count as the last one selected are included,
+   so the shortlist may be longer than requested. Every sequence is
+   selected if shortList is 0, if the shortlist would be no shorter
+   than the list of sequences, or if the best sequence shares fewer
+   than MINSEEDS k-mers (e.g. D segments or a region missing from the
+   query) since the counts then say little.
+
+   - 17.10.26 Original   By: ACRM
+   - 18.10.26 Counting moved to CountSharedKmers()
+   - 18.10.26 Takes the shortlist size rather than the GERMDB so that
+              it can differ between requests to a server
+*/
+int ShortlistSeqs(GERMREGION *region, GERMVIEW *view, char *seq,
+                  int shortList, BOOL *candidate)
+{
+   int *counts = NULL,
+       *sorted = NULL,
+       nSeqs   = 0,
+       nCandidates = 0,
+       i, j;
+
+   /* Mark the sequences used by entries in the view                    */
+   for(i=0; i<region->nSeqs; i++)
+      candidate[i] = FALSE;
+   for(i=0; i<view->nEntries; i++)
+   {
+      if(!candidate[view->entries[i]->seqClass])
+      {
+         candidate[view->entries[i]->seqClass] = TRUE;
+         nSeqs++;
+      }
+   }
+
+   if((shortList > 0) && (nSeqs > shortList)                         &&
+      ((counts = (int *)calloc(region->nSeqs, sizeof(int)))!=NULL)     &&
+      ((sorted = (int *)malloc(region->nSeqs * sizeof(int)))!=NULL)    &&
+      CountSharedKmers(region, seq, counts))
+   {
+      /* Find the count for the last sequence on the shortlist          */
+      for(i=0, j=0; i<region->nSeqs; i++)
+      {
+         if(candidate[i])
+            sorted[j++] = counts[i];
+      }
+      qsort(sorted, nSeqs, sizeof(int), CompareInts);
+
+      if(sorted[nSeqs-1] >= MINSEEDS)
+      {
+         int minCount = sorted[nSeqs - shortList];
+
+         for(i=0; i<region->nSeqs; i++)
+         {
+            if(candidate[i] && (counts[i] < minCount))
+               candidate[i] = FALSE;
+            if(candidate[i])
+               nCandidates++;
+         }
+      }
+   }
+
+   free(counts);
+   free(sorted);
+
+   /* Exhaustive search                                                 */
+   return((nCandidates == 0) ? nSeqs : nCandidates);
+}
+
+
+/************************************************************************/
+/*>int MostSharedKmers(GERMREGION *region, GERMVIEW *view, char *seq)
+   -------------------------------------------------------------------
+*//**
+   \param[in]  region     A database type from GetGermRegion()
+   \param[in]  view       The entries of that type being searched
+   \param[in]  seq        The query sequence
+   \return                Most k-mers shared with the query by any
+                          sequence used by the view
+
+   A quick measure of how well the query could match anything in the
+   view, without aligning.
+
+   - 18.10.26 Original   By: ACRM
+*/
+int MostSharedKmers(GERMREGION *region, GERMVIEW *view, char *seq)
+{
+   int *counts,
+       most = 0,
+       i;
+
+   if((counts = (int *)calloc(MAX(region->nSeqs, 1), sizeof(int)))==NULL)
+      return(0);
+
+   if(CountSharedKmers(region, seq, counts))
+   {
+      for(i=0; i<view->nEntries; i++)
+         most = MAX(most, counts[view->entries[i]->seqClass]);
+   }
+
+   free(counts);
+   return(most);
+}
+
+
+/************************************************************************/
+/*>static BOOL CountSharedKmers(GERMREGION *region, char *seq,
+                                int *counts)
+   -------------------------------------------------------------
+*//**
+   \param[in]     region  A database type from GetGermRegion()
+   \param[in]     seq     The query sequence
+   \param[in,out] counts  One count per unique sequence in the region.
+                          The k-mers each shares with seq are added
+
+   \return                Success (FALSE if out of memory)
+
+   - 18.10.26 Original (code from ShortlistSeqs())   By: ACRM
+*/
+static BOOL CountSharedKmers(GERMREGION *region, char *seq, int *counts)
+{
+   int *codes,
+       nCodes,
+       i, j;
+
+   if((codes = (int *)malloc((strlen(seq)+1) * sizeof(int)))==NULL)
+      return(FALSE);
+
+   nCodes = KmerCodes(seq, codes);
+   for(i=0; i<nCodes; i++)
+   {
+      for(j=region->kmerStart[codes[i]];
+          j<region->kmerStart[codes[i]+1];
+          j++)
+      {
+         counts[region->kmerSeqs[j]]++;
+      }
+   }
+
+   free(codes);
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static GERMVIEW *MakeGermView(GERMREGION *region, char *species,
+                                 char *locus)
+   ----------------------------------------------------------------
+*//**
+   \param[in,out] region   A loaded database type
+   \param[in]     species  Species or blank for all species
+   \param[in]     locus    Locus or blank for all loci
+   \return                 New view linked into the region (or NULL)
+
+   Finds the partitions that match the species and locus and merges
+   their entries back into file order. The entries left out are
+   counted separately for the species and for the locus. The lock must
+   be held.
+
+   - 17.10.26 Original   By: ACRM
+   - 18.10.26 The complete view is linked in with a release store for
+              LookupGermView()
+   - 18.10.26 Counts the entries left out for the species and the locus
+*/
+static GERMVIEW *MakeGermView(GERMREGION *region, char *species,
+                              char *locus)
+{
+   GERMVIEW *view;
+   int      *pos   = NULL,
+            nMatch = 0,
+            i, j;
+
+   if((view = (GERMVIEW *)malloc(sizeof(GERMVIEW)))==NULL)
+      return(NULL);
+   strncpy(view->species, species, MAXBUFF);
+   view->species[MAXBUFF] = '\0';
+   strncpy(view->locus, locus, LOCUSLEN);
+   view->locus[LOCUSLEN] = '\0';
+   view->nEntries        = 0;
+   view->nSpeciesSkipped = 0;
+   view->nLocusSkipped   = 0;
+   view->entries         = NULL;
+
+   /* pos[j] is the next entry to take from partition j, or -1 if the
+      partition doesn't match
+   */
+   if(region->nParts &&
+      (pos = (int *)malloc(region->nParts * sizeof(int)))==NULL)
+   {
+      free(view);
+      return(NULL);
+   }
+
+   for(j=0; j<region->nParts; j++)
+   {
+      GERMPART *part = &(region->parts[j]);
+
+      pos[j] = -1;
+      if((species[0] != '\0') && (strstr(part->species, species)==NULL))
+      {
+         view->nSpeciesSkipped += part->nEntries;
+      }
+      else if((locus[0] != '\0') && strcmp(part->locus, locus))
+      {
+         view->nLocusSkipped += part->nEntries;
+      }
+      else
+      {
+         pos[j] = part->first;
+         nMatch += part->nEntries;
+      }
+   }
+
+   if(nMatch &&
+      (view->entries = (GERMENTRY **)malloc(nMatch *
+                                            sizeof(GERMENTRY *)))==NULL)
+   {
+      free(pos);
+      free(view);
+      return(NULL);
+   }
+
+   /* Merge the partitions, taking the lowest file position each time  */
+   for(i=0; i<nMatch; i++)
+   {
+      int best = -1;
+
+      for(j=0; j<region->nParts; j++)
+      {
+         if((pos[j] >= 0) &&
+            ((best < 0) ||
+             (region->entries[pos[j]].order <
+              region->entries[pos[best]].order)))
+         {
+            best = j;
+         }
+      }
+
+      view->entries[view->nEntries++] = &(region->entries[pos[best]]);
+      if(++pos[best] == region->parts[best].first +
+                        region->parts[best].nEntries)
+         pos[best] = -1;
+   }
+
+   free(pos);
+   view->next = region->views;
+   __atomic_store_n(&(region->views), view, __ATOMIC_RELEASE);
+   return(view);
+}
+
+
+/************************************************************************/
+/*>static BOOL LoadGermRegion(GERMDB *germDB, GERMREGION *region)
+   --------------------------------------------------------------
+*//**
+   \param[in]     germDB   The germline database
+   \param[in,out] region   The database type to be read
+   \return                 Success
+
+   Reads all the entries for a database type from its .dat file
+
+   - 17.10.26 Original (file reading from ScanAgainstDB())  By: ACRM
+   - 18.10.26 The filename is made by DataFilename()
+*/
+static BOOL LoadGermRegion(GERMDB *germDB, GERMREGION *region)
+{
+   char filename[MAXBUFF+1];
+   BOOL noEnv;
+   FILE *dbFp = NULL;
+   int  maxEntries = 0;
+
+   if(!DataFilename(germDB, region->type, ".dat", filename))
+      return(FALSE);
+
+   if((dbFp = blOpenFile(filename, AGLDATADIR, "r", &noEnv))!=NULL)
+   {
+      char header[MAXBUFF+1];
+      char *seq = NULL;
+      char fastaBuffer[MAXBUFF+1];
+
+      fastaBuffer[0] = '\0';
+
+      while((seq = blReadFASTAExtBuffer(dbFp, header, MAXBUFF,
+                                        fastaBuffer, MAXBUFF))!=NULL)
+      {
+         GERMENTRY *entry;
+
+         if(region->nEntries >= maxEntries)
+         {
+            maxEntries += ENTRYBLOCK;
+            if((region->entries =
+                (GERMENTRY *)realloc(region->entries,
+                                     maxEntries * sizeof(GERMENTRY)))
+               == NULL)
+            {
+               fprintf(stderr, "\nError (agl): No memory for %s \
+database\n", region->type);
+               FCLOSE(dbFp);
+               return(FALSE);
+            }
+         }
+
+         entry         = &(region->entries[region->nEntries]);
+         entry->header = strdup(header);
+         entry->seq    = seq;
+         entry->seqLen = strlen(seq);
+         entry->order  = region->nEntries++;
+         SplitHeader(entry);
+         RankGene(entry->gene, &(entry->rank));
+      }
+      FCLOSE(dbFp);
+   }
+   else
+   {
+      fprintf(stderr, "\nError (agl): Unable to open data file (%s)\n",
+              filename);
+      if(noEnv)
+      {
+         fprintf(stderr, "   Set the environment variable '%s' to the \
+location of the processed sequence files.\n",
+                 AGLDATADIR);
+      }
+      fprintf(stderr, "\n");
+
+      return(FALSE);
+   }
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL DataFilename(GERMDB *germDB, char *name, char *ext,
+                            char *filename)
+   ---------------------------------------------------------------
+*//**
+   \param[in]  germDB    The germline database
+   \param[in]  name      Name of the data file
+   \param[in]  ext       Extension to add (or blank)
+   \param[out] filename  The file with the data prefix (MAXBUFF+1
+                         chars)
+   \return               Success (FALSE if the path is too long)
+
+   Makes the path to a data file from the data prefix. A path that
+   would not fit is reported rather than being cut short, since the
+   shortened path could name a different file.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static BOOL DataFilename(GERMDB *germDB, char *name, char *ext,
+                         char *filename)
+{
+   if(snprintf(filename, MAXBUFF, "%s%s%s", germDB->dataPrefix, name,
+               ext) >= MAXBUFF)
+   {
+      fprintf(stderr, "\nError (agl): Path to data file is too long \
+(%s%s%s)\n", germDB->dataPrefix, name, ext);
+      return(FALSE);
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static void SplitHeader(GERMENTRY *entry)
+   -----------------------------------------
+*//**
+   \param[in,out] entry   Database entry
+
+   Splits a header of the form >REGION_GENE_FRAME_SPECIES into its
+   fields. The fields are stored in a single buffer which starts with
+   the region. Missing fields are left blank.
+
+   - 17.10.26 Original   By: ACRM
+*/
+static void SplitHeader(GERMENTRY *entry)
+{
+   char *fields[4],
+        *buffer,
+        *chp;
+   int  i;
+
+   if((buffer = strdup((entry->header[0] == '>') ?
+                       entry->header+1 : entry->header))==NULL)
+   {
+      fprintf(stderr, "\nError (agl): No memory for database entry\n");
+      exit(1);
+   }
+
+   fields[0] = chp = buffer;
+   for(i=1; i<4; i++)
+   {
+      if((chp != NULL) && ((chp = strchr(chp, '_'))!=NULL))
+      {
+         *(chp++) = '\0';
+         fields[i] = chp;
+      }
+      else
+      {
+         fields[i] = buffer + strlen(buffer);
+      }
+   }
+
+   entry->region  = fields[0];
+   entry->gene    = fields[1];
+   entry->frame   = fields[2];
+   entry->species = fields[3];
+}
+
+
+/************************************************************************/
+/*>static void RankGene(char *gene, GENERANK *rank)
+   ------------------------------------------------
+*//**
+   \param[in]  gene   IMGT gene name (e.g. IGHV3-48*02)
+   \param[out] rank   The parsed fields used to break ties
+
+   Parses a gene name with FindFields() and keeps the numeric values
+   used by PreferEntry(). This is done once as each entry is loaded
+   rather than twice for every tied score.
+
+   - 17.10.26 Original (parsing from PreferHeader())   By: ACRM
+*/
+static void RankGene(char *gene, GENERANK *rank)
+{
+   char id[SMALLBUFF+1],
+        class[SMALLBUFF],
+        subclass[SMALLBUFF],
+        family[SMALLBUFF],
+        distal[SMALLBUFF];
+
+   /* Truncate in the same way as GetDomainID() used to                 */
+   strncpy(id, gene, SMALLBUFF);
+   id[SMALLBUFF] = '\0';
+
+   FindFields(id, class, subclass, family, &(rank->allele), distal);
+   rank->subclass = atoi(subclass);
+   rank->family   = atoi(family);
+   rank->distal   = (distal[0] != '\0');
+}
+
+
+/************************************************************************/
+/*>unsigned long HashGermDB(GERMDB *germDB, char **types, int nTypes)
+   ------------------------------------------------------------------
+*//**
+   \param[in]  germDB   The germline database
+   \param[in]  types    Database types used
+   \param[in]  nTypes   Number of types
+   \return              Hash of the data
+
+   Hashes the contents of the binary database (if mapped) and of the
+   .dat file for each type, so the hash changes whenever makedb.pl,
+   makebindb.pl or an edit to a static file such as hinges.dat changes
+   the data. The files are read directly rather than loaded.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 The filename is made by DataFilename()
+*/
+unsigned long HashGermDB(GERMDB *germDB, char **types, int nTypes)
+{
+   unsigned long hash = HashBytes(HASH_INIT, "agl", 3);
+   int           i;
+
+   if(germDB->mapAddr != NULL)
+      hash = HashBytes(hash, germDB->mapAddr, germDB->mapSize);
+
+   for(i=0; i<nTypes; i++)
+   {
+      char   filename[MAXBUFF+1],
+             buffer[HUGEBUFF];
+      size_t nRead;
+      BOOL   noEnv;
+      FILE   *fp;
+
+      hash = HashBytes(hash, types[i], strlen(types[i])+1);
+
+      if(DataFilename(germDB, types[i], ".dat", filename) &&
+         ((fp = blOpenFile(filename, AGLDATADIR, "r", &noEnv))!=NULL))
+      {
+         while((nRead = fread(buffer, 1, HUGEBUFF, fp)) > 0)
+            hash = HashBytes(hash, buffer, nRead);
+         FCLOSE(fp);
+      }
+   }
+
+   return(hash);
+}
+
+
+/************************************************************************/
+/*>void FreeGermDB(GERMDB *germDB)
+   -------------------------------
+*//**
+   \param[in]  germDB   The germline database
+
+   Frees all memory used by the germline database
+
+   - 17.10.26 Original   By: ACRM
+   - 17.10.26 Unmaps the binary database
+   - 18.10.26 Destroys the lock
+*/
+void FreeGermDB(GERMDB *germDB)
+{
+   int i, j;
+
+   if(germDB == NULL)
+      return;
+
+   for(i=0; i<germDB->nRegions; i++)
+   {
+      GERMREGION *region = &(germDB->regions[i]);
+      if(!region->mapped)
+      {
+         for(j=0; j<region->nEntries; j++)
+         {
+            free(region->entries[j].header);
+            free(region->entries[j].seq);
+            free(region->entries[j].region);  /* The split fields      */
+         }
+      }
+      while(region->views != NULL)
+      {
+         GERMVIEW *view = region->views;
+         region->views  = view->next;
+         free(view->entries);
+         free(view);
+      }
+      free(region->seqs);
+      free(region->kmerStart);
+      free(region->kmerSeqs);
+      free(region->parts);
+      free(region->entries);
+   }
+
+   if(germDB->mapAddr != NULL)
+      munmap(germDB->mapAddr, germDB->mapSize);
+
+   pthread_mutex_destroy(&(germDB->lock));
+   free(germDB);
+}
+
+
+#ifdef USEPATH
+/************************************************************************/
+static char *FindPath(void)
+{
+  char *path = NULL;
+  int  length, dirnameLength;
+
+  if((length = wai_getExecutablePath(NULL, 0, &dirnameLength)) > 0)
+  {
+     if((path = (char*)malloc(length + 1))==NULL)
+        return(NULL);
+
+    wai_getExecutablePath(path, length, &dirnameLength);
+    path[dirnameLength] = '\0';
+    return(path);
+  }
+
+  return(NULL);
+}
+
+/************************************************************************/
+static BOOL DirectoryExists(char *dirName)
+{
+
+   DIR* dir = opendir(dirName);
+   if (dir)
+   {
+      /* Directory exists. */
+      closedir(dir);
+      return(TRUE);
+   }
+
+   return(FALSE);
+}
+#endif
+
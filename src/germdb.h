@@ -0,0 +1,188 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       germdb.h
+
+   \version    V1.14
+   \date       18.10.26
+   \brief      In-memory germline database
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   17.10.26  Original
+   V1.1   17.10.26  Added support for the binary database
+   V1.2   17.10.26  Gene names are parsed once when the entries are loaded
+   V1.3   17.10.26  Entries are partitioned by species and locus
+   V1.4   17.10.26  Identical sequences are collected into GERMSEQ classes
+   V1.5   17.10.26  Added the k-mer index
+   V1.6   18.10.26  Added GERMBLOCKs of sequences for lane-parallel
+                    scoring
+   V1.7   18.10.26  Added a lock so the database can be shared between
+                    threads
+   V1.8   18.10.26  Added HashGermDB()
+   V1.9   18.10.26  Added MostSharedKmers()
+   V1.10  18.10.26  loaded is only set once a region is complete
+   V1.11  18.10.26  DEF_SHORTLIST is 0 so every sequence is aligned by
+                    default
+   V1.12  18.10.26  Removed the GERMBLOCKs
+   V1.13  18.10.26  The shortlist size is passed to ShortlistSeqs() rather
+                    than kept in the GERMDB
+   V1.14  18.10.26  A GERMVIEW counts the entries left out for the species
+                    and for the locus
+
+*************************************************************************/
+#ifndef _GERMDB_H
+#define _GERMDB_H
+
+/************************************************************************/
+/* Includes
+*/
+#include <stddef.h>
+#include <pthread.h>
+#include "bioplib/SysDefs.h"
+#include "agl.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define MAXREGIONS 32           /* Max number of database types         */
+#define GERMDB_FILE "germline.db" /* Compiled binary database           */
+#define LOCUSLEN   3            /* Locus is the start of the gene name  */
+#define KMERLEN    3            /* Length of k-mer seeds                */
+#define NKMERS     (26*26*26)   /* Number of possible k-mers (A-Z)      */
+#define MINSEEDS   5            /* Don't shortlist unless the best hit
+                                   shares at least this many k-mers     */
+#define DEF_SHORTLIST 0         /* Default number of sequences aligned
+                                   (0 = all)                            */
+
+/************************************************************************/
+/* Type definitions
+*/
+typedef struct
+{
+   int  subclass,               /* Numeric subclass (0 if not numeric)  */
+        family,                 /* Numeric family (0 if not numeric)    */
+        allele;                 /* Allele number                        */
+   BOOL distal;                 /* Distal copy of the gene              */
+}  GENERANK;
+
+typedef struct
+{
+   char *header,                /* FASTA header (including the >)       */
+        *seq,                   /* Translated germline sequence         */
+        *region,                /* Fields split from the header         */
+        *gene,
+        *frame,
+        *species;
+   int      seqLen,
+            order,              /* Position in the original data file   */
+            seqClass;           /* Index into the region's GERMSEQs     */
+   GENERANK rank;               /* Parsed gene name for breaking ties   */
+}  GERMENTRY;
+
+typedef struct
+{
+   char *seq;                   /* Sequence shared by a set of entries  */
+   int  seqLen,
+        nMembers;               /* Number of entries with this sequence */
+   char regionCode;             /* header[1] - controls the alignment   */
+}  GERMSEQ;
+
+typedef struct
+{
+   char *species;               /* Species for this partition           */
+   char locus[LOCUSLEN+1];      /* Locus (e.g. IGK, IGL, IGH)           */
+   int  first,                  /* First entry and number of entries    */
+        nEntries;
+}  GERMPART;
+
+typedef struct _germview
+{
+   struct _germview *next;
+   char      species[MAXBUFF+1]; /* Species and locus requested         */
+   char      locus[LOCUSLEN+1];
+   GERMENTRY **entries;         /* Matching entries in file order       */
+   int       nEntries,
+             nSpeciesSkipped,   /* Entries not of the species           */
+             nLocusSkipped;     /* Entries of the species but not the
+                                   locus                                */
+}  GERMVIEW;
+
+typedef struct
+{
+   char      type[SMALLBUFF+1]; /* Database type (e.g. heavy_v)         */
+   GERMENTRY *entries;          /* Entries grouped by partition         */
+   GERMPART  *parts;            /* Species/locus partitions             */
+   GERMVIEW  *views;            /* Species/locus selections made so far */
+   GERMSEQ   *seqs;             /* Unique sequences                     */
+   int       *kmerStart,        /* Index of k-mers to sequences: the    */
+             *kmerSeqs;         /* sequences for k-mer i are kmerSeqs
+                                   kmerStart[i] to kmerStart[i+1]-1     */
+   int       nEntries,
+             nParts,
+             nSeqs;
+   BOOL      loaded,            /* Set once everything above is built   */
+             mapped;            /* Strings are in the mapped binary DB  */
+}  GERMREGION;
+
+typedef struct
+{
+   char       dataPrefix[MAXBUFF+1]; /* Directory prefix for data files */
+   GERMREGION regions[MAXREGIONS];
+   int        nRegions;
+   char       *mapAddr;         /* Memory-mapped binary database        */
+   size_t     mapSize;
+   pthread_mutex_t lock;        /* Held while loading regions and views */
+}  GERMDB;
+
+/************************************************************************/
+/* Prototypes
+*/
+GERMDB *InitGermDB(char *dataDir);
+GERMREGION *GetGermRegion(GERMDB *germDB, char *type);
+GERMVIEW *GetGermView(GERMDB *germDB, char *type, char *species,
+                      char *locus);
+void FreeGermDB(GERMDB *germDB);
+int ShortlistSeqs(GERMREGION *region, GERMVIEW *view, char *seq,
+                  int shortList, BOOL *candidate);
+int MostSharedKmers(GERMREGION *region, GERMVIEW *view, char *seq);
+unsigned long HashGermDB(GERMDB *germDB, char **types, int nTypes);
+
+#endif
@@ -0,0 +1,2675 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       libagl.c
+
+   \version    V1.22
+   \date       18.10.26
+   \brief      Library code for assigning IMGT germlines
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2020-26
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+   The germline assignment code from agl.c, built into libagl so that
+   other programs can assign germlines without running agl and parsing
+   its output.
+
+   InitAGL() creates an AGLCONTEXT holding the germline database and
+   the options. AssignGermlines() then fills in an AGLRESULT for each
+   sequence. All the working storage is on the stack, allocated to fit
+   the sequence or thread-local in align.c, and the database is loaded
+   under its own lock, so any number of threads may call
+   AssignGermlines() with the same context. The alignments in the
+   result are allocated so there is no limit on the length of a
+   sequence; FreeAGLResult() frees them.
+
+   If SetAGLCache() has been called, each result is also stored, in a
+   simple text form, under a key made from the sequence and the options
+   that affect the result, so a repeated sequence is not aligned again.
+   SetAGLCacheDir() also keeps the results on disk, tied to a hash of
+   the germline data, so later runs can use them.
+
+   The database scans for a sequence are SCANJOBs run as a graph of
+   tasks (see taskpool.c). A scan that needs the end of an earlier
+   domain waits for it; the others may run at the same time if
+   SetAGLThreads() has given the context a thread pool.
+
+**************************************************************************
+
+   Usage:
+   ======
+   See libagl.h
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original - code moved from agl.c V1.16
+   V1.1   18.10.26  Added LoadAGL()
+   V1.2   18.10.26  Added the result cache so that repeated sequences
+                    are only assigned once
+   V1.3   18.10.26  Added SetAGLCacheDir() to keep results on disk
+   V1.4   18.10.26  ScanAgainstDB() skips sequences whose best possible
+                    score couldn't make them the best hit
+   V1.5   18.10.26  ScanAgainstDB() only scores the sequences and
+                    aligns just the best hit
+   V1.6   18.10.26  J, C and hinge regions are only searched for where
+                    the domains already found leave room for them
+   V1.7   18.10.26  The chain type is guessed from shared k-mers so
+                    that usually only one set of V regions is searched
+   V1.8   18.10.26  The scans for a sequence are run as a graph of
+                    tasks, on a thread pool if SetAGLThreads() has been
+                    called. The constant domains are all searched for
+                    after J so they can run together
+   V1.9   18.10.26  The alignments are allocated to fit the sequence
+                    rather than being limited to HUGEBUFF. Added
+                    FreeAGLResult()
+   V1.10  18.10.26  Added GetAGLGermlines()
+   V1.11  18.10.26  ScanAgainstDB() is timed for --stats
+   V1.12  18.10.26  ScanAgainstDB() counts the entries it visits and
+                    skips, and the ties, for --stats
+   V1.13  18.10.26  The chain typing, D-segment and each ScanAgainstDB()
+                    are traced for --trace
+   V1.14  18.10.26  Light chain J and C regions are searched for in the
+                    locus of the V region
+   V1.15  18.10.26  Sequences are normalised whether or not there is a
+                    result cache. The cache key is allocated to fit a
+                    long species
+   V1.16  18.10.26  ScanAgainstDB() no longer skips sequences on a bound
+                    for their score
+   V1.17  18.10.26  Light chain J and C regions are searched for in all
+                    loci again
+   V1.18  18.10.26  The whole sequence is searched for every region
+                    unless a slack is set
+   V1.19  18.10.26  ScanAgainstDB() skips sequences that can't beat a
+                    perfect best hit. Sequences are scored in blocks in
+                    file order as they are needed
+   V1.20  18.10.26  ScoreBlock() builds with CHECK_ALIGN again
+   V1.21  18.10.26  The shortlist size is kept in the context so it can
+                    be changed for each request to a server
+   V1.22  18.10.26  --stats counts the entries skipped for the locus
+                    apart from those skipped for the species
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "bioplib/seq.h"
+#include "bioplib/sequtil.h"
+#include "bioplib/general.h"
+#include "bioplib/macros.h"
+#include "agl.h"
+#include "germdb.h"
+#include "align.h"
+#include "taskpool.h"
+#include "stats.h"
+#include "trace.h"
+#include "libagl.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define BLOCK_UNDEFINED 0
+#define BLOCK_X_V       1
+#define BLOCK_D         2
+#define NCHARS          256     /* Possible residue characters          */
+
+/* Scans done by AssignSeq()                                            */
+#define SCAN_LV         0
+#define SCAN_LJ         1
+#define SCAN_LC         2
+#define SCAN_HV         3
+#define SCAN_HJ         4
+#define SCAN_HD         5
+#define SCAN_CH1        6
+#define SCAN_HINGE      7
+#define SCAN_CH2        8
+#define SCAN_CH3        9
+#define NSCANS          10
+#define GUESSMINKMERS   20      /* K-mers the chain type guessed must
+                                   share with a V sequence...           */
+#define GUESSRATIO      2       /* ...and this many times as many as the
+                                   other chain type                     */
+
+/************************************************************************/
+/* Type definitions
+*/
+typedef struct
+{
+   REAL score;
+   int  dbLen;
+   BOOL done;
+}  SEQSCORE;
+
+/* A database scan for one domain, run as a task. The query interval
+   searched comes from the domains found by the scans it refers to,
+   which must have finished first
+*/
+typedef struct _scanjob
+{
+   AGLCONTEXT      *context;
+   char            *type,       /* Database type                        */
+                   *seq,        /* The whole sequence (not changed)     */
+                   match[MAXBUFF+1],
+                   *align1,     /* Allocated when the scan is run       */
+                   *align2;
+   struct _scanjob *found,      /* Only scan if this domain was found   */
+                   *matched[2], /* Only scan if these found any match   */
+                   *after[2],   /* Start after the first of these found */
+                   *upTo;       /* Stop at the end of this if found     */
+   TASK            *task;       /* Task in the graph being run (or NULL
+                                   if not in it)                        */
+   REAL            score,       /* -1.0 if not scanned                  */
+                   threshold;   /* Score for the domain to be found     */
+   int             end,         /* End of the domain in the sequence
+                                   (-1 if not found)                    */
+                   offset;      /* Offset of the sequence scanned (D)   */
+   TASKFUNC        func;        /* DoScan() or DoDSegment()             */
+   long            traceSeq;    /* Sequence number for --trace (-1 if
+                                   not traced)                          */
+   BOOL            done;
+}  SCANJOB;
+
+/************************************************************************/
+/* Globals
+*/
+/* All the database types searched by AssignGermlines()                 */
+static char *sDBTypes[] =
+{
+   "light_v", "light_j", "light_c",
+   "heavy_v", "heavy_d", "heavy_j",
+   "CH1", "hinges", "CH2", "CH3-CHS"
+};
+
+/************************************************************************/
+/* Prototypes
+*/
+BOOL AssignSeq(AGLCONTEXT *context, char *inSeq, AGLRESULT *result);
+char *MakeCacheKey(AGLCONTEXT *context, char *seq, char **normSeq);
+void NormaliseSeq(char *out, char *seq);
+char *SerialiseResult(AGLRESULT *result);
+BOOL ParseResult(char *text, AGLRESULT *result);
+char *NextField(char **text);
+REAL ScanAgainstDB(char *type, char *seq, BOOL verbose, char *species,
+                   char *match, char *bestAlign1, char *bestAlign2,
+                   GERMDB *germDB, int shortList);
+REAL ScanRegion(char *type, char *seq, int start, int stop, int slack,
+                BOOL verbose, char *species, char *match,
+                char *bestAlign1, char *bestAlign2, GERMDB *germDB,
+                int shortList);
+int AlignedQueryEnd(char *align1, char *align2);
+int LongestGermSeq(GERMREGION *region);
+char *AllocAlignment(size_t size);
+char *CopyAlignment(char *align);
+int GuessChainType(char *seq, char *species, GERMDB *germDB,
+                   BOOL verbose);
+REAL CompareSeqs(char *theSeq, char *seq, int window,
+                 char *align1, char *align2, BOOL noScale);
+REAL CompareEntry(char *theSeq, GERMENTRY *entry,
+                  char *align1, char *align2);
+REAL ScoreEntry(char *theSeq, GERMENTRY *entry, int *dbLen);
+void AlignSettings(char regionCode, int *window, BOOL *noScale);
+void ScoreNextSeqs(char *theSeq, GERMREGION *region, GERMVIEW *view,
+                   int entryNum, BOOL *candidate, SEQSCORE *seqScores,
+                   GERMENTRY *bestEntry, REAL maxScore, int maxDbLen);
+BOOL ScoreBlock(char *theSeq, unsigned char *residues, int *seqs,
+                int *lengths, int maxLen, char regionCode,
+                SEQSCORE *seqScores);
+BOOL PreferEntry(GENERANK *newRank, GENERANK *oldRank);
+BOOL BetterHit(REAL score, int dbLen, REAL maxScore, int maxDbLen);
+BOOL CantBeatHit(char *theSeq, GERMENTRY *entry, GERMENTRY *bestEntry,
+                 REAL maxScore, int maxDbLen);
+void RemoveSequence(char *seq, char *align1, char *align2, BOOL verbose);
+int CalculateDbLen(char *seq);
+int CalcShortSeqLen(char *align1, char *align2);
+void AddDomain(AGLRESULT *result, char *domain, REAL score, char *match,
+               char *align1, char *align2, int offset);
+void InitScanJob(SCANJOB *job, AGLCONTEXT *context, char *type,
+                 char *seq, REAL threshold);
+void AllocScanAlignments(SCANJOB *job, int seqLen, char *type);
+void RunScanJobs(AGLCONTEXT *context, SCANJOB **jobs, int nJobs);
+void DoScan(void *arg);
+void DoDSegment(void *arg);
+int CopyDSegment(char *DSeq, char *seq);
+BOOL FindSpecialMatch(char *special, char *CH1, char *CH2, char *CH3);
+
+
+/************************************************************************/
+/*>AGLCONTEXT *InitAGL(char *dataDir, char *species, int chainType,
+                       BOOL doDSegment, int shortList, BOOL verbose)
+   -----------------------------------------------------------------
+*//**
+   \param[in]  dataDir     Data directory (or blank to search for it)
+   \param[in]  species     "Homo", "Mus" or blank
+   \param[in]  chainType   CHAINTYPE_LIGHT, _HEAVY or _UNKNOWN
+   \param[in]  doDSegment  Find the D segment of heavy chains
+   \param[in]  shortList   Number of germline sequences to align (0 for
+                           all)
+   \param[in]  verbose     Verbose output to stderr
+   \return                 Allocated context (or NULL)
+
+   Creates a context for AssignGermlines(). The germline databases are
+   read as they are first needed and then kept for the life of the
+   context.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 The shortlist size is kept in the context rather than the
+              germline database
+*/
+AGLCONTEXT *InitAGL(char *dataDir, char *species, int chainType,
+                    BOOL doDSegment, int shortList, BOOL verbose)
+{
+   AGLCONTEXT *context;
+
+   if((context = (AGLCONTEXT *)calloc(1, sizeof(AGLCONTEXT)))==NULL)
+      return(NULL);
+
+   if((context->germDB = InitGermDB(dataDir))==NULL)
+   {
+      free(context);
+      return(NULL);
+   }
+   strncpy(context->species, species, MAXBUFF);
+   context->chainType  = chainType;
+   context->shortList  = shortList;
+   context->slack      = DEF_SLACK;
+   context->doDSegment = doDSegment;
+   context->verbose    = verbose;
+
+   return(context);
+}
+
+
+/************************************************************************/
+/*>void FreeAGL(AGLCONTEXT *context)
+   ---------------------------------
+*//**
+   \param[in]  context   Context from InitAGL()
+
+   Frees the context, its germline database, its result cache and its
+   thread pool. No thread may still be using it.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Frees the result cache
+   - 18.10.26 Frees the thread pool
+*/
+void FreeAGL(AGLCONTEXT *context)
+{
+   if(context == NULL)
+      return;
+
+   FreeTaskPool(context->pool);
+   FreeResultCache(context->cache);
+   FreeGermDB(context->germDB);
+   free(context);
+}
+
+
+/************************************************************************/
+/*>void LoadAGL(AGLCONTEXT *context)
+   ---------------------------------
+*//**
+   \param[in]  context   Context from InitAGL()
+
+   Loads all the germline databases, and the species selections for
+   the context, now rather than when the first sequence needs them.
+   Used by servers so that the first request isn't slow.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void LoadAGL(AGLCONTEXT *context)
+{
+   int i;
+
+   for(i=0; i<sizeof(sDBTypes)/sizeof(sDBTypes[0]); i++)
+      GetGermView(context->germDB, sDBTypes[i], context->species, "");
+}
+
+
+/************************************************************************/
+/*>char **GetAGLGermlines(AGLCONTEXT *context, int *nGermlines)
+   ------------------------------------------------------------
+*//**
+   \param[in]  context      Context from InitAGL()
+   \param[out] nGermlines   Number of germline sequences
+   \return                  Their FASTA headers, as given in the match
+                            of an AGLDOMAIN (or NULL if no memory)
+
+   Lists every germline sequence that AssignGermlines() may match, for
+   all species, loading the databases if need be. The headers belong
+   to the context; only the array must be freed.
+
+   - 18.10.26 Original   By: ACRM
+*/
+char **GetAGLGermlines(AGLCONTEXT *context, int *nGermlines)
+{
+   GERMREGION *regions[sizeof(sDBTypes)/sizeof(sDBTypes[0])];
+   char       **headers;
+   int        nTypes = sizeof(sDBTypes)/sizeof(sDBTypes[0]),
+              i, j;
+
+   *nGermlines = 0;
+   for(i=0; i<nTypes; i++)
+   {
+      regions[i]   = GetGermRegion(context->germDB, sDBTypes[i]);
+      *nGermlines += regions[i]->nEntries;
+   }
+
+   if((headers = (char **)malloc(MAX(*nGermlines, 1) *
+                                 sizeof(char *)))==NULL)
+      return(NULL);
+
+   *nGermlines = 0;
+   for(i=0; i<nTypes; i++)
+   {
+      for(j=0; j<regions[i]->nEntries; j++)
+         headers[(*nGermlines)++] = regions[i]->entries[j].header;
+   }
+   return(headers);
+}
+
+
+/************************************************************************/
+/*>BOOL SetAGLCache(AGLCONTEXT *context, long maxEntries)
+   ------------------------------------------------------
+*//**
+   \param[in,out] context     Context from InitAGL()
+   \param[in]     maxEntries  Most results to keep (0 for no cache)
+   \return                    Success
+
+   Makes AssignGermlines() keep the results for up to maxEntries
+   distinct sequences, dropping the least recently used, so a sequence
+   that appears again is not re-aligned. Sequences are looked up in the
+   form in which AssignGermlines() assigns them (upper-cased with white
+   space removed), so the cache doesn't change the results. The
+   cache is shared by all the threads using the context and by copies
+   of the context with different options.
+
+   - 18.10.26 Original   By: ACRM
+*/
+BOOL SetAGLCache(AGLCONTEXT *context, long maxEntries)
+{
+   FreeResultCache(context->cache);
+   context->cache = NULL;
+
+   if(maxEntries > 0)
+   {
+      if((context->cache = CreateResultCache(maxEntries))==NULL)
+         return(FALSE);
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>BOOL SetAGLCacheDir(AGLCONTEXT *context, char *cacheDir)
+   --------------------------------------------------------
+*//**
+   \param[in,out] context    Context from InitAGL()
+   \param[in]     cacheDir   Directory for results kept between runs
+   \return                   Success
+
+   Makes AssignGermlines() keep its results in cacheDir as well as in
+   memory, and look there for sequences it hasn't seen in this run.
+   The results are stored under a hash of the germline data files, so
+   they are ignored if makedb.pl is rerun or hinges.dat is edited.
+   Call after SetAGLCache(), if that is used.
+
+   - 18.10.26 Original   By: ACRM
+*/
+BOOL SetAGLCacheDir(AGLCONTEXT *context, char *cacheDir)
+{
+   char version[SMALLBUFF+1];
+
+   if((context->cache == NULL) &&
+      ((context->cache = CreateResultCache(0))==NULL))
+      return(FALSE);
+
+   snprintf(version, SMALLBUFF, "%016lx",
+            HashGermDB(context->germDB, sDBTypes,
+                       sizeof(sDBTypes)/sizeof(sDBTypes[0])));
+   return(SetResultCacheDir(context->cache, cacheDir, version));
+}
+
+
+/************************************************************************/
+/*>void SetAGLSlack(AGLCONTEXT *context, int slack)
+   ------------------------------------------------
+*//**
+   \param[in,out] context   Context from InitAGL()
+   \param[in]     slack     Residues to search either side of where a
+                            domain can be (-1 to search the whole
+                            sequence)
+
+   The J region is only looked for after the end of V, the constant
+   domains after J (or V) and the hinge between the ends of CH1 and
+   CH2. This sets how far outside those regions to look. Cutting the
+   sequence short can change the scores, so by default (DEF_SLACK) the
+   whole sequence is searched. Call before any sequences are assigned.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 The default searches the whole sequence
+*/
+void SetAGLSlack(AGLCONTEXT *context, int slack)
+{
+   context->slack = (slack < 0) ? -1 : slack;
+}
+
+
+/************************************************************************/
+/*>BOOL SetAGLThreads(AGLCONTEXT *context, int nThreads)
+   -----------------------------------------------------
+*//**
+   \param[in,out] context    Context from InitAGL()
+   \param[in]     nThreads   Threads to run the scans for a sequence
+                             (0 or 1 for none)
+   \return                   Success
+
+   Creates a pool of threads so that the database scans for a sequence
+   that don't depend on each other (e.g. VH and the constant domains)
+   are run at the same time. This cuts the time taken to assign one
+   sequence, but not the total work. The pool is shared by all the
+   threads calling AssignGermlines(). Call before any sequences are
+   assigned.
+
+   - 18.10.26 Original   By: ACRM
+*/
+BOOL SetAGLThreads(AGLCONTEXT *context, int nThreads)
+{
+   if(nThreads <= 1)
+      return(TRUE);
+
+   return((context->pool = CreateTaskPool(nThreads, FreeAlignWork))
+          != NULL);
+}
+
+
+/************************************************************************/
+/*>void GetAGLCacheStats(AGLCONTEXT *context, long *nSeqs, long *nHits,
+                         long *nDiskHits)
+   --------------------------------------------------------------------
+*//**
+   \param[in]  context     Context from InitAGL()
+   \param[out] nSeqs       Sequences assigned since the cache was set up
+   \param[out] nHits       How many of those were found in memory
+   \param[out] nDiskHits   How many of those were found on disk
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Added nDiskHits
+*/
+void GetAGLCacheStats(AGLCONTEXT *context, long *nSeqs, long *nHits,
+                      long *nDiskHits)
+{
+   *nSeqs = *nHits = *nDiskHits = 0;
+   if(context->cache != NULL)
+      GetResultCacheStats(context->cache, nSeqs, nHits, nDiskHits);
+}
+
+
+/************************************************************************/
+/*>BOOL AssignGermlines(AGLCONTEXT *context, char *inSeq,
+                        AGLRESULT *result)
+   -----------------------------------------------------
+*//**
+   \param[in]   context   Database and options from InitAGL()
+   \param[in]   inSeq     Sequence to analyze
+   \param[out]  result    The domains found
+   \return                Success (FALSE if out of memory)
+
+   Finds the best matching germline for each domain of a sequence.
+   The context is not changed, so several threads may use the same
+   context at once. If the context has a result cache, the result is
+   taken from it when the same sequence has been seen with the same
+   options, and stored in it otherwise. The sequence is upper-cased
+   and white space is removed whether or not there is a cache. The
+   result must be freed with FreeAGLResult() before it is used again.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 The sequence is normalised without a cache as well so
+              that -c doesn't change the results
+*/
+BOOL AssignGermlines(AGLCONTEXT *context, char *inSeq, AGLRESULT *result)
+{
+   char *key,
+        *seq,
+        *text;
+   BOOL ok;
+
+   if(context->cache == NULL)
+   {
+      if((seq = (char *)malloc(strlen(inSeq) + 1))==NULL)
+         return(FALSE);
+      NormaliseSeq(seq, inSeq);
+      ok = AssignSeq(context, seq, result);
+      free(seq);
+      return(ok);
+   }
+
+   if((key = MakeCacheKey(context, inSeq, &seq))==NULL)
+      return(FALSE);
+
+   if((text = FindCachedResult(context->cache, key))!=NULL)
+   {
+      ok = ParseResult(text, result);
+      free(text);
+      if(ok)
+      {
+         free(key);
+         return(TRUE);
+      }
+   }
+
+   if((ok = AssignSeq(context, seq, result)))
+   {
+      if((text = SerialiseResult(result))!=NULL)
+      {
+         CacheResult(context->cache, key, text);
+         free(text);
+      }
+   }
+
+   free(key);
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>void FreeAGLResult(AGLRESULT *result)
+   -------------------------------------
+*//**
+   \param[in,out] result   Result from AssignGermlines()
+
+   Frees the alignments in the result and empties it.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void FreeAGLResult(AGLRESULT *result)
+{
+   int i;
+
+   for(i=0; i<result->nDomains; i++)
+   {
+      free(result->domains[i].align1);
+      free(result->domains[i].align2);
+   }
+   result->nDomains = 0;
+}
+
+
+/************************************************************************/
+/*>char *MakeCacheKey(AGLCONTEXT *context, char *seq, char **normSeq)
+   ------------------------------------------------------------------
+*//**
+   \param[in]   context   Context giving the options
+   \param[in]   seq       Sequence
+   \param[out]  normSeq   The normalised sequence within the key
+   \return                Allocated key (or NULL if no memory)
+
+   Makes the result cache key from the options that affect the result
+   followed by the sequence upper-cased with white space removed.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Includes the shortlist size since the cache may now be
+              shared between runs
+   - 18.10.26 Includes the slack
+   - 18.10.26 Allocated to fit the options as well as the sequence so a
+              long species can't overflow it
+*/
+char *MakeCacheKey(AGLCONTEXT *context, char *seq, char **normSeq)
+{
+   char *key;
+   int  optLen;
+
+   optLen = snprintf(NULL, 0, "%s\t%d\t%d\t%d\t%d\t", context->species,
+                     context->chainType, (int)context->doDSegment,
+                     context->shortList, context->slack);
+   if((optLen < 0) ||
+      ((key = (char *)malloc(optLen + strlen(seq) + 1))==NULL))
+      return(NULL);
+
+   sprintf(key, "%s\t%d\t%d\t%d\t%d\t", context->species,
+           context->chainType, (int)context->doDSegment,
+           context->shortList, context->slack);
+   *normSeq = key + optLen;
+   NormaliseSeq(*normSeq, seq);
+
+   return(key);
+}
+
+
+/************************************************************************/
+/*>void NormaliseSeq(char *out, char *seq)
+   ---------------------------------------
+*//**
+   \param[out]  out   Sequence upper-cased with white space removed
+                      (may be as long as seq)
+   \param[in]   seq   Sequence
+
+   - 18.10.26 Original   By: ACRM
+*/
+void NormaliseSeq(char *out, char *seq)
+{
+   for(; *seq; seq++)
+   {
+      if(!isspace((unsigned char)*seq))
+         *(out++) = toupper((unsigned char)*seq);
+   }
+   *out = '\0';
+}
+
+
+/************************************************************************/
+/*>char *SerialiseResult(AGLRESULT *result)
+   ----------------------------------------
+*//**
+   \param[in]  result   Result to store
+   \return              Allocated text form (or NULL if no memory)
+
+   Writes a result as text: a chain line, a tab-separated line for
+   each domain and a line for any special note. Scores are written in
+   hexadecimal so they are read back exactly. ParseResult() reverses
+   this.
+
+   - 18.10.26 Original   By: ACRM
+*/
+char *SerialiseResult(AGLRESULT *result)
+{
+   FILE   *fp;
+   char   *text = NULL;
+   size_t size  = 0;
+   int    i;
+
+   if((fp = open_memstream(&text, &size))==NULL)
+      return(NULL);
+
+   fprintf(fp, "chain\t%d\t%d\n", result->chainType,
+           (int)result->chainTypeFound);
+   for(i=0; i<result->nDomains; i++)
+   {
+      AGLDOMAIN *dom = &(result->domains[i]);
+      fprintf(fp, "domain\t%s\t%a\t%d\t%d\t%d\t%d\t%s\t%s\t%s\n",
+              dom->domain, (double)dom->score,
+              dom->seqStart, dom->seqEnd, dom->germStart, dom->germEnd,
+              dom->match, dom->align1, dom->align2);
+   }
+   if(result->special[0])
+      fprintf(fp, "special\t%s\n", result->special);
+
+   if(fclose(fp))
+   {
+      free(text);
+      return(NULL);
+   }
+   return(text);
+}
+
+
+/************************************************************************/
+/*>BOOL ParseResult(char *text, AGLRESULT *result)
+   -----------------------------------------------
+*//**
+   \param[in,out] text     Text from SerialiseResult() (modified)
+   \param[out]    result   The result
+   \return                 Success (FALSE if the text is corrupt, when
+                           the result is left empty)
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Allocates the alignments
+*/
+BOOL ParseResult(char *text, AGLRESULT *result)
+{
+   char *line,
+        *savePtr;
+   BOOL gotChain = FALSE;
+
+   result->nDomains   = 0;
+   result->special[0] = '\0';
+
+   for(line=strtok_r(text, "\n", &savePtr);
+       line!=NULL;
+       line=strtok_r(NULL, "\n", &savePtr))
+   {
+      char *type = NextField(&line);
+
+      if(!strcmp(type, "chain"))
+      {
+         result->chainType      = atoi(NextField(&line));
+         result->chainTypeFound = (BOOL)atoi(NextField(&line));
+         gotChain = TRUE;
+      }
+      else if(!strcmp(type, "domain") &&
+              (result->nDomains < MAXDOMAINS))
+      {
+         AGLDOMAIN *dom = &(result->domains[result->nDomains++]);
+
+         strncpy(dom->domain, NextField(&line), LABELBUFF-1);
+         dom->domain[LABELBUFF-1] = '\0';
+         dom->score     = (REAL)strtod(NextField(&line), NULL);
+         dom->seqStart  = atoi(NextField(&line));
+         dom->seqEnd    = atoi(NextField(&line));
+         dom->germStart = atoi(NextField(&line));
+         dom->germEnd   = atoi(NextField(&line));
+         strncpy(dom->match,  NextField(&line), MAXBUFF);
+         dom->match[MAXBUFF] = '\0';
+         dom->align1 = CopyAlignment(NextField(&line));
+         dom->align2 = CopyAlignment(NextField(&line));
+      }
+      else if(!strcmp(type, "special"))
+      {
+         strncpy(result->special, line, MAXBUFF);
+         result->special[MAXBUFF] = '\0';
+      }
+      else
+      {
+         FreeAGLResult(result);
+         return(FALSE);
+      }
+   }
+
+   if(!gotChain)
+      FreeAGLResult(result);
+   return(gotChain);
+}
+
+
+/************************************************************************/
+/*>char *NextField(char **text)
+   ----------------------------
+*//**
+   \param[in,out] text   Current position in a tab-separated line
+   \return               The next field (blank at the end of the line)
+
+   Terminates the next field and moves past it. Unlike strtok() empty
+   fields are kept.
+
+   - 18.10.26 Original   By: ACRM
+*/
+char *NextField(char **text)
+{
+   char *field = *text,
+        *tab;
+
+   if((tab = strchr(field, '\t'))!=NULL)
+   {
+      *tab  = '\0';
+      *text = tab+1;
+   }
+   else
+   {
+      *text = field + strlen(field);
+   }
+   return(field);
+}
+
+
+/************************************************************************/
+/*>BOOL AssignSeq(AGLCONTEXT *context, char *seq, AGLRESULT *result)
+   -----------------------------------------------------------------
+*//**
+   \param[in]   context   Database and options from InitAGL()
+   \param[in]   seq       Sequence to analyze
+   \param[out]  result    The domains found
+   \return                Success
+
+   Does the work of AssignGermlines() for a sequence that isn't cached.
+
+   Each database scan is a SCANJOB saying which earlier domains it
+   depends on. The jobs are run by RunScanJobs(), at the same time if
+   the context has a thread pool, and the domains are then added to the
+   result in a fixed order, so the result doesn't depend on the order
+   the scans finish in.
+
+   - 31.03.20 Original (as ProcessSeq())   By: ACRM
+   - 14.04.20 Added showAlignment
+   - 26.04.23 Added D-segment handling
+   - 19.03.25 Added hinge handling
+   - 17.10.26 Takes the germline database instead of the data directory
+   - 18.10.26 Renamed from ProcessSeq(). Takes an AGLCONTEXT and fills
+              in an AGLRESULT rather than printing. Works on a copy of
+              the sequence
+   - 18.10.26 Renamed from AssignGermlines() which now checks the cache
+   - 18.10.26 Only searches J, C and hinge regions after the domains
+              before them
+   - 18.10.26 Uses GuessChainType() to avoid searching both sets of V
+              regions
+   - 18.10.26 The scans are SCANJOBs run as a graph of tasks. The
+              sequence is no longer copied since only DoDSegment()
+              changes it and that makes its own copy. Dropped the
+              REMOVESEQS code as the scans may now run together
+   - 18.10.26 Frees the alignments of the scans
+   - 18.10.26 The chain typing is traced
+*/
+BOOL AssignSeq(AGLCONTEXT *context, char *seq, AGLRESULT *result)
+{
+   SCANJOB     jobs[NSCANS],
+               *lv     = &(jobs[SCAN_LV]),
+               *lj     = &(jobs[SCAN_LJ]),
+               *lc     = &(jobs[SCAN_LC]),
+               *hv     = &(jobs[SCAN_HV]),
+               *hj     = &(jobs[SCAN_HJ]),
+               *hd     = &(jobs[SCAN_HD]),
+               *CH1    = &(jobs[SCAN_CH1]),
+               *hinge  = &(jobs[SCAN_HINGE]),
+               *CH2    = &(jobs[SCAN_CH2]),
+               *CH3    = &(jobs[SCAN_CH3]),
+               *scans[NSCANS];
+   int         chainType   = context->chainType,
+               nScans      = 0,
+               i;
+   BOOL        doDSegment  = context->doDSegment;
+   TRACESPAN   span;
+
+   result->nDomains       = 0;
+   result->special[0]     = '\0';
+   result->chainTypeFound = FALSE;
+
+   InitScanJob(lv,    context, "light_v", seq, THRESHOLD_LV);
+   InitScanJob(lj,    context, "light_j", seq, THRESHOLD_LJ);
+   InitScanJob(lc,    context, "light_c", seq, THRESHOLD_LC);
+   InitScanJob(hv,    context, "heavy_v", seq, THRESHOLD_HV);
+   InitScanJob(hj,    context, "heavy_j", seq, THRESHOLD_HJ);
+   InitScanJob(hd,    context, "heavy_d", seq, THRESHOLD_HD);
+   InitScanJob(CH1,   context, "CH1",     seq, THRESHOLD_HC);
+   InitScanJob(hinge, context, "hinges",  seq, THRESHOLD_HINGE);
+   InitScanJob(CH2,   context, "CH2",     seq, THRESHOLD_HC);
+   InitScanJob(CH3,   context, "CH3-CHS", seq, THRESHOLD_HC);
+   hd->func = DoDSegment;
+
+   /* Find out what the chain type is if it isn't specified. If the
+      k-mers make it clear, only that V region is searched unless it
+      isn't found. These scans search the whole sequence
+   */
+   if(chainType == CHAINTYPE_UNKNOWN)
+   {
+      int guess;
+
+      StartTraceSpan(&span);
+      guess = GuessChainType(seq, context->species, context->germDB,
+                             context->verbose);
+
+      if(guess != CHAINTYPE_HEAVY)
+         scans[nScans++] = lv;
+      if(guess != CHAINTYPE_LIGHT)
+         scans[nScans++] = hv;
+      RunScanJobs(context, scans, nScans);
+
+      if((guess == CHAINTYPE_LIGHT) && (lv->score <= THRESHOLD_LV))
+         RunScanJobs(context, &hv, 1);
+      if((guess == CHAINTYPE_HEAVY) && (hv->score <= THRESHOLD_HV))
+         RunScanJobs(context, &lv, 1);
+
+      if((lv->score > hv->score) && (lv->score > THRESHOLD_LV))
+      {
+         chainType = CHAINTYPE_LIGHT;
+      }
+      else if((hv->score > lv->score) && (hv->score > THRESHOLD_HV))
+      {
+         chainType = CHAINTYPE_HEAVY;
+      }
+      
+      if(chainType == CHAINTYPE_UNKNOWN)
+      {
+         scans[0] = lc;
+         scans[1] = CH1;
+         RunScanJobs(context, scans, 2);
+
+         if((lc->score > CH1->score) && (lc->score > THRESHOLD_LC))
+         {
+            chainType = CHAINTYPE_LIGHT;
+         }
+         else if((CH1->score > lc->score) && (CH1->score > THRESHOLD_HC))
+         {
+            chainType = CHAINTYPE_HEAVY;
+         }
+      }
+      result->chainTypeFound = TRUE;
+      EndTraceSpan(&span, "chain typing", "stage", "\"chainType\":%d",
+                   chainType);
+   }
+
+   /* Each region is only searched for after the domains before it:
+      J after V, the constant domains after J (or V) and the hinge
+      between the ends of CH1 and CH2. Scans already done are not
+      repeated
+   */
+   lj->found      = lv;
+   lj->after[0]   = lv;
+   lc->after[0]   = lj;
+   lc->after[1]   = lv;
+
+   hj->found      = hv;
+   hj->after[0]   = hv;
+   hd->found      = hj;
+   hd->after[0]   = hv;
+   hd->after[1]   = hj;
+   CH1->after[0]  = CH2->after[0] = CH3->after[0] = hj;
+   CH1->after[1]  = CH2->after[1] = CH3->after[1] = hv;
+   hinge->matched[0] = CH1;
+   hinge->matched[1] = CH2;
+   hinge->after[0]   = CH1;
+   hinge->upTo       = CH2;
+
+   nScans = 0;
+   switch(chainType)
+   {
+   case CHAINTYPE_LIGHT:
+      scans[nScans++] = lv;
+      scans[nScans++] = lj;
+      scans[nScans++] = lc;
+      RunScanJobs(context, scans, nScans);
+
+      if(lv->score > THRESHOLD_LV)
+      {
+         AddDomain(result, "VL", lv->score, lv->match,
+                   lv->align1, lv->align2, 0);
+         if(lj->score > THRESHOLD_LJ)
+         {
+            AddDomain(result, "JL", lj->score, lj->match,
+                      lj->align1, lj->align2, 0);
+         }
+      }
+
+      if(lc->score > THRESHOLD_LC)
+      {
+         AddDomain(result, "CL", lc->score, lc->match,
+                   lc->align1, lc->align2, 0);
+      }
+      
+      break;
+
+   case CHAINTYPE_HEAVY:
+      scans[nScans++] = hv;
+      scans[nScans++] = hj;
+      if(doDSegment)
+         scans[nScans++] = hd;
+      scans[nScans++] = CH1;
+      scans[nScans++] = CH2;
+      scans[nScans++] = CH3;
+      scans[nScans++] = hinge;
+      RunScanJobs(context, scans, nScans);
+
+      if(hv->score > THRESHOLD_HV)
+      {
+         AddDomain(result, "VH", hv->score, hv->match,
+                   hv->align1, hv->align2, 0);
+         
+         if(hj->score > THRESHOLD_HJ)
+         {
+            AddDomain(result, "JH", hj->score, hj->match,
+                      hj->align1, hj->align2, 0);
+
+            /* If we have found both V and J, then we can try to find
+               the D segment (if required)
+            */
+            if(doDSegment && (hd->score > THRESHOLD_HD))
+            {
+               int alnLength = CalcShortSeqLen(hd->align1, hd->align2);
+      
+               AddDomain(result, "DH", hd->score/(REAL)alnLength,
+                         hd->match, hd->align1, hd->align2, hd->offset);
+            }
+         }
+      }
+
+      if(CH1->score > THRESHOLD_HC)
+      {
+         AddDomain(result, "CH1", CH1->score, CH1->match,
+                   CH1->align1, CH1->align2, 0);
+      }
+      
+      if(hinge->score > THRESHOLD_HINGE)
+      {
+         AddDomain(result, "HINGE", hinge->score, hinge->match,
+                   hinge->align1, hinge->align2, 0);
+      }
+      
+      if(CH2->score > THRESHOLD_HC)
+      {
+         AddDomain(result, "CH2", CH2->score, CH2->match,
+                   CH2->align1, CH2->align2, 0);
+      }
+      
+      if(CH3->score > THRESHOLD_HC)
+      {
+         AddDomain(result, "CH3-CHS", CH3->score, CH3->match,
+                   CH3->align1, CH3->align2, 0);
+      }
+
+      
+      /* 22.02.24 Added to print info on special cases where mixed allelic
+         variants actually indicate a higher numbered allele
+      */
+      FindSpecialMatch(result->special, CH1->match, CH2->match,
+                       CH3->match);
+
+      break;
+
+   default:
+      /* Leave the chain type unknown for the caller to report         */
+      chainType = CHAINTYPE_UNKNOWN;
+      break;
+   }
+
+   for(i=0; i<NSCANS; i++)
+   {
+      free(jobs[i].align1);
+      free(jobs[i].align2);
+   }
+
+   result->chainType = chainType;
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>void InitScanJob(SCANJOB *job, AGLCONTEXT *context, char *type,
+                    char *seq, REAL threshold)
+   ---------------------------------------------------------------
+*//**
+   \param[out] job         The job
+   \param[in]  context     Database and options from InitAGL()
+   \param[in]  type        Database type to scan
+   \param[in]  seq         The whole sequence
+   \param[in]  threshold   Score for the domain to count as found
+
+   Sets up a scan with no dependencies that hasn't been run. The
+   alignments are only allocated when it is run and are freed by
+   AssignSeq().
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Takes the sequence being traced from this thread
+*/
+void InitScanJob(SCANJOB *job, AGLCONTEXT *context, char *type,
+                 char *seq, REAL threshold)
+{
+   job->context   = context;
+   job->type      = type;
+   job->seq       = seq;
+   job->match[0]  = '\0';
+   job->align1    = job->align2     = NULL;
+   job->found     = job->matched[0] = job->matched[1] = NULL;
+   job->after[0]  = job->after[1]   = job->upTo     = NULL;
+   job->task      = NULL;
+   job->score     = -1.0;
+   job->threshold = threshold;
+   job->end       = -1;
+   job->offset    = 0;
+   job->func      = DoScan;
+   job->traceSeq  = GetTraceSeq();
+   job->done      = FALSE;
+}
+
+
+/************************************************************************/
+/*>void RunScanJobs(AGLCONTEXT *context, SCANJOB **jobs, int nJobs)
+   ----------------------------------------------------------------
+*//**
+   \param[in]     context   Database and options from InitAGL()
+   \param[in,out] jobs      The scans to run
+   \param[in]     nJobs     Number of scans
+
+   Runs the scans that haven't already been done. Each waits for any
+   of the others that it depends on. They are run on the context's
+   thread pool, if it has one, except with verbose output which would
+   be jumbled.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void RunScanJobs(AGLCONTEXT *context, SCANJOB **jobs, int nJobs)
+{
+   TASKGRAPH graph;
+   int       i, j, k;
+
+   InitTaskGraph(&graph);
+   for(i=0; i<nJobs; i++)
+   {
+      if(!jobs[i]->done)
+         jobs[i]->task = AddTask(&graph, jobs[i]->func, jobs[i]);
+   }
+
+   for(i=0; i<nJobs; i++)
+   {
+      SCANJOB *job = jobs[i],
+              *deps[6];
+
+      if(job->task == NULL)
+         continue;
+
+      deps[0] = job->found;
+      deps[1] = job->matched[0];
+      deps[2] = job->matched[1];
+      deps[3] = job->after[0];
+      deps[4] = job->after[1];
+      deps[5] = job->upTo;
+      for(j=0; j<6; j++)
+      {
+         /* Only the jobs in this graph have a task                    */
+         if((deps[j] == NULL) || (deps[j]->task == NULL))
+            continue;
+         for(k=0; k<j; k++)
+         {
+            if(deps[k] == deps[j])
+               break;
+         }
+         if(k == j)
+            AddDependency(job->task, deps[j]->task);
+      }
+   }
+
+   RunTaskGraph(context->verbose ? NULL : context->pool, &graph);
+
+   for(i=0; i<nJobs; i++)
+      jobs[i]->task = NULL;
+}
+
+
+/************************************************************************/
+/*>void DoScan(void *arg)
+   ----------------------
+*//**
+   \param[in,out] arg   The SCANJOB
+
+   Task to scan the database for a domain. The part of the sequence
+   searched starts at the end of the first domain in after[] that was
+   found (or the start of the sequence) and stops at the end of upTo
+   (or the end of the sequence). Nothing is done if the domain found
+   wasn't or matched[] didn't match anything.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Allocates the alignments
+   - 18.10.26 Traces the job's sequence
+*/
+void DoScan(void *arg)
+{
+   SCANJOB    *job     = (SCANJOB *)arg;
+   AGLCONTEXT *context = job->context;
+   int        seqLen   = strlen(job->seq),
+              start    = 0,
+              stop     = seqLen,
+              i;
+
+   job->done = TRUE;
+   SetTraceSeq(job->traceSeq);
+
+   if((job->found != NULL) && (job->found->end < 0))
+      return;
+   for(i=0; i<2; i++)
+   {
+      if((job->matched[i] != NULL) && !job->matched[i]->match[0])
+         return;
+   }
+
+   for(i=0; i<2; i++)
+   {
+      if((job->after[i] != NULL) && (job->after[i]->end >= 0))
+      {
+         start = job->after[i]->end;
+         break;
+      }
+   }
+   if((job->upTo != NULL) && (job->upTo->end >= 0))
+      stop = job->upTo->end;
+
+   AllocScanAlignments(job, seqLen, job->type);
+   job->score = ScanRegion(job->type, job->seq, start, stop,
+                           context->slack, context->verbose,
+                           context->species, job->match,
+                           job->align1, job->align2, context->germDB,
+                           context->shortList);
+   if(job->score > job->threshold)
+      job->end = AlignedQueryEnd(job->align1, job->align2);
+}
+
+
+/************************************************************************/
+/*>void AllocScanAlignments(SCANJOB *job, int seqLen, char *type)
+   --------------------------------------------------------------
+*//**
+   \param[in,out] job      The scan
+   \param[in]     seqLen   Length of the sequence that will be aligned
+   \param[in]     type     Database type it will be aligned with
+
+   Allocates alignments long enough for the sequence and any germline
+   sequence of the type to be aligned with nothing in common.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void AllocScanAlignments(SCANJOB *job, int seqLen, char *type)
+{
+   size_t size = seqLen +
+                 LongestGermSeq(GetGermRegion(job->context->germDB, type)) +
+                 1;
+
+   job->align1    = AllocAlignment(size);
+   job->align2    = AllocAlignment(size);
+   job->align1[0] = job->align2[0] = '\0';
+}
+
+
+/************************************************************************/
+/*>REAL ScanAgainstDB(char *type, char *theSeq, BOOL verbose, 
+                      char *species, char *match, char *bestAlign1, 
+                      char *bestAlign2, GERMDB *germDB, int shortList)
+   -----------------------------------------------------------------------
+*//**
+   \param[in]  type       The database type against which we scan
+   \param[in]  theSeq     The sequences to test
+   \param[in]  verbose    Verbose output
+   \param[in]  species    "Homo", "Mus" or blank
+   \param[out] match      The best matching entry
+   \param[out] bestAlign1 The alignment of our sequence
+   \param[out] bestAlign2 The alignment of the database sequence
+   \param[in]  germDB     Germline database
+   \param[in]  shortList  Number of sequences to align (0 for all)
+   \return                The score for the match
+
+   Scans a sequence against the specified database. The alignments
+   must have room for the lengths of the sequence and the longest
+   germline sequence of this type (see LongestGermSeq()).
+
+   - 31.03.20 Original   By: ACRM
+   - 11.06.21 Added USEPATH code
+   - 13.06.22 Added window size of 2 for C regions and 10 for others
+   - 19.03.25 Initialize match
+   - 17.10.26 Scans the in-memory entries from the germline database
+              rather than reading the data file each time
+   - 17.10.26 Scans just the entries for the species rather than
+              testing every header
+   - 17.10.26 Aligns each unique sequence only once
+   - 17.10.26 Only aligns the sequences shortlisted on shared k-mers
+   - 18.10.26 Scores the shortlisted sequences in blocks first so only
+              the best is aligned
+   - 18.10.26 A sequence that still needs aligning is skipped if even a
+              perfect score couldn't make it the best hit so far. The
+              acceptance test is now in BetterHit()
+   - 18.10.26 Sequences that weren't scored in blocks are scored with
+              ScoreEntry() rather than aligned. Only the best hit is
+              aligned, once the scan is finished
+   - 18.10.26 Timed for --stats
+   - 18.10.26 Counts the entries visited and skipped, and the ties
+              broken on the name, for --stats
+   - 18.10.26 Traced for --trace
+   - 18.10.26 No longer skips sequences on a bound for their score.
+              Scaled scores have no useful bound and the block scores
+              are already worked out
+   - 18.10.26 Skips sequences that CantBeatHit() once the best hit
+              scores 1.0. The sequences are scored in blocks in file
+              order as they are needed, so this saves the work
+   - 18.10.26 Takes the shortlist size rather than using the one in the
+              GERMDB
+   - 18.10.26 The entries skipped for the species and for the locus are
+              counted separately
+*/
+REAL ScanAgainstDB(char *type, char *theSeq, BOOL verbose, char *species,
+                   char *match, char *bestAlign1, char *bestAlign2,
+                   GERMDB *germDB, int shortList)
+{
+   GERMENTRY   *bestEntry = NULL;
+   GENERANK    noRank     = {0, 0, 0, FALSE};
+   REAL        maxScore   = 0.0;
+   int         maxDbLen   = 0,
+               nSkipped   = 0,
+               nPruned    = 0,
+               nTies      = 0,
+               entryNum;
+   GERMREGION  *region;
+   GERMVIEW    *view;
+   SEQSCORE    *seqScores;
+   BOOL        *candidate;
+   STATSTIMER  timer;
+   TRACESPAN   span;
+
+   StartStatsTimer(&timer);
+   StartTraceSpan(&span);
+   match[0] = '\0';
+   
+   if(verbose)
+      fprintf(stderr,"\n\nChecking %s\n", type);
+
+   region = GetGermRegion(germDB, type);
+   view   = GetGermView(germDB, type, species, "");
+
+   /* One score for each unique sequence, filled in as we meet them     */
+   if(((seqScores = (SEQSCORE *)calloc(MAX(region->nSeqs, 1),
+                                       sizeof(SEQSCORE)))==NULL) ||
+      ((candidate = (BOOL *)malloc(MAX(region->nSeqs, 1) *
+                                   sizeof(BOOL)))==NULL))
+   {
+      fprintf(stderr, "\nError (agl): No memory for scores\n");
+      exit(1);
+   }
+
+   /* Only the sequences sharing most k-mers with ours are aligned     */
+   ShortlistSeqs(region, view, theSeq, shortList, candidate);
+
+   /* The entries must be considered in file order since which one is
+      kept depends on what has been seen already; identical sequences
+      just reuse the score
+   */
+   for(entryNum=0; entryNum<view->nEntries; entryNum++)
+   {
+      GERMENTRY *entry    = view->entries[entryNum];
+      SEQSCORE  *seqScore = &(seqScores[entry->seqClass]);
+      char      *header   = entry->header;
+      REAL      score;
+      int       dbLen;
+
+      if(!candidate[entry->seqClass])
+      {
+         nSkipped++;
+         continue;
+      }
+
+      if(!seqScore->done)
+      {
+         /* Not worth scoring if it can't become the best hit           */
+         if(CantBeatHit(theSeq, entry, bestEntry, maxScore, maxDbLen))
+         {
+            nPruned++;
+            if(verbose)
+               fprintf(stderr, "Comparing with %s (can't beat %.4f)\n",
+                       header, maxScore);
+            continue;
+         }
+
+         /* Score it in a block with those needed next, or alone       */
+         ScoreNextSeqs(theSeq, region, view, entryNum, candidate,
+                       seqScores, bestEntry, maxScore, maxDbLen);
+         if(!seqScore->done)
+         {
+            seqScore->score = ScoreEntry(theSeq, entry,
+                                         &(seqScore->dbLen));
+            seqScore->done  = TRUE;
+         }
+      }
+      score = seqScore->score;
+      dbLen = seqScore->dbLen;
+
+#ifdef DEBUG
+      if(verbose)
+         fprintf(stderr, "Comparing with %s {%f, %f} {%d, %d}\n",
+                 header, score, maxScore, dbLen, maxDbLen);
+#endif 
+      if(BetterHit(score, dbLen, maxScore, maxDbLen))
+      {
+         if(verbose)
+            fprintf(stderr, "Comparing with %s *** %.4f\n",
+                    header, score);
+      
+         maxScore  = score;
+         maxDbLen  = dbLen;
+         bestEntry = entry;
+      }
+      else if(score == maxScore)
+      {
+         /* If the scores are the same, choose the one with the 
+            better gene name
+         */
+         nTies++;
+         if(PreferEntry(&(entry->rank),
+                        (bestEntry==NULL)?&noRank:&(bestEntry->rank)))
+         {
+            if(verbose)
+               fprintf(stderr, "Comparing with %s *** %.4f \
+(Chosen on name)\n", header, score);
+      
+            maxScore  = score;
+            bestEntry = entry;
+         }
+         else if(verbose)
+         {
+            fprintf(stderr, "Comparing with %s (rejected %.4f)\n",
+                    header, score);
+         }
+      }
+      else if(verbose)
+      {
+         fprintf(stderr, "Comparing with %s (%.4f)\n",
+                 header, score);
+      }
+   }
+
+   /* Only now align the best hit                                      */
+   if(bestEntry != NULL)
+      CompareEntry(theSeq, bestEntry, bestAlign1, bestAlign2);
+
+   free(seqScores);
+   free(candidate);
+
+   if(bestEntry != NULL)
+      strncpy(match, bestEntry->header, MAXBUFF);
+
+   timer.nVisited          = view->nEntries;
+   timer.nSpeciesSkipped   = view->nSpeciesSkipped;
+   timer.nLocusSkipped     = view->nLocusSkipped;
+   timer.nShortlistSkipped = nSkipped;
+   timer.nPruned           = nPruned;
+   timer.nTies             = nTies;
+   StopStatsTimer(&timer, type);
+   EndTraceSpan(&span, type, "scan", "\"type\":\"%s\",\"entries\":%d",
+                type, view->nEntries);
+   return(maxScore);
+
+}
+
+
+/************************************************************************/
+/*>REAL ScanRegion(char *type, char *seq, int start, int stop, int slack,
+                   BOOL verbose, char *species, char *match,
+                   char *bestAlign1, char *bestAlign2, GERMDB *germDB,
+                   int shortList)
+   ----------------------------------------------------------------------
+*//**
+   \param[in]  type       The database type against which we scan
+   \param[in]  seq        The full sequence
+   \param[in]  start      First residue (from 0) the region may start at
+   \param[in]  stop       Residue after the last the region may reach
+   \param[in]  slack      Residues to search either side of start and
+                          stop (-1 to search the whole sequence)
+   \param[in]  verbose    Verbose output
+   \param[in]  species    "Homo", "Mus" or blank
+   \param[out] match      The best matching entry
+   \param[out] bestAlign1 The alignment of our sequence
+   \param[out] bestAlign2 The alignment of the database sequence
+   \param[in]  germDB     Germline database
+   \param[in]  shortList  Number of sequences to align (0 for all)
+   \return                The score for the match
+
+   Like ScanAgainstDB() but only searches the part of the sequence where
+   the domain can be, given the domains already found. The residues
+   outside the part searched are added back to the alignment against
+   gaps, so it can be used just as if the whole sequence had been
+   searched. If the part is too short to hold the longest germline
+   sequence, the whole sequence is searched. The alignments must have
+   room for the whole sequence as for ScanAgainstDB().
+
+   The score is for the part searched, so it may not be the same as
+   for the whole sequence: a germline sequence that runs off the end of
+   the part is scored only on the residues that fit.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 The working copies are allocated to fit
+   - 18.10.26 Added shortList
+*/
+REAL ScanRegion(char *type, char *seq, int start, int stop, int slack,
+                BOOL verbose, char *species, char *match,
+                char *bestAlign1, char *bestAlign2, GERMDB *germDB,
+                int shortList)
+{
+   char       *subSeq,
+              *align1,
+              *align2;
+   int        seqLen     = strlen(seq),
+              maxGermLen = LongestGermSeq(GetGermRegion(germDB, type)),
+              subLen;
+   REAL       score;
+
+   /* If there isn't room for the whole of any germline sequence, the
+      best alignment would run outside the region so the whole sequence
+      is searched, as it would be if the region weren't known
+   */
+   start = MAX(start - slack, 0);
+   stop  = MIN(stop  + slack, seqLen);
+   if((slack < 0) || ((start == 0) && (stop == seqLen)) ||
+      (stop - start < maxGermLen))
+   {
+      return(ScanAgainstDB(type, seq, verbose, species,
+                           match, bestAlign1, bestAlign2, germDB,
+                           shortList));
+   }
+
+   if(verbose)
+      fprintf(stderr, "\n\nSearching residues %d-%d for %s\n",
+              start+1, stop, type);
+
+   subLen = stop - start;
+   subSeq = AllocAlignment(subLen + 1);
+   align1 = AllocAlignment(subLen + maxGermLen + 1);
+   align2 = AllocAlignment(subLen + maxGermLen + 1);
+   strncpy(subSeq, seq+start, subLen);
+   subSeq[subLen] = '\0';
+
+   score = ScanAgainstDB(type, subSeq, verbose, species,
+                         match, align1, align2, germDB, shortList);
+
+   if(match[0])
+   {
+      int alnLen = strlen(align1),
+          endLen = seqLen - stop;
+
+      /* Residues before and after the region are left unaligned       */
+      strncpy(bestAlign1, seq, start);
+      memset(bestAlign2, '-', start);
+      strcpy(bestAlign1+start, align1);
+      strcpy(bestAlign2+start, align2);
+      strcpy(bestAlign1+start+alnLen, seq+stop);
+      memset(bestAlign2+start+alnLen, '-', endLen);
+      bestAlign2[start+alnLen+endLen] = '\0';
+   }
+
+   free(subSeq);
+   free(align1);
+   free(align2);
+   return(score);
+}
+
+
+/************************************************************************/
+/*>int AlignedQueryEnd(char *align1, char *align2)
+   -----------------------------------------------
+*//**
+   \param[in]  align1   Alignment of the query
+   \param[in]  align2   Alignment of the germline
+   \return              Residue after the last aligned residue of the
+                        query (numbered from 0)
+
+   Finds where a domain ends in the query (as seqEnd from AddDomain()),
+   which is where the next domain may start.
+
+   - 18.10.26 Original   By: ACRM
+*/
+int AlignedQueryEnd(char *align1, char *align2)
+{
+   int pos = 0,
+       end = 0,
+       i;
+
+   for(i=0; align1[i]; i++)
+   {
+      if(align1[i] != '-')
+      {
+         pos++;
+         if(align2[i] != '-')
+            end = pos;
+      }
+   }
+   return(end);
+}
+
+
+/************************************************************************/
+/*>int LongestGermSeq(GERMREGION *region)
+   --------------------------------------
+*//**
+   \param[in]  region   A germline region
+   \return              Length of its longest sequence
+
+   - 18.10.26 Original (code from ScanRegion())   By: ACRM
+*/
+int LongestGermSeq(GERMREGION *region)
+{
+   int maxLen = 0,
+       i;
+
+   for(i=0; i<region->nSeqs; i++)
+      maxLen = MAX(maxLen, region->seqs[i].seqLen);
+   return(maxLen);
+}
+
+
+/************************************************************************/
+/*>char *AllocAlignment(size_t size)
+   ---------------------------------
+*//**
+   \param[in]  size   Bytes needed
+   \return            Allocated buffer
+
+   Allocates an alignment or other working copy of a sequence. Like
+   the other working storage, running out of memory is fatal.
+
+   - 18.10.26 Original   By: ACRM
+*/
+char *AllocAlignment(size_t size)
+{
+   char *buffer;
+
+   if((buffer = (char *)malloc(size))==NULL)
+   {
+      fprintf(stderr, "\nError (agl): No memory for alignment\n");
+      exit(1);
+   }
+   return(buffer);
+}
+
+
+/************************************************************************/
+/*>char *CopyAlignment(char *align)
+   --------------------------------
+*//**
+   \param[in]  align   An alignment
+   \return             Allocated copy
+
+   - 18.10.26 Original   By: ACRM
+*/
+char *CopyAlignment(char *align)
+{
+   return(strcpy(AllocAlignment(strlen(align) + 1), align));
+}
+
+
+/************************************************************************/
+/*>int GuessChainType(char *seq, char *species, GERMDB *germDB,
+                      BOOL verbose)
+   ------------------------------------------------------------
+*//**
+   \param[in]  seq       The sequence
+   \param[in]  species   "Homo", "Mus" or blank
+   \param[in]  germDB    Germline database
+   \param[in]  verbose   Verbose output
+   \return               CHAINTYPE_LIGHT or CHAINTYPE_HEAVY if the
+                         sequence is clearly one or the other, otherwise
+                         CHAINTYPE_UNKNOWN
+
+   Guesses the chain type from the most k-mers the sequence shares with
+   any light or heavy V region sequence. This is much quicker than
+   searching the V regions. A guess is only made if the V region of
+   one type shares at least GUESSMINKMERS and GUESSRATIO times as many
+   as the other. Otherwise (e.g. constant regions alone or both V
+   regions together) both must be searched.
+
+   - 18.10.26 Original   By: ACRM
+*/
+int GuessChainType(char *seq, char *species, GERMDB *germDB,
+                   BOOL verbose)
+{
+   int light, heavy;
+
+   light = MostSharedKmers(GetGermRegion(germDB, "light_v"),
+                           GetGermView(germDB, "light_v", species, ""),
+                           seq);
+   heavy = MostSharedKmers(GetGermRegion(germDB, "heavy_v"),
+                           GetGermView(germDB, "heavy_v", species, ""),
+                           seq);
+   if(verbose)
+      fprintf(stderr, "\n\nShared %d-mers: light_v %d heavy_v %d\n",
+              KMERLEN, light, heavy);
+
+   if((light >= GUESSMINKMERS) && (light >= GUESSRATIO * heavy))
+      return(CHAINTYPE_LIGHT);
+   if((heavy >= GUESSMINKMERS) && (heavy >= GUESSRATIO * light))
+      return(CHAINTYPE_HEAVY);
+   return(CHAINTYPE_UNKNOWN);
+}
+
+
+/************************************************************************/
+/*>BOOL BetterHit(REAL score, int dbLen, REAL maxScore, int maxDbLen)
+   ------------------------------------------------------------------
+*//**
+   \param[in]  score      Score of the new hit
+   \param[in]  dbLen      Length of the new hit's germline sequence
+   \param[in]  maxScore   Score of the best hit so far
+   \param[in]  maxDbLen   Length of the best hit so far
+   \return                Should the new hit replace the best?
+
+   The test for a better hit used by ScanAgainstDB() (ties on score
+   are settled separately on the gene name). The result can only go
+   from FALSE to TRUE as score or dbLen increase, so it also tells us
+   whether a hit with at most this score and length could be better.
+
+   - 18.10.26 Original (code from ScanAgainstDB())   By: ACRM
+*/
+BOOL BetterHit(REAL score, int dbLen, REAL maxScore, int maxDbLen)
+{
+   return(/* Length has increased and score not decreased much         */
+          ((dbLen > maxDbLen) &&
+           (score > (maxScore-THRESHOLD_LEN_SCORE)))   ||
+          /* Score has increased and length not shorter                */
+          ((score > maxScore) && (dbLen >= maxDbLen))  ||
+          /* Score has increased significantly while length is 
+             shorter 
+          */
+          ((score >  (maxScore + THRESHOLD_SCORE_INC)) &&
+           (dbLen >= (maxDbLen-THRESHOLD_SCORE_LEN))));
+}
+
+
+/************************************************************************/
+/*>BOOL CantBeatHit(char *theSeq, GERMENTRY *entry, GERMENTRY *bestEntry,
+                    REAL maxScore, int maxDbLen)
+   ---------------------------------------------------------------------
+*//**
+   \param[in]  theSeq     The sequence of interest
+   \param[in]  entry      An entry that hasn't been scored
+   \param[in]  bestEntry  The best hit so far (or NULL)
+   \param[in]  maxScore   Score of the best hit so far
+   \param[in]  maxDbLen   Length of the best hit so far
+   \return                 Is it certain that ScanAgainstDB() wouldn't
+                           keep the entry, whatever its score?
+
+   A scaled score is at most 1.0, since every aligned pair scores at
+   most 1 and there are no more of them than residues in the shorter
+   aligned length. The entry's dbLen is at most its length. If
+   BetterHit() says that even such a hit isn't better, the entry could
+   only be kept on a tie, which needs a score equal to maxScore and a
+   gene name that PreferEntry() prefers. In practice this only happens
+   once the best hit scores 1.0.
+
+   There is no such bound on a D segment score (which isn't scaled),
+   or where a '-' is left out of the shorter length.
+
+   - 18.10.26 Original   By: ACRM
+*/
+BOOL CantBeatHit(char *theSeq, GERMENTRY *entry, GERMENTRY *bestEntry,
+                 REAL maxScore, int maxDbLen)
+{
+   int  window;
+   BOOL noScale;
+
+   if((bestEntry == NULL) ||
+      BetterHit(1.0, entry->seqLen, maxScore, maxDbLen))
+      return(FALSE);
+
+   AlignSettings(entry->header[1], &window, &noScale);
+   if(noScale || (strchr(entry->seq, '-') != NULL) ||
+      (strchr(theSeq, '-') != NULL))
+      return(FALSE);
+
+   return((maxScore > 1.0) ||
+          !PreferEntry(&(entry->rank), &(bestEntry->rank)));
+}
+
+
+/************************************************************************/
+int CalculateDbLen(char *seq)
+{
+   int i,
+       len=0;
+
+   for(i=0; i<strlen(seq); i++)
+   {
+      if(seq[i] != '-')
+         len++;
+   }
+   return(len);
+}
+
+/************************************************************************/
+/*>BOOL PreferEntry(GENERANK *newRank, GENERANK *oldRank)
+   -----------------------------------------------------
+*//**
+   \param[in]  newRank  The parsed gene name for the new entry
+   \param[in]  oldRank  The parsed gene name for the current best entry
+   \return              Should be use the new entry?
+
+   Used when two hits score the same. Tests the names of the hits and
+   sees if the new one has a preferred name
+
+   - 31.03.20 Original   By: ACRM
+   - 17.10.26 Renamed from PreferHeader(). Now takes the gene names
+              already parsed by the database code rather than parsing
+              both headers on every call
+CHECKED
+*/
+BOOL PreferEntry(GENERANK *newRank, GENERANK *oldRank)
+{
+   int oldNum, newNum;
+
+   /* If it's non-distal and the current best is distal, 
+      keep the new one 
+   */
+   if(!newRank->distal && oldRank->distal)
+      return(TRUE);
+   
+   /* If the sub-class is numeric and the old one isn't, 
+      keep the new one 
+   */
+   oldNum = oldRank->subclass;
+   newNum = newRank->subclass;
+   if((newNum > 0) && (oldNum == 0))
+      return(TRUE);
+
+   /* If both are numeric and the new one is lower, 
+      keep the new one  
+   */
+   if((newNum && oldNum) && (newNum < oldNum))
+      return(TRUE);
+   if(newNum > oldNum)
+      return(FALSE);
+
+   /* If the family is numeric and the old one isn't,
+      keep the new one 
+   */
+   oldNum = oldRank->family;
+   newNum = newRank->family;
+   if((newNum > 0) && (oldNum == 0))
+      return(TRUE);
+
+   /* If both are numeric and the new one is lower,
+      keep the new one   
+   */
+   if((newNum && oldNum) && (newNum < oldNum))
+      return(TRUE);
+   if(newNum > oldNum)
+      return(FALSE);
+
+   /* Keep the lowest allele                                            
+   */
+   if(newRank->allele < oldRank->allele)
+      return(TRUE);
+
+   return(FALSE);
+}
+
+
+/************************************************************************/
+/*>REAL CompareEntry(char *theSeq, GERMENTRY *entry,
+                     char *align1, char *align2)
+   -------------------------------------------------
+*//**
+   \param[in]   theSeq   the sequence of interest
+   \param[in]   entry    the database entry
+   \param[out]  align1   the alignment of theSeq
+   \param[out]  align2   the alignment of the database sequence
+   \return               the score
+
+   Aligns a sequence with a database entry using the settings for the
+   type of entry.
+
+   - 17.10.26 Original (code from ScanAgainstDB())   By: ACRM
+   - 18.10.26 Settings moved to AlignSettings()
+*/
+REAL CompareEntry(char *theSeq, GERMENTRY *entry,
+                  char *align1, char *align2)
+{
+   int  window;
+   BOOL noScale;
+
+   AlignSettings(entry->header[1], &window, &noScale);
+   return(CompareSeqs(theSeq, entry->seq, window, align1, align2,
+                      noScale));
+}
+
+
+/************************************************************************/
+/*>REAL ScoreEntry(char *theSeq, GERMENTRY *entry, int *dbLen)
+   -----------------------------------------------------------
+*//**
+   \param[in]   theSeq   the sequence of interest
+   \param[in]   entry    the database entry
+   \param[out]  dbLen    residues of the database sequence in the
+                         alignment
+   \return               the score
+
+   Gives the score and length that CompareEntry() would, without
+   building the alignment. A '-' in either sequence would be counted
+   as a gap by CalcShortSeqLen(), so those are still aligned.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Alignments allocated to fit
+*/
+REAL ScoreEntry(char *theSeq, GERMENTRY *entry, int *dbLen)
+{
+   int  window,
+        score,
+        shortLen;
+   BOOL noScale;
+
+   if((strchr(theSeq, '-') != NULL) || (strchr(entry->seq, '-') != NULL))
+   {
+      size_t size   = strlen(theSeq) + entry->seqLen + 1;
+      char   *align1 = AllocAlignment(size),
+             *align2 = AllocAlignment(size);
+      REAL   realScore = CompareEntry(theSeq, entry, align1, align2);
+
+      *dbLen = CalculateDbLen(align2);
+      free(align1);
+      free(align2);
+      return(realScore);
+   }
+
+   AlignSettings(entry->header[1], &window, &noScale);
+   score  = AffineScore(theSeq, strlen(theSeq),
+                        entry->seq, entry->seqLen,
+                        5,      /* opening penalty    */
+                        1,      /* extension penalty  */
+                        window, /* window             */
+                        &shortLen);
+
+   /* The alignment includes all of the database sequence              */
+   *dbLen = entry->seqLen;
+
+   if(noScale)
+      return((REAL)score);
+   return((REAL)score / (REAL)shortLen);
+}
+
+
+/************************************************************************/
+/*>void AlignSettings(char regionCode, int *window, BOOL *noScale)
+   ---------------------------------------------------------------
+*//**
+   \param[in]   regionCode  header[1] of the database entry
+   \param[out]  window      Window size for the alignment
+   \param[out]  noScale     Don't scale the score by length
+
+   Gives the alignment settings for a type of database entry
+
+   - 18.10.26 Original (code from CompareEntry())   By: ACRM
+*/
+void AlignSettings(char regionCode, int *window, BOOL *noScale)
+{
+   *window  = 10;
+   *noScale = FALSE;
+
+   if(regionCode == 'C')
+   {
+      /* Use a window of 10 by default, or a window of 2 for 
+         constant regions
+      */
+      *window = 2;
+   }
+   else if(regionCode == 'D')
+   {
+      /* Don't scale the score if it's a D-segment                      */
+      *noScale = TRUE;
+   }
+}
+
+
+/************************************************************************/
+/*>void ScoreNextSeqs(char *theSeq, GERMREGION *region, GERMVIEW *view,
+                      int entryNum, BOOL *candidate, SEQSCORE *seqScores,
+                      GERMENTRY *bestEntry, REAL maxScore, int maxDbLen)
+   ----------------------------------------------------------------------
+*//**
+   \param[in]     theSeq     The sequence of interest
+   \param[in]     region     The database type being scanned
+   \param[in]     view       The entries being scanned
+   \param[in]     entryNum   The entry that needs a score
+   \param[in]     candidate  Which unique sequences need a score
+   \param[in,out] seqScores  Scores for the unique sequences
+   \param[in]     bestEntry  The best hit so far (or NULL)
+   \param[in]     maxScore   Score of the best hit so far
+   \param[in]     maxDbLen   Length of the best hit so far
+
+   Scores the sequence of an entry against ours with AffineScoreLanes(),
+   along with those of the entries after it that will be needed, in
+   file order, up to a block of ALIGNLANES. Sequences that already have
+   a score or that CantBeatHit() the best hit so far are left out, so
+   once a perfect hit has been found, little more is scored. Sequences
+   containing a '-', longer than MAXLANELEN or with other alignment
+   settings are also left out. The entry's sequence is left without a
+   score if it can't be scored this way (e.g. if the CPU doesn't
+   support it).
+
+   A perfect hit is usually a sequence found whole in ours, as often
+   happens with constant domains. Such a sequence is given its score
+   without aligning and ends the block.
+
+   - 18.10.26 Original (replaces ScoreSeqBlocks())   By: ACRM
+*/
+void ScoreNextSeqs(char *theSeq, GERMREGION *region, GERMVIEW *view,
+                   int entryNum, BOOL *candidate, SEQSCORE *seqScores,
+                   GERMENTRY *bestEntry, REAL maxScore, int maxDbLen)
+{
+   unsigned char packed[MAXLANELEN * ALIGNLANES];
+   int    packedSeqs[ALIGNLANES],
+          packedLengths[ALIGNLANES],
+          nPacked    = 0,
+          packedMax  = 0,
+          window,
+          lane, p;
+   GERMENTRY *first = view->entries[entryNum];
+   char   packedCode = first->header[1];
+   BOOL   noScale;
+
+   /* A '-' in our sequence would be taken as a gap by CalcShortSeqLen()
+      so these are aligned one at a time
+   */
+   if(strchr(theSeq, '-') != NULL)
+      return;
+   AlignSettings(packedCode, &window, &noScale);
+
+   for(; (entryNum<view->nEntries) && (nPacked<ALIGNLANES); entryNum++)
+   {
+      GERMENTRY *entry   = view->entries[entryNum];
+      GERMSEQ   *germSeq = &(region->seqs[entry->seqClass]);
+
+      if(!candidate[entry->seqClass]               ||
+         seqScores[entry->seqClass].done           ||
+         (germSeq->regionCode != packedCode)       ||
+         (germSeq->seqLen < 1)                     ||
+         (germSeq->seqLen > MAXLANELEN)            ||
+         (strchr(germSeq->seq, '-') != NULL)       ||
+         CantBeatHit(theSeq, entry, bestEntry, maxScore, maxDbLen))
+      {
+         /* The entry asked for must be scored some other way           */
+         if(entry == first)
+            return;
+         continue;
+      }
+
+      /* A sequence found whole in ours can only be aligned without
+         gaps, so it scores 1.0. The block stops before it so that the
+         sequences after it can be tested against it with CantBeatHit()
+      */
+      if(!noScale && (strstr(theSeq, germSeq->seq) != NULL))
+      {
+         if(nPacked == 0)
+         {
+            seqScores[entry->seqClass].score = 1.0;
+            seqScores[entry->seqClass].dbLen = germSeq->seqLen;
+            seqScores[entry->seqClass].done  = TRUE;
+            return;
+         }
+         break;
+      }
+
+      /* Identical sequences appear more than once                      */
+      for(lane=0; lane<nPacked; lane++)
+      {
+         if(packedSeqs[lane] == entry->seqClass)
+            break;
+      }
+      if(lane < nPacked)
+         continue;
+
+      packedSeqs[nPacked]    = entry->seqClass;
+      packedLengths[nPacked] = germSeq->seqLen;
+      packedMax              = MAX(packedMax, germSeq->seqLen);
+      nPacked++;
+   }
+   if(nPacked == 0)
+      return;
+
+   /* Interleave the residues from the C-terminal end, padded with
+      zeros, as needed by AffineScoreLanes()
+   */
+   memset(packed, 0, (size_t)packedMax * ALIGNLANES);
+   for(lane=nPacked; lane<ALIGNLANES; lane++)
+   {
+      packedSeqs[lane]    = (-1);
+      packedLengths[lane] = 0;
+   }
+   for(lane=0; lane<nPacked; lane++)
+   {
+      GERMSEQ *germSeq = &(region->seqs[packedSeqs[lane]]);
+
+      for(p=0; p<germSeq->seqLen; p++)
+      {
+         packed[(size_t)p*ALIGNLANES + lane] =
+            (unsigned char)germSeq->seq[germSeq->seqLen - 1 - p];
+      }
+   }
+
+   ScoreBlock(theSeq, packed, packedSeqs, packedLengths, packedMax,
+              packedCode, seqScores);
+}
+
+
+/************************************************************************/
+/*>BOOL ScoreBlock(char *theSeq, unsigned char *residues, int *seqs,
+                   int *lengths, int maxLen, char regionCode,
+                   SEQSCORE *seqScores)
+   ---------------------------------------------------------------
+*//**
+   \param[in]     theSeq      The sequence of interest
+   \param[in]     residues    Interleaved residues for the block
+   \param[in]     seqs        Unique sequence in each lane
+   \param[in]     lengths     Length of the sequence in each lane
+   \param[in]     maxLen      Longest sequence in the block
+   \param[in]     regionCode  Region code (header[1]) for the block
+   \param[in,out] seqScores   Scores for the unique sequences
+   \return                    Success
+
+   Scores a block of sequences. The scores are exactly those that
+   CompareSeqs() would give.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Removed the unused region
+   - 18.10.26 With CHECK_ALIGN, the sequence to check against is taken
+              from the lane rather than the region
+*/
+BOOL ScoreBlock(char *theSeq, unsigned char *residues, int *seqs,
+                int *lengths, int maxLen, char regionCode,
+                SEQSCORE *seqScores)
+{
+   int  scores[ALIGNLANES],
+        shortLens[ALIGNLANES],
+        window,
+        lane;
+   BOOL noScale;
+
+   AlignSettings(regionCode, &window, &noScale);
+
+   if(!AffineScoreLanes(theSeq, strlen(theSeq), residues, lengths,
+                        maxLen,
+                        5,      /* opening penalty    */
+                        1,      /* extension penalty  */
+                        window, /* window             */
+                        scores, shortLens))
+      return(FALSE);
+
+   for(lane=0; lane<ALIGNLANES; lane++)
+   {
+      SEQSCORE *seqScore;
+
+      if(lengths[lane] < 1)
+         continue;
+
+      seqScore        = &(seqScores[seqs[lane]]);
+      seqScore->score = noScale ? (REAL)scores[lane] :
+                                  (REAL)scores[lane] / (REAL)shortLens[lane];
+      seqScore->dbLen = lengths[lane];
+      seqScore->done  = TRUE;
+
+#ifdef CHECK_ALIGN
+      {
+         size_t      size = strlen(theSeq) + lengths[lane] + 1;
+         char        *checkAlign1 = AllocAlignment(size),
+                     *checkAlign2 = AllocAlignment(size),
+                     *checkSeq    = AllocAlignment(lengths[lane] + 1);
+         REAL        checkScore;
+         int         p;
+
+         /* The lane holds the sequence from the C-terminal end         */
+         for(p=0; p<lengths[lane]; p++)
+         {
+            checkSeq[lengths[lane] - 1 - p] =
+               (char)residues[(size_t)p*ALIGNLANES + lane];
+         }
+         checkSeq[lengths[lane]] = '\0';
+
+         checkScore = CompareSeqs(theSeq, checkSeq, window,
+                                  checkAlign1, checkAlign2, noScale);
+         if(checkScore != seqScore->score)
+         {
+            fprintf(stderr, "Warning: block score differs from \
+alignment (%f, expected %f)\n%s\n%s\n", seqScore->score, checkScore,
+                    theSeq, checkSeq);
+         }
+         free(checkAlign1);
+         free(checkAlign2);
+         free(checkSeq);
+      }
+#endif
+   }
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>REAL CompareSeqs(char *theSeq, char *seq, int window, 
+                    char *align1, char *align2, BOOL noScale)
+   ---------------------------------------------------------------------
+*//**
+   \param[in]   theSeq   the sequence of interest
+   \param[in]   seq      the database sequence
+   \param[in]   window   Window size
+   \param[out]  align1   Alignment of our sequence
+   \param[out]  align2   Alignment of database sequence
+   \param[in]   noScale  Don't scale score by length (for D-segment)
+   \return               Score for alignment
+
+   - 31.03.20 Original   By: ACRM
+   - 13.06.22 Changed to use a window in the alignment to speed it up
+              Added window size as a parameter
+   - 26.04.23 Added noScale
+   - 27.04.23 Changed extension penalty from 5 to 1
+   - 18.10.26 Uses AffineAlign() in place of blAffinealignWindow().
+              Compile with -DCHECK_ALIGN to compare the two
+*/
+REAL CompareSeqs(char *theSeq, char *seq, int window,
+                 char *align1, char *align2, BOOL noScale)
+{
+   int  score;
+   int  alignLen;
+   int  shortSeqLen = MIN(strlen(theSeq), strlen(seq));
+   
+   score = AffineAlign(theSeq, strlen(theSeq),
+                       seq, strlen(seq),
+                       5,      /* opening penalty    */
+                       1,      /* extension penalty  */
+                       window, /* window             */
+                       align1,
+                       align2,
+                       &alignLen);
+   align1[alignLen] = align2[alignLen] = '\0';
+
+#ifdef CHECK_ALIGN
+   {
+      size_t      size = strlen(theSeq) + strlen(seq) + 1;
+      char        *checkAlign1 = AllocAlignment(size),
+                  *checkAlign2 = AllocAlignment(size);
+      int         checkScore,
+                  checkLen;
+
+      checkScore = blAffinealignWindow(theSeq, strlen(theSeq),
+                                       seq, strlen(seq),
+                                       FALSE, TRUE, 5, 1, window,
+                                       checkAlign1, checkAlign2,
+                                       &checkLen);
+      checkAlign1[checkLen] = checkAlign2[checkLen] = '\0';
+      if((checkScore != score) ||
+         strcmp(checkAlign1, align1) || strcmp(checkAlign2, align2))
+      {
+         fprintf(stderr, "Warning: %s alignment differs from BiopLib \
+(score %d, expected %d)\n%s\n%s\n", 
+                 AlignKernelName(GetAlignKernel()), score, checkScore,
+                 theSeq, seq);
+      }
+      free(checkAlign1);
+      free(checkAlign2);
+   }
+#endif
+
+   shortSeqLen = CalcShortSeqLen(align1, align2);
+
+#ifdef DEBUG   
+   fprintf(stderr, "\n>>>%s\n", align1);
+   fprintf(stderr, ">>>%s %d\n", align2, shortSeqLen);
+#endif
+
+   if(noScale)
+      return((REAL)score);
+   
+   return((REAL)score / (REAL)shortSeqLen);
+}
+
+
+/************************************************************************/
+int CalcShortSeqLen(char *align1, char *align2)
+{
+   int start, stop, i, len1=0, len2=0,
+      alnLen = strlen(align1);
+   
+
+   /* Find where the alignment starts                                   */
+   for(start=0; start<alnLen; start++)
+   {
+      if((align1[start] != '-') && (align2[start] != '-'))
+         break;
+   }
+   /* Find where the alignment stops                                    */
+   for(stop=alnLen-1; stop>start; stop--)
+   {
+      if((align1[stop] != '-') && (align2[stop] != '-'))
+         break;
+   }
+   /* Step between start and stop and calculate the number of residues 
+      in each sequence
+   */
+   for(i=start; i<=stop; i++)
+   {
+      if(align1[i] != '-')
+         len1++;
+      if(align2[i] != '-')
+         len2++;
+   }
+
+   return(MIN(len1, len2));
+}
+
+
+/************************************************************************/
+/*>void RemoveSequence(char *seq, char *align1, char *align2, 
+                       BOOL verbose)
+   -----------------------------------------------------------
+*//**
+   \param[in,out]   seq        The sequence
+   \param[in]       align1     Our sequence aligned
+   \param[in]       align2     Database sequence aligned
+   \param[in]       verbose    Verbose output
+
+   Finds the region of the sequence that has been aligned with a 
+   database sequence and removes it.
+
+   - 31.03.20 Original   By: ACRM
+   - 18.10.26 The variables only used by the OLD code are declared
+              with it. Nothing is removed if nothing is aligned
+*/
+void RemoveSequence(char *seq, char *align1, char *align2, BOOL verbose)
+{
+   int         i,
+               start  = 0,
+               stop   = -1,
+               alnLen = MAX(strlen(align1), strlen(align2));
+#ifdef OLD
+   int         j;
+   char        buffer[HUGEBUFF+1];
+#endif
+
+   if(verbose)
+   {
+      fprintf(stderr, "Input seq:        %s\n", seq);
+      fprintf(stderr, "Alignment:        %s\n", align1);
+      fprintf(stderr, "                  %s\n", align2);
+      fprintf(stderr, "Alignment length: %d\n", alnLen);
+   }
+   
+   /* Find the start of the aligned region                              */
+   for(i=0; i<alnLen; i++)
+   {
+      if((align1[i] != '-') &&
+         (align2[i] != '-'))
+      {
+         start = i;
+         break;
+      }
+   }
+   
+   /* Find the end of the aligned region                                */
+   for(i=alnLen-1; i>start; i--)
+   {
+      if((align1[i] != '-') &&
+         (align2[i] != '-'))
+      {
+         stop = i;
+         break;
+      }
+   }
+
+   if(verbose)
+      fprintf(stderr, "Start: %d Stop: %d\n", start, stop);
+
+#ifdef OLD
+   /* Copy up to the start                                              */
+   j=0;
+   for(i=0; i<start; i++)
+   {
+      if(align1[i] != '-')
+      {
+         buffer[j++] = align1[i];
+      }
+
+   }
+   
+   /* Copy after the end                                                */
+   for(i=stop+1; i<alnLen; i++)
+   {
+      if(align1[i] != '-')
+      {
+         buffer[j++] = align1[i];
+      }
+   }
+   buffer[j] = '\0';
+   
+   /* Copy this back into seq                                           */
+   i = strlen(seq);
+   strncpy(seq, buffer, i);
+   seq[i] = '\0';
+#else
+   for(i=0; i<strlen(seq); i++)
+   {
+      if((i>=start) && (i<=stop))
+      {
+         seq[i] = 'X';
+      }
+   }
+#endif
+   
+   if(verbose)
+      fprintf(stderr, "Output seq:       %s\n", seq);
+}
+
+
+/************************************************************************/
+/*>void AddDomain(AGLRESULT *result, char *domain, REAL score,
+                  char *match, char *align1, char *align2, int offset)
+   -------------------------------------------------------------------
+*//**
+   \param[in,out] result   The result for the sequence
+   \param[in]     domain   Domain label
+   \param[in]     score    Score for the match
+   \param[in]     match    Match FASTA header
+   \param[in]     align1   Alignment of the query
+   \param[in]     align2   Alignment of the germline
+   \param[in]     offset   Offset of the aligned query in the full
+                           sequence
+
+   Adds a domain to the result. The aligned region is the part between
+   the first and last positions where neither sequence has a gap (as
+   shown by -a), and is given as residue numbers in each sequence.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Copies the alignments to fit
+*/
+void AddDomain(AGLRESULT *result, char *domain, REAL score, char *match,
+               char *align1, char *align2, int offset)
+{
+   AGLDOMAIN *dom;
+   int       alnLen = strlen(align1),
+             pos1   = 0,
+             pos2   = 0,
+             i;
+
+   if(result->nDomains >= MAXDOMAINS)
+      return;
+   dom = &(result->domains[result->nDomains++]);
+
+   strncpy(dom->domain, domain, LABELBUFF-1);
+   dom->domain[LABELBUFF-1] = '\0';
+   strncpy(dom->match,  match,  MAXBUFF);
+   dom->match[MAXBUFF] = '\0';
+   dom->align1    = CopyAlignment(align1);
+   dom->align2    = CopyAlignment(align2);
+   dom->score     = score;
+   dom->seqStart  = dom->seqEnd  = 0;
+   dom->germStart = dom->germEnd = 0;
+
+   for(i=0; i<alnLen; i++)
+   {
+      if(align1[i] != '-')
+         pos1++;
+      if(align2[i] != '-')
+         pos2++;
+      if((align1[i] != '-') && (align2[i] != '-'))
+      {
+         if(dom->seqStart == 0)
+         {
+            dom->seqStart  = pos1 + offset;
+            dom->germStart = pos2;
+         }
+         dom->seqEnd  = pos1 + offset;
+         dom->germEnd = pos2;
+      }
+   }
+}
+
+
+/************************************************************************/
+/*>void DoDSegment(void *arg)
+   --------------------------
+*//**
+   \param[in,out] arg   The SCANJOB for the D segment. after[0] and
+                        after[1] are the V and J scans
+
+   Task to identify the D-segment. The V and J regions are masked out
+   of a copy of the sequence and just the region between them is
+   searched since this is so short. The score is not scaled.
+
+-  26.04.23 Original   By: ACRM   
+-  17.10.26 Takes the germline database instead of the data directory
+-  18.10.26 Adds the D segment to the result rather than printing it
+-  18.10.26 Now a task that fills in a SCANJOB. Masks a copy of the
+            sequence
+-  18.10.26 The D segment and alignments are allocated to fit
+-  18.10.26 Traced for --trace
+*/
+void DoDSegment(void *arg)
+{
+   SCANJOB     *job     = (SCANJOB *)arg,
+               *hv      = job->after[0],
+               *hj      = job->after[1];
+   AGLCONTEXT  *context = job->context;
+   char        *DSeq,
+               *seq;
+   int         seqLen;
+   TRACESPAN   span;
+   
+   job->done = TRUE;
+   SetTraceSeq(job->traceSeq);
+   if(hj->end < 0)
+      return;
+
+   StartTraceSpan(&span);
+
+   seqLen = strlen(job->seq);
+   seq    = CopyAlignment(job->seq);
+   DSeq   = AllocAlignment(seqLen + 1);
+   RemoveSequence(seq, hv->align1, hv->align2, context->verbose);
+   RemoveSequence(seq, hj->align1, hj->align2, context->verbose);
+
+   job->offset = CopyDSegment(DSeq, seq);
+   free(seq);
+   
+   AllocScanAlignments(job, strlen(DSeq), "heavy_d");
+   job->score = ScanAgainstDB("heavy_d", DSeq, context->verbose,
+                              context->species, job->match,
+                              job->align1, job->align2, context->germDB,
+                              context->shortList);
+   free(DSeq);
+   EndTraceSpan(&span, "D segment", "stage", NULL);
+}
+
+/************************************************************************/
+/*>int CopyDSegment(char *DSeq, char *seq)
+   ---------------------------------------
+*//**
+   \param[out]   *DSeq    The region between the V and J segments
+   \param[in]    *seq     Sequence to analyze
+   \return                Offset of DSeq in seq
+
+   Takes the sequence (seq) which has the V and J regions masked out
+   with X characters and then extracts the region between them and
+   copies it into DSeq.
+
+-  26.04.23 Original   By: ACRM   
+-  18.10.26 Returns the offset
+*/
+int CopyDSegment(char *DSeq, char *seq)
+{
+   int inPos  = 0,
+       outPos = 0,
+       offset = 0,
+       block  = BLOCK_UNDEFINED;
+   
+   for(inPos=0, outPos=0;  inPos<strlen(seq);  inPos++)
+   {
+      switch(block)
+      {
+      case BLOCK_UNDEFINED:
+         if(seq[inPos] == 'X') block = BLOCK_X_V;
+         break;
+      case BLOCK_X_V:
+         if(seq[inPos] != 'X')
+         {
+            block  = BLOCK_D;
+            offset = inPos;
+            DSeq[outPos++] = seq[inPos];
+         }
+         break;
+      case BLOCK_D:
+         if(seq[inPos] == 'X')
+         {
+            inPos = strlen(seq+1);
+            break;
+         }
+         DSeq[outPos++] = seq[inPos];
+      }
+   }
+   DSeq[outPos] = '\0';
+   return(offset);
+}
+
+
+/************************************************************************/
+/*>BOOL FindSpecialMatch(char *special, char *CH1, char *CH2, char *CH3)
+   ---------------------------------------------------------------------
+*//**
+     \param[out]  special  Note on the special case (blank if none)
+     \param[in]   CH1    CH1 label
+     \param[in]   CH2    CH2 label
+     \param[in]   CH3    CH3-CHS label
+     \return             True if this was a special case; false otherwise
+
+     Looks for cases where apparent mixed allelic variants actually match
+     a different allelic variant indentifier.
+
+     - 22.02.24 Original   By: ACRM
+     - 18.10.26 Renamed from PrintSpecialMatches(). Stores the note
+                rather than printing it
+*/
+BOOL FindSpecialMatch(char *special, char *CH1, char *CH2, char *CH3)
+{
+   special[0] = '\0';
+
+   CH1 = strchr(CH1, '_');
+   CH1++;
+   TERMAT(CH1, '_');
+   
+   CH2 = strchr(CH2, '_');
+   CH2++;
+   TERMAT(CH2, '_');
+   
+   CH3 = strchr(CH3, '_');
+   CH3++;
+   TERMAT(CH3, '_');
+   
+   if(!strncmp(CH1, "IGHG1*03", 8) &&
+      !strncmp(CH2, "IGHG1*01", 8) &&
+      !strncmp(CH3, "IGHG1*01", 8))
+   {
+      strcpy(special, "*CH1/2/3 matches IGHG1*08");
+      return(TRUE);
+   }
+   else if (!strncmp(CH1, "IGHG1*01", 8) &&
+            !strncmp(CH2, "IGHG1*01", 8) &&
+            !strncmp(CH3, "IGHG1*03", 8))
+   {
+      strcpy(special, "*** CH1/2/3 matches IGHG1*15");
+      return(TRUE);
+   }
+   else if (!strncmp(CH1, "IGHG1*03", 8) &&
+            !strncmp(CH2, "IGHG1*01", 8) &&
+            !strncmp(CH3, "IGHG1*03", 8))
+   {
+      strcpy(special, "*** CH1/2/3 matches IGHG1*03");
+      return(TRUE);
+   }
+   else if (!strncmp(CH1, "IGHG1*01", 8) &&
+            !strncmp(CH3, "IGHG1*04", 8))
+   {
+      strcpy(special, "*** CH1/2/3 matches IGHG1*04");
+      return(TRUE);
+   }
+   else if (!strncmp(CH1, "IGHG1*01", 8) &&
+            !strncmp(CH3, "IGHG1*07", 8))
+   {
+      strcpy(special, "*** CH1/2/3 matches IGHG1*07");
+      return(TRUE);
+   }
+   
+   return(FALSE);
+}
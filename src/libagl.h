@@ -0,0 +1,158 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       libagl.h
+
+   \version    V1.9
+   \date       18.10.26
+   \brief      Library interface for assigning IMGT germlines
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+
+**************************************************************************
+
+   Usage:
+   ======
+   AGLCONTEXT *context;
+   AGLRESULT  result;
+
+   context = InitAGL(dataDir, species, chainType, doDSegment,
+                     DEF_SHORTLIST, FALSE);
+   ...
+   AssignGermlines(context, seq, &result);   (from any thread)
+   ...
+   FreeAGLResult(&result);
+   ...
+   FreeAGL(context);
+
+   Each thread should call FreeAlignWork() before it exits.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+   V1.1   18.10.26  Added LoadAGL()
+   V1.2   18.10.26  Added SetAGLCache() and GetAGLCacheStats()
+   V1.3   18.10.26  Added SetAGLCacheDir()
+   V1.4   18.10.26  Added SetAGLSlack() and DEF_SLACK
+   V1.5   18.10.26  Added SetAGLThreads()
+   V1.6   18.10.26  The alignments in an AGLDOMAIN are allocated to fit.
+                    Added FreeAGLResult()
+   V1.7   18.10.26  Added GetAGLGermlines()
+   V1.8   18.10.26  DEF_SLACK is -1 so the whole sequence is searched
+                    by default
+   V1.9   18.10.26  The shortlist size is kept in the AGLCONTEXT
+
+*************************************************************************/
+#ifndef _LIBAGL_H
+#define _LIBAGL_H
+
+/************************************************************************/
+/* Includes
+*/
+#include "bioplib/SysDefs.h"
+#include "agl.h"
+#include "germdb.h"
+#include "align.h"
+#include "rescache.h"
+#include "taskpool.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define MAXDOMAINS 8            /* Most domains assigned in a sequence  */
+#define DEF_SLACK  (-1)         /* Residues searched either side of the
+                                   region where a domain can be (-1 for
+                                   the whole sequence)                  */
+
+/************************************************************************/
+/* Type definitions
+*/
+typedef struct
+{
+   GERMDB *germDB;              /* Germline database, loaded as needed  */
+   char   species[MAXBUFF+1];   /* "Homo", "Mus" or blank               */
+   int    chainType,            /* CHAINTYPE_ or CHAINTYPE_UNKNOWN to
+                                   work it out for each sequence        */
+          shortList,            /* Germline sequences to align (0 for
+                                   all)                                 */
+          slack;                /* Residues searched outside the region
+                                   where a domain can be (-1 to search
+                                   the whole sequence)                  */
+   BOOL   doDSegment,           /* Find the D segment of heavy chains   */
+          verbose;              /* Verbose output to stderr             */
+   RESCACHE *cache;             /* Results already found (or NULL)      */
+   TASKPOOL *pool;              /* Threads to run scans (or NULL)       */
+}  AGLCONTEXT;
+
+typedef struct
+{
+   char domain[LABELBUFF],      /* Domain label (VH, JH, DH, CH1, ...)  */
+        match[MAXBUFF+1],       /* FASTA header of the best germline    */
+        *align1,                /* Alignment of the query               */
+        *align2;                /* Alignment of the germline            */
+   REAL score;                  /* Fractional sequence identity         */
+   int  seqStart,               /* First and last aligned residues of   */
+        seqEnd,                 /* the query, numbered from 1           */
+        germStart,              /* First and last aligned residues of   */
+        germEnd;                /* the germline, numbered from 1        */
+}  AGLDOMAIN;
+
+typedef struct
+{
+   AGLDOMAIN domains[MAXDOMAINS]; /* Domains found, in output order     */
+   char      special[MAXBUFF+1]; /* Note on mixed IGHG1 alleles (or
+                                    blank)                              */
+   int       nDomains,
+             chainType;         /* CHAINTYPE_UNKNOWN if not identified  */
+   BOOL      chainTypeFound;    /* The chain type was worked out rather
+                                   than given                           */
+}  AGLRESULT;
+
+/************************************************************************/
+/* Prototypes
+*/
+AGLCONTEXT *InitAGL(char *dataDir, char *species, int chainType,
+                    BOOL doDSegment, int shortList, BOOL verbose);
+BOOL AssignGermlines(AGLCONTEXT *context, char *seq, AGLRESULT *result);
+void FreeAGLResult(AGLRESULT *result);
+void LoadAGL(AGLCONTEXT *context);
+char **GetAGLGermlines(AGLCONTEXT *context, int *nGermlines);
+BOOL SetAGLCache(AGLCONTEXT *context, long maxEntries);
+BOOL SetAGLCacheDir(AGLCONTEXT *context, char *cacheDir);
+void SetAGLSlack(AGLCONTEXT *context, int slack);
+BOOL SetAGLThreads(AGLCONTEXT *context, int nThreads);
+void GetAGLCacheStats(AGLCONTEXT *context, long *nSeqs, long *nHits,
+                      long *nDiskHits);
+void FreeAGL(AGLCONTEXT *context);
+
+#endif
@@ -0,0 +1,444 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       pipeline.c
+
+   \version    V1.2
+   \date       18.10.26
+   \brief      Multi-threaded processing of FASTA records
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+   Runs a function over each record of a FASTA file using a pool of
+   worker threads. The calling thread reads the records and puts them
+   on a queue. Each worker takes a record from the queue and processes
+   it, writing the output to a memory buffer. A writer thread writes
+   the buffers out in the order the records were read, so the output
+   is the same as processing the records one at a time.
+
+   The records waiting to be processed or written are kept in a ring
+   of REORDERPERTHREAD slots for each worker. The reader waits when
+   the ring is full, so only that many records are ever held in
+   memory however far the slowest record holds up the writer.
+
+   The records are read with fastain.c, so a record is not copied but
+   is passed to the record function where it lies in the mapped file
+   or input block. The writer releases each record once its output has
+   been written, which is in the order they were read as fastain.c
+   requires.
+
+   The record function must be safe to call from several threads at
+   once.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+   V1.1   18.10.26  Records are read with fastain.c and processed where
+                    they lie rather than being copied
+   V1.2   18.10.26  Reading the records is timed for --stats
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "bioplib/macros.h"
+#include "agl.h"
+#include "align.h"
+#include "fastain.h"
+#include "stats.h"
+#include "pipeline.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define REORDERPERTHREAD 4      /* Records in flight for each worker    */
+
+/************************************************************************/
+/* Type definitions
+*/
+typedef struct
+{
+   FASTAREC fasta;              /* The FASTA record                     */
+   char     *output;            /* Output from the record function      */
+   size_t   outputSize;
+   long     num;                /* Position in the input                */
+}  RECORD;
+
+typedef struct
+{
+   pthread_mutex_t lock;
+   pthread_cond_t  queued,      /* A record is waiting for a worker     */
+                   finished,    /* A record has been processed          */
+                   written;     /* A record has been written            */
+   RECORD     **queue,          /* Ring of records waiting for a worker */
+              **done;           /* Processed records by num % window    */
+   int        window,           /* Slots in each ring                   */
+              queueHead,
+              queueCount;
+   long       nRead,
+              nWritten;
+   BOOL       eof;
+   FASTAIN    *in;
+   FILE       *out;
+   RECORDFUNC processRecord;
+   void       *data;
+}  PIPELINE;
+
+/************************************************************************/
+/* Prototypes
+*/
+static void *Worker(void *arg);
+static void *Writer(void *arg);
+static void ProcessRecord(PIPELINE *pipeline, RECORD *record);
+static void FreeRecord(PIPELINE *pipeline, RECORD *record);
+static BOOL ReadRecord(FASTAIN *in, FASTAREC *fasta);
+
+
+/************************************************************************/
+/*>long RunPipeline(FILE *in, FILE *out, int nThreads,
+                    RECORDFUNC processRecord, void *data)
+   ---------------------------------------------------------
+*//**
+   \param[in]  in             Input FASTA file
+   \param[in]  out            Output file
+   \param[in]  nThreads       Number of worker threads
+   \param[in]  processRecord  Function to call for each record
+   \param[in]  data           Passed to processRecord()
+   \return                    Number of records read
+
+   Calls processRecord() for each record in the FASTA file and writes
+   its output in the order of the input. With one thread (or fewer)
+   the records are simply processed in turn writing straight to out.
+   Nothing must have been read from in unless it is a regular file.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Reads the records with fastain.c
+   - 18.10.26 Reads them with ReadRecord() so the time is counted
+*/
+long RunPipeline(FILE *in, FILE *out, int nThreads,
+                 RECORDFUNC processRecord, void *data)
+{
+   PIPELINE  pipeline;
+   pthread_t workers[MAXTHREADS],
+             writer;
+   FASTAIN   *fastaIn;
+   FASTAREC  fasta;
+   long      nRecords = 0;
+   int       i;
+
+   if((fastaIn = OpenFASTAIn(in))==NULL)
+   {
+      fprintf(stderr, "\nError (agl): No memory for input\n");
+      exit(1);
+   }
+
+   if(nThreads <= 1)
+   {
+      while(ReadRecord(fastaIn, &fasta))
+      {
+         (*processRecord)(out, fasta.header, fasta.seq, data);
+         ReleaseFASTARecord(fastaIn, &fasta);
+         nRecords++;
+      }
+      CloseFASTAIn(fastaIn);
+      return(nRecords);
+   }
+
+   nThreads = MIN(nThreads, MAXTHREADS);
+
+   memset(&pipeline, 0, sizeof(PIPELINE));
+   pipeline.window        = nThreads * REORDERPERTHREAD;
+   pipeline.in            = fastaIn;
+   pipeline.out           = out;
+   pipeline.processRecord = processRecord;
+   pipeline.data          = data;
+
+   if(((pipeline.queue = (RECORD **)calloc(pipeline.window,
+                                           sizeof(RECORD *)))==NULL) ||
+      ((pipeline.done  = (RECORD **)calloc(pipeline.window,
+                                           sizeof(RECORD *)))==NULL))
+   {
+      fprintf(stderr, "\nError (agl): No memory for thread queues\n");
+      exit(1);
+   }
+
+   pthread_mutex_init(&(pipeline.lock), NULL);
+   pthread_cond_init(&(pipeline.queued),   NULL);
+   pthread_cond_init(&(pipeline.finished), NULL);
+   pthread_cond_init(&(pipeline.written),  NULL);
+
+   if(pthread_create(&writer, NULL, Writer, &pipeline))
+   {
+      fprintf(stderr, "\nError (agl): Unable to start writer thread\n");
+      exit(1);
+   }
+   for(i=0; i<nThreads; i++)
+   {
+      if(pthread_create(&(workers[i]), NULL, Worker, &pipeline))
+      {
+         fprintf(stderr, "\nError (agl): Unable to start thread %d\n",
+                 i+1);
+         exit(1);
+      }
+   }
+
+   while(ReadRecord(fastaIn, &fasta))
+   {
+      RECORD *record;
+
+      if((record = (RECORD *)calloc(1, sizeof(RECORD)))==NULL)
+      {
+         fprintf(stderr, "\nError (agl): No memory for sequence\n");
+         exit(1);
+      }
+      record->fasta = fasta;
+
+      pthread_mutex_lock(&(pipeline.lock));
+      while(pipeline.nRead - pipeline.nWritten >= pipeline.window)
+         pthread_cond_wait(&(pipeline.written), &(pipeline.lock));
+      record->num = pipeline.nRead++;
+      pipeline.queue[(pipeline.queueHead + pipeline.queueCount) %
+                     pipeline.window] = record;
+      pipeline.queueCount++;
+      pthread_cond_signal(&(pipeline.queued));
+      pthread_mutex_unlock(&(pipeline.lock));
+   }
+
+   pthread_mutex_lock(&(pipeline.lock));
+   pipeline.eof = TRUE;
+   nRecords     = pipeline.nRead;
+   pthread_cond_broadcast(&(pipeline.queued));
+   pthread_cond_signal(&(pipeline.finished));
+   pthread_mutex_unlock(&(pipeline.lock));
+
+   for(i=0; i<nThreads; i++)
+      pthread_join(workers[i], NULL);
+   pthread_join(writer, NULL);
+
+   pthread_cond_destroy(&(pipeline.written));
+   pthread_cond_destroy(&(pipeline.finished));
+   pthread_cond_destroy(&(pipeline.queued));
+   pthread_mutex_destroy(&(pipeline.lock));
+   free(pipeline.queue);
+   free(pipeline.done);
+   CloseFASTAIn(fastaIn);
+
+   return(nRecords);
+}
+
+
+/************************************************************************/
+/*>int CountCPUs(void)
+   -------------------
+*//**
+   \return   Number of CPUs online (at least 1)
+
+   - 18.10.26 Original   By: ACRM
+*/
+int CountCPUs(void)
+{
+   long nCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+
+   if(nCPUs < 1)
+      return(1);
+   return((int)MIN(nCPUs, MAXTHREADS));
+}
+
+
+/************************************************************************/
+/*>static void *Worker(void *arg)
+   ------------------------------
+*//**
+   \param[in]  arg   The PIPELINE
+   \return           NULL
+
+   Worker thread. Takes records from the queue and processes them
+   until the input is finished and the queue is empty.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void *Worker(void *arg)
+{
+   PIPELINE *pipeline = (PIPELINE *)arg;
+
+   pthread_mutex_lock(&(pipeline->lock));
+   for(;;)
+   {
+      RECORD *record;
+
+      while((pipeline->queueCount == 0) && !pipeline->eof)
+         pthread_cond_wait(&(pipeline->queued), &(pipeline->lock));
+      if(pipeline->queueCount == 0)
+         break;
+
+      record = pipeline->queue[pipeline->queueHead];
+      pipeline->queueHead = (pipeline->queueHead + 1) % pipeline->window;
+      pipeline->queueCount--;
+      pthread_mutex_unlock(&(pipeline->lock));
+
+      ProcessRecord(pipeline, record);
+
+      pthread_mutex_lock(&(pipeline->lock));
+      pipeline->done[record->num % pipeline->window] = record;
+      pthread_cond_signal(&(pipeline->finished));
+   }
+   pthread_mutex_unlock(&(pipeline->lock));
+
+   FreeAlignWork();
+   return(NULL);
+}
+
+
+/************************************************************************/
+/*>static void *Writer(void *arg)
+   ------------------------------
+*//**
+   \param[in]  arg   The PIPELINE
+   \return           NULL
+
+   Writer thread. Waits for each record in turn to be processed and
+   writes out its output.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void *Writer(void *arg)
+{
+   PIPELINE *pipeline = (PIPELINE *)arg;
+
+   pthread_mutex_lock(&(pipeline->lock));
+   for(;;)
+   {
+      int    slot = pipeline->nWritten % pipeline->window;
+      RECORD *record;
+
+      while((pipeline->done[slot] == NULL) &&
+            !(pipeline->eof && (pipeline->nWritten == pipeline->nRead)))
+         pthread_cond_wait(&(pipeline->finished), &(pipeline->lock));
+      if((record = pipeline->done[slot]) == NULL)
+         break;
+      pipeline->done[slot] = NULL;
+      pthread_mutex_unlock(&(pipeline->lock));
+
+      if(record->outputSize)
+         fwrite(record->output, 1, record->outputSize, pipeline->out);
+      FreeRecord(pipeline, record);
+
+      pthread_mutex_lock(&(pipeline->lock));
+      pipeline->nWritten++;
+      pthread_cond_signal(&(pipeline->written));
+   }
+   pthread_mutex_unlock(&(pipeline->lock));
+
+   return(NULL);
+}
+
+
+/************************************************************************/
+/*>static void ProcessRecord(PIPELINE *pipeline, RECORD *record)
+   -------------------------------------------------------------
+*//**
+   \param[in]     pipeline   The PIPELINE
+   \param[in,out] record     The record to process
+
+   Runs the record function with its output going to a memory buffer
+   which is stored in the record.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 The sequence is no longer freed here as it belongs to
+              the input
+*/
+static void ProcessRecord(PIPELINE *pipeline, RECORD *record)
+{
+   FILE *fp;
+
+   if((fp = open_memstream(&(record->output),
+                           &(record->outputSize)))==NULL)
+   {
+      fprintf(stderr, "\nError (agl): No memory for output\n");
+      exit(1);
+   }
+
+   (*pipeline->processRecord)(fp, record->fasta.header,
+                              record->fasta.seq, pipeline->data);
+   fclose(fp);
+}
+
+
+/************************************************************************/
+/*>static void FreeRecord(PIPELINE *pipeline, RECORD *record)
+   ----------------------------------------------------------
+*//**
+   \param[in]  pipeline   The PIPELINE
+   \param[in]  record     Record to free
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Releases the FASTA record
+*/
+static void FreeRecord(PIPELINE *pipeline, RECORD *record)
+{
+   ReleaseFASTARecord(pipeline->in, &(record->fasta));
+   free(record->output);
+   free(record);
+}
+
+
+/************************************************************************/
+/*>static BOOL ReadRecord(FASTAIN *in, FASTAREC *fasta)
+   ----------------------------------------------------
+*//**
+   \param[in]  in       FASTA input
+   \param[out] fasta    The record read
+   \return              Was a record read?
+
+   ReadFASTARecord() timed as the input stage for --stats
+
+   - 18.10.26 Original   By: ACRM
+*/
+static BOOL ReadRecord(FASTAIN *in, FASTAREC *fasta)
+{
+   STATSTIMER timer;
+   BOOL       gotRecord;
+
+   StartStatsTimer(&timer);
+   if((gotRecord = ReadFASTARecord(in, fasta)))
+      StopStatsStage(&timer, STATS_INPUT);
+   return(gotRecord);
+}
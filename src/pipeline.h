@@ -0,0 +1,82 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       pipeline.h
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Multi-threaded processing of FASTA records
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+
+*************************************************************************/
+#ifndef _PIPELINE_H
+#define _PIPELINE_H
+
+/************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include "bioplib/SysDefs.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define MAXTHREADS 256          /* Most worker threads allowed by -j    */
+
+/************************************************************************/
+/* Type definitions
+*/
+/* Called for each record. Everything for the record must be written
+   to out, which is private to the call
+*/
+typedef void (*RECORDFUNC)(FILE *out, char *header, char *seq,
+                           void *data);
+
+/************************************************************************/
+/* Prototypes
+*/
+long RunPipeline(FILE *in, FILE *out, int nThreads,
+                 RECORDFUNC processRecord, void *data);
+int CountCPUs(void);
+
+#endif
@@ -0,0 +1,664 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       rescache.c
+
+   \version    V1.2
+   \date       18.10.26
+   \brief      Cache of results keyed on the sequence and options
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+   An in-memory cache mapping a key string (the normalised sequence and
+   the options used to assign it) to a result string. The cache holds
+   at most a fixed number of entries; when it is full the least
+   recently used entry is dropped. All the functions take the cache's
+   lock so it may be shared between threads.
+
+   Results may also be kept on disk so they last from one run to the
+   next. Each result is a file named from the hash of its key, holding
+   the key on the first line (so a hash collision is just a miss) and
+   then the result. The files are below a sub-directory named after a
+   version string supplied by the caller, so when the version changes
+   the old results are simply never looked at again. Files are written
+   under a temporary name and renamed into place, so several agl
+   processes can share the directory.
+
+**************************************************************************
+
+   Usage:
+   ======
+   See libagl.c
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+   V1.1   18.10.26  Added the on-disk cache
+   V1.2   18.10.26  Paths in the cache directory that are too long are
+                    reported rather than cut short
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "bioplib/macros.h"
+#include "rescache.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define MINBUCKETS 64           /* Size limits of the hash table        */
+#define MAXBUCKETS (1UL<<20)
+
+/************************************************************************/
+/* Prototypes
+*/
+static RESCACHEENTRY *FindEntry(RESCACHE *cache, char *key,
+                                unsigned long hash);
+static void Unlink(RESCACHE *cache, RESCACHEENTRY *entry);
+static void MakeNewest(RESCACHE *cache, RESCACHEENTRY *entry);
+static void DropOldest(RESCACHE *cache);
+static void AddEntry(RESCACHE *cache, char *key, char *value);
+static BOOL DiskPath(RESCACHE *cache, char *key, char *subDir,
+                     char *path);
+static char *ReadDiskResult(RESCACHE *cache, char *key);
+static void WriteDiskResult(RESCACHE *cache, char *key, char *value);
+static BOOL MakeDir(char *dir);
+static void WarnCacheDir(RESCACHE *cache);
+
+
+/************************************************************************/
+/*>RESCACHE *CreateResultCache(long maxEntries)
+   --------------------------------------------
+*//**
+   \param[in]  maxEntries   Most results to keep in memory (0 if the
+                            cache is only to be on disk)
+   \return                  Allocated cache (or NULL)
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Allows 0 entries
+*/
+RESCACHE *CreateResultCache(long maxEntries)
+{
+   RESCACHE *cache;
+
+   if(maxEntries < 0)
+      return(NULL);
+
+   if((cache = (RESCACHE *)calloc(1, sizeof(RESCACHE)))==NULL)
+      return(NULL);
+
+   cache->maxEntries = maxEntries;
+   for(cache->nBuckets = MINBUCKETS;
+       (cache->nBuckets < (unsigned long)maxEntries) &&
+       (cache->nBuckets < MAXBUCKETS);
+       cache->nBuckets *= 2);
+
+   if((cache->buckets =
+       (RESCACHEENTRY **)calloc(cache->nBuckets,
+                                sizeof(RESCACHEENTRY *)))==NULL)
+   {
+      free(cache);
+      return(NULL);
+   }
+
+   pthread_mutex_init(&(cache->lock), NULL);
+   return(cache);
+}
+
+
+/************************************************************************/
+/*>BOOL SetResultCacheDir(RESCACHE *cache, char *dir, char *version)
+   -----------------------------------------------------------------
+*//**
+   \param[in,out] cache     The cache
+   \param[in]     dir       Directory for the on-disk cache
+   \param[in]     version   Version of the data the results come from
+   \return                  Success (FALSE if the directory can't be
+                            created or its path is too long)
+
+   Keeps results on disk in dir/version as well as in memory.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Fails if dir/version is too long rather than cutting it
+              short
+*/
+BOOL SetResultCacheDir(RESCACHE *cache, char *dir, char *version)
+{
+   char path[MAXBUFF+1];
+
+   if((snprintf(path, MAXBUFF, "%s/%s", dir, version) >= MAXBUFF) ||
+      !MakeDir(dir) || !MakeDir(path))
+      return(FALSE);
+
+   strncpy(cache->dir, path, MAXBUFF);
+   cache->dir[MAXBUFF] = '\0';
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>char *FindCachedResult(RESCACHE *cache, char *key)
+   --------------------------------------------------
+*//**
+   \param[in]  cache   The cache
+   \param[in]  key     Key to look up
+   \return             Allocated copy of the result (or NULL if not
+                       cached or no memory)
+
+   Looks up a key, making it the most recently used entry if found.
+   If it isn't in memory, looks on disk and adds it to memory if found
+   there.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Looks on disk
+*/
+char *FindCachedResult(RESCACHE *cache, char *key)
+{
+   RESCACHEENTRY *entry;
+   char          *value = NULL;
+   unsigned long hash   = HashString(key);
+
+   pthread_mutex_lock(&(cache->lock));
+   cache->nLookups++;
+   if((entry = FindEntry(cache, key, hash))!=NULL)
+   {
+      cache->nHits++;
+      Unlink(cache, entry);
+      MakeNewest(cache, entry);
+      value = strdup(entry->value);
+   }
+   pthread_mutex_unlock(&(cache->lock));
+
+   if((value == NULL) && cache->dir[0])
+   {
+      if((value = ReadDiskResult(cache, key))!=NULL)
+      {
+         AddEntry(cache, key, value);
+         pthread_mutex_lock(&(cache->lock));
+         cache->nDiskHits++;
+         pthread_mutex_unlock(&(cache->lock));
+      }
+   }
+
+   return(value);
+}
+
+
+/************************************************************************/
+/*>void CacheResult(RESCACHE *cache, char *key, char *value)
+   ---------------------------------------------------------
+*//**
+   \param[in]  cache   The cache
+   \param[in]  key     Key
+   \param[in]  value   Result to store (copied)
+
+   Adds a result to the cache in memory and, if there is a cache
+   directory, on disk.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Also writes to disk
+*/
+void CacheResult(RESCACHE *cache, char *key, char *value)
+{
+   AddEntry(cache, key, value);
+   if(cache->dir[0])
+      WriteDiskResult(cache, key, value);
+}
+
+
+/************************************************************************/
+/*>void GetResultCacheStats(RESCACHE *cache, long *nLookups, long *nHits,
+                             long *nDiskHits)
+   ----------------------------------------------------------------------
+*//**
+   \param[in]  cache       The cache
+   \param[out] nLookups    Number of lookups
+   \param[out] nHits       Number of those found in memory
+   \param[out] nDiskHits   Number of those found on disk
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Added nDiskHits
+*/
+void GetResultCacheStats(RESCACHE *cache, long *nLookups, long *nHits,
+                         long *nDiskHits)
+{
+   pthread_mutex_lock(&(cache->lock));
+   *nLookups  = cache->nLookups;
+   *nHits     = cache->nHits;
+   *nDiskHits = cache->nDiskHits;
+   pthread_mutex_unlock(&(cache->lock));
+}
+
+
+/************************************************************************/
+/*>void FreeResultCache(RESCACHE *cache)
+   -------------------------------------
+*//**
+   \param[in]  cache   The cache
+
+   - 18.10.26 Original   By: ACRM
+*/
+void FreeResultCache(RESCACHE *cache)
+{
+   if(cache == NULL)
+      return;
+
+   while(cache->oldest != NULL)
+      DropOldest(cache);
+
+   pthread_mutex_destroy(&(cache->lock));
+   free(cache->buckets);
+   free(cache);
+}
+
+
+/************************************************************************/
+/*>unsigned long HashString(char *string)
+   --------------------------------------
+*//**
+   \param[in]  string   String to hash
+   \return              FNV-1a hash
+
+   - 18.10.26 Original   By: ACRM
+*/
+unsigned long HashString(char *string)
+{
+   return(HashBytes(HASH_INIT, string, strlen(string)));
+}
+
+
+/************************************************************************/
+/*>unsigned long HashBytes(unsigned long hash, char *data, size_t size)
+   --------------------------------------------------------------------
+*//**
+   \param[in]  hash   Hash so far (HASH_INIT to start)
+   \param[in]  data   Data to add
+   \param[in]  size   Bytes of data
+   \return            Updated FNV-1a hash
+
+   - 18.10.26 Original (from HashString())   By: ACRM
+*/
+unsigned long HashBytes(unsigned long hash, char *data, size_t size)
+{
+   size_t i;
+
+   for(i=0; i<size; i++)
+   {
+      hash ^= (unsigned char)data[i];
+      hash *= 1099511628211UL;
+   }
+
+   return(hash);
+}
+
+
+/************************************************************************/
+/*>static RESCACHEENTRY *FindEntry(RESCACHE *cache, char *key,
+                                   unsigned long hash)
+   -----------------------------------------------------------
+*//**
+   \param[in]  cache   The cache (locked)
+   \param[in]  key     Key to find
+   \param[in]  hash    Hash of the key
+   \return             The entry or NULL
+
+   - 18.10.26 Original   By: ACRM
+*/
+static RESCACHEENTRY *FindEntry(RESCACHE *cache, char *key,
+                                unsigned long hash)
+{
+   RESCACHEENTRY *entry;
+
+   for(entry = cache->buckets[hash & (cache->nBuckets - 1)];
+       entry != NULL;
+       entry = entry->nextInBucket)
+   {
+      if((entry->hash == hash) && !strcmp(entry->key, key))
+         return(entry);
+   }
+
+   return(NULL);
+}
+
+
+/************************************************************************/
+/*>static void Unlink(RESCACHE *cache, RESCACHEENTRY *entry)
+   ---------------------------------------------------------
+*//**
+   \param[in]  cache   The cache (locked)
+   \param[in]  entry   Entry to take out of the least recently used
+                       list
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void Unlink(RESCACHE *cache, RESCACHEENTRY *entry)
+{
+   if(entry->newer != NULL)
+      entry->newer->older = entry->older;
+   else
+      cache->newest = entry->older;
+
+   if(entry->older != NULL)
+      entry->older->newer = entry->newer;
+   else
+      cache->oldest = entry->newer;
+
+   entry->newer = entry->older = NULL;
+}
+
+
+/************************************************************************/
+/*>static void MakeNewest(RESCACHE *cache, RESCACHEENTRY *entry)
+   -------------------------------------------------------------
+*//**
+   \param[in]  cache   The cache (locked)
+   \param[in]  entry   Entry to put at the head of the least recently
+                       used list
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void MakeNewest(RESCACHE *cache, RESCACHEENTRY *entry)
+{
+   entry->older = cache->newest;
+   entry->newer = NULL;
+   if(cache->newest != NULL)
+      cache->newest->newer = entry;
+   cache->newest = entry;
+   if(cache->oldest == NULL)
+      cache->oldest = entry;
+}
+
+
+/************************************************************************/
+/*>static void DropOldest(RESCACHE *cache)
+   ---------------------------------------
+*//**
+   \param[in]  cache   The cache (locked)
+
+   Removes and frees the least recently used entry.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void DropOldest(RESCACHE *cache)
+{
+   RESCACHEENTRY *entry,
+                 **prev;
+
+   if((entry = cache->oldest) == NULL)
+      return;
+
+   Unlink(cache, entry);
+
+   for(prev = &(cache->buckets[entry->hash & (cache->nBuckets - 1)]);
+       *prev != entry;
+       prev = &((*prev)->nextInBucket));
+   *prev = entry->nextInBucket;
+
+   free(entry->key);
+   free(entry->value);
+   free(entry);
+   cache->nEntries--;
+}
+
+
+/************************************************************************/
+/*>static void AddEntry(RESCACHE *cache, char *key, char *value)
+   -------------------------------------------------------------
+*//**
+   \param[in]  cache   The cache
+   \param[in]  key     Key
+   \param[in]  value   Result to store (copied)
+
+   Adds a result to the in-memory cache, dropping the least recently
+   used entry if it is full. If the key is already there (another
+   thread got there first) nothing is done. Running out of memory just
+   means the result isn't cached.
+
+   - 18.10.26 Original (from CacheResult())   By: ACRM
+*/
+static void AddEntry(RESCACHE *cache, char *key, char *value)
+{
+   RESCACHEENTRY *entry;
+   unsigned long hash = HashString(key),
+                 bucket;
+
+   if(cache->maxEntries == 0)
+      return;
+
+   if((entry = (RESCACHEENTRY *)calloc(1, sizeof(RESCACHEENTRY)))==NULL)
+      return;
+   if(((entry->key   = strdup(key))==NULL) ||
+      ((entry->value = strdup(value))==NULL))
+   {
+      free(entry->key);
+      free(entry);
+      return;
+   }
+   entry->hash = hash;
+   bucket      = hash & (cache->nBuckets - 1);
+
+   pthread_mutex_lock(&(cache->lock));
+   if(FindEntry(cache, key, hash) != NULL)
+   {
+      pthread_mutex_unlock(&(cache->lock));
+      free(entry->key);
+      free(entry->value);
+      free(entry);
+      return;
+   }
+
+   if(cache->nEntries >= cache->maxEntries)
+      DropOldest(cache);
+
+   entry->nextInBucket    = cache->buckets[bucket];
+   cache->buckets[bucket] = entry;
+   MakeNewest(cache, entry);
+   cache->nEntries++;
+   pthread_mutex_unlock(&(cache->lock));
+}
+
+
+/************************************************************************/
+/*>static BOOL DiskPath(RESCACHE *cache, char *key, char *subDir,
+                        char *path)
+   --------------------------------------------------------------
+*//**
+   \param[in]  cache    The cache
+   \param[in]  key      Key
+   \param[out] subDir   Directory for the file (HUGEBUFF+1 chars)
+   \param[out] path     File for the key (HUGEBUFF+1 chars)
+   \return              Success (FALSE if the path is too long)
+
+   Results are spread over 256 sub-directories by the first byte of
+   the hash of the key.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Checks that the path fits and warns if it doesn't
+*/
+static BOOL DiskPath(RESCACHE *cache, char *key, char *subDir,
+                     char *path)
+{
+   unsigned long hash = HashString(key);
+
+   if((snprintf(subDir, HUGEBUFF, "%s/%02lx", cache->dir,
+                hash >> 56) >= HUGEBUFF) ||
+      (snprintf(path, HUGEBUFF, "%s/%016lx", subDir,
+                hash) >= HUGEBUFF))
+   {
+      WarnCacheDir(cache);
+      return(FALSE);
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static char *ReadDiskResult(RESCACHE *cache, char *key)
+   -------------------------------------------------------
+*//**
+   \param[in]  cache   The cache
+   \param[in]  key     Key
+   \return             Allocated result (or NULL if not found)
+
+   - 18.10.26 Original   By: ACRM
+*/
+static char *ReadDiskResult(RESCACHE *cache, char *key)
+{
+   char   subDir[HUGEBUFF+1],
+          path[HUGEBUFF+1],
+          *text,
+          *value = NULL;
+   size_t keyLen = strlen(key);
+   long   size;
+   FILE   *fp;
+
+   if(!DiskPath(cache, key, subDir, path) ||
+      ((fp = fopen(path, "r"))==NULL))
+      return(NULL);
+
+   if(!fseek(fp, 0L, SEEK_END) && ((size = ftell(fp)) > (long)keyLen) &&
+      !fseek(fp, 0L, SEEK_SET) &&
+      ((text = (char *)malloc(size+1))!=NULL))
+   {
+      if((fread(text, 1, size, fp) == (size_t)size) &&
+         !strncmp(text, key, keyLen) && (text[keyLen] == '\n'))
+      {
+         text[size] = '\0';
+         value = strdup(text + keyLen + 1);
+      }
+      free(text);
+   }
+
+   fclose(fp);
+   return(value);
+}
+
+
+/************************************************************************/
+/*>static void WriteDiskResult(RESCACHE *cache, char *key, char *value)
+   --------------------------------------------------------------------
+*//**
+   \param[in]  cache   The cache
+   \param[in]  key     Key
+   \param[in]  value   Result
+
+   Writes the key and result to a temporary file and renames it into
+   place. Failures are ignored - the result just isn't stored.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Warns if the name of the temporary file is too long
+              rather than letting mkstemp() fail on a cut short
+              template
+*/
+static void WriteDiskResult(RESCACHE *cache, char *key, char *value)
+{
+   char subDir[HUGEBUFF+1],
+        path[HUGEBUFF+1],
+        tmpPath[HUGEBUFF+1];
+   int  fd;
+   FILE *fp;
+   BOOL ok;
+
+   if(!DiskPath(cache, key, subDir, path) || !MakeDir(subDir))
+      return;
+
+   if(snprintf(tmpPath, HUGEBUFF, "%s.XXXXXX", path) >= HUGEBUFF)
+   {
+      WarnCacheDir(cache);
+      return;
+   }
+   if((fd = mkstemp(tmpPath)) < 0)
+      return;
+   if((fp = fdopen(fd, "w"))==NULL)
+   {
+      close(fd);
+      unlink(tmpPath);
+      return;
+   }
+
+   ok = (fprintf(fp, "%s\n%s", key, value) >= 0);
+   if(fclose(fp))
+      ok = FALSE;
+
+   if(!ok || rename(tmpPath, path))
+      unlink(tmpPath);
+}
+
+
+/************************************************************************/
+/*>static BOOL MakeDir(char *dir)
+   ------------------------------
+*//**
+   \param[in]  dir   Directory
+   \return           Does the directory now exist?
+
+   - 18.10.26 Original   By: ACRM
+*/
+static BOOL MakeDir(char *dir)
+{
+   struct stat statBuf;
+
+   if(mkdir(dir, 0777) && (errno != EEXIST))
+      return(FALSE);
+   return(!stat(dir, &statBuf) && S_ISDIR(statBuf.st_mode));
+}
+
+
+/************************************************************************/
+/*>static void WarnCacheDir(RESCACHE *cache)
+   -----------------------------------------
+*//**
+   \param[in,out] cache   The cache
+
+   Warns, the first time only, that results can't be kept in the cache
+   directory because the paths in it are too long.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void WarnCacheDir(RESCACHE *cache)
+{
+   pthread_mutex_lock(&(cache->lock));
+   if(!cache->dirWarned)
+   {
+      fprintf(stderr, "Warning (agl): Paths in the cache directory are \
+too long to use (%s)\n", cache->dir);
+      cache->dirWarned = TRUE;
+   }
+   pthread_mutex_unlock(&(cache->lock));
+}
@@ -0,0 +1,113 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       rescache.h
+
+   \version    V1.2
+   \date       18.10.26
+   \brief      Cache of results keyed on the sequence and options
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+   V1.1   18.10.26  Added the on-disk cache
+   V1.2   18.10.26  Paths in the cache directory that are too long are
+                    reported rather than cut short
+
+*************************************************************************/
+#ifndef _RESCACHE_H
+#define _RESCACHE_H
+
+/************************************************************************/
+/* Includes
+*/
+#include <stddef.h>
+#include <pthread.h>
+#include "bioplib/SysDefs.h"
+#include "agl.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define HASH_INIT 14695981039346656037UL /* FNV-1a start value       */
+
+/************************************************************************/
+/* Type definitions
+*/
+typedef struct _rescacheentry
+{
+   struct _rescacheentry *nextInBucket, /* Hash chain                  */
+                         *newer,        /* Least recently used list     */
+                         *older;
+   char          *key,
+                 *value;
+   unsigned long hash;
+}  RESCACHEENTRY;
+
+typedef struct
+{
+   pthread_mutex_t lock;
+   RESCACHEENTRY   **buckets,
+                   *newest,
+                   *oldest;
+   char            dir[MAXBUFF+1]; /* On-disk cache directory or blank  */
+   BOOL            dirWarned;   /* Told the user dir can't be used      */
+   unsigned long   nBuckets;
+   long            maxEntries,  /* 0 for no in-memory cache             */
+                   nEntries,
+                   nLookups,
+                   nHits,
+                   nDiskHits;
+}  RESCACHE;
+
+/************************************************************************/
+/* Prototypes
+*/
+RESCACHE *CreateResultCache(long maxEntries);
+BOOL SetResultCacheDir(RESCACHE *cache, char *dir, char *version);
+char *FindCachedResult(RESCACHE *cache, char *key);
+void CacheResult(RESCACHE *cache, char *key, char *value);
+void GetResultCacheStats(RESCACHE *cache, long *nLookups, long *nHits,
+                         long *nDiskHits);
+void FreeResultCache(RESCACHE *cache);
+unsigned long HashString(char *string);
+unsigned long HashBytes(unsigned long hash, char *data, size_t size);
+
+#endif
@@ -0,0 +1,639 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       server.c
+
+   \version    V1.2
+   \date       18.10.26
+   \brief      Unix domain socket server and client
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+   Runs agl as a daemon listening on a Unix domain socket so that the
+   germline databases stay loaded between requests, and provides the
+   client end.
+
+   The main thread accepts connections and queues them for a pool of
+   worker threads. Each connection is one request: the client sends
+   its input then shuts down its side of the socket for writing, and
+   the worker calls the connection function with the socket as input
+   and output, then closes it. Any number of sequences may be sent in
+   one request.
+
+   The client sends its input from a second thread while it reads the
+   reply, so a large request can't deadlock with the server filling
+   the socket buffer.
+
+   A reply may be sent as frames, each being a channel character
+   (SERVER_OUTPUT or SERVER_ERROR) and the length of the data as 8 hex
+   digits, followed by the data. This lets the client print the errors
+   about its request on its own standard error. Whether a reply is
+   framed is agreed in the request; RunClient() expects a framed reply.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+   V1.1   18.10.26  Added framed replies so that errors reach the client
+   V1.2   18.10.26  Only the owner may connect to the socket
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "bioplib/macros.h"
+#include "agl.h"
+#include "server.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define MAXPENDING 64           /* Connections waiting for a worker     */
+#define IOBUFF     65536        /* Client copy buffer                   */
+
+/************************************************************************/
+/* Type definitions
+*/
+typedef struct
+{
+   pthread_mutex_t lock;
+   pthread_cond_t  queued,      /* A connection is waiting              */
+                   dequeued;    /* A worker has taken a connection      */
+   int      fds[MAXPENDING],    /* Ring of accepted connections         */
+            head,
+            count;
+   CONNFUNC serveConnection;
+   void     *data;
+}  SERVER;
+
+typedef struct
+{
+   FILE *in;
+   int  fd;
+   BOOL ok;
+}  SENDER;
+
+/************************************************************************/
+/* Globals
+*/
+static char sSockPath[MAXBUFF+1]; /* Socket to remove when stopped     */
+
+/************************************************************************/
+/* Prototypes
+*/
+static int Listen(char *sockPath);
+static int Connect(char *sockPath);
+static void *Worker(void *arg);
+static void *Sender(void *arg);
+static BOOL WriteAll(int fd, char *buffer, size_t size);
+static size_t ReadAll(int fd, char *buffer, size_t size);
+static void StopServer(int sig);
+
+
+/************************************************************************/
+/*>BOOL RunServer(char *sockPath, int nThreads, CONNFUNC serveConnection,
+                  void *data)
+   ----------------------------------------------------------------------
+*//**
+   \param[in]  sockPath         Path of the Unix domain socket
+   \param[in]  nThreads         Number of worker threads
+   \param[in]  serveConnection  Function to handle each connection
+   \param[in]  data             Passed to serveConnection()
+   \return                      FALSE if the server couldn't start.
+                                Otherwise it runs until killed
+
+   Listens on the socket and hands each connection to a worker thread.
+   SIGINT or SIGTERM removes the socket and exits.
+
+   - 18.10.26 Original   By: ACRM
+*/
+BOOL RunServer(char *sockPath, int nThreads, CONNFUNC serveConnection,
+               void *data)
+{
+   SERVER    server;
+   pthread_t thread;
+   int       listenFd,
+             i;
+
+   if((listenFd = Listen(sockPath)) < 0)
+      return(FALSE);
+
+   strncpy(sSockPath, sockPath, MAXBUFF);
+   signal(SIGINT,  StopServer);
+   signal(SIGTERM, StopServer);
+   signal(SIGPIPE, SIG_IGN);
+
+   memset(&server, 0, sizeof(SERVER));
+   server.serveConnection = serveConnection;
+   server.data            = data;
+   pthread_mutex_init(&(server.lock), NULL);
+   pthread_cond_init(&(server.queued),   NULL);
+   pthread_cond_init(&(server.dequeued), NULL);
+
+   for(i=0; i<MAX(nThreads, 1); i++)
+   {
+      if(pthread_create(&thread, NULL, Worker, &server) ||
+         pthread_detach(thread))
+      {
+         fprintf(stderr, "\nError (agl): Unable to start thread %d\n",
+                 i+1);
+         unlink(sockPath);
+         return(FALSE);
+      }
+   }
+
+   for(;;)
+   {
+      int fd;
+
+      if((fd = accept(listenFd, NULL, NULL)) < 0)
+      {
+         if(errno != EINTR)
+            perror("Warning (agl): accept");
+         continue;
+      }
+
+      pthread_mutex_lock(&(server.lock));
+      while(server.count == MAXPENDING)
+         pthread_cond_wait(&(server.dequeued), &(server.lock));
+      server.fds[(server.head + server.count) % MAXPENDING] = fd;
+      server.count++;
+      pthread_cond_signal(&(server.queued));
+      pthread_mutex_unlock(&(server.lock));
+   }
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>BOOL RunClient(char *sockPath, char *request, FILE *in, FILE *out,
+                  FILE *err)
+   ------------------------------------------------------------------
+*//**
+   \param[in]  sockPath   Path of the server's socket
+   \param[in]  request    Request line sent before the input. This must
+                          ask for a framed reply
+   \param[in]  in         Input to send to the server
+   \param[in]  out        Where to write the output
+   \param[in]  err        Where to write the errors
+   \return                Success
+
+   Sends a request to a server started with RunServer() and copies
+   each frame of the reply to the output or the errors.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Reads a framed reply
+*/
+BOOL RunClient(char *sockPath, char *request, FILE *in, FILE *out,
+               FILE *err)
+{
+   pthread_t sender;
+   SENDER    senderData;
+   char      *buffer,
+             head[FRAMEHEADLEN+1];
+   size_t    nRead;
+   int       fd;
+   BOOL      ok = TRUE;
+
+   if((fd = Connect(sockPath)) < 0)
+   {
+      fprintf(stderr, "Error (agl): Unable to connect to server at %s\n",
+              sockPath);
+      return(FALSE);
+   }
+
+   if((buffer = (char *)malloc(IOBUFF))==NULL)
+   {
+      fprintf(stderr, "Error (agl): No memory for client buffer\n");
+      close(fd);
+      return(FALSE);
+   }
+
+   signal(SIGPIPE, SIG_IGN);
+   if(!WriteAll(fd, request, strlen(request)))
+   {
+      fprintf(stderr, "Error (agl): Unable to send request\n");
+      free(buffer);
+      close(fd);
+      return(FALSE);
+   }
+
+   senderData.in = in;
+   senderData.fd = fd;
+   senderData.ok = TRUE;
+   if(pthread_create(&sender, NULL, Sender, &senderData))
+   {
+      fprintf(stderr, "Error (agl): Unable to start client thread\n");
+      free(buffer);
+      close(fd);
+      return(FALSE);
+   }
+
+   while((nRead = ReadAll(fd, head, FRAMEHEADLEN)) != 0)
+   {
+      FILE          *dest;
+      unsigned long size;
+      char          *end;
+
+      head[nRead] = '\0';
+      size = strtoul(head+1, &end, 16);
+      if((nRead < FRAMEHEADLEN) || (*end != '\0') ||
+         ((head[0] != SERVER_OUTPUT) && (head[0] != SERVER_ERROR)))
+      {
+         ok = FALSE;
+         break;
+      }
+      dest = (head[0] == SERVER_OUTPUT) ? out : err;
+
+      while(size > 0)
+      {
+         size_t want = MIN(size, IOBUFF);
+
+         if((nRead = ReadAll(fd, buffer, want)) < want)
+         {
+            ok = FALSE;
+            break;
+         }
+         fwrite(buffer, 1, nRead, dest);
+         size -= nRead;
+      }
+      if(!ok)
+         break;
+   }
+
+   pthread_join(sender, NULL);
+   if(!ok || !senderData.ok)
+      fprintf(stderr, "Error (agl): Connection to server failed\n");
+
+   free(buffer);
+   close(fd);
+   return(ok && senderData.ok);
+}
+
+
+/************************************************************************/
+/*>static int Listen(char *sockPath)
+   ---------------------------------
+*//**
+   \param[in]  sockPath   Path of the Unix domain socket
+   \return                Listening socket (-1 on error)
+
+   Creates the socket. A socket file left behind by a server that has
+   died is replaced, but not one with a live server. The socket is
+   created under a umask that allows only the owner to connect, since
+   anyone who can connect can use the server. It must be called before
+   any other threads are started.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 The socket is only accessible by the owner
+*/
+static int Listen(char *sockPath)
+{
+   struct sockaddr_un addr;
+   mode_t             oldMask;
+   int                fd,
+                      status;
+
+   if(strlen(sockPath) >= sizeof(addr.sun_path))
+   {
+      fprintf(stderr, "Error (agl): Socket path is too long: %s\n",
+              sockPath);
+      return(-1);
+   }
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   strcpy(addr.sun_path, sockPath);
+
+   if((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+   {
+      perror("Error (agl): socket");
+      return(-1);
+   }
+
+   oldMask = umask(0077);
+   status  = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+   if((status < 0) && (errno == EADDRINUSE))
+   {
+      int liveFd;
+
+      if((liveFd = Connect(sockPath)) >= 0)
+      {
+         fprintf(stderr, "Error (agl): A server is already running on \
+%s\n", sockPath);
+         close(liveFd);
+         close(fd);
+         umask(oldMask);
+         return(-1);
+      }
+
+      unlink(sockPath);
+      status = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+   }
+   umask(oldMask);
+
+   if(status < 0)
+   {
+      perror("Error (agl): bind");
+      close(fd);
+      return(-1);
+   }
+
+   if(chmod(sockPath, S_IRUSR | S_IWUSR) < 0)
+   {
+      perror("Error (agl): chmod");
+      close(fd);
+      unlink(sockPath);
+      return(-1);
+   }
+
+   if(listen(fd, SOMAXCONN) < 0)
+   {
+      perror("Error (agl): listen");
+      close(fd);
+      unlink(sockPath);
+      return(-1);
+   }
+
+   return(fd);
+}
+
+
+/************************************************************************/
+/*>static int Connect(char *sockPath)
+   ----------------------------------
+*//**
+   \param[in]  sockPath   Path of the Unix domain socket
+   \return                Connected socket (-1 on error)
+
+   - 18.10.26 Original   By: ACRM
+*/
+static int Connect(char *sockPath)
+{
+   struct sockaddr_un addr;
+   int                fd;
+
+   if(strlen(sockPath) >= sizeof(addr.sun_path))
+      return(-1);
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   strcpy(addr.sun_path, sockPath);
+
+   if((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+      return(-1);
+   if(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+   {
+      close(fd);
+      return(-1);
+   }
+   return(fd);
+}
+
+
+/************************************************************************/
+/*>static void *Worker(void *arg)
+   ------------------------------
+*//**
+   \param[in]  arg   The SERVER
+   \return           NULL
+
+   Worker thread. Takes each connection from the queue and serves it.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void *Worker(void *arg)
+{
+   SERVER *server = (SERVER *)arg;
+
+   for(;;)
+   {
+      FILE *in  = NULL,
+           *out = NULL;
+      int  fd,
+           outFd;
+
+      pthread_mutex_lock(&(server->lock));
+      while(server->count == 0)
+         pthread_cond_wait(&(server->queued), &(server->lock));
+      fd = server->fds[server->head];
+      server->head = (server->head + 1) % MAXPENDING;
+      server->count--;
+      pthread_cond_signal(&(server->dequeued));
+      pthread_mutex_unlock(&(server->lock));
+
+      if(((outFd = dup(fd)) < 0) ||
+         ((in  = fdopen(fd,    "r"))==NULL) ||
+         ((out = fdopen(outFd, "w"))==NULL))
+      {
+         fprintf(stderr, "Warning (agl): Unable to serve connection\n");
+         if(in != NULL)
+            fclose(in);
+         else
+            close(fd);
+         if(outFd >= 0)
+            close(outFd);
+         continue;
+      }
+
+      (*server->serveConnection)(in, out, server->data);
+
+      fclose(out);
+      fclose(in);
+   }
+
+   return(NULL);
+}
+
+
+/************************************************************************/
+/*>static void *Sender(void *arg)
+   ------------------------------
+*//**
+   \param[in,out]  arg   The SENDER
+   \return               NULL
+
+   Client thread that copies the input to the server then shuts down
+   the socket for writing to mark the end of the request.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void *Sender(void *arg)
+{
+   SENDER *sender = (SENDER *)arg;
+   char   buffer[HUGEBUFF];
+   size_t nRead;
+
+   while((nRead = fread(buffer, 1, HUGEBUFF, sender->in)) > 0)
+   {
+      if(!WriteAll(sender->fd, buffer, nRead))
+      {
+         sender->ok = FALSE;
+         break;
+      }
+   }
+   shutdown(sender->fd, SHUT_WR);
+
+   return(NULL);
+}
+
+
+/************************************************************************/
+/*>static BOOL WriteAll(int fd, char *buffer, size_t size)
+   -------------------------------------------------------
+*//**
+   \param[in]  fd       File descriptor
+   \param[in]  buffer   Data to write
+   \param[in]  size     Number of bytes
+   \return              Success
+
+   Writes all of a buffer, carrying on after partial writes.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static BOOL WriteAll(int fd, char *buffer, size_t size)
+{
+   while(size > 0)
+   {
+      ssize_t nWritten = write(fd, buffer, size);
+
+      if(nWritten < 0)
+      {
+         if(errno == EINTR)
+            continue;
+         return(FALSE);
+      }
+      buffer += nWritten;
+      size   -= nWritten;
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>BOOL WriteServerFrame(FILE *out, int channel, char *data, size_t size)
+   ----------------------------------------------------------------------
+*//**
+   \param[in]  out       Connection to the client
+   \param[in]  channel   SERVER_OUTPUT or SERVER_ERROR
+   \param[in]  data      Data to send
+   \param[in]  size      Number of bytes
+   \return               Success
+
+   Sends data as one or more frames of a framed reply.
+
+   - 18.10.26 Original   By: ACRM
+*/
+BOOL WriteServerFrame(FILE *out, int channel, char *data, size_t size)
+{
+   do
+   {
+      size_t frameSize = MIN(size, 0xffffffffUL);
+
+      if((fprintf(out, "%c%08lx", channel, (unsigned long)frameSize)
+          != FRAMEHEADLEN) ||
+         (fwrite(data, 1, frameSize, out) != frameSize))
+         return(FALSE);
+      data += frameSize;
+      size -= frameSize;
+   }  while(size > 0);
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static size_t ReadAll(int fd, char *buffer, size_t size)
+   --------------------------------------------------------
+*//**
+   \param[in]  fd       File descriptor
+   \param[out] buffer   Data read
+   \param[in]  size     Number of bytes wanted
+   \return              Number of bytes read (less than size only at the
+                        end of the input or on an error)
+
+   Reads the number of bytes asked for, carrying on after partial
+   reads.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static size_t ReadAll(int fd, char *buffer, size_t size)
+{
+   size_t total = 0;
+
+   while(total < size)
+   {
+      ssize_t nRead = read(fd, buffer+total, size-total);
+
+      if(nRead < 0)
+      {
+         if(errno == EINTR)
+            continue;
+         break;
+      }
+      if(nRead == 0)
+         break;
+      total += nRead;
+   }
+   return(total);
+}
+
+
+/************************************************************************/
+/*>static void StopServer(int sig)
+   -------------------------------
+*//**
+   \param[in]  sig   Signal number
+
+   Signal handler. Removes the socket and exits.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Marked sig as unused
+*/
+static void StopServer(int sig)
+{
+   (void)sig;
+   unlink(sSockPath);
+   _exit(0);
+}
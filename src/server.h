@@ -0,0 +1,86 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       server.h
+
+   \version    V1.1
+   \date       18.10.26
+   \brief      Unix domain socket server and client
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+   V1.1   18.10.26  Added framed replies
+
+*************************************************************************/
+#ifndef _SERVER_H
+#define _SERVER_H
+
+/************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include "bioplib/SysDefs.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define SERVER_OUTPUT 'O'       /* Channels of the frames in a reply    */
+#define SERVER_ERROR  'E'
+#define FRAMEHEADLEN  9         /* Channel and 8 hex digits of length   */
+
+/************************************************************************/
+/* Type definitions
+*/
+/* Called for each connection with the request on in and the reply
+   going to out
+*/
+typedef void (*CONNFUNC)(FILE *in, FILE *out, void *data);
+
+/************************************************************************/
+/* Prototypes
+*/
+BOOL RunServer(char *sockPath, int nThreads, CONNFUNC serveConnection,
+               void *data);
+BOOL RunClient(char *sockPath, char *request, FILE *in, FILE *out,
+               FILE *err);
+BOOL WriteServerFrame(FILE *out, int channel, char *data, size_t size);
+
+#endif
@@ -0,0 +1,484 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       stats.c
+
+   \version    V1.4
+   \date       18.10.26
+   \brief      Counts and times the work done for --stats
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+   Keeps the number of scans of each germline database type and the
+   wall and CPU time they took, with the entries looked at or skipped
+   and the alignments done. Each thread adds to its own counts, so
+   nothing is shared while sequences are being processed; the first
+   time a thread records anything its counts are added to a list under
+   a lock. PrintStats() adds up the counts from every thread.
+
+   The alignment code counts each sequence it scores or aligns and the
+   matrix cells for it with CountStatsAlignments(). These are running
+   totals for the thread; a scan is given the increase between
+   starting and stopping its timer, which is right since a scan runs
+   on one thread. For the SIMD kernels only the cells of the real
+   sequences in the lanes are counted, so the numbers are the same
+   whichever kernel is used.
+
+   The input and output stages are timed in the same way but just
+   count the calls.
+
+   Until EnableStats() is called the timers do nothing.
+
+**************************************************************************
+
+   Usage:
+   ======
+   See stats.h
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+   V1.1   18.10.26  Counts the entries visited and skipped, alignments,
+                    DP cells and ties for each database type. Added
+                    the input and output stages
+   V1.2   18.10.26  Removed the count of entries that couldn't score
+                    enough
+   V1.3   18.10.26  Counts the entries that couldn't beat the best hit
+   V1.4   18.10.26  Counts the entries skipped for the locus apart from
+                    those skipped for the species
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include "stats.h"
+
+/************************************************************************/
+/* Globals
+*/
+static char *sStageNames[NSTATSSTAGES] = {"input", "output"};
+
+static BOOL                sEnabled     = FALSE;
+static THREADSTATS         *sAllStats   = NULL;
+static pthread_mutex_t     sStatsLock   = PTHREAD_MUTEX_INITIALIZER;
+static __thread THREADSTATS *sThreadStats = NULL;
+
+/************************************************************************/
+/* Prototypes
+*/
+static double ReadClock(clockid_t clock);
+static THREADSTATS *ThreadStats(void);
+static STATSTYPE *FindStatsType(THREADSTATS *stats, char *type);
+static void AddStatsType(STATSTYPE *total, STATSTYPE *typeStats);
+static int CompareStatsTypes(const void *a, const void *b);
+
+
+/************************************************************************/
+/*>void EnableStats(void)
+   ----------------------
+*//**
+   Starts counting. Must be called before any threads are started.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void EnableStats(void)
+{
+   sEnabled = TRUE;
+}
+
+
+/************************************************************************/
+/*>BOOL StatsEnabled(void)
+   -----------------------
+*//**
+   \return     Is EnableStats() in force?
+
+   - 18.10.26 Original   By: ACRM
+*/
+BOOL StatsEnabled(void)
+{
+   return(sEnabled);
+}
+
+
+/************************************************************************/
+/*>void StartStatsTimer(STATSTIMER *timer)
+   ---------------------------------------
+*//**
+   \param[out] timer    Timer to start
+
+   Notes the wall clock, this thread's CPU clock and its alignments so
+   far. The counts to be filled in by the caller are cleared.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Notes the alignments
+*/
+void StartStatsTimer(STATSTIMER *timer)
+{
+   THREADSTATS *stats;
+
+   memset(timer, 0, sizeof(STATSTIMER));
+   if(!sEnabled || ((stats = ThreadStats())==NULL))
+      return;
+
+   timer->nAlignments = stats->nAlignments;
+   timer->nCells      = stats->nCells;
+   timer->wallTime = ReadClock(CLOCK_MONOTONIC);
+   timer->cpuTime  = ReadClock(CLOCK_THREAD_CPUTIME_ID);
+}
+
+
+/************************************************************************/
+/*>void StopStatsTimer(STATSTIMER *timer, char *type)
+   --------------------------------------------------
+*//**
+   \param[in]  timer    Timer from StartStatsTimer() in this thread
+   \param[in]  type     The database type scanned
+
+   Counts a scan of the database type and the time since the timer
+   was started.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Adds the counts from the timer and the alignments
+*/
+void StopStatsTimer(STATSTIMER *timer, char *type)
+{
+   THREADSTATS *stats;
+   STATSTYPE   *typeStats;
+
+   if(!sEnabled || ((stats = ThreadStats())==NULL) ||
+      ((typeStats = FindStatsType(stats, type))==NULL))
+      return;
+
+   typeStats->nScans++;
+   typeStats->nVisited          += timer->nVisited;
+   typeStats->nSpeciesSkipped   += timer->nSpeciesSkipped;
+   typeStats->nLocusSkipped     += timer->nLocusSkipped;
+   typeStats->nShortlistSkipped += timer->nShortlistSkipped;
+   typeStats->nPruned           += timer->nPruned;
+   typeStats->nTies             += timer->nTies;
+   typeStats->nAlignments       += stats->nAlignments -
+                                   timer->nAlignments;
+   typeStats->nCells            += stats->nCells - timer->nCells;
+   typeStats->wallTime += ReadClock(CLOCK_MONOTONIC) - timer->wallTime;
+   typeStats->cpuTime  += ReadClock(CLOCK_THREAD_CPUTIME_ID) -
+                          timer->cpuTime;
+}
+
+
+/************************************************************************/
+/*>void StopStatsStage(STATSTIMER *timer, int stage)
+   -------------------------------------------------
+*//**
+   \param[in]  timer    Timer from StartStatsTimer() in this thread
+   \param[in]  stage    STATS_INPUT or STATS_OUTPUT
+
+   Counts a call of the stage and the time since the timer was
+   started.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void StopStatsStage(STATSTIMER *timer, int stage)
+{
+   THREADSTATS *stats;
+
+   if(!sEnabled || (stage < 0) || (stage >= NSTATSSTAGES) ||
+      ((stats = ThreadStats())==NULL))
+      return;
+
+   stats->stages[stage].nCalls++;
+   stats->stages[stage].wallTime += ReadClock(CLOCK_MONOTONIC) -
+                                    timer->wallTime;
+   stats->stages[stage].cpuTime  += ReadClock(CLOCK_THREAD_CPUTIME_ID) -
+                                    timer->cpuTime;
+}
+
+
+/************************************************************************/
+/*>void CountStatsAlignments(long nAlignments, long nCells)
+   --------------------------------------------------------
+*//**
+   \param[in]  nAlignments  Sequences scored or aligned
+   \param[in]  nCells       Matrix cells filled for them
+
+   Adds to this thread's alignment totals.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void CountStatsAlignments(long nAlignments, long nCells)
+{
+   THREADSTATS *stats;
+
+   if(!sEnabled || ((stats = ThreadStats())==NULL))
+      return;
+
+   stats->nAlignments += nAlignments;
+   stats->nCells      += nCells;
+}
+
+
+/************************************************************************/
+/*>void PrintStats(FILE *fp)
+   -------------------------
+*//**
+   \param[in]  fp       Output file pointer
+
+   Prints the counts added up over all the threads, in order of the
+   database type, then the input and output stages, and the peak
+   memory used by the process. Threads still running should be idle.
+
+   - 18.10.26 Original   By: ACRM
+   - 18.10.26 Prints the entries, alignments and ties for each type,
+              the stages and the number of threads
+   - 18.10.26 Prints the entries skipped for the locus
+*/
+void PrintStats(FILE *fp)
+{
+   THREADSTATS   total,
+                 *stats;
+   struct rusage usage;
+   int           nThreads = 0,
+                 i;
+
+   memset(&total, 0, sizeof(THREADSTATS));
+
+   pthread_mutex_lock(&sStatsLock);
+   for(stats=sAllStats; stats!=NULL; stats=stats->next)
+   {
+      for(i=0; i<stats->nTypes; i++)
+      {
+         STATSTYPE *typeStats = FindStatsType(&total,
+                                              stats->types[i].type);
+         if(typeStats != NULL)
+            AddStatsType(typeStats, &(stats->types[i]));
+      }
+      for(i=0; i<NSTATSSTAGES; i++)
+      {
+         total.stages[i].nCalls   += stats->stages[i].nCalls;
+         total.stages[i].wallTime += stats->stages[i].wallTime;
+         total.stages[i].cpuTime  += stats->stages[i].cpuTime;
+      }
+      nThreads++;
+   }
+   pthread_mutex_unlock(&sStatsLock);
+   qsort(total.types, total.nTypes, sizeof(STATSTYPE),
+         CompareStatsTypes);
+
+   fprintf(fp, "\nStatistics (agl)\n");
+   fprintf(fp, "%-10s %8s %10s %10s %10s %10s %10s %8s\n",
+           "Database", "Scans", "Visited", "Species", "Locus",
+           "Shortlist", "Pruned", "Ties");
+   for(i=0; i<total.nTypes; i++)
+   {
+      STATSTYPE *typeStats = &(total.types[i]);
+      fprintf(fp, "%-10s %8ld %10ld %10ld %10ld %10ld %10ld %8ld\n",
+              typeStats->type, typeStats->nScans, typeStats->nVisited,
+              typeStats->nSpeciesSkipped, typeStats->nLocusSkipped,
+              typeStats->nShortlistSkipped, typeStats->nPruned,
+              typeStats->nTies);
+   }
+
+   fprintf(fp, "\n%-10s %11s %14s %12s %12s\n",
+           "Database", "Alignments", "Cells", "Wall(s)", "CPU(s)");
+   for(i=0; i<total.nTypes; i++)
+   {
+      STATSTYPE *typeStats = &(total.types[i]);
+      fprintf(fp, "%-10s %11ld %14ld %12.4f %12.4f\n",
+              typeStats->type, typeStats->nAlignments,
+              typeStats->nCells, typeStats->wallTime,
+              typeStats->cpuTime);
+   }
+
+   fprintf(fp, "\n%-10s %11s %12s %12s\n",
+           "Stage", "Calls", "Wall(s)", "CPU(s)");
+   for(i=0; i<NSTATSSTAGES; i++)
+   {
+      fprintf(fp, "%-10s %11ld %12.4f %12.4f\n",
+              sStageNames[i], total.stages[i].nCalls,
+              total.stages[i].wallTime, total.stages[i].cpuTime);
+   }
+
+   getrusage(RUSAGE_SELF, &usage);
+   fprintf(fp, "\nThreads %d\n", nThreads);
+   fprintf(fp, "Peak memory (KB) %ld\n", (long)usage.ru_maxrss);
+}
+
+
+/************************************************************************/
+/*>void FreeStats(void)
+   --------------------
+*//**
+   Frees the counts of every thread. No thread may record anything
+   afterwards.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void FreeStats(void)
+{
+   THREADSTATS *stats,
+               *next;
+
+   pthread_mutex_lock(&sStatsLock);
+   for(stats=sAllStats; stats!=NULL; stats=next)
+   {
+      next = stats->next;
+      free(stats);
+   }
+   sAllStats = NULL;
+   pthread_mutex_unlock(&sStatsLock);
+
+   sThreadStats = NULL;
+   sEnabled     = FALSE;
+}
+
+
+/************************************************************************/
+/*>static double ReadClock(clockid_t clock)
+   ----------------------------------------
+*//**
+   \param[in]  clock    Clock to read
+   \return              Its time in seconds
+
+   - 18.10.26 Original   By: ACRM
+*/
+static double ReadClock(clockid_t clock)
+{
+   struct timespec now;
+
+   clock_gettime(clock, &now);
+   return((double)now.tv_sec + (double)now.tv_nsec / 1.0e9);
+}
+
+
+/************************************************************************/
+/*>static THREADSTATS *ThreadStats(void)
+   -------------------------------------
+*//**
+   \return     This thread's counts (or NULL if no memory)
+
+   Allocates them and adds them to the list the first time.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static THREADSTATS *ThreadStats(void)
+{
+   if(sThreadStats == NULL)
+   {
+      if((sThreadStats = (THREADSTATS *)calloc(1, sizeof(THREADSTATS)))
+         == NULL)
+         return(NULL);
+
+      pthread_mutex_lock(&sStatsLock);
+      sThreadStats->next = sAllStats;
+      sAllStats          = sThreadStats;
+      pthread_mutex_unlock(&sStatsLock);
+   }
+
+   return(sThreadStats);
+}
+
+
+/************************************************************************/
+/*>static STATSTYPE *FindStatsType(THREADSTATS *stats, char *type)
+   ---------------------------------------------------------------
+*//**
+   \param[in]  stats    Counts to search
+   \param[in]  type     Database type
+   \return              Its counts (or NULL if there are too many
+                        types)
+
+   Finds the counts for a database type, adding them if need be.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static STATSTYPE *FindStatsType(THREADSTATS *stats, char *type)
+{
+   int i;
+
+   for(i=0; i<stats->nTypes; i++)
+   {
+      if(!strcmp(stats->types[i].type, type))
+         return(&(stats->types[i]));
+   }
+
+   if(stats->nTypes >= MAXSTATSTYPES)
+      return(NULL);
+
+   strncpy(stats->types[i].type, type, LABELBUFF-1);
+   return(&(stats->types[stats->nTypes++]));
+}
+
+
+/************************************************************************/
+/*>static void AddStatsType(STATSTYPE *total, STATSTYPE *typeStats)
+   ----------------------------------------------------------------
+*//**
+   \param[in,out] total      Counts for a database type
+   \param[in]     typeStats  More counts for the same type
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void AddStatsType(STATSTYPE *total, STATSTYPE *typeStats)
+{
+   total->nScans            += typeStats->nScans;
+   total->nVisited          += typeStats->nVisited;
+   total->nSpeciesSkipped   += typeStats->nSpeciesSkipped;
+   total->nLocusSkipped     += typeStats->nLocusSkipped;
+   total->nShortlistSkipped += typeStats->nShortlistSkipped;
+   total->nPruned           += typeStats->nPruned;
+   total->nTies             += typeStats->nTies;
+   total->nAlignments       += typeStats->nAlignments;
+   total->nCells            += typeStats->nCells;
+   total->wallTime          += typeStats->wallTime;
+   total->cpuTime           += typeStats->cpuTime;
+}
+
+
+/************************************************************************/
+/*>static int CompareStatsTypes(const void *a, const void *b)
+   ----------------------------------------------------------
+*//**
+   \param[in]  a        STATSTYPE
+   \param[in]  b        STATSTYPE
+   \return              Comparison of their database types for qsort()
+
+   - 18.10.26 Original   By: ACRM
+*/
+static int CompareStatsTypes(const void *a, const void *b)
+{
+   return(strcmp(((STATSTYPE *)a)->type, ((STATSTYPE *)b)->type));
+}
@@ -0,0 +1,157 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       stats.h
+
+   \version    V1.4
+   \date       18.10.26
+   \brief      Counts and times the work done for --stats
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+
+**************************************************************************
+
+   Usage:
+   ======
+   STATSTIMER timer;
+
+   EnableStats();                  (before any threads are started)
+   ...
+   StartStatsTimer(&timer);
+   ... scan the database, filling in timer.nVisited etc ...
+   StopStatsTimer(&timer, type);   (from any thread)
+   ...
+   StartStatsTimer(&timer);
+   ... read a record ...
+   StopStatsStage(&timer, STATS_INPUT);
+   ...
+   CountStatsAlignments(1, cells); (from the alignment code)
+   ...
+   PrintStats(stderr);
+   FreeStats();
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+   V1.1   18.10.26  Counts the entries visited and skipped, alignments,
+                    DP cells and ties for each database type. Added
+                    the input and output stages
+   V1.2   18.10.26  Removed the count of entries that couldn't score
+                    enough
+   V1.3   18.10.26  Counts the entries that couldn't beat the best hit
+   V1.4   18.10.26  Counts the entries skipped for the locus apart from
+                    those skipped for the species
+
+*************************************************************************/
+#ifndef _STATS_H
+#define _STATS_H
+
+/************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include "bioplib/SysDefs.h"
+#include "agl.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define MAXSTATSTYPES 16        /* Most database types counted          */
+
+#define STATS_INPUT   0         /* Stages timed by StopStatsStage()     */
+#define STATS_OUTPUT  1
+#define NSTATSSTAGES  2
+
+/************************************************************************/
+/* Type definitions
+*/
+typedef struct
+{
+   char   type[LABELBUFF];      /* Database type                        */
+   long   nScans,
+          nVisited,             /* Entries considered                   */
+          nSpeciesSkipped,      /* Entries not of the species           */
+          nLocusSkipped,        /* Entries not of the locus             */
+          nShortlistSkipped,    /* Entries not on the k-mer shortlist   */
+          nPruned,              /* Entries that couldn't beat the best  */
+          nTies,                /* Equal scores decided on the name     */
+          nAlignments,          /* Sequences scored or aligned          */
+          nCells;               /* Dynamic programming matrix cells     */
+   double wallTime,             /* Seconds                              */
+          cpuTime;
+}  STATSTYPE;
+
+typedef struct
+{
+   long   nCalls;
+   double wallTime,             /* Seconds                              */
+          cpuTime;
+}  STATSSTAGE;
+
+typedef struct _threadstats
+{
+   struct _threadstats *next;   /* List of every thread's counts        */
+   STATSTYPE           types[MAXSTATSTYPES];
+   STATSSTAGE          stages[NSTATSSTAGES];
+   long                nAlignments, /* Totals for the thread            */
+                       nCells;
+   int                 nTypes;
+}  THREADSTATS;
+
+typedef struct
+{
+   double wallTime,             /* Clocks when the timer was started    */
+          cpuTime;
+   long   nAlignments,          /* Thread's totals when it was started  */
+          nCells,
+          nVisited,             /* Filled in by the caller for a scan   */
+          nSpeciesSkipped,
+          nLocusSkipped,
+          nShortlistSkipped,
+          nPruned,
+          nTies;
+}  STATSTIMER;
+
+/************************************************************************/
+/* Prototypes
+*/
+void EnableStats(void);
+BOOL StatsEnabled(void);
+void StartStatsTimer(STATSTIMER *timer);
+void StopStatsTimer(STATSTIMER *timer, char *type);
+void StopStatsStage(STATSTIMER *timer, int stage);
+void CountStatsAlignments(long nAlignments, long nCells);
+void PrintStats(FILE *fp);
+void FreeStats(void);
+
+#endif
@@ -0,0 +1,523 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       taskpool.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Work-stealing thread pool for graphs of small tasks
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+   Runs a small graph of tasks, each of which may have to wait for
+   others to finish, on a pool of threads. Used to run the database
+   scans for one sequence at the same time.
+
+   Each thread in the pool has a deque of tasks that are ready to run.
+   When a task finishes, any tasks that were only waiting for it go on
+   the bottom of the deque of the thread that ran it, and that thread
+   takes its next task from the bottom, so a chain of tasks tends to
+   stay on one thread. A thread with nothing to do steals the oldest
+   task from the top of another deque. Threads from outside the pool
+   put their tasks on an extra deque and help to run tasks until their
+   own graph is finished, so RunTaskGraph() may be called from any
+   number of threads at once.
+
+   The tasks are only ever linked into one deque at a time, so no
+   memory is allocated once the pool is running.
+
+**************************************************************************
+
+   Usage:
+   ======
+   See taskpool.h
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "bioplib/macros.h"
+#include "taskpool.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+
+/************************************************************************/
+/* Globals
+*/
+/* The deque belonging to this thread if it is in a pool               */
+static __thread TASKDEQUE *sOwnDeque = NULL;
+
+/************************************************************************/
+/* Prototypes
+*/
+static void *PoolThread(void *arg);
+static TASKDEQUE *HomeDeque(TASKPOOL *pool);
+static void PushTask(TASKDEQUE *deque, TASK *task);
+static TASK *TakeTask(TASKPOOL *pool, TASKDEQUE *home);
+static void RunTask(TASKDEQUE *home, TASK *task);
+static void RunGraphInTurn(TASKGRAPH *graph);
+
+
+/************************************************************************/
+/*>TASKPOOL *CreateTaskPool(int nThreads, void (*threadExit)(void))
+   ----------------------------------------------------------------
+*//**
+   \param[in]  nThreads     Number of threads (at most MAXPOOLTHREADS)
+   \param[in]  threadExit   Called by each thread before it exits (or
+                            NULL)
+   \return                  The pool (or NULL if it couldn't be
+                            created)
+
+   - 18.10.26 Original   By: ACRM
+*/
+TASKPOOL *CreateTaskPool(int nThreads, void (*threadExit)(void))
+{
+   TASKPOOL *pool;
+   int      i;
+
+   if((pool = (TASKPOOL *)calloc(1, sizeof(TASKPOOL)))==NULL)
+      return(NULL);
+
+   nThreads         = MIN(MAX(nThreads, 1), MAXPOOLTHREADS);
+   pool->threadExit = threadExit;
+   pthread_mutex_init(&(pool->lock), NULL);
+   pthread_cond_init(&(pool->changed), NULL);
+   for(i=0; i<=nThreads; i++)
+   {
+      pthread_mutex_init(&(pool->deques[i].lock), NULL);
+      pool->deques[i].pool  = pool;
+      pool->deques[i].index = i;
+   }
+
+   for(pool->nThreads=0; pool->nThreads<nThreads; pool->nThreads++)
+   {
+      if(pthread_create(&(pool->threads[pool->nThreads]), NULL,
+                        PoolThread, &(pool->deques[pool->nThreads])))
+      {
+         FreeTaskPool(pool);
+         return(NULL);
+      }
+   }
+
+   return(pool);
+}
+
+
+/************************************************************************/
+/*>void FreeTaskPool(TASKPOOL *pool)
+   ---------------------------------
+*//**
+   \param[in]  pool   Pool from CreateTaskPool() (or NULL)
+
+   Stops the threads and frees the pool. No graphs may still be
+   running.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void FreeTaskPool(TASKPOOL *pool)
+{
+   int i;
+
+   if(pool == NULL)
+      return;
+
+   pthread_mutex_lock(&(pool->lock));
+   pool->stopping = TRUE;
+   pthread_cond_broadcast(&(pool->changed));
+   pthread_mutex_unlock(&(pool->lock));
+
+   for(i=0; i<pool->nThreads; i++)
+      pthread_join(pool->threads[i], NULL);
+
+   for(i=0; i<=pool->nThreads; i++)
+      pthread_mutex_destroy(&(pool->deques[i].lock));
+   pthread_cond_destroy(&(pool->changed));
+   pthread_mutex_destroy(&(pool->lock));
+   free(pool);
+}
+
+
+/************************************************************************/
+/*>void InitTaskGraph(TASKGRAPH *graph)
+   ------------------------------------
+*//**
+   \param[out] graph   An empty graph
+
+   - 18.10.26 Original   By: ACRM
+*/
+void InitTaskGraph(TASKGRAPH *graph)
+{
+   graph->nTasks = graph->nLeft = 0;
+}
+
+
+/************************************************************************/
+/*>TASK *AddTask(TASKGRAPH *graph, TASKFUNC func, void *arg)
+   ---------------------------------------------------------
+*//**
+   \param[in,out] graph   The graph
+   \param[in]     func    Function to run
+   \param[in]     arg     Passed to func
+   \return                The task (or NULL if the graph is full)
+
+   - 18.10.26 Original   By: ACRM
+*/
+TASK *AddTask(TASKGRAPH *graph, TASKFUNC func, void *arg)
+{
+   TASK *task;
+
+   if(graph->nTasks >= MAXTASKS)
+      return(NULL);
+
+   task = &(graph->tasks[graph->nTasks++]);
+   memset(task, 0, sizeof(TASK));
+   task->graph = graph;
+   task->func  = func;
+   task->arg   = arg;
+   return(task);
+}
+
+
+/************************************************************************/
+/*>BOOL AddDependency(TASK *task, TASK *before)
+   --------------------------------------------
+*//**
+   \param[in,out] task     Task that must wait
+   \param[in,out] before   Task that must finish first
+   \return                 Success (FALSE if before has too many
+                           dependents)
+
+   Makes task wait for before. Both must be in the same graph.
+
+   - 18.10.26 Original   By: ACRM
+*/
+BOOL AddDependency(TASK *task, TASK *before)
+{
+   if(before->nDependents >= MAXDEPENDENTS)
+      return(FALSE);
+
+   before->dependents[before->nDependents++] = task;
+   task->nWaiting++;
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>void RunTaskGraph(TASKPOOL *pool, TASKGRAPH *graph)
+   ---------------------------------------------------
+*//**
+   \param[in]     pool    Pool from CreateTaskPool() (or NULL)
+   \param[in,out] graph   The tasks to run
+
+   Runs all the tasks in the graph, each once the tasks it waits for
+   have finished, and returns when they are all done. The calling
+   thread runs tasks too. Without a pool the tasks are run in turn in
+   the order they were added, as far as their dependencies allow.
+   A graph can only be run once.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void RunTaskGraph(TASKPOOL *pool, TASKGRAPH *graph)
+{
+   TASKDEQUE *home;
+   TASK      *ready[MAXTASKS];
+   int       i,
+             nReady = 0;
+
+   if(pool == NULL)
+   {
+      RunGraphInTurn(graph);
+      return;
+   }
+
+   /* Find the ready tasks before queueing any: once the first is queued
+      another thread may finish it and queue its dependents itself
+   */
+   home         = HomeDeque(pool);
+   graph->nLeft = graph->nTasks;
+   for(i=0; i<graph->nTasks; i++)
+   {
+      if(graph->tasks[i].nWaiting == 0)
+         ready[nReady++] = &(graph->tasks[i]);
+   }
+   for(i=0; i<nReady; i++)
+      PushTask(home, ready[i]);
+
+   for(;;)
+   {
+      TASK *task;
+
+      pthread_mutex_lock(&(pool->lock));
+      while((graph->nLeft > 0) && (pool->nQueued == 0))
+         pthread_cond_wait(&(pool->changed), &(pool->lock));
+      if(graph->nLeft == 0)
+      {
+         pthread_mutex_unlock(&(pool->lock));
+         break;
+      }
+      pthread_mutex_unlock(&(pool->lock));
+
+      if((task = TakeTask(pool, home))!=NULL)
+         RunTask(home, task);
+   }
+}
+
+
+/************************************************************************/
+/*>static void *PoolThread(void *arg)
+   ----------------------------------
+*//**
+   \param[in]  arg   The thread's TASKDEQUE
+   \return           NULL
+
+   Runs tasks until the pool is stopped.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void *PoolThread(void *arg)
+{
+   TASKDEQUE *home = (TASKDEQUE *)arg;
+   TASKPOOL  *pool = home->pool;
+
+   sOwnDeque = home;
+
+   for(;;)
+   {
+      TASK *task;
+
+      pthread_mutex_lock(&(pool->lock));
+      while((pool->nQueued == 0) && !pool->stopping)
+         pthread_cond_wait(&(pool->changed), &(pool->lock));
+      if(pool->stopping)
+      {
+         pthread_mutex_unlock(&(pool->lock));
+         break;
+      }
+      pthread_mutex_unlock(&(pool->lock));
+
+      if((task = TakeTask(pool, home))!=NULL)
+         RunTask(home, task);
+   }
+
+   if(pool->threadExit != NULL)
+      (*pool->threadExit)();
+   return(NULL);
+}
+
+
+/************************************************************************/
+/*>static TASKDEQUE *HomeDeque(TASKPOOL *pool)
+   -------------------------------------------
+*//**
+   \param[in]  pool   The pool
+   \return            Deque for tasks made ready by this thread
+
+   A thread in the pool uses its own deque. Any other thread shares the
+   extra deque after those of the pool's threads.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static TASKDEQUE *HomeDeque(TASKPOOL *pool)
+{
+   if((sOwnDeque != NULL) && (sOwnDeque->pool == pool))
+      return(sOwnDeque);
+   return(&(pool->deques[pool->nThreads]));
+}
+
+
+/************************************************************************/
+/*>static void PushTask(TASKDEQUE *deque, TASK *task)
+   --------------------------------------------------
+*//**
+   \param[in,out] deque   Deque to add to
+   \param[in,out] task    Task that is ready to run
+
+   Puts a task on the bottom of a deque and wakes the pool.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void PushTask(TASKDEQUE *deque, TASK *task)
+{
+   TASKPOOL *pool = deque->pool;
+
+   pthread_mutex_lock(&(deque->lock));
+   task->next = NULL;
+   task->prev = deque->bottom;
+   if(deque->bottom != NULL)
+      deque->bottom->next = task;
+   else
+      deque->top = task;
+   deque->bottom = task;
+   pthread_mutex_unlock(&(deque->lock));
+
+   pthread_mutex_lock(&(pool->lock));
+   pool->nQueued++;
+   pthread_cond_broadcast(&(pool->changed));
+   pthread_mutex_unlock(&(pool->lock));
+}
+
+
+/************************************************************************/
+/*>static TASK *TakeTask(TASKPOOL *pool, TASKDEQUE *home)
+   ------------------------------------------------------
+*//**
+   \param[in,out] pool   The pool
+   \param[in,out] home   This thread's deque
+   \return               A task to run (or NULL if another thread got
+                         there first)
+
+   Takes the newest task from our own deque or, failing that, steals
+   the oldest from another.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static TASK *TakeTask(TASKPOOL *pool, TASKDEQUE *home)
+{
+   TASK *task = NULL;
+   int  nDeques = pool->nThreads + 1,
+        i;
+
+   pthread_mutex_lock(&(home->lock));
+   if((task = home->bottom)!=NULL)
+   {
+      home->bottom = task->prev;
+      if(home->bottom != NULL)
+         home->bottom->next = NULL;
+      else
+         home->top = NULL;
+   }
+   pthread_mutex_unlock(&(home->lock));
+
+   for(i=1; (task == NULL) && (i<nDeques); i++)
+   {
+      TASKDEQUE *victim = &(pool->deques[(home->index + i) % nDeques]);
+
+      pthread_mutex_lock(&(victim->lock));
+      if((task = victim->top)!=NULL)
+      {
+         victim->top = task->next;
+         if(victim->top != NULL)
+            victim->top->prev = NULL;
+         else
+            victim->bottom = NULL;
+      }
+      pthread_mutex_unlock(&(victim->lock));
+   }
+
+   if(task != NULL)
+   {
+      pthread_mutex_lock(&(pool->lock));
+      pool->nQueued--;
+      pthread_mutex_unlock(&(pool->lock));
+   }
+   return(task);
+}
+
+
+/************************************************************************/
+/*>static void RunTask(TASKDEQUE *home, TASK *task)
+   ------------------------------------------------
+*//**
+   \param[in,out] home   This thread's deque
+   \param[in,out] task   The task
+
+   Runs a task, queues any tasks that were only waiting for it and
+   marks it as finished.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void RunTask(TASKDEQUE *home, TASK *task)
+{
+   TASKPOOL  *pool  = home->pool;
+   TASKGRAPH *graph = task->graph;
+   int       i;
+
+   (*task->func)(task->arg);
+
+   for(i=0; i<task->nDependents; i++)
+   {
+      if(__sync_sub_and_fetch(&(task->dependents[i]->nWaiting), 1) == 0)
+         PushTask(home, task->dependents[i]);
+   }
+
+   pthread_mutex_lock(&(pool->lock));
+   graph->nLeft--;
+   pthread_cond_broadcast(&(pool->changed));
+   pthread_mutex_unlock(&(pool->lock));
+}
+
+
+/************************************************************************/
+/*>static void RunGraphInTurn(TASKGRAPH *graph)
+   --------------------------------------------
+*//**
+   \param[in,out] graph   The tasks to run
+
+   Runs the tasks in the calling thread. Each pass runs, in the order
+   they were added, the tasks whose dependencies have finished.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void RunGraphInTurn(TASKGRAPH *graph)
+{
+   BOOL done[MAXTASKS];
+   int  i, j;
+
+   for(i=0; i<graph->nTasks; i++)
+      done[i] = FALSE;
+
+   for(graph->nLeft = graph->nTasks; graph->nLeft > 0; )
+   {
+      for(i=0; i<graph->nTasks; i++)
+      {
+         TASK *task = &(graph->tasks[i]);
+
+         if(done[i] || (task->nWaiting > 0))
+            continue;
+
+         (*task->func)(task->arg);
+         for(j=0; j<task->nDependents; j++)
+            task->dependents[j]->nWaiting--;
+         done[i] = TRUE;
+         graph->nLeft--;
+      }
+   }
+}
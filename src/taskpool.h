@@ -0,0 +1,134 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       taskpool.h
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Work-stealing thread pool for graphs of small tasks
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+
+**************************************************************************
+
+   Usage:
+   ======
+   TASKGRAPH graph;
+   TASK      *a, *b, *c;
+
+   InitTaskGraph(&graph);
+   a = AddTask(&graph, FuncA, argA);
+   b = AddTask(&graph, FuncB, argB);
+   c = AddTask(&graph, FuncC, argC);
+   AddDependency(c, a);          (c runs after a and b)
+   AddDependency(c, b);
+   RunTaskGraph(pool, &graph);   (pool may be NULL to run them in turn)
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+
+*************************************************************************/
+#ifndef _TASKPOOL_H
+#define _TASKPOOL_H
+
+/************************************************************************/
+/* Includes
+*/
+#include <pthread.h>
+#include "bioplib/SysDefs.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define MAXTASKS       16       /* Most tasks in a graph                */
+#define MAXDEPENDENTS  8        /* Most tasks waiting on one task       */
+#define MAXPOOLTHREADS 64       /* Most threads in a pool               */
+
+/************************************************************************/
+/* Type definitions
+*/
+typedef void (*TASKFUNC)(void *arg);
+
+typedef struct _task
+{
+   struct _task     *prev,      /* Links in a worker's deque            */
+                    *next,
+                    *dependents[MAXDEPENDENTS]; /* Tasks waiting on this */
+   struct _taskgraph *graph;
+   TASKFUNC         func;
+   void             *arg;
+   int              nWaiting,   /* Tasks still to finish before this    */
+                    nDependents;
+}  TASK;
+
+typedef struct _taskgraph
+{
+   TASK tasks[MAXTASKS];
+   int  nTasks,
+        nLeft;                  /* Tasks not yet finished               */
+}  TASKGRAPH;
+
+typedef struct
+{
+   pthread_mutex_t   lock;      /* Protects the deque                   */
+   TASK              *top,      /* Oldest task - stolen from here       */
+                     *bottom;   /* Newest task - run by the owner       */
+   struct _taskpool  *pool;
+   int               index;     /* Position in the pool's deques        */
+}  TASKDEQUE;
+
+typedef struct _taskpool
+{
+   pthread_mutex_t lock;        /* Held to sleep or wake                */
+   pthread_cond_t  changed;     /* A task has been queued or finished   */
+   pthread_t       threads[MAXPOOLTHREADS];
+   TASKDEQUE       deques[MAXPOOLTHREADS+1]; /* One per thread and one
+                                                for other threads       */
+   int             nThreads,
+                   nQueued;     /* Tasks in all the deques              */
+   BOOL            stopping;
+   void            (*threadExit)(void);
+}  TASKPOOL;
+
+/************************************************************************/
+/* Prototypes
+*/
+TASKPOOL *CreateTaskPool(int nThreads, void (*threadExit)(void));
+void FreeTaskPool(TASKPOOL *pool);
+void InitTaskGraph(TASKGRAPH *graph);
+TASK *AddTask(TASKGRAPH *graph, TASKFUNC func, void *arg);
+BOOL AddDependency(TASK *task, TASK *before);
+void RunTaskGraph(TASKPOOL *pool, TASKGRAPH *graph);
+
+#endif
@@ -0,0 +1,436 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       trace.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Timeline of the work on each sequence for --trace
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+   Writes spans of time as Chrome trace events, which may be viewed in
+   chrome://tracing or https://ui.perfetto.dev. Each span is a
+   complete ("X") event with the number of the sequence it was for in
+   its arguments. Each thread gets its own track.
+
+   Only a sample of the sequences is traced. StartTraceSeq() numbers
+   each sequence and picks out the given percentage of them, evenly
+   spread and starting with the first. The sequence being traced is
+   kept for each thread, so spans for a sequence that isn't traced
+   cost no more than a test. Work handed to another thread must take
+   the sequence number with it (see SetTraceSeq()).
+
+   Each thread builds up its events in a buffer of its own, which is
+   written to the file under a lock when it gets to TRACEFLUSHSIZE
+   bytes. CloseTrace() writes out what is left. The events in the file
+   are therefore not in time order, which the viewers don't mind.
+
+**************************************************************************
+
+   Usage:
+   ======
+   See trace.h
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <pthread.h>
+#include "bioplib/macros.h"
+#include "trace.h"
+
+/************************************************************************/
+/* Globals
+*/
+static FILE                 *sTraceFp    = NULL;
+static double               sTraceStart  = 0.0,
+                            sPercent     = 100.0;
+static long                 sNSeqs       = 0;
+static int                  sNThreads    = 0;
+static THREADTRACE          *sAllTraces  = NULL;
+static pthread_mutex_t      sTraceLock   = PTHREAD_MUTEX_INITIALIZER;
+static __thread THREADTRACE *sThreadTrace = NULL;
+static __thread long        sTraceSeq    = -1;
+
+/************************************************************************/
+/* Prototypes
+*/
+static double TraceTime(void);
+static THREADTRACE *ThreadTrace(void);
+static void AddTraceEvent(THREADTRACE *trace, char *format, ...);
+static void FlushTrace(THREADTRACE *trace);
+
+
+/************************************************************************/
+/*>BOOL OpenTrace(char *filename, double percent)
+   ----------------------------------------------
+*//**
+   \param[in]  filename   File for the trace events
+   \param[in]  percent    Percentage of sequences to trace
+   \return                Success
+
+   Starts the trace. Must be called before any threads are started.
+
+   - 18.10.26 Original   By: ACRM
+*/
+BOOL OpenTrace(char *filename, double percent)
+{
+   if((sTraceFp = fopen(filename, "w"))==NULL)
+      return(FALSE);
+
+   sPercent    = percent;
+   sNSeqs      = 0;
+   sTraceStart = 0.0;
+   sTraceStart = TraceTime();
+
+   fprintf(sTraceFp, "{\"traceEvents\":[\n");
+   fprintf(sTraceFp, "{\"name\":\"process_name\",\"ph\":\"M\",\
+\"pid\":1,\"tid\":0,\"args\":{\"name\":\"agl\"}}");
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>long StartTraceSeq(void)
+   ------------------------
+*//**
+   \return     Number of the sequence if it is to be traced (otherwise
+               -1)
+
+   Called for each sequence before any work is done on it. Decides
+   whether it is in the sample and sets this thread's sequence.
+
+   - 18.10.26 Original   By: ACRM
+*/
+long StartTraceSeq(void)
+{
+   long seqNum;
+
+   sTraceSeq = -1;
+   if(sTraceFp == NULL)
+      return(-1);
+
+   seqNum = __sync_fetch_and_add(&sNSeqs, 1);
+   if((seqNum == 0) ||
+      ((long)(seqNum * sPercent / 100.0) >
+       (long)((seqNum - 1) * sPercent / 100.0)))
+      sTraceSeq = seqNum;
+
+   return(sTraceSeq);
+}
+
+
+/************************************************************************/
+/*>long GetTraceSeq(void)
+   ----------------------
+*//**
+   \return     The sequence this thread is tracing (-1 if none)
+
+   - 18.10.26 Original   By: ACRM
+*/
+long GetTraceSeq(void)
+{
+   return(sTraceSeq);
+}
+
+
+/************************************************************************/
+/*>void SetTraceSeq(long seqNum)
+   -----------------------------
+*//**
+   \param[in]  seqNum   Sequence from GetTraceSeq() (-1 for none)
+
+   Sets the sequence this thread's spans are for. Used by a thread
+   doing work for a sequence started on another, and to stop tracing
+   when a sequence is finished.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void SetTraceSeq(long seqNum)
+{
+   sTraceSeq = seqNum;
+}
+
+
+/************************************************************************/
+/*>void StartTraceSpan(TRACESPAN *span)
+   ------------------------------------
+*//**
+   \param[out] span     Span to start
+
+   Notes the time if this thread's sequence is being traced.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void StartTraceSpan(TRACESPAN *span)
+{
+   span->seqNum = sTraceSeq;
+   if(span->seqNum >= 0)
+      span->start = TraceTime();
+}
+
+
+/************************************************************************/
+/*>void EndTraceSpan(TRACESPAN *span, char *name, char *category,
+                     char *argFormat, ...)
+   --------------------------------------------------------------
+*//**
+   \param[in]  span       Span from StartTraceSpan() in this thread
+   \param[in]  name       Name of the span
+   \param[in]  category   Category of the span
+   \param[in]  argFormat  printf() format for the members of the args
+                          object after the sequence number (or NULL)
+   \param[in]  ...        Values for argFormat
+
+   Adds the span to the trace if its sequence is being traced. Strings
+   in the arguments must be escaped with EscapeTraceString().
+
+   - 18.10.26 Original   By: ACRM
+*/
+void EndTraceSpan(TRACESPAN *span, char *name, char *category,
+                  char *argFormat, ...)
+{
+   THREADTRACE *trace;
+   char        args[TRACEARGSIZE];
+   double      end;
+
+   if((span->seqNum < 0) || ((trace = ThreadTrace())==NULL))
+      return;
+
+   end     = TraceTime();
+   args[0] = '\0';
+   if(argFormat != NULL)
+   {
+      va_list ap;
+
+      args[0] = ',';
+      va_start(ap, argFormat);
+      vsnprintf(args+1, TRACEARGSIZE-1, argFormat, ap);
+      va_end(ap);
+   }
+
+   AddTraceEvent(trace, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\
+\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"seq\":%ld%s}}",
+                 name, category, span->start, end - span->start,
+                 trace->tid, span->seqNum, args);
+}
+
+
+/************************************************************************/
+/*>void EscapeTraceString(char *out, char *in, int maxLen)
+   -------------------------------------------------------
+*//**
+   \param[out] out      Escaped string
+   \param[in]  in       String to escape
+   \param[in]  maxLen   Size of out
+
+   Escapes a string to go inside quotes in the arguments of a span.
+   Control characters are dropped and the string is cut short if need
+   be.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void EscapeTraceString(char *out, char *in, int maxLen)
+{
+   int i = 0;
+
+   for(; (*in != '\0') && (i < maxLen-2); in++)
+   {
+      if((*in == '"') || (*in == '\\'))
+         out[i++] = '\\';
+      if((unsigned char)*in >= ' ')
+         out[i++] = *in;
+   }
+   out[i] = '\0';
+}
+
+
+/************************************************************************/
+/*>void CloseTrace(void)
+   ---------------------
+*//**
+   Writes out the events still held by every thread and finishes the
+   trace file. Threads still running should be idle.
+
+   - 18.10.26 Original   By: ACRM
+*/
+void CloseTrace(void)
+{
+   THREADTRACE *trace,
+               *next;
+
+   if(sTraceFp == NULL)
+      return;
+
+   pthread_mutex_lock(&sTraceLock);
+   for(trace=sAllTraces; trace!=NULL; trace=next)
+   {
+      next = trace->next;
+      if(trace->len)
+         fwrite(trace->data, 1, trace->len, sTraceFp);
+      free(trace->data);
+      free(trace);
+   }
+   sAllTraces = NULL;
+
+   fprintf(sTraceFp, "\n],\n\"displayTimeUnit\":\"ms\"}\n");
+   fclose(sTraceFp);
+   sTraceFp = NULL;
+   pthread_mutex_unlock(&sTraceLock);
+
+   sThreadTrace = NULL;
+   sTraceSeq    = -1;
+}
+
+
+/************************************************************************/
+/*>static double TraceTime(void)
+   -----------------------------
+*//**
+   \return     Microseconds since OpenTrace()
+
+   - 18.10.26 Original   By: ACRM
+*/
+static double TraceTime(void)
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return((double)now.tv_sec * 1.0e6 + (double)now.tv_nsec / 1.0e3 -
+          sTraceStart);
+}
+
+
+/************************************************************************/
+/*>static THREADTRACE *ThreadTrace(void)
+   -------------------------------------
+*//**
+   \return     This thread's events (or NULL if no memory)
+
+   Allocates them and adds them to the list the first time, naming
+   the thread's track.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static THREADTRACE *ThreadTrace(void)
+{
+   if(sThreadTrace == NULL)
+   {
+      if((sThreadTrace = (THREADTRACE *)calloc(1, sizeof(THREADTRACE)))
+         == NULL)
+         return(NULL);
+
+      pthread_mutex_lock(&sTraceLock);
+      sThreadTrace->tid  = ++sNThreads;
+      sThreadTrace->next = sAllTraces;
+      sAllTraces         = sThreadTrace;
+      pthread_mutex_unlock(&sTraceLock);
+
+      AddTraceEvent(sThreadTrace, ",\n{\"name\":\"thread_name\",\
+\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+                    sThreadTrace->tid, sThreadTrace->tid);
+   }
+
+   return(sThreadTrace);
+}
+
+
+/************************************************************************/
+/*>static void AddTraceEvent(THREADTRACE *trace, char *format, ...)
+   ----------------------------------------------------------------
+*//**
+   \param[in,out] trace    The thread's events
+   \param[in]     format   printf() format for the event
+   \param[in]     ...      Values for format
+
+   Adds an event to the thread's buffer, writing the buffer out if it
+   is full enough. The event is dropped if there is no memory.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void AddTraceEvent(THREADTRACE *trace, char *format, ...)
+{
+   va_list ap;
+   int     len;
+
+   va_start(ap, format);
+   len = vsnprintf(NULL, 0, format, ap);
+   va_end(ap);
+
+   if(trace->len + len + 1 > trace->size)
+   {
+      size_t size = MAX(trace->size * 2, trace->len + len + 1);
+      char   *data;
+
+      if((data = (char *)realloc(trace->data, size))==NULL)
+         return;
+      trace->data = data;
+      trace->size = size;
+   }
+
+   va_start(ap, format);
+   vsnprintf(trace->data + trace->len, len + 1, format, ap);
+   va_end(ap);
+   trace->len += len;
+
+   if(trace->len >= TRACEFLUSHSIZE)
+      FlushTrace(trace);
+}
+
+
+/************************************************************************/
+/*>static void FlushTrace(THREADTRACE *trace)
+   ------------------------------------------
+*//**
+   \param[in,out] trace    The thread's events
+
+   Writes the thread's events to the file.
+
+   - 18.10.26 Original   By: ACRM
+*/
+static void FlushTrace(THREADTRACE *trace)
+{
+   pthread_mutex_lock(&sTraceLock);
+   if(sTraceFp != NULL)
+      fwrite(trace->data, 1, trace->len, sTraceFp);
+   pthread_mutex_unlock(&sTraceLock);
+   trace->len = 0;
+}
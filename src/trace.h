@@ -0,0 +1,118 @@
+/************************************************************************/
+/**
+
+   Program:    agl (Assign Germ Line)
+   \file       trace.h
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Timeline of the work on each sequence for --trace
+
+   \copyright  (c) UCL / Prof. Andrew C. R. Martin 2026
+   \author     Prof. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   LICENSE
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file LICENSE.
+
+**************************************************************************
+
+   Description:
+   ============
+
+**************************************************************************
+
+   Usage:
+   ======
+   TRACESPAN seqSpan, span;
+
+   OpenTrace("out.json", 1.0);      (before any threads are started)
+   ...
+   StartTraceSeq();                 (for each sequence)
+   StartTraceSpan(&seqSpan);
+   ...
+   StartTraceSpan(&span);
+   ... one stage ...
+   EndTraceSpan(&span, "name", "category", "\"n\":%d", n);
+   ...
+   EndTraceSpan(&seqSpan, "sequence", "sequence", NULL);
+   SetTraceSeq(-1);
+   ...
+   CloseTrace();
+
+   Work for the sequence done on another thread must first call
+   SetTraceSeq() with the value GetTraceSeq() gave.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original
+
+*************************************************************************/
+#ifndef _TRACE_H
+#define _TRACE_H
+
+/************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stddef.h>
+#include "bioplib/SysDefs.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define TRACEFLUSHSIZE (64*1024) /* A thread's events are written out
+                                   once this many bytes are waiting    */
+#define TRACEARGSIZE   512      /* Longest arguments of an event        */
+
+/************************************************************************/
+/* Type definitions
+*/
+typedef struct _threadtrace
+{
+   struct _threadtrace *next;   /* List of every thread's events        */
+   char   *data;                /* Events not yet written               */
+   size_t size,                 /* Bytes allocated                      */
+          len;                  /* Bytes used                           */
+   int    tid;                  /* Track for the thread                 */
+}  THREADTRACE;
+
+typedef struct
+{
+   double start;                /* Microseconds since OpenTrace()       */
+   long   seqNum;               /* Sequence traced (-1 if not traced)   */
+}  TRACESPAN;
+
+/************************************************************************/
+/* Prototypes
+*/
+BOOL OpenTrace(char *filename, double percent);
+long StartTraceSeq(void);
+long GetTraceSeq(void);
+void SetTraceSeq(long seqNum);
+void StartTraceSpan(TRACESPAN *span);
+void EndTraceSpan(TRACESPAN *span, char *name, char *category,
+                  char *argFormat, ...);
+void EscapeTraceString(char *out, char *in, int maxLen);
+void CloseTrace(void);
+
+#endif
@@ -0,0 +1,404 @@
+#!/usr/bin/perl -s
+#*************************************************************************
+#
+#   Program:    agl (Assign Germ Line)
+#   File:       bench.pl
+#
+#   Version:    V1.2
+#   Date:       18.10.26
+#   Function:   Time agl on a set of standard workloads
+#
+#   Copyright:  (c) UCL / Prof. Andrew C. R. Martin 2026
+#   Author:     Prof. Andrew C. R. Martin
+#   Address:    Institute of Structural and Molecular Biology
+#               Division of Biosciences
+#               University College
+#               Gower Street
+#               London
+#               WC1E 6BT
+#   EMail:      andrew@bioinf.org.uk
+#
+#*************************************************************************
+#
+#   This program is not in the public domain, but it may be copied
+#   according to the conditions laid out in the accompanying file
+#   LICENSE
+#
+#   The code may be modified as required, but any modifications must be
+#   documented so that the person responsible can be identified.
+#
+#   The code may not be sold commercially or included as part of a
+#   commercial product except as described in the file LICENSE.
+#
+#*************************************************************************
+#
+#   Description:
+#   ============
+#   Runs agl with --stats over each workload below. A workload is a
+#   set of the test sequences in src/t, repeated to make up the number
+#   of sequences asked for, and the options to run agl with. Each
+#   workload is run several times and the quickest run is kept.
+#
+#   The results are written as JSON giving, for each workload, the
+#   sequences per second, the peak memory, the counts and time spent
+#   on each germline database type, and the time spent reading and
+#   printing the sequences, as reported by --stats.
+#
+#   If a baseline file written by an earlier run is given, each
+#   workload is compared with it. A workload that has become slower,
+#   or uses more memory, by more than the allowed percentage is
+#   reported and the script exits with a non-zero status. It also
+#   does so if the baseline file doesn't exist or has no results for
+#   a workload, since nothing has then been checked. Timings are only
+#   comparable on the same machine.
+#
+#*************************************************************************
+#
+#   Usage:
+#   ======
+#   bench.pl [-n=nseq] [-r=runs] [-l=percent] [-b=baseline.json]
+#            [-w=baseline.json] [-t=testdir] [agl [datadir]]
+#            -n Sequences in each workload (default 500)
+#            -r Times to run each workload (default 3)
+#            -l Allowed slow-down or growth in percent (default 10)
+#            -b Compare with this baseline
+#            -w Write the results to this file as a new baseline
+#            -t Directory containing the test sequences (default
+#               src/t)
+#
+#   agl defaults to the agl in the directory above this script. The
+#   results are written to standard output and the comparison with
+#   the baseline to standard error.
+#
+#*************************************************************************
+#
+#   Revision History:
+#   =================
+#   V1.0   18.10.26   Original   By: ACRM
+#   V1.1   18.10.26   Reads all the tables printed by --stats
+#   V1.2   18.10.26   Fails if there is no baseline to compare with
+#
+#*************************************************************************
+use strict;
+# Add the path of the executable to the library path
+use FindBin;
+use lib $FindBin::Bin;
+use lib "./";
+use fasta;
+use JSON::PP;
+use Time::HiRes qw(time);
+
+# Each workload is the files of test sequences and the options for agl
+my @workloads =
+    (
+     {'name'    => 'heavy',
+      'files'   => ['Vheavy.faa', 'heavy.faa'],
+      'options' => '-H'},
+     {'name'    => 'light',
+      'files'   => ['Vlight.faa', 'light.faa', '11258L.faa',
+                    'pdb6oz2_0PH_Light.faa'],
+      'options' => '-L'},
+     {'name'    => 'mixed',
+      'files'   => ['both.faa', 'pdb1yqv_0P.faa', '11258L.faa',
+                    '11258H.faa', 'test.faa'],
+      'options' => ''},
+     {'name'    => 'fullheavy',
+      'files'   => ['11258H.faa', '11309H.faa', '11881H.faa'],
+      'options' => '-H'},
+     {'name'    => 'dsegment',
+      'files'   => ['heavy.faa', '11258H.faa', '11309H.faa',
+                    '11881H.faa'],
+      'options' => '-H -D'},
+     {'name'    => 'species',
+      'files'   => ['both.faa', 'pdb1yqv_0P.faa', '11258L.faa',
+                    '11258H.faa', 'test.faa'],
+      'options' => '-s Homo'}
+    );
+
+my $nSeqs   = defined($::n) ? $::n : 500;
+my $nRuns   = defined($::r) ? $::r : 3;
+my $limit   = defined($::l) ? $::l : 10;
+my $testDir = defined($::t) ? $::t : "$FindBin::Bin/../src/t";
+my $agl     = (scalar(@ARGV) ? shift(@ARGV) : "$FindBin::Bin/../agl");
+my $dataDir = (scalar(@ARGV) ? shift(@ARGV) : '');
+
+UsageDie() if(defined($::h) || ($nSeqs < 1) || ($nRuns < 1));
+
+if(! -x $agl)
+{
+    print STDERR "Error (bench.pl): $agl is not executable\n";
+    exit 1;
+}
+
+my $tmpDir = "/tmp/aglbench_$$";
+mkdir($tmpDir) || die "Can't create $tmpDir";
+
+my %results = ('agl'       => $agl,
+               'sequences' => $nSeqs + 0,
+               'runs'      => $nRuns + 0,
+               'workloads' => {});
+
+foreach my $workload (@workloads)
+{
+    print STDERR "Running $$workload{'name'}...\n";
+    my $seqFile = WriteWorkload($workload, $testDir, $tmpDir, $nSeqs);
+    $results{'workloads'}{$$workload{'name'}} =
+        RunWorkload($agl, $dataDir, $$workload{'options'}, $seqFile,
+                    $tmpDir, $nSeqs, $nRuns);
+}
+
+`rm -rf $tmpDir`;
+
+my $json = JSON::PP->new->pretty->canonical;
+print $json->encode(\%results);
+
+if(defined($::w))
+{
+    if(open(my $fp, '>', $::w))
+    {
+        print $fp $json->encode(\%results);
+        close $fp;
+        print STDERR "Baseline written to $::w\n";
+    }
+    else
+    {
+        print STDERR "Error (bench.pl): Can't write $::w\n";
+        exit 1;
+    }
+}
+
+if(defined($::b))
+{
+    exit(CompareBaseline(\%results, $::b, $limit) ? 0 : 1);
+}
+
+#*************************************************************************
+# Writes a FASTA file containing the sequences from the workload's
+# files, repeated to make up $nSeqs sequences, each with its own
+# header. Returns the filename
+sub WriteWorkload
+{
+    my($workload, $testDir, $tmpDir, $nSeqs) = @_;
+
+    my @seqs = ();
+    foreach my $file (@{$$workload{'files'}})
+    {
+        if(open(my $fp, '<', "$testDir/$file"))
+        {
+            my($id, $info, $sequence);
+            while((($id, $info, $sequence) = fasta::ReadFasta($fp)) &&
+                  ($id ne ''))
+            {
+                push @seqs, $sequence;
+            }
+            close $fp;
+        }
+        else
+        {
+            print STDERR "Error (bench.pl): Can't read $testDir/$file\n";
+            exit 1;
+        }
+    }
+
+    my $seqFile = "$tmpDir/$$workload{'name'}.faa";
+    open(my $fp, '>', $seqFile) || die "Can't write $seqFile";
+    for(my $i=0; $i<$nSeqs; $i++)
+    {
+        print $fp ">seq$i\n$seqs[$i % scalar(@seqs)]\n";
+    }
+    close $fp;
+
+    return($seqFile);
+}
+
+#*************************************************************************
+# Runs agl on the sequence file $nRuns times and returns a hash of the
+# results of the quickest run
+sub RunWorkload
+{
+    my($agl, $dataDir, $options, $seqFile, $tmpDir, $nSeqs, $nRuns) = @_;
+
+    my $statsFile = "$tmpDir/stats.txt";
+    $options .= " -d $dataDir" if($dataDir ne '');
+
+    my %best = ();
+    for(my $run=0; $run<$nRuns; $run++)
+    {
+        my $start = time();
+        my $status = system("$agl --stats $options $seqFile " .
+                            ">/dev/null 2>$statsFile");
+        my $seconds = time() - $start;
+
+        if($status)
+        {
+            print STDERR "Error (bench.pl): $agl failed on $seqFile\n";
+            exit 1;
+        }
+
+        if(!defined($best{'seconds'}) || ($seconds < $best{'seconds'}))
+        {
+            %best = ReadStats($statsFile);
+            $best{'options'}    = $options;
+            $best{'seconds'}    = $seconds;
+            $best{'seqsPerSec'} = $nSeqs / $seconds;
+        }
+    }
+
+    return(\%best);
+}
+
+#*************************************************************************
+# Reads the output of --stats. Returns a hash containing the peak
+# memory, a hash of the counts and times for each database type, and
+# a hash of the calls and times for the input and output stages. The
+# keys for each table come from its column headings
+sub ReadStats
+{
+    my($statsFile) = @_;
+
+    my %stats   = ('peakKB'  => 0,
+                   'regions' => {},
+                   'stages'  => {});
+    my $table   = '';
+    my @columns = ();
+
+    open(my $fp, '<', $statsFile) || die "Can't read $statsFile";
+    while(<$fp>)
+    {
+        chomp;
+        if(/^(Database|Stage)\s/)
+        {
+            $table = ($1 eq 'Database') ? 'regions' : 'stages';
+            (undef, @columns) = split;
+            foreach my $column (@columns)
+            {
+                $column = lc($column);
+                $column =~ s/\(s\)$//;
+            }
+        }
+        elsif(/^Peak memory \(KB\)\s+(\d+)/)
+        {
+            $stats{'peakKB'} = $1 + 0;
+        }
+        elsif(/^\s*$/)
+        {
+            $table = '';
+        }
+        elsif($table ne '')
+        {
+            my($name, @values) = split;
+            for(my $i=0; $i<scalar(@columns); $i++)
+            {
+                $stats{$table}{$name}{$columns[$i]} = $values[$i] + 0;
+            }
+        }
+    }
+    close $fp;
+
+    return(%stats);
+}
+
+#*************************************************************************
+# Compares the results with those in the baseline file, reporting each
+# workload. Returns FALSE if any has become slower or bigger by more
+# than $limit percent, or if the baseline is missing or lacks a
+# workload
+sub CompareBaseline
+{
+    my($results, $baselineFile, $limit) = @_;
+
+    my $baseline;
+    if(open(my $fp, '<', $baselineFile))
+    {
+        local $/ = undef;
+        $baseline = decode_json(<$fp>);
+        close $fp;
+    }
+    else
+    {
+        print STDERR "Error (bench.pl): No baseline in $baselineFile. " .
+            "Use 'make benchbase' to create one\n";
+        return(0);
+    }
+
+    my $ok = 1;
+    printf STDERR "\n%-12s %12s %12s %8s %12s %12s %8s\n",
+        'Workload', 'Seqs/s', 'Baseline', 'Change',
+        'Peak(KB)', 'Baseline', 'Change';
+
+    foreach my $name (sort keys %{$$results{'workloads'}})
+    {
+        my $new = $$results{'workloads'}{$name};
+        my $old = $$baseline{'workloads'}{$name};
+
+        if(!defined($old))
+        {
+            printf STDERR "%-12s %12.1f %12s %8s %12d %12s %8s%s\n",
+                $name, $$new{'seqsPerSec'}, 'none', '',
+                $$new{'peakKB'}, 'none', '', ' NO BASELINE';
+            $ok = 0;
+            next;
+        }
+
+        my $speed  = Change($$new{'seqsPerSec'}, $$old{'seqsPerSec'});
+        my $memory = Change($$new{'peakKB'},     $$old{'peakKB'});
+        my $flag   = '';
+        if((-$speed > $limit) || ($memory > $limit))
+        {
+            $flag = ' REGRESSION';
+            $ok   = 0;
+        }
+
+        printf STDERR "%-12s %12.1f %12.1f %7.1f%% %12d %12d %7.1f%%%s\n",
+            $name, $$new{'seqsPerSec'}, $$old{'seqsPerSec'}, $speed,
+            $$new{'peakKB'}, $$old{'peakKB'}, $memory, $flag;
+    }
+
+    if($$results{'sequences'} != $$baseline{'sequences'})
+    {
+        print STDERR "Warning: the baseline used " .
+            "$$baseline{'sequences'} sequences per workload\n";
+    }
+
+    return($ok);
+}
+
+#*************************************************************************
+# Returns the percentage change from $old to $new
+sub Change
+{
+    my($new, $old) = @_;
+    return(0) if($old == 0);
+    return(100.0 * ($new - $old) / $old);
+}
+
+#*************************************************************************
+sub UsageDie
+{
+    print <<__EOF;
+
+bench.pl V1.2 (c) 2026 UCL, Prof. Andrew C.R. Martin
+
+Usage: bench.pl [-n=nseq] [-r=runs] [-l=percent] [-b=baseline.json]
+                [-w=baseline.json] [-t=testdir] [agl [datadir]]
+       -n Sequences in each workload (default 500)
+       -r Times to run each workload (default 3)
+       -l Allowed slow-down or growth in percent (default 10)
+       -b Compare with this baseline
+       -w Write the results to this file as a new baseline
+       -t Directory containing the test sequences (default src/t)
+
+Times agl on a set of standard workloads, writing the sequences per
+second, peak memory and time spent scanning each germline database
+type as JSON to standard output. With -b, the results are compared
+with an earlier run and any workload that has become slower or uses
+more memory by more than the allowed percentage is reported on
+standard error; the exit status is then non-zero. It is also non-zero
+if the baseline doesn't exist or has no results for a workload.
+
+agl defaults to the agl in the directory above this script.
+
+__EOF
+
+    exit 0;
+}
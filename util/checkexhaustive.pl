@@ -0,0 +1,147 @@
+#!/usr/bin/perl -s
+#*************************************************************************
+#
+#   Program:    agl (Assign Germ Line)
+#   File:       checkexhaustive.pl
+#
+#   Version:    V1.0
+#   Date:       18.10.26
+#   Function:   Check that agl gives the same results by default as
+#               with -x
+#
+#   Copyright:  (c) UCL / Prof. Andrew C. R. Martin 2026
+#   Author:     Prof. Andrew C. R. Martin
+#   Address:    Institute of Structural and Molecular Biology
+#               Division of Biosciences
+#               University College
+#               Gower Street
+#               London
+#               WC1E 6BT
+#   EMail:      andrew@bioinf.org.uk
+#
+#*************************************************************************
+#
+#   This program is not in the public domain, but it may be copied
+#   according to the conditions laid out in the accompanying file
+#   LICENSE
+#
+#   The code may be modified as required, but any modifications must be
+#   documented so that the person responsible can be identified.
+#
+#   The code may not be sold commercially or included as part of a
+#   commercial product except as described in the file LICENSE.
+#
+#*************************************************************************
+#
+#   Description:
+#   ============
+#   Runs agl on each file of test sequences in src/t, with each set of
+#   options below, once with the default options and once with -x to
+#   align against every germline sequence. Anything that speeds up the
+#   default search must not change the results, so any difference is
+#   reported and the script exits with a non-zero status.
+#
+#   src/t/shortlist.faa holds sequences whose best V match is not
+#   among the 30 sharing most k-mers with them.
+#
+#*************************************************************************
+#
+#   Usage:
+#   ======
+#   checkexhaustive.pl [-t=testdir] [agl [datadir]]
+#            -t Directory containing the test sequences (default
+#               src/t)
+#
+#   agl defaults to the agl in the directory above this script.
+#
+#*************************************************************************
+#
+#   Revision History:
+#   =================
+#   V1.0   18.10.26   Original   By: ACRM
+#
+#*************************************************************************
+use strict;
+use FindBin;
+
+# Options each file is run with
+my @optionSets = ('-a', '-H -D -a', '-L -a', '-s Mus -a');
+
+my $testDir = defined($::t) ? $::t : "$FindBin::Bin/../src/t";
+my $agl     = (scalar(@ARGV) ? shift(@ARGV) : "$FindBin::Bin/../agl");
+my $dataDir = (scalar(@ARGV) ? shift(@ARGV) : '');
+
+UsageDie() if(defined($::h));
+
+if(! -x $agl)
+{
+    print STDERR "Error (checkexhaustive.pl): $agl is not executable\n";
+    exit 1;
+}
+
+my @files = sort(glob("$testDir/*.faa"));
+if(!scalar(@files))
+{
+    print STDERR "Error (checkexhaustive.pl): No test sequences in " .
+        "$testDir\n";
+    exit 1;
+}
+
+my $nFailed = 0;
+foreach my $file (@files)
+{
+    foreach my $options (@optionSets)
+    {
+        my $default    = RunAGL($agl, $dataDir, $options, $file);
+        my $exhaustive = RunAGL($agl, $dataDir, "$options -x", $file);
+
+        if($default ne $exhaustive)
+        {
+            print STDERR "FAILED: agl $options $file differs from -x\n";
+            $nFailed++;
+        }
+    }
+}
+
+my $nRuns = scalar(@files) * scalar(@optionSets);
+print STDERR "$nFailed of $nRuns runs differ from -x\n";
+exit(($nFailed == 0) ? 0 : 1);
+
+#*************************************************************************
+# Runs agl with the given options on a file and returns its output.
+# Exits if agl fails
+sub RunAGL
+{
+    my($agl, $dataDir, $options, $file) = @_;
+
+    $options .= " -d $dataDir" if($dataDir ne '');
+    my $output = `$agl $options $file`;
+    if($?)
+    {
+        print STDERR "Error (checkexhaustive.pl): agl $options $file " .
+            "failed\n";
+        exit 1;
+    }
+    return($output);
+}
+
+#*************************************************************************
+sub UsageDie
+{
+    print <<__EOF;
+
+checkexhaustive.pl V1.0 (c) 2026 UCL, Prof. Andrew C.R. Martin
+
+Usage: checkexhaustive.pl [-t=testdir] [agl [datadir]]
+       -t Directory containing the test sequences (default src/t)
+
+Runs agl on each file of test sequences with and without -x and
+reports any file for which the results differ. The exit status is
+non-zero if any do.
+
+agl defaults to the agl in the directory above this script.
+
+__EOF
+
+    exit 0;
+}
@@ -0,0 +1,237 @@
+#!/usr/bin/perl
+#*************************************************************************
+#
+#   Program:    agl (Assign Germ Line)
+#   File:       makebindb.pl
+#
+#   Version:    V1.1
+#   Date:       17.10.26
+#   Function:   Compile the .dat files into a binary germline database
+#
+#   Copyright:  (c) UCL / Prof. Andrew C. R. Martin 2026
+#   Author:     Prof. Andrew C. R. Martin
+#   Address:    Institute of Structural and Molecular Biology
+#               Division of Biosciences
+#               University College
+#               Gower Street
+#               London
+#               WC1E 6BT
+#   EMail:      andrew@bioinf.org.uk
+#
+#*************************************************************************
+#
+#   This program is not in the public domain, but it may be copied
+#   according to the conditions laid out in the accompanying file
+#   LICENSE
+#
+#   The code may be modified as required, but any modifications must be
+#   documented so that the person responsible can be identified.
+#
+#   The code may not be sold commercially or included as part of a
+#   commercial product except as described in the file LICENSE.
+#
+#*************************************************************************
+#
+#   Description:
+#   ============
+#   Reads the translated germline .dat files written by makedb.pl
+#   (together with the static data such as hinges.dat) and writes a
+#   single binary file, germline.db, that agl maps into memory
+#   read-only instead of parsing the FASTA files.
+#
+#   The file layout (all integers are unsigned 32-bit little-endian)
+#   must match the definitions in src/germdb.c:
+#
+#   Header:  magic "AGLGDB\0\0", byte order marker (0x01020304),
+#            version, number of types, number of entries, offsets of
+#            the type table, entry table, string arena and residue
+#            arena, sizes of the two arenas and the total file size
+#   Types:   one record per database type: name (32 bytes, NUL
+#            padded), first entry, number of entries
+#   Entries: one record per entry: string offsets of the full header
+#            and of the pre-split region, gene, frame and species
+#            fields, then residue offset and sequence length
+#   Strings: NUL-terminated strings
+#   Residues:NUL-terminated sequences, one after another. Entries with
+#            identical sequences share the same residue offset
+#
+#*************************************************************************
+#
+#   Usage:
+#   ======
+#   makebindb.pl [outfile [datadir ...]]
+#
+#   Defaults to writing ./share/agl/data/germline.db from the .dat
+#   files in ./share/agl/data and ./staticdata
+#
+#*************************************************************************
+#
+#   Revision History:
+#   =================
+#   V1.0   17.10.26   Original   By: ACRM
+#   V1.1   17.10.26   Identical sequences are stored once
+#
+#*************************************************************************
+use strict;
+# Add the path of the executable to the library path
+use FindBin;
+use lib $FindBin::Bin;
+use lib "./";
+use fasta;
+
+my $magic       = "AGLGDB\0\0";
+my $byteOrder   = 0x01020304;
+my $version     = 1;
+my $typeNameLen = 32;
+my $headerSize  = 8 + (12 * 4);
+
+my $outFile  = shift(@ARGV);
+$outFile     = "./share/agl/data/germline.db" if(!defined($outFile));
+my @dataDirs = @ARGV;
+@dataDirs    = ("./share/agl/data", "./staticdata") if(!scalar(@dataDirs));
+
+my @types = ReadDatFiles(@dataDirs);
+WriteBinaryDB($outFile, @types);
+
+#*************************************************************************
+# Reads all the .dat files from the specified directories. Returns a
+# list of hashes, one per database type, each containing the type name
+# and a list of [header, sequence] pairs
+sub ReadDatFiles
+{
+    my(@dataDirs) = @_;
+    my @types = ();
+
+    foreach my $dataDir (@dataDirs)
+    {
+        if(opendir(my $dp, $dataDir))
+        {
+            my @files = sort grep(/\.dat$/, readdir($dp));
+            closedir($dp);
+
+            foreach my $file (@files)
+            {
+                my $type = $file;
+                $type =~ s/\.dat$//;
+                if(length($type) >= $typeNameLen)
+                {
+                    print STDERR "Type name too long: $type\n";
+                    next;
+                }
+
+                my @entries = ();
+                if(open(my $fp, '<', "$dataDir/$file"))
+                {
+                    my($id, $info, $sequence);
+                    while((($id, $info, $sequence) =
+                           fasta::ReadFasta($fp)) && ($id ne ''))
+                    {
+                        push @entries, [$info, $sequence];
+                    }
+                    close $fp;
+                    push @types, {'name' => $type,
+                                  'entries' => \@entries};
+                }
+                else
+                {
+                    print STDERR "Can't read $dataDir/$file\n";
+                }
+            }
+        }
+        else
+        {
+            print STDERR "Can't read directory $dataDir\n";
+        }
+    }
+    return(@types);
+}
+
+#*************************************************************************
+# Splits a header of the form >REGION_GENE_FRAME_SPECIES into its fields
+# in the same way as PrintResult() in agl
+sub SplitHeader
+{
+    my($header) = @_;
+    $header =~ s/^>//;
+    my($region, $gene, $frame, $species) = split(/_/, $header, 4);
+    $region  = '' if(!defined($region));
+    $gene    = '' if(!defined($gene));
+    $frame   = '' if(!defined($frame));
+    $species = '' if(!defined($species));
+    return($region, $gene, $frame, $species);
+}
+
+#*************************************************************************
+# Writes the binary database
+sub WriteBinaryDB
+{
+    my($outFile, @types) = @_;
+    my $strings   = '';
+    my $residues  = '';
+    my %stringPos = ();
+    my %seqPos    = ();
+    my $typeTable = '';
+    my $entryTable = '';
+    my $nEntries  = 0;
+
+    foreach my $type (@types)
+    {
+        my $name = $type->{'name'};
+        $typeTable .= pack("a${typeNameLen}VV", $name, $nEntries,
+                           scalar(@{$type->{'entries'}}));
+
+        foreach my $entry (@{$type->{'entries'}})
+        {
+            my($header, $sequence) = @$entry;
+            my @offsets = ();
+            foreach my $string ($header, SplitHeader($header))
+            {
+                push @offsets, AddString(\$strings, \%stringPos, $string);
+            }
+            my $seqOffset = AddString(\$residues, \%seqPos, $sequence);
+            $entryTable .= pack("V7", @offsets, $seqOffset,
+                                length($sequence));
+            $nEntries++;
+        }
+    }
+
+    my $typesOffset    = $headerSize;
+    my $entriesOffset  = $typesOffset   + length($typeTable);
+    my $stringsOffset  = $entriesOffset + length($entryTable);
+    my $residuesOffset = $stringsOffset + length($strings);
+    my $fileSize       = $residuesOffset + length($residues);
+
+    my $header = $magic . pack("V12", $byteOrder, $version,
+                               scalar(@types), $nEntries,
+                               $typesOffset, $entriesOffset,
+                               $stringsOffset, $residuesOffset,
+                               length($strings), length($residues),
+                               $fileSize, 0);
+
+    my $tmpFile = "$outFile.tmp";
+    if(open(my $fp, '>:raw', $tmpFile))
+    {
+        print $fp $header, $typeTable, $entryTable, $strings, $residues;
+        close $fp;
+        rename($tmpFile, $outFile) ||
+            print STDERR "Can't rename $tmpFile to $outFile\n";
+    }
+    else
+    {
+        print STDERR "Can't write $tmpFile\n";
+    }
+}
+
+#*************************************************************************
+# Adds a string to an arena (if not already there) and returns its
+# offset
+sub AddString
+{
+    my($pStrings, $pStringPos, $string) = @_;
+    if(!defined($$pStringPos{$string}))
+    {
+        $$pStringPos{$string} = length($$pStrings);
+        $$pStrings .= "$string\0";
+    }
+    return($$pStringPos{$string});
+}